@@ -1,11 +1,26 @@
 #include <assert.h>
 #include <errno.h>
 #include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "bigint.h"
+#include "bigint_chunk.h"
+#include "dmath.h"
 #include "CuTest/CuTest.h"
+#ifdef JCCL_BENCHMARK
+#include "timer.h"
+#endif /*JCCL_BENCHMARK*/
+
+/* sse4.1, avx2 and avx-512 kernels for the bitwise operators and hexstrings, chosen at runtime by cpuid */
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__) && ULONG_MAX == 0xffffffffffffffffUL
+#include <immintrin.h>
+#define BIGINT_HAVE_X86_SIMD
+#endif
 
 enum {
 	NIBBLE_BIT = 4,
@@ -23,12 +38,15 @@ enum {
 	NIBBLE_MSB_MASK = 1<<NIBBLE_MSB,
 };
 
-struct bigint {
-	int nchunk;
-	unsigned long pad_chunk;
-	unsigned long chunks[];
-};
+/*
+ * the chunks are stored in one of three places, see struct bigint in
+ * bigint.h:
+ *   - inline_chunks, when they fit.
+ *   - right after the struct, allocated together with it by bigint_init.
+ *   - in a separate allocation when a bigint grows beyond nalloc chunks.
+ */
 #define BIGINT_SIZE(nchunk) sizeof(struct bigint) + sizeof(*((struct bigint *)NULL)->chunks) * (nchunk)
+#define BIGINT_TRAILING_CHUNKS(n) ((unsigned long *)((struct bigint *)(n) + 1))
 
 const char *bigint_hex_charset = "0123456789abcdef";
 enum pad_chunks {
@@ -36,20 +54,149 @@ enum pad_chunks {
 	PAD_CHUNK_NEGATIVE = ULONG_MAX,
 };
 static const unsigned long pad_chunks[] = {PAD_CHUNK_POSITIVE, PAD_CHUNK_NEGATIVE}; // indexed by MSB
-static const struct bigint bigint_one = {.nchunk = 1, .pad_chunk = PAD_CHUNK_POSITIVE, .chunks = {1} };
+
+
+/*
+ * the instruction set extensions the cpu supports for the simd kernels, see
+ * BIGINT_HAVE_X86_SIMD. the kernels for the widest one up to bigint_simd_max
+ * are used.
+ */
+enum bigint_simd {
+	BIGINT_SIMD_NONE,
+	BIGINT_SIMD_SSE41,
+	BIGINT_SIMD_AVX2,
+	BIGINT_SIMD_AVX512,
+};
+static enum bigint_simd bigint_simd_max = BIGINT_SIMD_AVX512; // lowered by the tests to compare the kernels
+
+static enum bigint_simd bigint_simd_supported(void) {
+#ifdef BIGINT_HAVE_X86_SIMD
+	if (__builtin_cpu_supports("avx512f")) {
+		return BIGINT_SIMD_AVX512;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		return BIGINT_SIMD_AVX2;
+	}
+	if (__builtin_cpu_supports("sse4.1")) {
+		return BIGINT_SIMD_SSE41;
+	}
+#endif /* BIGINT_HAVE_X86_SIMD */
+	return BIGINT_SIMD_NONE;
+}
+
+static enum bigint_simd bigint_simd_level(void) {
+	enum bigint_simd simd = bigint_simd_supported();
+	return simd < bigint_simd_max ? simd : bigint_simd_max;
+}
 
 
 static struct bigint *bigint_init(int nchunk) {
 	assert(nchunk > 0);
-	struct bigint *n = (struct bigint *)calloc(1, BIGINT_SIZE(nchunk));
+	int ntrailing = nchunk > BIGINT_INLINE_NCHUNK ? nchunk : 0;
+	struct bigint *n = (struct bigint *)calloc(1, BIGINT_SIZE(ntrailing));
 	if (n == NULL) {
 		return NULL;
 	}
 
 	n->nchunk = nchunk;
+	if (ntrailing > 0) {
+		n->nalloc = ntrailing;
+		n->chunks = BIGINT_TRAILING_CHUNKS(n);
+	} else {
+		n->nalloc = BIGINT_INLINE_NCHUNK;
+		n->chunks = n->inline_chunks;
+	}
 
 	return n;
 }
+
+
+/* whether n->chunks is an allocation of its own */
+static inline int bigint_has_chunk_allocation(const struct bigint *n) {
+	return n->chunks != n->inline_chunks && n->chunks != BIGINT_TRAILING_CHUNKS(n);
+}
+
+
+void bigint_init_inline(struct bigint *n) {
+	if (n != NULL) {
+		*n = (struct bigint)BIGINT_STATIC_INIT(*n);
+	}
+}
+
+
+void bigint_clear(struct bigint *n) {
+	if (n != NULL) {
+		if (bigint_has_chunk_allocation(n)) {
+			free(n->chunks);
+		}
+		bigint_init_inline(n);
+	}
+}
+
+
+/*
+ * make sure there is room for nchunk chunks in n, the contents of n is kept.
+ *
+ * returns:
+ *   error --> errno
+ *   --> 0
+ */
+static int bigint_reserve(struct bigint *n, int nchunk) {
+	assert(n != NULL);
+	if (nchunk <= n->nalloc) {
+		return 0;
+	}
+
+	int nalloc = nchunk > 2*n->nalloc ? nchunk : 2*n->nalloc;
+	unsigned long *chunks;
+	if (!bigint_has_chunk_allocation(n)) {
+		if ((chunks = malloc(nalloc*sizeof(*chunks))) != NULL) {
+			memmove(chunks, n->chunks, n->nchunk*sizeof(*chunks));
+		}
+	} else {
+		chunks = realloc(n->chunks, nalloc*sizeof(*chunks));
+	}
+
+	if (chunks == NULL) {
+		return ENOMEM;
+	}
+
+	n->chunks = chunks;
+	n->nalloc = nalloc;
+	return 0;
+}
+void TestBigint_reserve(CuTest *tc) {
+	struct bigint *n = bigint_init(1);
+	CuAssertPtrNotNull(tc, n);
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(n, 1337));
+
+	CuAssertIntEquals(tc, 0, bigint_reserve(n, BIGINT_INLINE_NCHUNK));
+	CuAssertPtrEquals(tc, n->inline_chunks, n->chunks);
+
+	struct bigint *trailing = bigint_init(BIGINT_INLINE_NCHUNK+1);
+	CuAssertPtrNotNull(tc, trailing);
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(trailing, 1337));
+	CuAssertPtrEquals(tc, BIGINT_TRAILING_CHUNKS(trailing), trailing->chunks);
+
+	struct bigint on_stack = BIGINT_STATIC_INIT(on_stack);
+	on_stack.chunks[0] = 1337;
+
+	for (int i = 2; i < 100; i += 7) {
+		struct bigint *ns[] = {n, trailing, &on_stack};
+		for (int j = 0; j < 3; j++) {
+			CuAssertIntEquals(tc, 0, bigint_reserve(ns[j], i));
+			CuAssertTrue(tc, ns[j]->nalloc >= i);
+			CuAssertIntEquals(tc, 1, ns[j]->nchunk);
+			CuAssertIntEquals(tc, 1337, ns[j]->chunks[0]);
+		}
+	}
+
+	bigint_clear(&on_stack);
+	CuAssertPtrEquals(tc, on_stack.inline_chunks, on_stack.chunks);
+	CuAssertIntEquals(tc, 0, on_stack.chunks[0]);
+	bigint_destroy(trailing);
+	bigint_destroy(n);
+}
 void TestBigint_init(CuTest *tc) {
 	for (int i = 1; i <= 10; i++) {
 		struct bigint *n = bigint_init(i);
@@ -107,25 +254,78 @@ void TestBigint_msb(CuTest *tc) {
 
 void bigint_destroy(struct bigint *n) {
 	if (n != NULL) {
+		if (bigint_has_chunk_allocation(n)) {
+			free(n->chunks);
+		}
 		free(n);
 	}
 }
 
 
-struct bigint *bigint_copy(const struct bigint *n) {
-	if (n == NULL) {
-		return NULL;
+struct bigint *bigint_with_capacity(int nchunk) {
+	struct bigint *n = bigint_init(nchunk > 0 ? nchunk : 1);
+	if (n != NULL) {
+		n->nchunk = 1;
 	}
+	return n;
+}
 
-	struct bigint *res = bigint_init(n->nchunk);
-	if (res == NULL) {
-		return NULL;
+
+/*
+ * the operators are implemented as *_into functions that writes into an
+ * existing bigint, and the allocating versions wraps them with this. nchunk
+ * is the expected size of the result, so that it usually fits without
+ * growing.
+ */
+#define BIGINT_NEW_RESULT(nchunk, into) do {\
+		struct bigint *res = bigint_init(nchunk);\
+		if (res != NULL && (into) != 0) {\
+			bigint_destroy(res);\
+			res = NULL;\
+		}\
+		return res;\
+	} while(0)
+
+
+/* the number of chunks of n when it is normalised, see bigint_defer_normalisation */
+static int bigint_normalised_nchunk(const struct bigint *n) {
+	int i = n->nchunk-1;
+	if (n->unnormalised) {
+		while (i > 0 && n->chunks[i] == n->pad_chunk && pad_chunks[n->chunks[i-1] >> LONG_MSB] == n->pad_chunk) {
+			i--;
+		}
 	}
+	return i+1;
+}
 
-	res->pad_chunk = n->pad_chunk;
-	memmove(res->chunks, n->chunks, n->nchunk*sizeof(*n->chunks));
 
-	return res;
+int bigint_copy_into(struct bigint *dst, const struct bigint *n) {
+	if (dst == NULL || n == NULL) {
+		return EINVAL;
+	}
+	if (dst == n) {
+		return 0;
+	}
+
+	int nchunk = dst->unnormalised ? n->nchunk : bigint_normalised_nchunk(n);
+	if (bigint_reserve(dst, nchunk) != 0) {
+		return ENOMEM;
+	}
+
+	dst->nchunk = nchunk;
+	dst->pad_chunk = n->pad_chunk;
+	memmove(dst->chunks, n->chunks, nchunk*sizeof(*n->chunks));
+
+	return 0;
+}
+
+
+struct bigint *bigint_copy(const struct bigint *n) {
+	if (n == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(n->nchunk, bigint_copy_into(res, n));
 }
 void TestBigint_copy(CuTest *tc) {
 	struct bigint *single_chunk_n = bigint_from_long(pad_chunks[1]);
@@ -156,6 +356,14 @@ static void bigint_identify_pad_chunk_and_trim(struct bigint *n) {
 	int msb = bigint_msb(n, n->nchunk-1);
 	n->pad_chunk = pad_chunks[msb];
 
+	// deferred, only the chunk that sums and differences add on top is dropped
+	if (n->unnormalised) {
+		if (n->nchunk > 1 && n->chunks[n->nchunk-1] == n->pad_chunk && bigint_msb(n, n->nchunk-2) == msb) {
+			n->nchunk--;
+		}
+		return;
+	}
+
 	int i;
 	for (i = n->nchunk-1; i > 0; i--) {
 		if (n->chunks[i] != n->pad_chunk) {
@@ -167,13 +375,8 @@ static void bigint_identify_pad_chunk_and_trim(struct bigint *n) {
 		i++;
 	}
 
-	int new_nchunk = i+1;
-	if (new_nchunk != n->nchunk) {
-		assert(new_nchunk < n->nchunk);
-		n->nchunk = new_nchunk;
-		struct bigint *new_n = realloc(n, BIGINT_SIZE(new_nchunk));
-		assert(new_n == n);
-	}
+	assert(i+1 <= n->nchunk);
+	n->nchunk = i+1; // NOTE: the memory is kept, so that it may be reused by *_into operations
 }
 void TestBigint_identify_pad_chunk_and_trim(CuTest *tc) {
 	struct bigint *untrimable_positive = bigint_init(2);
@@ -219,16 +422,66 @@ void TestBigint_identify_pad_chunk_and_trim(CuTest *tc) {
 }
 
 
-struct bigint *bigint_from_long(unsigned long n) {
-	struct bigint *bigint = bigint_init(1);
-	if (bigint == NULL) {
-		return NULL;
+void bigint_defer_normalisation(struct bigint *n, int defer) {
+	if (n != NULL) {
+		n->unnormalised = defer != 0;
+		bigint_identify_pad_chunk_and_trim(n);
+	}
+}
+
+
+void bigint_normalise(struct bigint *n) {
+	if (n != NULL) {
+		int unnormalised = n->unnormalised;
+		n->unnormalised = 0;
+		bigint_identify_pad_chunk_and_trim(n);
+		n->unnormalised = unnormalised;
+	}
+}
+
+
+/*
+ * dst = the two's complement number in c[0..n), where c must not be the
+ * chunks of dst. it is trimmed before dst is grown, so a value that fits
+ * inline never allocates even if n does not.
+ *
+ * returns:
+ *   error --> errno
+ *   --> 0
+ */
+static int bigint_assign_chunks(struct bigint *dst, const unsigned long *c, int n) {
+	unsigned long pad_chunk = pad_chunks[c[n-1] >> LONG_MSB];
+	int ntrim = dst->unnormalised ? 1 : n;
+	while (ntrim-- > 0 && n > 1 && c[n-1] == pad_chunk && pad_chunks[c[n-2] >> LONG_MSB] == pad_chunk) {
+		n--;
+	}
+
+	if (bigint_reserve(dst, n) != 0) {
+		return ENOMEM;
+	}
+
+	memmove(dst->chunks, c, n*sizeof(*c));
+	dst->nchunk = n;
+	dst->pad_chunk = pad_chunk;
+	return 0;
+}
+
+
+int bigint_from_long_into(struct bigint *dst, unsigned long n) {
+	if (dst == NULL) {
+		return EINVAL;
 	}
 
-	bigint->chunks[0] = n;
+	dst->nchunk = 1;
+	dst->chunks[0] = n;
+
+	bigint_identify_pad_chunk_and_trim(dst);
+	return 0;
+}
+
 
-	bigint_identify_pad_chunk_and_trim(bigint);
-	return bigint;
+struct bigint *bigint_from_long(unsigned long n) {
+	BIGINT_NEW_RESULT(1, bigint_from_long_into(res, n));
 }
 void TestBigint_from_long(CuTest *tc) {
 	unsigned long a_number = 1337;
@@ -249,7 +502,7 @@ int bigint_to_long(const struct bigint *n, unsigned long *result) {
 
 	*result = n->chunks[0];
 
-	return n->nchunk > 1 ? ERANGE : 0;
+	return bigint_normalised_nchunk(n) > 1 ? ERANGE : 0;
 }
 void TestBigint_to_long(CuTest *tc) {
 	unsigned long a_number = 1337;
@@ -263,170 +516,741 @@ void TestBigint_to_long(CuTest *tc) {
 	bigint_destroy(n);
 }
 
+/* -1 when the host is little endian, otherwise 1, see bigint_import */
+static int bigint_native_endian(void) {
+	const union {
+		unsigned long chunk;
+		unsigned char bytes[sizeof(unsigned long)];
+	} one = {1};
+	return one.bytes[0] == 1 ? -1 : 1;
+}
 
-struct bigint *bigint_from_msb_first_hexstring(const char *s, size_t ns) {
-	if (s == NULL) {
-		return NULL;
+/* whether order, size and endian are valid, endian == 0 is replaced by the host byte order */
+static int bigint_valid_layout(int order, size_t size, int *endian) {
+	if ((order != 1 && order != -1) || size == 0 || *endian < -1 || *endian > 1) {
+		return 0;
+	}
+	if (*endian == 0) {
+		*endian = bigint_native_endian();
 	}
+	return 1;
+}
 
-	if (ns == 0) {
-		ns = strlen(s);
+/* whether the bytes are stored like the chunks of the host, least significant first */
+static int bigint_layout_is_native(int order, size_t size, int endian) {
+	return bigint_native_endian() == -1 && order == -1 && (endian == -1 || size == 1);
+}
+
+/* the offset into the data of byte k of the value, counted from the least significant byte */
+static size_t bigint_byte_offset(size_t k, size_t count, int order, size_t size, int endian) {
+	size_t word = k/size, byte = k%size;
+	return (order == -1 ? word : count-1-word)*size + (endian == -1 ? byte : size-1-byte);
+}
+
+/* the number of bits up to and including the most significant one that differs from pad */
+static size_t chunks_nbit_above_pad(const unsigned long *c, int n, unsigned long pad) {
+	int i = n-1;
+	while (i >= 0 && c[i] == pad) {
+		i--;
 	}
+	return i < 0 ? 0 : (size_t)i*LONG_BIT + LONG_BIT - __builtin_clzl(c[i] ^ pad);
+}
 
-	int nchunk = ns/NNIBBLE_IN_LONG;
 
-	int empty_space_in_last_chunk = ns%NNIBBLE_IN_LONG != 0;
-	if(empty_space_in_last_chunk) {
-		nchunk += 1;
+/* the number of bits of |n| */
+static size_t bigint_magnitude_nbit(const struct bigint *n) {
+	size_t nbit = chunks_nbit_above_pad(n->chunks, n->nchunk, n->pad_chunk);
+	if (n->pad_chunk == 0) {
+		return nbit;
 	}
 
-	struct bigint *n = bigint_init(nchunk);
-	if (n == NULL) {
-		goto error;
+	// |n| = ~n + 1 has one bit more than ~n when n = -2^k, i.e. when the lowest set bit is the highest 0
+	int i = 0;
+	while (n->chunks[i] == 0) {
+		i++;
 	}
+	return (size_t)i*LONG_BIT + __builtin_ctzl(n->chunks[i]) == nbit ? nbit+1 : nbit;
+}
 
-	unsigned long nibble;
-	for (size_t i = 0; i < ns; i++) {
-		char *hexchar = strchr(bigint_hex_charset, s[ns-1-i]);
-		if (hexchar == NULL) {
-			goto error;
-		}
 
+int bigint_import_into(struct bigint *dst, const void *data, size_t count, int order, size_t size, int endian, enum bigint_format format) {
+	if (dst == NULL || (data == NULL && count > 0) || !bigint_valid_layout(order, size, &endian)) {
+		return EINVAL;
+	}
 
-		nibble = hexchar-bigint_hex_charset;
+	if (count > ((size_t)INT_MAX-1)*sizeof(unsigned long)/size) {
+		return ERANGE;
+	}
+	size_t nbyte = count*size;
+	int nchunk = nbyte/sizeof(unsigned long) + 1; // the chunk above the bytes is for the sign
+	if (bigint_reserve(dst, nchunk) != 0) {
+		return ENOMEM;
+	}
+	memset(dst->chunks, 0, nchunk*sizeof(*dst->chunks));
 
-		n->chunks[i/NNIBBLE_IN_LONG] |= nibble<<(NIBBLE_BIT * (i%NNIBBLE_IN_LONG));
+	const unsigned char *bytes = data;
+	if (nbyte > 0 && bigint_layout_is_native(order, size, endian)) {
+		memcpy(dst->chunks, bytes, nbyte);
+	} else {
+		for (size_t k = 0; k < nbyte; k++) {
+			unsigned long byte = bytes[bigint_byte_offset(k, count, order, size, endian)];
+			dst->chunks[k/sizeof(unsigned long)] |= byte << (CHAR_BIT*(k%sizeof(unsigned long)));
+		}
 	}
 
-	if (empty_space_in_last_chunk && (nibble>>NIBBLE_MSB) == 1) {
-		n->chunks[n->nchunk-1] |= pad_chunks[1] << (ns%NNIBBLE_IN_LONG);
+	if (format == BIGINT_TWOS_COMPLEMENT && nbyte > 0) {
+		size_t top = nbyte-1; // the byte with the sign bit
+		if ((dst->chunks[top/sizeof(unsigned long)] >> (CHAR_BIT*(top%sizeof(unsigned long)) + CHAR_BIT-1) & 1) == 1) {
+			dst->chunks[nbyte/sizeof(unsigned long)] |= ULONG_MAX << (CHAR_BIT*(nbyte%sizeof(unsigned long)));
+		}
 	}
+	dst->nchunk = nchunk;
 
-	bigint_identify_pad_chunk_and_trim(n);
-	return n;
-error:
-	bigint_destroy(n);
-	return NULL;
+	bigint_identify_pad_chunk_and_trim(dst);
+	return 0;
 }
 
 
-int bigint_nnibble(const struct bigint *n) {
-	return n == NULL ? -EINVAL : n->nchunk*NNIBBLE_IN_LONG;
+struct bigint *bigint_import(const void *data, size_t count, int order, size_t size, int endian, enum bigint_format format) {
+	BIGINT_NEW_RESULT(1, bigint_import_into(res, data, count, order, size, endian, format));
 }
-void TestBigint_nnibble(CuTest *tc) {
-	for (int i = 1; i < 10; i++) {
-		struct bigint *n = bigint_init(i);
-		CuAssertPtrNotNull(tc, n);
 
-		CuAssertIntEquals(tc, i, n->nchunk);
-		CuAssertIntEquals(tc, i*NNIBBLE_IN_LONG, bigint_nnibble(n));
 
-		bigint_destroy(n);
+size_t bigint_export_count(const struct bigint *n, size_t size, enum bigint_format format) {
+	if (n == NULL || size == 0) {
+		return 0;
+	}
+
+	size_t nbit;
+	if (format == BIGINT_TWOS_COMPLEMENT) {
+		nbit = chunks_nbit_above_pad(n->chunks, n->nchunk, n->pad_chunk) + 1;
+	} else {
+		nbit = bigint_magnitude_nbit(n);
 	}
+
+	return (nbit + CHAR_BIT*size - 1) / (CHAR_BIT*size);
 }
 
 
-int bigint_to_msb_first_hexstring(const struct bigint *n, char *s) {
-	if (n == NULL || s == NULL) {
-		return -EINVAL;
+static const unsigned long *bigint_magnitude(const struct bigint *n, unsigned long *buf);
+
+int bigint_export(const struct bigint *n, void *data, size_t count, int order, size_t size, int endian, enum bigint_format format) {
+	if (n == NULL || (data == NULL && count > 0) || !bigint_valid_layout(order, size, &endian)) {
+		return EINVAL;
 	}
 
-	char *start_of_chunk = s;
-	for (int i = n->nchunk-1; i >= 0; i--) {
-		unsigned long chunk = n->chunks[i];
+	if (bigint_export_count(n, size, format) > count) {
+		return ERANGE;
+	}
 
-		for (char *p = start_of_chunk+NNIBBLE_IN_LONG-1; p >= start_of_chunk; p--) {
-			*p = bigint_hex_charset[chunk & NIBBLE_MASK];
-			chunk >>= NIBBLE_BIT;
+	unsigned long small[BIGINT_INLINE_NCHUNK], *buf = NULL;
+	const unsigned long *chunks = n->chunks;
+	unsigned long pad_chunk = n->pad_chunk;
+	if (format == BIGINT_MAGNITUDE && pad_chunk != 0) {
+		if (n->nchunk > BIGINT_INLINE_NCHUNK && (buf = malloc(n->nchunk*sizeof(*buf))) == NULL) {
+			return ENOMEM;
 		}
+		chunks = bigint_magnitude(n, buf != NULL ? buf : small);
+		pad_chunk = 0;
+	}
 
-		start_of_chunk += NNIBBLE_IN_LONG;
+	// the value fits, so the bytes above nbyte are all padding
+	unsigned char *bytes = data;
+	size_t nbyte = count*size, nvalue = (size_t)n->nchunk*sizeof(unsigned long);
+	if (nvalue > nbyte) {
+		nvalue = nbyte;
+	}
+	if (nbyte > 0 && bigint_layout_is_native(order, size, endian)) {
+		memcpy(bytes, chunks, nvalue);
+		memset(bytes+nvalue, (unsigned char)pad_chunk, nbyte-nvalue);
+	} else {
+		for (size_t k = 0; k < nbyte; k++) {
+			unsigned long chunk = k < nvalue ? chunks[k/sizeof(unsigned long)] : pad_chunk;
+			bytes[bigint_byte_offset(k, count, order, size, endian)] = chunk >> (CHAR_BIT*(k%sizeof(unsigned long)));
+		}
 	}
-	*start_of_chunk = '\0';
 
-	return start_of_chunk-s;
+	free(buf);
+	return 0;
 }
 
 
-void TestBigintCreationAndHextring(CuTest *tc) {
-	enum {
-		RES_LEN = 128,
-	};
-
-	const unsigned long n_uint = (1UL<<31) - 1;
-	char const * const n_hexstring =          "000000007fffffff";
-	size_t n_hexstring_len = strlen(n_hexstring);
-
-	struct bigint *bns[3];
-	CuAssertPtrNotNull(tc, (bns[0] = bigint_from_long(n_uint)));
-	CuAssertPtrNotNull(tc, (bns[1] = bigint_from_msb_first_hexstring(n_hexstring, 16)));
-	CuAssertPtrNotNull(tc, (bns[2] = bigint_from_msb_first_hexstring(n_hexstring, 0)));
+const struct bigint *bigint_view(struct bigint *view, const unsigned long *chunks, int nchunk) {
+	if (view == NULL || chunks == NULL || nchunk < 1 || (uintptr_t)chunks % _Alignof(unsigned long) != 0) {
+		return NULL;
+	}
 
-	char res[RES_LEN];
+	view->nchunk = nchunk;
+	view->nalloc = nchunk;
+	view->unnormalised = 0;
+	view->chunks = (unsigned long *)chunks; // never written, see bigint.h
+	memset(view->inline_chunks, 0, sizeof(view->inline_chunks));
 
-	for (int i = 0; i < 3; i++) {
-		CuAssertIntEquals(tc, n_hexstring_len, bigint_to_msb_first_hexstring(bns[i], res));
-		CuAssertStrEquals(tc, n_hexstring, res);
-		bigint_destroy(bns[i]);
-	}
+	bigint_identify_pad_chunk_and_trim(view); // only reads the chunks
+	return view;
+}
 
-	char const * const multi_long_hexstring =                    "effffffffffffffff";
-	char const * const multi_long_hexstring_res = "fffffffffffffffeffffffffffffffff";
-	size_t multi_long_hexstring_res_len = strlen(multi_long_hexstring_res);
 
-	CuAssertPtrNotNull(tc, (bns[0] = bigint_from_msb_first_hexstring(multi_long_hexstring, 17)));
-	CuAssertPtrNotNull(tc, (bns[1] = bigint_from_msb_first_hexstring(multi_long_hexstring, 0)));
 
-	for (int i = 0; i < 2; i++) {
-		CuAssertIntEquals(tc, multi_long_hexstring_res_len, bigint_to_msb_first_hexstring(bns[i], res));
-		CuAssertStrEquals(tc, multi_long_hexstring_res, res);
-		bigint_destroy(bns[i]);
+static unsigned random_chunks_ncall = 0;
+static void random_chunks(unsigned long *r, int n) {
+	for (int i = 0; i < n; i++) {
+		switch ((random_chunks_ncall++ + (unsigned)rand()) % 8) {
+			case 0: r[i] = 0; break; // provoke edge cases in carry propagation
+			case 1: r[i] = ULONG_MAX; break;
+			default: r[i] = ((unsigned long)rand() << 42) ^ ((unsigned long)rand() << 21) ^ rand(); break;
+		}
 	}
 }
 
 
-int bigint_compare(const struct bigint *a, const struct bigint *b) {
-	if (a == NULL) {
-		return b == NULL ? 0 : -1;
-	} else if (b == NULL) {
-		return a == NULL ? 0 : 1;
+static struct bigint *bigint_random_for_test(int nchunk) {
+	struct bigint *n = bigint_init(nchunk);
+	if (n != NULL) {
+		random_chunks(n->chunks, nchunk);
+		bigint_identify_pad_chunk_and_trim(n);
 	}
+	return n;
+}
 
-	int a_msb = bigint_msb(a, -1);
-	int b_msb = bigint_msb(b, -1);
 
-	if (a_msb != b_msb) {
-		return a_msb == 1 ? -1 : 1;
+void TestBigintImportExport(CuTest *tc) {
+	enum {
+		MAX_NBYTE = 16*sizeof(unsigned long),
+	};
+	unsigned char bytes[MAX_NBYTE];
+
+	const unsigned char abcd[] = {0x0a, 0x0b, 0x0c, 0x0d};
+	const struct {
+		int order;
+		size_t size;
+		int endian;
+		enum bigint_format format;
+		long expected;
+	} layouts[] = {
+		{-1, 1, 0, BIGINT_MAGNITUDE, 0x0d0c0b0a},
+		{1, 1, 0, BIGINT_MAGNITUDE, 0x0a0b0c0d},
+		{1, 2, -1, BIGINT_MAGNITUDE, 0x0b0a0d0c},
+		{-1, 2, 1, BIGINT_MAGNITUDE, 0x0c0d0a0b},
+		{-1, 4, 1, BIGINT_MAGNITUDE, 0x0a0b0c0d},
+		{1, 1, 0, BIGINT_TWOS_COMPLEMENT, 0x0a0b0c0d},
+	};
+	for (size_t i = 0; i < sizeof(layouts)/sizeof(*layouts); i++) {
+		struct bigint *n = bigint_import(abcd, sizeof(abcd)/layouts[i].size, layouts[i].order, layouts[i].size, layouts[i].endian, layouts[i].format);
+		struct bigint *expected = bigint_from_long(layouts[i].expected);
+		CuAssertIntEquals(tc, 0, bigint_compare(expected, n));
+		CuAssertIntEquals(tc, 0, bigint_export(n, bytes, sizeof(abcd)/layouts[i].size, layouts[i].order, layouts[i].size, layouts[i].endian, layouts[i].format));
+		CuAssertIntEquals(tc, 0, memcmp(abcd, bytes, sizeof(abcd)));
+		bigint_destroy(n);
+		bigint_destroy(expected);
 	}
 
-	if (a->nchunk != b->nchunk) {
-		int abs_res = a->nchunk > b->nchunk ? 1 : -1;
-		return a_msb == 1 ? -abs_res : abs_res;
+	// the sign and the padding
+	const unsigned char minus_128[] = {0x80, 0xff, 0xff, 0xff}, plus_128[] = {0x80, 0, 0, 0};
+	struct bigint *n = bigint_import(minus_128, 1, -1, 1, 0, BIGINT_TWOS_COMPLEMENT), *expected = bigint_from_long(-128);
+	CuAssertIntEquals(tc, 0, bigint_compare(expected, n));
+	CuAssertIntEquals(tc, 1, bigint_export_count(n, 1, BIGINT_TWOS_COMPLEMENT));
+	CuAssertIntEquals(tc, 1, bigint_export_count(n, 1, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, 0, bigint_export(n, bytes, 4, -1, 1, 0, BIGINT_TWOS_COMPLEMENT));
+	CuAssertIntEquals(tc, 0, memcmp(minus_128, bytes, 4));
+	CuAssertIntEquals(tc, 0, bigint_export(n, bytes, 4, -1, 1, 0, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, 0, memcmp(plus_128, bytes, 4));
+	bigint_destroy(n);
+	n = bigint_import(minus_128, 1, -1, 1, 0, BIGINT_MAGNITUDE);
+	CuAssertIntEquals(tc, 0, bigint_export(n, bytes, 4, -1, 1, 0, BIGINT_TWOS_COMPLEMENT));
+	CuAssertIntEquals(tc, 0, memcmp(plus_128, bytes, 4));
+	CuAssertIntEquals(tc, 2, bigint_export_count(n, 1, BIGINT_TWOS_COMPLEMENT));
+	CuAssertIntEquals(tc, ERANGE, bigint_export(n, bytes, 1, -1, 1, 0, BIGINT_TWOS_COMPLEMENT));
+	CuAssertIntEquals(tc, 0, bigint_export(n, bytes, 1, -1, 1, 0, BIGINT_MAGNITUDE));
+	bigint_destroy(n);
+	bigint_destroy(expected);
+
+	n = bigint_from_long(0);
+	CuAssertIntEquals(tc, 0, bigint_export_count(n, 1, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, 1, bigint_export_count(n, 1, BIGINT_TWOS_COMPLEMENT));
+	CuAssertIntEquals(tc, 0, bigint_export(n, NULL, 0, 1, 1, 0, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, 0, bigint_import_into(n, NULL, 0, 1, 1, 0, BIGINT_TWOS_COMPLEMENT));
+	CuAssertIntEquals(tc, 0, bigint_compare(n, expected = bigint_from_long(0)));
+	CuAssertIntEquals(tc, EINVAL, bigint_import_into(n, abcd, 1, 0, 1, 0, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, EINVAL, bigint_export(n, bytes, 1, 1, 0, 0, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, EINVAL, bigint_export(n, bytes, 1, 1, 1, 2, BIGINT_MAGNITUDE));
+	bigint_destroy(n);
+	bigint_destroy(expected);
+
+	// round trips through every layout, including the -2^k whose magnitude is one bit longer than the rest
+	const int orders[] = {-1, 1}, endians[] = {-1, 0, 1};
+	const size_t sizes[] = {1, 2, 3, 8, 16};
+	for (int nchunk = 1; nchunk <= 4; nchunk++) {
+		for (int j = 0; j < 4; j++) {
+			struct bigint *a = bigint_random_for_test(nchunk);
+			if (j == 3) {
+				bigint_destroy(a);
+				struct bigint *minus_one = bigint_from_long(-1);
+				a = bigint_shl_ul(minus_one, nchunk*LONG_BIT - 1);
+				bigint_destroy(minus_one);
+			}
+			struct bigint *abs = bigint_abs(a);
+			for (size_t k = 0; k < sizeof(sizes)/sizeof(*sizes); k++) {
+				for (size_t o = 0; o < 2; o++) {
+					for (size_t e = 0; e < 3; e++) {
+						size_t count = bigint_export_count(a, sizes[k], BIGINT_TWOS_COMPLEMENT);
+						CuAssertIntEquals(tc, 0, bigint_export(a, bytes, count, orders[o], sizes[k], endians[e], BIGINT_TWOS_COMPLEMENT));
+						struct bigint *b = bigint_import(bytes, count, orders[o], sizes[k], endians[e], BIGINT_TWOS_COMPLEMENT);
+						CuAssertIntEquals(tc, 0, bigint_compare(a, b));
+						CuAssertIntEquals(tc, ERANGE, bigint_export(a, bytes, count-1, orders[o], sizes[k], endians[e], BIGINT_TWOS_COMPLEMENT));
+						bigint_destroy(b);
+
+						count = bigint_export_count(a, sizes[k], BIGINT_MAGNITUDE);
+						CuAssertIntEquals(tc, 0, bigint_export(a, bytes, count, orders[o], sizes[k], endians[e], BIGINT_MAGNITUDE));
+						b = bigint_import(bytes, count, orders[o], sizes[k], endians[e], BIGINT_MAGNITUDE);
+						CuAssertIntEquals(tc, 0, bigint_compare(abs, b));
+						CuAssertIntEquals(tc, count > 0 ? ERANGE : 0, bigint_export(a, bytes, count-1, orders[o], sizes[k], endians[e], BIGINT_MAGNITUDE));
+						bigint_destroy(b);
+					}
+				}
+			}
+			bigint_destroy(a);
+			bigint_destroy(abs);
+		}
 	}
+}
 
-	for (int i = a->nchunk-1; i >= 0; i--) {
-		if (a->chunks[i] != b->chunks[i]) {
-			return a->chunks[i] > b->chunks[i] ? 1 : -1;
+
+void TestBigint_view(CuTest *tc) {
+	enum {
+		RES_LEN = 3*NNIBBLE_IN_LONG+1,
+	};
+	const unsigned long chunks[] = {5, 0, 0}, minus_one[] = {ULONG_MAX, ULONG_MAX}, unsigned_max[] = {ULONG_MAX, 0};
+	struct bigint storage, other_storage;
+
+	const struct bigint *view = bigint_view(&storage, chunks, 3);
+	struct bigint *five = bigint_from_long(5), *res = bigint_with_capacity(1);
+	CuAssertPtrEquals(tc, &storage, (void *)view);
+	CuAssertIntEquals(tc, 1, view->nchunk); // trimmed
+	CuAssertIntEquals(tc, 0, bigint_compare(five, view));
+	CuAssertIntEquals(tc, 0, bigint_xor_into(res, view, five));
+	CuAssertIntEquals(tc, 0, bigint_compare(res, bigint_view(&other_storage, chunks+1, 1)));
+
+	view = bigint_view(&storage, minus_one, 2);
+	CuAssertIntEquals(tc, 0, bigint_and_into(res, view, five));
+	CuAssertIntEquals(tc, 0, bigint_compare(five, res));
+	CuAssertIntEquals(tc, -1, bigint_compare(view, five));
+
+	view = bigint_view(&storage, unsigned_max, 2);
+	char s[RES_LEN];
+	CuAssertIntEquals(tc, 2*NNIBBLE_IN_LONG, bigint_to_msb_first_hexstring(view, s));
+	CuAssertStrEquals(tc, "0000000000000000ffffffffffffffff", s);
+	CuAssertIntEquals(tc, 0, bigint_add_into(res, view, view));
+	CuAssertIntEquals(tc, 1, bigint_compare(res, view));
+	CuAssertTrue(tc, unsigned_max[0] == ULONG_MAX && unsigned_max[1] == 0);
+
+	CuAssertPtrEquals(tc, NULL, (void *)bigint_view(NULL, chunks, 1));
+	CuAssertPtrEquals(tc, NULL, (void *)bigint_view(&storage, NULL, 1));
+	CuAssertPtrEquals(tc, NULL, (void *)bigint_view(&storage, chunks, 0));
+	CuAssertPtrEquals(tc, NULL, (void *)bigint_view(&storage, (const unsigned long *)((const char *)chunks + 1), 1));
+
+	bigint_destroy(five);
+	bigint_destroy(res);
+}
+
+
+/*
+ * hexstring kernels. a chunk is NNIBBLE_IN_LONG characters with the most
+ * significant nibble first, and n chunks are stored in s in the order
+ * chunks[n-1], ..., chunks[0]. the parsers return -1 when s has a character
+ * that is not in bigint_hex_charset, otherwise 0.
+ */
+typedef int chunks_from_hex_fn(unsigned long *chunks, const char *s, int n);
+typedef void chunks_to_hex_fn(char *s, const unsigned long *chunks, int n);
+
+/* *chunk = the ns <= NNIBBLE_IN_LONG characters in s */
+static int chunk_from_hex(unsigned long *chunk, const char *s, int ns) {
+	unsigned long value = 0;
+	for (int i = 0; i < ns; i++) {
+		unsigned long nibble;
+		if (s[i] >= '0' && s[i] <= '9') {
+			nibble = s[i] - '0';
+		} else if (s[i] >= 'a' && s[i] <= 'f') {
+			nibble = s[i] - 'a' + 10;
+		} else {
+			return -1;
 		}
+		value = (value << NIBBLE_BIT) | nibble;
 	}
 
+	*chunk = value;
 	return 0;
 }
-void TestBigint_compare(CuTest *tc) {
-	struct bigint *zero = bigint_from_long(0), *four = bigint_from_long(4);
-	CuAssertPtrNotNull(tc, zero);
-	CuAssertPtrNotNull(tc, four);
 
-	struct bigint *long_min = bigint_from_long(LONG_MIN), *long_max = bigint_from_long(LONG_MAX);
-	CuAssertPtrNotNull(tc, long_min);
-	CuAssertPtrNotNull(tc, long_max);
+static int chunks_from_hex_scalar(unsigned long *chunks, const char *s, int n) {
+	for (int i = 0; i < n; i++) {
+		if (chunk_from_hex(&chunks[i], s + (size_t)NNIBBLE_IN_LONG*(n-1-i), NNIBBLE_IN_LONG) != 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
 
-	struct bigint *longer_min = bigint_shift_left(long_min, four), *longer_max = bigint_shift_left(long_max, four);
-	CuAssertPtrNotNull(tc, longer_min);
-	CuAssertPtrNotNull(tc, longer_max);
+static void chunks_to_hex_scalar(char *s, const unsigned long *chunks, int n) {
+	for (int i = n-1; i >= 0; i--) {
+		unsigned long chunk = chunks[i];
+		for (char *p = s+NNIBBLE_IN_LONG-1; p >= s; p--) {
+			*p = bigint_hex_charset[chunk & NIBBLE_MASK];
+			chunk >>= NIBBLE_BIT;
+		}
+		s += NNIBBLE_IN_LONG;
+	}
+}
 
-	CuAssertIntEquals(tc, 0, bigint_compare(NULL, NULL));
-	CuAssertIntEquals(tc, 1, bigint_compare(longer_max, NULL));
+#ifdef BIGINT_HAVE_X86_SIMD
+/*
+ * the characters are validated and turned into nibbles by subtracting '0'
+ * and 'a' followed by unsigned range checks, then maddubs combines the pairs
+ * of nibbles into bytes and the 8 bytes of each chunk are packed together,
+ * most significant first. sse4.1 converts one chunk per step and avx2 two.
+ */
+__attribute__((target("sse4.1")))
+static int chunks_from_hex_sse41(unsigned long *chunks, const char *s, int n) {
+	unsigned invalid = 0;
+	for (int i = 0; i < n; i++) {
+		__m128i c = _mm_loadu_si128((const __m128i *)(s + (size_t)NNIBBLE_IN_LONG*(n-1-i)));
+		__m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0')), letter = _mm_sub_epi8(c, _mm_set1_epi8('a'));
+		__m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+		__m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+		invalid |= _mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) ^ 0xffff;
+
+		__m128i nibbles = _mm_blendv_epi8(_mm_add_epi8(letter, _mm_set1_epi8(10)), digit, is_digit);
+		__m128i bytes = _mm_maddubs_epi16(nibbles, _mm_set1_epi16(0x0110)); // 16*high + low
+		chunks[i] = __builtin_bswap64(_mm_cvtsi128_si64(_mm_packus_epi16(bytes, bytes)));
+	}
+	return invalid != 0 ? -1 : 0;
+}
+
+__attribute__((target("avx2")))
+static int chunks_from_hex_avx2(unsigned long *chunks, const char *s, int n) {
+	unsigned invalid = 0;
+	int i;
+	for (i = 0; i+2 <= n; i += 2) {
+		__m256i c = _mm256_loadu_si256((const __m256i *)(s + (size_t)NNIBBLE_IN_LONG*(n-2-i))); // chunks[i+1] and chunks[i]
+		__m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0')), letter = _mm256_sub_epi8(c, _mm256_set1_epi8('a'));
+		__m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+		__m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+		invalid |= ~(unsigned)_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_letter));
+
+		__m256i nibbles = _mm256_blendv_epi8(_mm256_add_epi8(letter, _mm256_set1_epi8(10)), digit, is_digit);
+		__m256i bytes = _mm256_maddubs_epi16(nibbles, _mm256_set1_epi16(0x0110));
+		bytes = _mm256_packus_epi16(bytes, bytes); // within each 128 bit lane
+		chunks[i+1] = __builtin_bswap64(_mm256_extract_epi64(bytes, 0));
+		chunks[i] = __builtin_bswap64(_mm256_extract_epi64(bytes, 2));
+	}
+	if (i < n && chunks_from_hex_sse41(chunks+i, s, n-i) != 0) {
+		return -1;
+	}
+	return invalid != 0 ? -1 : 0;
+}
+
+/* the reverse: the nibbles of each chunk are interleaved most significant first and looked up in the charset by pshufb */
+__attribute__((target("sse4.1")))
+static void chunks_to_hex_sse41(char *s, const unsigned long *chunks, int n) {
+	const __m128i charset = _mm_loadu_si128((const __m128i *)bigint_hex_charset), mask = _mm_set1_epi8(NIBBLE_MASK);
+	for (int i = 0; i < n; i++) {
+		__m128i x = _mm_cvtsi64_si128(__builtin_bswap64(chunks[n-1-i]));
+		__m128i nibbles = _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(x, NIBBLE_BIT), mask), _mm_and_si128(x, mask));
+		_mm_storeu_si128((__m128i *)(s + (size_t)NNIBBLE_IN_LONG*i), _mm_shuffle_epi8(charset, nibbles));
+	}
+}
+
+__attribute__((target("avx2")))
+static void chunks_to_hex_avx2(char *s, const unsigned long *chunks, int n) {
+	const __m256i charset = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)bigint_hex_charset));
+	const __m256i mask = _mm256_set1_epi8(NIBBLE_MASK);
+	int i;
+	for (i = 0; i+2 <= n; i += 2) {
+		__m256i x = _mm256_setr_epi64x(__builtin_bswap64(chunks[n-1-i]), 0, __builtin_bswap64(chunks[n-2-i]), 0);
+		__m256i nibbles = _mm256_unpacklo_epi8(_mm256_and_si256(_mm256_srli_epi16(x, NIBBLE_BIT), mask), _mm256_and_si256(x, mask));
+		_mm256_storeu_si256((__m256i *)(s + (size_t)NNIBBLE_IN_LONG*i), _mm256_shuffle_epi8(charset, nibbles));
+	}
+	chunks_to_hex_sse41(s + (size_t)NNIBBLE_IN_LONG*i, chunks, n-i);
+}
+#endif /* BIGINT_HAVE_X86_SIMD */
+
+static chunks_from_hex_fn *chunks_from_hex_select(void) {
+	switch (bigint_simd_level()) {
+#ifdef BIGINT_HAVE_X86_SIMD
+		case BIGINT_SIMD_AVX512:
+		case BIGINT_SIMD_AVX2: return chunks_from_hex_avx2;
+		case BIGINT_SIMD_SSE41: return chunks_from_hex_sse41;
+#endif /* BIGINT_HAVE_X86_SIMD */
+		default: return chunks_from_hex_scalar;
+	}
+}
+
+static chunks_to_hex_fn *chunks_to_hex_select(void) {
+	switch (bigint_simd_level()) {
+#ifdef BIGINT_HAVE_X86_SIMD
+		case BIGINT_SIMD_AVX512:
+		case BIGINT_SIMD_AVX2: return chunks_to_hex_avx2;
+		case BIGINT_SIMD_SSE41: return chunks_to_hex_sse41;
+#endif /* BIGINT_HAVE_X86_SIMD */
+		default: return chunks_to_hex_scalar;
+	}
+}
+
+
+struct bigint *bigint_from_msb_first_hexstring(const char *s, size_t ns) {
+	if (s == NULL) {
+		return NULL;
+	}
+
+	if (ns == 0) {
+		ns = strlen(s);
+	}
+
+	int nfull = ns/NNIBBLE_IN_LONG, nrest = ns%NNIBBLE_IN_LONG;
+	struct bigint *n = bigint_init(nfull + (nrest != 0));
+	if (n == NULL) {
+		goto error;
+	}
+
+	// the first nrest characters are the most significant chunk, sign extended from its top nibble
+	if (nrest != 0) {
+		unsigned long *chunk = &n->chunks[nfull];
+		if (chunk_from_hex(chunk, s, nrest) != 0) {
+			goto error;
+		}
+		if ((*chunk >> (NIBBLE_BIT*nrest - 1)) == 1) {
+			*chunk |= pad_chunks[1] << (NIBBLE_BIT*nrest);
+		}
+	}
+
+	if (chunks_from_hex_select()(n->chunks, s+nrest, nfull) != 0) {
+		goto error;
+	}
+
+	bigint_identify_pad_chunk_and_trim(n);
+	return n;
+error:
+	bigint_destroy(n);
+	return NULL;
+}
+
+
+int bigint_nnibble(const struct bigint *n) {
+	return n == NULL ? -EINVAL : bigint_normalised_nchunk(n)*NNIBBLE_IN_LONG;
+}
+void TestBigint_nnibble(CuTest *tc) {
+	for (int i = 1; i < 10; i++) {
+		struct bigint *n = bigint_init(i);
+		CuAssertPtrNotNull(tc, n);
+
+		CuAssertIntEquals(tc, i, n->nchunk);
+		CuAssertIntEquals(tc, i*NNIBBLE_IN_LONG, bigint_nnibble(n));
+
+		bigint_destroy(n);
+	}
+}
+
+
+int bigint_to_msb_first_hexstring(const struct bigint *n, char *s) {
+	if (n == NULL || s == NULL) {
+		return -EINVAL;
+	}
+
+	int nchunk = bigint_normalised_nchunk(n);
+	chunks_to_hex_select()(s, n->chunks, nchunk);
+	s[nchunk*NNIBBLE_IN_LONG] = '\0';
+
+	return nchunk*NNIBBLE_IN_LONG;
+}
+
+
+void TestBigintCreationAndHextring(CuTest *tc) {
+	enum {
+		RES_LEN = 128,
+	};
+
+	const unsigned long n_uint = (1UL<<31) - 1;
+	char const * const n_hexstring =          "000000007fffffff";
+	size_t n_hexstring_len = strlen(n_hexstring);
+
+	struct bigint *bns[3];
+	CuAssertPtrNotNull(tc, (bns[0] = bigint_from_long(n_uint)));
+	CuAssertPtrNotNull(tc, (bns[1] = bigint_from_msb_first_hexstring(n_hexstring, 16)));
+	CuAssertPtrNotNull(tc, (bns[2] = bigint_from_msb_first_hexstring(n_hexstring, 0)));
+
+	char res[RES_LEN];
+
+	for (int i = 0; i < 3; i++) {
+		CuAssertIntEquals(tc, n_hexstring_len, bigint_to_msb_first_hexstring(bns[i], res));
+		CuAssertStrEquals(tc, n_hexstring, res);
+		bigint_destroy(bns[i]);
+	}
+
+	char const * const multi_long_hexstring =                    "effffffffffffffff";
+	char const * const multi_long_hexstring_res = "fffffffffffffffeffffffffffffffff";
+	size_t multi_long_hexstring_res_len = strlen(multi_long_hexstring_res);
+
+	CuAssertPtrNotNull(tc, (bns[0] = bigint_from_msb_first_hexstring(multi_long_hexstring, 17)));
+	CuAssertPtrNotNull(tc, (bns[1] = bigint_from_msb_first_hexstring(multi_long_hexstring, 0)));
+
+	for (int i = 0; i < 2; i++) {
+		CuAssertIntEquals(tc, multi_long_hexstring_res_len, bigint_to_msb_first_hexstring(bns[i], res));
+		CuAssertStrEquals(tc, multi_long_hexstring_res, res);
+		bigint_destroy(bns[i]);
+	}
+}
+
+
+void TestBigintHexstringKernels(CuTest *tc) {
+	enum {
+		MAX_NCHUNK = 37,
+		MAX_LEN = MAX_NCHUNK*NNIBBLE_IN_LONG,
+	};
+	unsigned long chunks[MAX_NCHUNK], res[MAX_NCHUNK];
+	char expected[MAX_LEN+1], s[MAX_LEN+1];
+
+	enum bigint_simd supported = bigint_simd_supported();
+	for (enum bigint_simd simd = BIGINT_SIMD_NONE; simd <= supported; simd++) {
+		bigint_simd_max = simd;
+		for (int n = 0; n <= MAX_NCHUNK; n++) {
+			random_chunks(chunks, n);
+			chunks_to_hex_scalar(expected, chunks, n);
+			memset(s, 0, sizeof(s));
+			chunks_to_hex_select()(s, chunks, n);
+			CuAssertIntEquals(tc, 0, memcmp(expected, s, n*NNIBBLE_IN_LONG));
+			CuAssertIntEquals(tc, 0, chunks_from_hex_select()(res, s, n));
+			CuAssertIntEquals(tc, 0, memcmp(chunks, res, n*sizeof(*res)));
+		}
+
+		// every character that is not in the charset, at every position
+		for (int c = 1; c < 256; c++) {
+			if (strchr(bigint_hex_charset, c) != NULL) {
+				continue;
+			}
+			for (int i = 0; i < 3*NNIBBLE_IN_LONG; i += (c & 7) + 1) {
+				memcpy(s, expected, 3*NNIBBLE_IN_LONG);
+				s[i] = c;
+				CuAssertIntEquals(tc, -1, chunks_from_hex_select()(res, s, 3));
+			}
+		}
+	}
+	bigint_simd_max = BIGINT_SIMD_AVX512;
+
+	// the top chunk is sign extended from its first nibble, also when it is not a full chunk
+	const char *hexstrings[][2] = {
+		{"8", "fffffffffffffff8"},
+		{"7", "0000000000000007"},
+		{"f0", "fffffffffffffff0"},
+		{"8000000000000000", "8000000000000000"},
+		{"80000000000000001", "fffffffffffffff80000000000000001"},
+	};
+	for (size_t i = 0; i < sizeof(hexstrings)/sizeof(*hexstrings); i++) {
+		struct bigint *n = bigint_from_msb_first_hexstring(hexstrings[i][0], 0);
+		CuAssertPtrNotNull(tc, n);
+		CuAssertIntEquals(tc, strlen(hexstrings[i][1]), bigint_to_msb_first_hexstring(n, s));
+		CuAssertStrEquals(tc, hexstrings[i][1], s);
+		bigint_destroy(n);
+	}
+
+	CuAssertPtrEquals(tc, NULL, bigint_from_msb_first_hexstring("123456789abcdefg", 0));
+	CuAssertPtrEquals(tc, NULL, bigint_from_msb_first_hexstring("1A", 0));
+	CuAssertPtrEquals(tc, NULL, bigint_from_msb_first_hexstring("12\0", 3));
+}
+
+
+void TestBigintHexstringBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		NCHUNK = 1<<16,
+		LEN = NCHUNK*NNIBBLE_IN_LONG,
+		NITERATION = 100,
+	};
+	const char *simd_names[] = {"scalar", "sse4.1", "avx2", "avx512"};
+
+	struct bigint *n = bigint_random_for_test(NCHUNK), *res = NULL;
+	char *s = malloc(LEN+1);
+	CuAssertPtrNotNull(tc, n);
+	CuAssertPtrNotNull(tc, s);
+
+	// throughput in bytes of hexstring per second
+#undef TIMED_BLOCK_ACTION
+#define TIMED_BLOCK_ACTION(description, mean_duration) printf("%s %g bytes/s\n", (description), LEN/(mean_duration))
+	enum bigint_simd supported = bigint_simd_supported();
+	for (enum bigint_simd simd = BIGINT_SIMD_NONE; simd <= supported; simd++) {
+		char description[64];
+		bigint_simd_max = simd;
+		snprintf(description, sizeof(description), "%s to hexstring", simd_names[simd]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_to_msb_first_hexstring(n, s);
+		}
+		snprintf(description, sizeof(description), "%s from hexstring", simd_names[simd]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_destroy(res);
+			res = bigint_from_msb_first_hexstring(s, LEN);
+		}
+		CuAssertIntEquals(tc, 0, bigint_compare(n, res));
+	}
+	bigint_simd_max = BIGINT_SIMD_AVX512;
+#undef TIMED_BLOCK_ACTION
+#define TIMED_BLOCK_ACTION(description, mean_duration) printf("%s %g\n", (description), (mean_duration))
+
+	bigint_destroy(n);
+	bigint_destroy(res);
+	free(s);
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
+
+
+int bigint_compare(const struct bigint *a, const struct bigint *b) {
+	if (a == NULL) {
+		return b == NULL ? 0 : -1;
+	} else if (b == NULL) {
+		return a == NULL ? 0 : 1;
+	}
+
+	int na = bigint_normalised_nchunk(a), nb = bigint_normalised_nchunk(b);
+	if (na == 1 && nb == 1) {
+		long a0 = a->chunks[0], b0 = b->chunks[0];
+		return (a0 > b0) - (a0 < b0);
+	}
+
+	int a_msb = bigint_msb(a, -1);
+	int b_msb = bigint_msb(b, -1);
+
+	if (a_msb != b_msb) {
+		return a_msb == 1 ? -1 : 1;
+	}
+
+	if (na != nb) {
+		int abs_res = na > nb ? 1 : -1;
+		return a_msb == 1 ? -abs_res : abs_res;
+	}
+
+	for (int i = na-1; i >= 0; i--) {
+		if (a->chunks[i] != b->chunks[i]) {
+			return a->chunks[i] > b->chunks[i] ? 1 : -1;
+		}
+	}
+
+	return 0;
+}
+void TestBigint_compare(CuTest *tc) {
+	struct bigint *zero = bigint_from_long(0), *four = bigint_from_long(4);
+	CuAssertPtrNotNull(tc, zero);
+	CuAssertPtrNotNull(tc, four);
+
+	struct bigint *long_min = bigint_from_long(LONG_MIN), *long_max = bigint_from_long(LONG_MAX);
+	CuAssertPtrNotNull(tc, long_min);
+	CuAssertPtrNotNull(tc, long_max);
+
+	struct bigint *longer_min = bigint_shift_left(long_min, four), *longer_max = bigint_shift_left(long_max, four);
+	CuAssertPtrNotNull(tc, longer_min);
+	CuAssertPtrNotNull(tc, longer_max);
+
+	CuAssertIntEquals(tc, 0, bigint_compare(NULL, NULL));
+	CuAssertIntEquals(tc, 1, bigint_compare(longer_max, NULL));
 	CuAssertIntEquals(tc, 1, bigint_compare(longer_min, NULL));
 	CuAssertIntEquals(tc, -1, bigint_compare(NULL, longer_max));
 	CuAssertIntEquals(tc, -1, bigint_compare(NULL, longer_min));
@@ -461,341 +1285,6874 @@ void TestBigint_compare(CuTest *tc) {
 }
 
 
+/*
+ * r = a op b, or r = a op pad for every chunk when b == NULL. each chunk is
+ * read before the chunk with the same index is written, so r may alias a
+ * and/or b.
+ */
+enum bigint_bitwise {
+	BIGINT_BITWISE_AND,
+	BIGINT_BITWISE_OR,
+	BIGINT_BITWISE_XOR,
+};
+typedef void chunks_bitwise_fn(unsigned long *r, const unsigned long *a, const unsigned long *b, unsigned long pad, int n, enum bigint_bitwise op);
+
+static void chunks_bitwise_scalar(unsigned long *r, const unsigned long *a, const unsigned long *b, unsigned long pad, int n, enum bigint_bitwise op) {
+	switch (op) {
+		case BIGINT_BITWISE_AND: for (int i = 0; i < n; i++) r[i] = a[i] & (b != NULL ? b[i] : pad); break;
+		case BIGINT_BITWISE_OR: for (int i = 0; i < n; i++) r[i] = a[i] | (b != NULL ? b[i] : pad); break;
+		case BIGINT_BITWISE_XOR: for (int i = 0; i < n; i++) r[i] = a[i] ^ (b != NULL ? b[i] : pad); break;
+		default: assert(0);
+	}
+}
+
+#ifdef BIGINT_HAVE_X86_SIMD
+#define CHUNKS_BITWISE_LOOP(vector, nchunk_in_vector, load, store, vop) \
+		for (; i + (nchunk_in_vector) <= n; i += (nchunk_in_vector)) {\
+			vector y = b != NULL ? load((const void *)(b+i)) : broadcast;\
+			store((void *)(r+i), vop(load((const void *)(a+i)), y));\
+		}
+
+__attribute__((target("avx2")))
+static void chunks_bitwise_avx2(unsigned long *r, const unsigned long *a, const unsigned long *b, unsigned long pad, int n, enum bigint_bitwise op) {
+	const __m256i broadcast = _mm256_set1_epi64x((long long)pad);
+	int i = 0;
+	switch (op) {
+		case BIGINT_BITWISE_AND: CHUNKS_BITWISE_LOOP(__m256i, 4, _mm256_loadu_si256, _mm256_storeu_si256, _mm256_and_si256); break;
+		case BIGINT_BITWISE_OR: CHUNKS_BITWISE_LOOP(__m256i, 4, _mm256_loadu_si256, _mm256_storeu_si256, _mm256_or_si256); break;
+		case BIGINT_BITWISE_XOR: CHUNKS_BITWISE_LOOP(__m256i, 4, _mm256_loadu_si256, _mm256_storeu_si256, _mm256_xor_si256); break;
+		default: assert(0);
+	}
+	chunks_bitwise_scalar(r+i, a+i, b != NULL ? b+i : NULL, pad, n-i, op);
+}
+
+__attribute__((target("avx512f")))
+static void chunks_bitwise_avx512(unsigned long *r, const unsigned long *a, const unsigned long *b, unsigned long pad, int n, enum bigint_bitwise op) {
+	const __m512i broadcast = _mm512_set1_epi64((long long)pad);
+	int i = 0;
+	switch (op) {
+		case BIGINT_BITWISE_AND: CHUNKS_BITWISE_LOOP(__m512i, 8, _mm512_loadu_si512, _mm512_storeu_si512, _mm512_and_si512); break;
+		case BIGINT_BITWISE_OR: CHUNKS_BITWISE_LOOP(__m512i, 8, _mm512_loadu_si512, _mm512_storeu_si512, _mm512_or_si512); break;
+		case BIGINT_BITWISE_XOR: CHUNKS_BITWISE_LOOP(__m512i, 8, _mm512_loadu_si512, _mm512_storeu_si512, _mm512_xor_si512); break;
+		default: assert(0);
+	}
+	chunks_bitwise_scalar(r+i, a+i, b != NULL ? b+i : NULL, pad, n-i, op);
+}
+#undef CHUNKS_BITWISE_LOOP
+#endif /* BIGINT_HAVE_X86_SIMD */
+
+/* the operands are usually too short for the vectors to pay off below BIGINT_SIMD_THRESHOLD chunks */
+#ifndef BIGINT_SIMD_THRESHOLD
+#define BIGINT_SIMD_THRESHOLD 8
+#endif /* BIGINT_SIMD_THRESHOLD */
+static chunks_bitwise_fn *chunks_bitwise_select(int n) {
+	if (n < BIGINT_SIMD_THRESHOLD) {
+		return chunks_bitwise_scalar;
+	}
+
+	switch (bigint_simd_level()) {
+#ifdef BIGINT_HAVE_X86_SIMD
+		case BIGINT_SIMD_AVX512: return chunks_bitwise_avx512;
+		case BIGINT_SIMD_AVX2: return chunks_bitwise_avx2;
+#endif /* BIGINT_HAVE_X86_SIMD */
+		default: return chunks_bitwise_scalar;
+	}
+}
+
+
+/*
+ * the overlapping chunks of a and b are combined first, then the rest of
+ * the longer operand with the pad chunk of the shorter one. nchunk is read
+ * up front since dst may be any of the operands.
+ */
+static int bigint_bitwise_into(struct bigint *dst, const struct bigint *a, const struct bigint *b, enum bigint_bitwise op) {
+	if (dst == NULL || a == NULL || b == NULL) {
+		return EINVAL;
+	}
+
+	if (a->nchunk < b->nchunk) {
+		const struct bigint *t = a;
+		a = b;
+		b = t;
+	}
+	int na = a->nchunk, nb = b->nchunk;
+	unsigned long pad_b = b->pad_chunk;
+
+	if (bigint_reserve(dst, na) != 0) {
+		return ENOMEM;
+	}
+
+	chunks_bitwise_select(nb)(dst->chunks, a->chunks, b->chunks, 0, nb, op);
+	chunks_bitwise_select(na-nb)(dst->chunks+nb, a->chunks+nb, NULL, pad_b, na-nb, op);
+	dst->nchunk = na;
+
+	bigint_identify_pad_chunk_and_trim(dst);
+	return 0;
+}
+
+
+int bigint_not_into(struct bigint *dst, const struct bigint *n) {
+	if (dst == NULL || n == NULL) {
+		return EINVAL;
+	}
+
+	if (bigint_reserve(dst, n->nchunk) != 0) {
+		return ENOMEM;
+	}
+
+	chunks_bitwise_select(n->nchunk)(dst->chunks, n->chunks, NULL, ULONG_MAX, n->nchunk, BIGINT_BITWISE_XOR);
+	dst->nchunk = n->nchunk;
+
+	bigint_identify_pad_chunk_and_trim(dst);
+	return 0;
+}
+
+
 struct bigint *bigint_not(const struct bigint *n) {
 	if (n == NULL) {
 		return NULL;
 	}
 
-	struct bigint *res = bigint_init(n->nchunk);
+	BIGINT_NEW_RESULT(n->nchunk, bigint_not_into(res, n));
+}
+
+#define BIGINT_MAXCHUNK(a, b) ((a) == NULL || (b) == NULL ? 1 : (a)->nchunk > (b)->nchunk ? (a)->nchunk : (b)->nchunk)
+
+int bigint_and_into(struct bigint *dst, const struct bigint *a, const struct bigint *b) {
+	return bigint_bitwise_into(dst, a, b, BIGINT_BITWISE_AND);
+}
+
+
+int bigint_or_into(struct bigint *dst, const struct bigint *a, const struct bigint *b) {
+	return bigint_bitwise_into(dst, a, b, BIGINT_BITWISE_OR);
+}
+
+
+int bigint_xor_into(struct bigint *dst, const struct bigint *a, const struct bigint *b) {
+	return bigint_bitwise_into(dst, a, b, BIGINT_BITWISE_XOR);
+}
+
+
+struct bigint *bigint_and(const struct bigint *a, const struct bigint *b) {
+	if (a == NULL || b == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(BIGINT_MAXCHUNK(a, b), bigint_and_into(res, a, b));
+}
+
+
+struct bigint *bigint_or(const struct bigint *a, const struct bigint *b) {
+	if (a == NULL || b == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(BIGINT_MAXCHUNK(a, b), bigint_or_into(res, a, b));
+}
+
+
+struct bigint *bigint_xor(const struct bigint *a, const struct bigint *b) {
+	if (a == NULL || b == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(BIGINT_MAXCHUNK(a, b), bigint_xor_into(res, a, b));
+}
+
+
+void TestBigintBitwiseOperators(CuTest *tc) {
+	enum {
+		NHEXSTRING=7,
+		RES_LEN = 32+1,
+	};
+
+	enum {
+		A,
+		B,
+		NOT_A,
+		NOT_B,
+		A_AND_B,
+		A_OR_B,
+		A_XOR_B,
+	};
+	const char *hexstrings[] = {
+		"0000000000007fff0000000000007fff",
+		                "ffffffffffff1337",
+		"ffffffffffff8000ffffffffffff8000",
+		                "000000000000ecc8",
+		"0000000000007fff0000000000001337",
+		                "ffffffffffff7fff",
+		"ffffffffffff8000ffffffffffff6cc8",
+	};
+
+	struct bigint *bns[NHEXSTRING];
+	bns[A] = bigint_from_msb_first_hexstring(hexstrings[A], 0);
+	bns[B] = bigint_from_msb_first_hexstring(hexstrings[B], 0);
+	bns[NOT_A] = bigint_not(bns[A]);
+	bns[NOT_B] = bigint_not(bns[B]);
+	bns[A_AND_B] = bigint_and(bns[A], bns[B]);
+	bns[A_OR_B] = bigint_or(bns[A], bns[B]);
+	bns[A_XOR_B] = bigint_xor(bns[A], bns[B]);
+
+	for (int i = 0; i < NHEXSTRING; i++) {
+		char res[RES_LEN];
+		CuAssertIntEquals(tc, strlen(hexstrings[i]), bigint_to_msb_first_hexstring(bns[i], res));
+		CuAssertStrEquals(tc, hexstrings[i], res);
+		bigint_destroy(bns[i]);
+	}
+}
+
+
+void TestChunks_bitwise(CuTest *tc) {
+	enum {
+		MAX_NCHUNK = 40,
+	};
+	const enum bigint_bitwise ops[] = {BIGINT_BITWISE_AND, BIGINT_BITWISE_OR, BIGINT_BITWISE_XOR};
+	unsigned long a[MAX_NCHUNK], b[MAX_NCHUNK], expected[MAX_NCHUNK], r[MAX_NCHUNK];
+	random_chunks(a, MAX_NCHUNK);
+	random_chunks(b, MAX_NCHUNK);
+
+	enum bigint_simd supported = bigint_simd_supported();
+	for (enum bigint_simd simd = BIGINT_SIMD_NONE; simd <= supported; simd++) {
+		bigint_simd_max = simd;
+		for (size_t i = 0; i < sizeof(ops)/sizeof(*ops); i++) {
+			for (int n = 0; n <= MAX_NCHUNK; n++) {
+				chunks_bitwise_scalar(expected, a, b, 0, n, ops[i]);
+				chunks_bitwise_select(n)(r, a, b, 0, n, ops[i]);
+				CuAssertIntEquals(tc, 0, memcmp(expected, r, n*sizeof(*r)));
+
+				chunks_bitwise_scalar(expected, a, NULL, ULONG_MAX, n, ops[i]);
+				memcpy(r, a, n*sizeof(*r));
+				chunks_bitwise_select(n)(r, r, NULL, ULONG_MAX, n, ops[i]);
+				CuAssertIntEquals(tc, 0, memcmp(expected, r, n*sizeof(*r)));
+			}
+		}
+	}
+	bigint_simd_max = BIGINT_SIMD_AVX512;
+
+	// the overlapping chunks and the padded tail, with dst as one of the operands
+	const int nchunks[] = {1, 3, 9, 17, 33};
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		for (size_t j = 0; j < sizeof(nchunks)/sizeof(*nchunks); j++) {
+			struct bigint *x = bigint_random_for_test(nchunks[i]), *y = bigint_random_for_test(nchunks[j]);
+			struct bigint *and = bigint_and(x, y), *or = bigint_or(x, y), *xor = bigint_xor(x, y), *not = bigint_not(x);
+			int maxchunks = BIGINT_MAXCHUNK(x, y);
+			for (int k = 0; k <= maxchunks; k++) {
+				unsigned long xk = bigint_index_with_padding(x, k), yk = bigint_index_with_padding(y, k);
+				CuAssertTrue(tc, bigint_index_with_padding(and, k) == (xk & yk));
+				CuAssertTrue(tc, bigint_index_with_padding(or, k) == (xk | yk));
+				CuAssertTrue(tc, bigint_index_with_padding(xor, k) == (xk ^ yk));
+				CuAssertTrue(tc, bigint_index_with_padding(not, k) == ~xk);
+			}
+
+			CuAssertIntEquals(tc, 0, bigint_xor_into(x, x, y));
+			CuAssertIntEquals(tc, 0, bigint_compare(xor, x));
+			CuAssertIntEquals(tc, 0, bigint_or_into(y, x, y)); // (x^y)|y == x|y
+			CuAssertIntEquals(tc, 0, bigint_compare(or, y));
+			bigint_destroy(x);
+			bigint_destroy(y);
+			bigint_destroy(and);
+			bigint_destroy(or);
+			bigint_destroy(xor);
+			bigint_destroy(not);
+		}
+	}
+}
+
+
+void TestBigintBitwiseBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		MAX_NCHUNK = 10000,
+		NITERATION = 1000,
+	};
+	const char *simd_names[] = {"scalar", "sse4.1", "avx2", "avx512"};
+
+	const int nchunks[] = {4, 16, 100, 1000, 10000};
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		struct bigint *x = bigint_random_for_test(nchunks[i]), *y = bigint_random_for_test(nchunks[i] - nchunks[i]/4);
+		struct bigint *res = bigint_with_capacity(nchunks[i]);
+		CuAssertPtrNotNull(tc, x);
+		CuAssertPtrNotNull(tc, y);
+		CuAssertPtrNotNull(tc, res);
+
+		enum bigint_simd supported = bigint_simd_supported();
+		for (enum bigint_simd simd = BIGINT_SIMD_NONE; simd <= supported; simd++) {
+			char description[64];
+			bigint_simd_max = simd;
+			snprintf(description, sizeof(description), "%s and %d", simd_names[simd], nchunks[i]);
+			TIMED_BLOCK(NITERATION, description) {
+				bigint_and_into(res, x, y);
+			}
+			snprintf(description, sizeof(description), "%s xor %d", simd_names[simd], nchunks[i]);
+			TIMED_BLOCK(NITERATION, description) {
+				bigint_xor_into(res, x, y);
+			}
+			snprintf(description, sizeof(description), "%s not %d", simd_names[simd], nchunks[i]);
+			TIMED_BLOCK(NITERATION, description) {
+				bigint_not_into(res, x);
+			}
+		}
+		bigint_simd_max = BIGINT_SIMD_AVX512;
+
+		bigint_destroy(x);
+		bigint_destroy(y);
+		bigint_destroy(res);
+	}
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
+
+
+/* chunk i of n, with the pad chunk above the chunks for any i, so that bit indices need not fit in an int */
+static inline unsigned long bigint_chunk_at(const struct bigint *n, unsigned long i) {
+	return i < (unsigned long)n->nchunk ? n->chunks[i] : n->pad_chunk;
+}
+
+
+/*
+ * the number of bits that differ from pad in a, which for the chunks of a
+ * bigint and its pad chunk is the number of ones in a non-negative one and
+ * the number of zeros in a negative one.
+ */
+typedef unsigned long chunks_popcount_fn(const unsigned long *a, int n, unsigned long pad);
+
+static unsigned long chunks_popcount_scalar(const unsigned long *a, int n, unsigned long pad) {
+	unsigned long count = 0;
+	for (int i = 0; i < n; i++) {
+		count += __builtin_popcountl(a[i] ^ pad);
+	}
+	return count;
+}
+
+#ifdef BIGINT_HAVE_X86_SIMD
+/* the same loop, where the builtin is one popcnt instruction instead of a bit twiddling sequence */
+__attribute__((target("popcnt")))
+static unsigned long chunks_popcount_popcnt(const unsigned long *a, int n, unsigned long pad) {
+	unsigned long count = 0;
+	for (int i = 0; i < n; i++) {
+		count += __builtin_popcountl(a[i] ^ pad);
+	}
+	return count;
+}
+#endif /* BIGINT_HAVE_X86_SIMD */
+
+/* popcnt is a cpuid bit of its own, but every cpu with it also has sse4.1 */
+static chunks_popcount_fn *chunks_popcount_select(void) {
+#ifdef BIGINT_HAVE_X86_SIMD
+	if (bigint_simd_level() >= BIGINT_SIMD_SSE41 && __builtin_cpu_supports("popcnt")) {
+		return chunks_popcount_popcnt;
+	}
+#endif /* BIGINT_HAVE_X86_SIMD */
+	return chunks_popcount_scalar;
+}
+
+
+long bigint_bit_length(const struct bigint *n) {
+	return n == NULL ? -EINVAL : (long)bigint_magnitude_nbit(n);
+}
+
+
+long bigint_popcount(const struct bigint *n) {
+	return n == NULL ? -EINVAL : (long)chunks_popcount_select()(n->chunks, n->nchunk, n->pad_chunk);
+}
+
+
+/* two's complement has the same trailing zeros as the magnitude, so the sign does not matter here */
+long bigint_ctz(const struct bigint *n) {
+	if (n == NULL) {
+		return -EINVAL;
+	}
+
+	int i = 0;
+	while (i < n->nchunk && n->chunks[i] == 0) {
+		i++;
+	}
+	if (i == n->nchunk) {
+		return -EDOM;
+	}
+	return (long)i*LONG_BIT + __builtin_ctzl(n->chunks[i]);
+}
+
+
+int bigint_test_bit(const struct bigint *n, unsigned long bit) {
+	if (n == NULL) {
+		return -EINVAL;
+	}
+	return bigint_chunk_at(n, bit/LONG_BIT) >> (bit%LONG_BIT) & 1;
+}
+
+
+/*
+ * flipping a bit in the top chunk or above it may change the sign, so n is
+ * first grown to have a pad chunk above the bit, which the trim removes
+ * again when it is not needed.
+ */
+int bigint_set_bit(struct bigint *n, unsigned long bit, int value) {
+	if (n == NULL) {
+		return EINVAL;
+	}
+
+	unsigned long i = bit/LONG_BIT, mask = 1UL << (bit%LONG_BIT);
+	if (((bigint_chunk_at(n, i) & mask) != 0) == (value != 0)) {
+		return 0;
+	}
+
+	if (i+1 >= (unsigned long)n->nchunk) {
+		if (i > (unsigned long)INT_MAX-2) {
+			return ERANGE;
+		}
+		int nchunk = i+2;
+		if (bigint_reserve(n, nchunk) != 0) {
+			return ENOMEM;
+		}
+		for (int j = n->nchunk; j < nchunk; j++) {
+			n->chunks[j] = n->pad_chunk;
+		}
+		n->nchunk = nchunk;
+	}
+	n->chunks[i] ^= mask;
+
+	bigint_identify_pad_chunk_and_trim(n);
+	return 0;
+}
+
+
+/* the nbit bits from first, 0 < nbit <= LONG_BIT */
+static inline unsigned long bigint_bits_at(const struct bigint *n, unsigned long first, int nbit) {
+	unsigned long i = first/LONG_BIT;
+	int offset = first%LONG_BIT;
+	unsigned long bits = bigint_chunk_at(n, i) >> offset;
+	if (offset > 0 && offset+nbit > LONG_BIT) {
+		bits |= bigint_chunk_at(n, i+1) << (LONG_BIT-offset);
+	}
+	return nbit < LONG_BIT ? bits & ((1UL << nbit) - 1) : bits;
+}
+
+
+int bigint_get_bits(const struct bigint *n, unsigned long first, int nbit, unsigned long *bits) {
+	if (n == NULL || bits == NULL || nbit < 0 || nbit > LONG_BIT) {
+		return EINVAL;
+	}
+
+	*bits = nbit == 0 ? 0 : bigint_bits_at(n, first, nbit);
+	return 0;
+}
+
+
+/*
+ * chunk j of dst is read from chunks j+first/LONG_BIT and the one above of
+ * n, so the chunks are written from the least significant one and dst may be
+ * n. the chunk above the bits is 0 for the sign.
+ */
+int bigint_extract_bits_into(struct bigint *dst, const struct bigint *n, unsigned long first, unsigned long nbit) {
+	if (dst == NULL || n == NULL) {
+		return EINVAL;
+	}
+
+	if (nbit/LONG_BIT > (unsigned long)INT_MAX-2) {
+		return ERANGE;
+	}
+	int nwhole = nbit/LONG_BIT, nrest = nbit%LONG_BIT;
+	int nchunk = nwhole + (nrest > 0) + 1;
+	if (bigint_reserve(dst, nchunk) != 0) {
+		return ENOMEM;
+	}
+
+	for (int j = 0; j < nwhole; j++) {
+		dst->chunks[j] = bigint_bits_at(n, first + (unsigned long)j*LONG_BIT, LONG_BIT);
+	}
+	if (nrest > 0) {
+		dst->chunks[nwhole] = bigint_bits_at(n, first + (unsigned long)nwhole*LONG_BIT, nrest);
+	}
+	dst->chunks[nchunk-1] = 0;
+	dst->nchunk = nchunk;
+
+	bigint_identify_pad_chunk_and_trim(dst);
+	return 0;
+}
+
+
+struct bigint *bigint_extract_bits(const struct bigint *n, unsigned long first, unsigned long nbit) {
+	if (n == NULL || nbit/LONG_BIT > (unsigned long)INT_MAX-2) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(nbit/LONG_BIT + 2, bigint_extract_bits_into(res, n, first, nbit));
+}
+
+
+/* the queries against shifts and masks of bigints, the way they were emulated before */
+static void bigint_bits_test(CuTest *tc, const struct bigint *x) {
+	struct bigint zero = BIGINT_STATIC_INIT(zero), one = BIGINT_STATIC_INIT(one), t = BIGINT_STATIC_INIT(t), mask = BIGINT_STATIC_INIT(mask);
+	struct bigint expected = BIGINT_STATIC_INIT(expected), actual = BIGINT_STATIC_INIT(actual);
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&one, 1));
+	int negative = x->pad_chunk != 0;
+
+	// |x| < 2^length <= 2|x|
+	long length = bigint_bit_length(x);
+	CuAssertTrue(tc, length >= 0);
+	CuAssertIntEquals(tc, 0, negative ? bigint_negate_into(&t, x) : bigint_copy_into(&t, x));
+	CuAssertIntEquals(tc, 0, bigint_shr_ul_into(&expected, &t, length));
+	CuAssertIntEquals(tc, 0, bigint_compare(&expected, &zero));
+	if (length > 0) {
+		CuAssertIntEquals(tc, 0, bigint_shr_ul_into(&expected, &t, length-1));
+		CuAssertIntEquals(tc, 0, bigint_compare(&expected, &one));
+	}
+
+	long count = 0;
+	unsigned long nbit = (unsigned long)x->nchunk*LONG_BIT + 3;
+	for (unsigned long bit = 0; bit < nbit; bit++) {
+		CuAssertIntEquals(tc, 0, bigint_shr_ul_into(&t, x, bit));
+		int expected_bit = t.chunks[0] & 1;
+		CuAssertIntEquals(tc, expected_bit, bigint_test_bit(x, bit));
+		count += expected_bit != negative;
+	}
+	CuAssertIntEquals(tc, negative, bigint_test_bit(x, ULONG_MAX));
+	CuAssertIntEquals(tc, count, bigint_popcount(x));
+
+	long zeros = bigint_ctz(x);
+	if (bigint_compare(x, &zero) == 0) {
+		CuAssertIntEquals(tc, -EDOM, zeros);
+	} else {
+		CuAssertIntEquals(tc, 1, bigint_test_bit(x, zeros));
+		CuAssertIntEquals(tc, 0, bigint_shr_ul_into(&t, x, zeros));
+		CuAssertIntEquals(tc, 0, bigint_shl_ul_into(&t, &t, zeros));
+		CuAssertIntEquals(tc, 0, bigint_compare(x, &t));
+	}
+
+	const unsigned long firsts[] = {0, 1, 63, 64, 65, nbit/2, nbit, 10*nbit};
+	const unsigned long nbits[] = {0, 1, 7, 63, 64, 65, 130, nbit};
+	for (size_t i = 0; i < sizeof(firsts)/sizeof(*firsts); i++) {
+		for (size_t j = 0; j < sizeof(nbits)/sizeof(*nbits); j++) {
+			CuAssertIntEquals(tc, 0, bigint_shl_ul_into(&mask, &one, nbits[j]));
+			CuAssertIntEquals(tc, 0, bigint_subtract_into(&mask, &mask, &one));
+			CuAssertIntEquals(tc, 0, bigint_shr_ul_into(&expected, x, firsts[i]));
+			CuAssertIntEquals(tc, 0, bigint_and_into(&expected, &expected, &mask));
+
+			CuAssertIntEquals(tc, 0, bigint_extract_bits_into(&actual, x, firsts[i], nbits[j]));
+			CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+			CuAssertIntEquals(tc, 0, bigint_copy_into(&actual, x));
+			CuAssertIntEquals(tc, 0, bigint_extract_bits_into(&actual, &actual, firsts[i], nbits[j]));
+			CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+
+			if (nbits[j] <= LONG_BIT) {
+				unsigned long bits = 1337;
+				CuAssertIntEquals(tc, 0, bigint_get_bits(x, firsts[i], nbits[j], &bits));
+				CuAssertTrue(tc, bits == (expected.nchunk > 0 ? expected.chunks[0] : 0));
+			}
+		}
+	}
+
+	// x | 1<<bit and x & ~(1<<bit), which may change the sign and length
+	const unsigned long bits[] = {0, 5, 63, 64, (unsigned long)x->nchunk*LONG_BIT - 1, (unsigned long)x->nchunk*LONG_BIT, 3*nbit};
+	for (size_t i = 0; i < sizeof(bits)/sizeof(*bits); i++) {
+		CuAssertIntEquals(tc, 0, bigint_shl_ul_into(&mask, &one, bits[i]));
+		for (int value = 0; value <= 1; value++) {
+			if (value) {
+				CuAssertIntEquals(tc, 0, bigint_or_into(&expected, x, &mask));
+			} else {
+				CuAssertIntEquals(tc, 0, bigint_not_into(&t, &mask));
+				CuAssertIntEquals(tc, 0, bigint_and_into(&expected, x, &t));
+			}
+			CuAssertIntEquals(tc, 0, bigint_copy_into(&actual, x));
+			CuAssertIntEquals(tc, 0, bigint_set_bit(&actual, bits[i], value));
+			CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+			CuAssertIntEquals(tc, expected.nchunk, actual.nchunk);
+			CuAssertIntEquals(tc, value, bigint_test_bit(&actual, bits[i]));
+		}
+	}
+
+	bigint_clear(&zero);
+	bigint_clear(&one);
+	bigint_clear(&t);
+	bigint_clear(&mask);
+	bigint_clear(&expected);
+	bigint_clear(&actual);
+}
+void TestBigintBits(CuTest *tc) {
+	struct bigint x = BIGINT_STATIC_INIT(x);
+	const long longs[] = {0, 1, -1, 2, -2, LONG_MAX, LONG_MIN, 1L << 40, -(1L << 40)};
+	for (size_t i = 0; i < sizeof(longs)/sizeof(*longs); i++) {
+		CuAssertIntEquals(tc, 0, bigint_from_long_into(&x, longs[i]));
+		bigint_bits_test(tc, &x);
+	}
+
+	// -2^k has one bit more than its ~, and the magnitude of LONG_MIN needs the chunk above
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&x, LONG_MIN));
+	CuAssertIntEquals(tc, LONG_BIT, bigint_bit_length(&x));
+	CuAssertIntEquals(tc, 0, bigint_shl_ul_into(&x, &x, 100));
+	CuAssertIntEquals(tc, LONG_BIT+100, bigint_bit_length(&x));
+	CuAssertIntEquals(tc, LONG_BIT+100-1, bigint_ctz(&x));
+	CuAssertIntEquals(tc, LONG_BIT+100-1, bigint_popcount(&x));
+
+	enum bigint_simd supported = bigint_simd_supported();
+	for (int nchunk = 1; nchunk <= 5; nchunk++) {
+		for (int i = 0; i < 4; i++) {
+			struct bigint *n = bigint_random_for_test(nchunk);
+			CuAssertPtrNotNull(tc, n);
+			bigint_bits_test(tc, n);
+
+			bigint_simd_max = BIGINT_SIMD_NONE;
+			long count = bigint_popcount(n);
+			bigint_simd_max = supported;
+			CuAssertIntEquals(tc, count, bigint_popcount(n));
+			bigint_simd_max = BIGINT_SIMD_AVX512;
+
+			bigint_destroy(n);
+		}
+	}
+
+	// the result needs more chunks than there are
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&x, 1));
+	CuAssertIntEquals(tc, ERANGE, bigint_set_bit(&x, ULONG_MAX, 1));
+	CuAssertIntEquals(tc, 0, bigint_set_bit(&x, ULONG_MAX, 0));
+	CuAssertIntEquals(tc, ERANGE, bigint_extract_bits_into(&x, &x, 0, ULONG_MAX));
+	CuAssertPtrEquals(tc, NULL, bigint_extract_bits(&x, 0, ULONG_MAX));
+	CuAssertIntEquals(tc, EINVAL, bigint_get_bits(&x, 0, LONG_BIT+1, &(unsigned long){0}));
+
+	bigint_clear(&x);
+}
+
+
+void TestBigintBitsBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		NITERATION = 1000,
+	};
+
+	const int nchunks[] = {4, 100, 10000};
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		struct bigint *x = bigint_random_for_test(nchunks[i]);
+		struct bigint *one = bigint_from_long(1), *t = bigint_with_capacity(nchunks[i]), *mask = bigint_with_capacity(nchunks[i]);
+		CuAssertPtrNotNull(tc, x);
+		CuAssertPtrNotNull(tc, one);
+		CuAssertPtrNotNull(tc, t);
+		CuAssertPtrNotNull(tc, mask);
+		unsigned long first = (unsigned long)nchunks[i]*LONG_BIT/2 + 3, sum = 0;
+
+		char description[64];
+		snprintf(description, sizeof(description), "test_bit %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			sum += bigint_test_bit(x, first);
+		}
+		snprintf(description, sizeof(description), "test_bit by shift %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_shr_ul_into(t, x, first);
+			sum += t->chunks[0] & 1;
+		}
+		snprintf(description, sizeof(description), "get_bits 20 %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			unsigned long bits = 0;
+			CuAssertIntEquals(tc, 0, bigint_get_bits(x, first, 20, &bits));
+			sum += bits;
+		}
+		snprintf(description, sizeof(description), "get_bits 20 by shift and mask %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_shl_ul_into(mask, one, 20);
+			bigint_subtract_into(mask, mask, one);
+			bigint_shr_ul_into(t, x, first);
+			bigint_and_into(t, t, mask);
+			sum += t->chunks[0];
+		}
+		snprintf(description, sizeof(description), "scalar popcount %d", nchunks[i]);
+		bigint_simd_max = BIGINT_SIMD_NONE;
+		TIMED_BLOCK(NITERATION, description) {
+			sum += bigint_popcount(x);
+		}
+		bigint_simd_max = BIGINT_SIMD_AVX512;
+		snprintf(description, sizeof(description), "popcnt popcount %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			sum += bigint_popcount(x);
+		}
+		snprintf(description, sizeof(description), "bit_length %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			sum += bigint_bit_length(x);
+		}
+		CuAssertTrue(tc, sum > 0);
+
+		bigint_destroy(x);
+		bigint_destroy(one);
+		bigint_destroy(t);
+		bigint_destroy(mask);
+	}
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
+
+
+int bigint_shl_ul_into(struct bigint *dst, const struct bigint *a, unsigned long shift) {
+	if (dst == NULL || a == NULL) {
+		return EINVAL;
+	}
+
+	unsigned long nwhole = shift/LONG_BIT;
+	int nbit = shift%LONG_BIT;
+
+	if (nwhole > (unsigned long)(INT_MAX - a->nchunk - 1)) {
+		return ERANGE;
+	}
+
+	int nchunk = a->nchunk + nwhole + 1;
+	unsigned long pad_chunk = a->pad_chunk;
+	unsigned long small[BIGINT_INLINE_NCHUNK+1], *r = small;
+	if (nchunk > BIGINT_INLINE_NCHUNK+1) {
+		if (bigint_reserve(dst, nchunk) != 0) {
+			return ENOMEM;
+		}
+		r = dst->chunks;
+	}
+
+	// whole chunks are moved and the bits are shifted in the same pass, from the most significant chunk so that dst may be a
+	if (nbit == 0) {
+		memmove(r+nwhole, a->chunks, a->nchunk*sizeof(*r));
+		r[nchunk-1] = pad_chunk;
+	} else {
+		unsigned long carry = chunks_shift_left(r+nwhole, a->chunks, a->nchunk, nbit);
+		r[nchunk-1] = (pad_chunk << nbit) | carry;
+	}
+	memset(r, 0, nwhole*sizeof(*r));
+
+	if (r == small) {
+		return bigint_assign_chunks(dst, small, nchunk);
+	}
+	dst->nchunk = nchunk;
+
+	bigint_identify_pad_chunk_and_trim(dst);
+	return 0;
+}
+
+
+int bigint_shr_ul_into(struct bigint *dst, const struct bigint *a, unsigned long shift) {
+	if (dst == NULL || a == NULL) {
+		return EINVAL;
+	}
+
+	unsigned long nwhole = shift/LONG_BIT;
+	int nbit = shift%LONG_BIT;
+
+	if (nwhole >= (unsigned long)a->nchunk) {
+		dst->chunks[0] = a->pad_chunk;
+		dst->nchunk = 1;
+		bigint_identify_pad_chunk_and_trim(dst);
+		return 0;
+	}
+
+	int nchunk = a->nchunk - nwhole;
+	unsigned long pad_chunk = a->pad_chunk;
+	if (bigint_reserve(dst, nchunk) != 0) {
+		return ENOMEM;
+	}
+
+	// from the least significant chunk, so that dst may be a
+	if (nbit == 0) {
+		memmove(dst->chunks, a->chunks+nwhole, nchunk*sizeof(*dst->chunks));
+	} else {
+		chunks_shift_right(dst->chunks, a->chunks+nwhole, nchunk, nbit);
+		dst->chunks[nchunk-1] |= pad_chunk << (LONG_BIT-nbit);
+	}
+	dst->nchunk = nchunk;
+
+	bigint_identify_pad_chunk_and_trim(dst);
+	return 0;
+}
+
+
+struct bigint *bigint_shl_ul(const struct bigint *a, unsigned long shift) {
+	if (a == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(a->nchunk+1, bigint_shl_ul_into(res, a, shift));
+}
+
+
+struct bigint *bigint_shr_ul(const struct bigint *a, unsigned long shift) {
+	if (a == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(a->nchunk, bigint_shr_ul_into(res, a, shift));
+}
+
+
+/*
+ * |b| as a shift count. counts that does not fit into one chunk are
+ * ULONG_MAX, which is more than any bigint can be shifted.
+ */
+static unsigned long bigint_shift_count(const struct bigint *b) {
+	if (bigint_normalised_nchunk(b) > 1) {
+		return ULONG_MAX;
+	}
+	return bigint_msb(b, -1) == 1 ? -b->chunks[0] : b->chunks[0];
+}
+
+
+int bigint_shift_left_into(struct bigint *dst, const struct bigint *a, const struct bigint *b) {
+	if (dst == NULL || a == NULL || b == NULL) {
+		return EINVAL;
+	}
+
+	unsigned long shift = bigint_shift_count(b);
+	if (bigint_msb(b, -1) == 1) {
+		return bigint_shr_ul_into(dst, a, shift);
+	}
+	return bigint_shl_ul_into(dst, a, shift); // left shift with more than ULONG_MAX would in most cases result in out of memory, so do not try
+}
+
+
+int bigint_shift_right_into(struct bigint *dst, const struct bigint *a, const struct bigint *b) {
+	if (dst == NULL || a == NULL || b == NULL) {
+		return EINVAL;
+	}
+
+	unsigned long shift = bigint_shift_count(b);
+	if (bigint_msb(b, -1) == 1) {
+		return bigint_shl_ul_into(dst, a, shift);
+	}
+	return bigint_shr_ul_into(dst, a, shift);
+}
+
+
+struct bigint *bigint_shift_left(const struct bigint *a, const struct bigint *b) {
+	if (a == NULL || b == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(a->nchunk+1, bigint_shift_left_into(res, a, b));
+}
+
+
+struct bigint *bigint_shift_right(const struct bigint *a, const struct bigint *b) {
+	if (a == NULL || b == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(a->nchunk, bigint_shift_right_into(res, a, b));
+}
+
+
+void TestBigintBitshift(CuTest *tc) {
+	enum {
+		NHEXSTRING = 9,
+		RES_LEN = 64+1,
+	};
+
+	enum {
+		A,
+		B,
+		MINUS_B,
+		A_LEFT_SHIFT_B,
+		A_RIGHT_SHIFT_MINUS_B,
+		A_RIGHT_SHIFT_B,
+		A_LEFT_SHIFT_MINUS_B,
+		C,
+		C_RIGHT_SHIFT_B,
+	};
+	const char *hexstrings[] = {
+		"bfffffffffffefffffffffffffffefff",
+		"0000000000000043",
+		"ffffffffffffffbd",
+		"fffffffffffffffdffffffffffff7fffffffffffffff7ff80000000000000000",
+		"fffffffffffffffdffffffffffff7fffffffffffffff7ff80000000000000000",
+		"f7fffffffffffdff",
+		"f7fffffffffffdff",
+		"8fffffffffffffff",
+		"ffffffffffffffff",
+	};
+
+	struct bigint *bns[NHEXSTRING];
+	bns[A] = bigint_from_msb_first_hexstring(hexstrings[A],0);
+	bns[B] = bigint_from_msb_first_hexstring(hexstrings[B],0);
+	bns[MINUS_B] = bigint_negate(bns[B]);
+	bns[A_LEFT_SHIFT_B] = bigint_shift_left(bns[A], bns[B]);
+	bns[A_RIGHT_SHIFT_MINUS_B] = bigint_shift_right(bns[A], bns[MINUS_B]);
+	bns[A_RIGHT_SHIFT_B] = bigint_shift_right(bns[A], bns[B]);
+	bns[A_LEFT_SHIFT_MINUS_B] = bigint_shift_left(bns[A], bns[MINUS_B]);
+	bns[C] = bigint_from_msb_first_hexstring(hexstrings[C], 0);
+	bns[C_RIGHT_SHIFT_B] = bigint_shift_right(bns[C], bns[B]);
+
+	for (int i = 0; i < NHEXSTRING; i++) {
+		char res[RES_LEN];
+		CuAssertIntEquals(tc, strlen(hexstrings[i]), bigint_to_msb_first_hexstring(bns[i], res));
+		CuAssertStrEquals(tc, hexstrings[i], res);
+		bigint_destroy(bns[i]);
+	}
+}
+
+
+/* r = a+b, returns carry. r may alias a and/or b */
+static unsigned long chunks_add_n(unsigned long *r, const unsigned long *a, const unsigned long *b, int n) {
+	unsigned long carry = 0;
+	for (int i = 0; i < n; i++) {
+		r[i] = chunk_add_carry(a[i], b[i], carry, &carry);
+	}
+	return carry;
+}
+
+/* r = a-b, returns borrow. r may alias a and/or b */
+static unsigned long chunks_sub_n(unsigned long *r, const unsigned long *a, const unsigned long *b, int n) {
+	unsigned long borrow = 0;
+	for (int i = 0; i < n; i++) {
+		r[i] = chunk_sub_borrow(a[i], b[i], borrow, &borrow);
+	}
+	return borrow;
+}
+
+/*
+ * r[0..n) = a+b and a-b, where a[0..na) and b[0..nb) are two's complement
+ * numbers extended with pad_a and pad_b, and n >= max(na, nb). the
+ * overlapping chunks are added first, then the tail of the longer operand
+ * with the pad chunk of the shorter one. r may alias a and/or b.
+ */
+static void chunks_add_padded(unsigned long *r, const unsigned long *a, int na, unsigned long pad_a, const unsigned long *b, int nb, unsigned long pad_b, int n) {
+	if (na < nb) {
+		const unsigned long *tmp = a;
+		a = b;
+		b = tmp;
+		int ntmp = na;
+		na = nb;
+		nb = ntmp;
+		unsigned long pad_tmp = pad_a;
+		pad_a = pad_b;
+		pad_b = pad_tmp;
+	}
+
+	unsigned long carry = chunks_add_n(r, a, b, nb);
+	int i;
+	for (i = nb; i < na; i++) {
+		r[i] = chunk_add_carry(a[i], pad_b, carry, &carry);
+	}
+	for (; i < n; i++) {
+		r[i] = chunk_add_carry(pad_a, pad_b, carry, &carry);
+	}
+}
+
+static void chunks_sub_padded(unsigned long *r, const unsigned long *a, int na, unsigned long pad_a, const unsigned long *b, int nb, unsigned long pad_b, int n) {
+	int noverlap = na < nb ? na : nb;
+	unsigned long borrow = chunks_sub_n(r, a, b, noverlap);
+	int i;
+	for (i = noverlap; i < na; i++) {
+		r[i] = chunk_sub_borrow(a[i], pad_b, borrow, &borrow);
+	}
+	for (; i < nb; i++) {
+		r[i] = chunk_sub_borrow(pad_a, b[i], borrow, &borrow);
+	}
+	for (; i < n; i++) {
+		r[i] = chunk_sub_borrow(pad_a, pad_b, borrow, &borrow);
+	}
+}
+
+
+int bigint_negate_into(struct bigint *dst, const struct bigint *n) {
+	if (dst == NULL || n == NULL) {
+		return EINVAL;
+	}
+
+	if (n->nchunk == 1 && n->chunks[0] != LONG_MSB_MASK) {
+		dst->chunks[0] = -n->chunks[0];
+		dst->nchunk = 1;
+		dst->pad_chunk = pad_chunks[dst->chunks[0] >> LONG_MSB];
+		return 0;
+	}
+
+	int nchunk = n->nchunk+1; // -LONG_MIN does not fit into one chunk
+	unsigned long small[BIGINT_INLINE_NCHUNK+1], *r = small;
+	if (nchunk > BIGINT_INLINE_NCHUNK+1) {
+		if (bigint_reserve(dst, nchunk) != 0) {
+			return ENOMEM;
+		}
+		r = dst->chunks;
+	}
+
+	unsigned long carry = 1;
+	for (int i = 0; i < nchunk; i++) {
+		unsigned long chunk = ~bigint_index_with_padding(n, i) + carry;
+		carry = carry && chunk == 0;
+		r[i] = chunk;
+	}
+
+	if (r == small) {
+		return bigint_assign_chunks(dst, small, nchunk);
+	}
+	dst->nchunk = nchunk;
+
+	bigint_identify_pad_chunk_and_trim(dst);
+	return 0;
+}
+
+
+struct bigint *bigint_negate(const struct bigint *n) {
+	if (n == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(n->nchunk+1, bigint_negate_into(res, n));
+}
+
+
+int bigint_abs_into(struct bigint *dst, const struct bigint *n) {
+	if (dst == NULL || n == NULL) {
+		return EINVAL;
+	}
+
+	return bigint_msb(n, -1) == 1 ? bigint_negate_into(dst, n) : bigint_copy_into(dst, n);
+}
+
+
+struct bigint *bigint_abs(const struct bigint *n) {
+	if (n == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(n->nchunk+1, bigint_abs_into(res, n));
+}
+
+
+/*
+ * a+b, or a-b when subtract. the result has one chunk more than the largest
+ * operand so that it can not overflow.
+ */
+static int bigint_add_or_subtract_into(struct bigint *dst, const struct bigint *a, const struct bigint *b, int subtract) {
+	if (dst == NULL || a == NULL || b == NULL) {
+		return EINVAL;
+	}
+
+	if (a->nchunk == 1 && b->nchunk == 1) {
+		long sum;
+		if (!(subtract ? __builtin_sub_overflow((long)a->chunks[0], (long)b->chunks[0], &sum) : __builtin_add_overflow((long)a->chunks[0], (long)b->chunks[0], &sum))) {
+			dst->chunks[0] = sum;
+			dst->nchunk = 1;
+			dst->pad_chunk = pad_chunks[dst->chunks[0] >> LONG_MSB];
+			return 0;
+		}
+	}
+
+	// small results are computed on the stack and trimmed before dst is grown
+	int nchunk = BIGINT_MAXCHUNK(a, b) + 1;
+	unsigned long small[BIGINT_INLINE_NCHUNK+1], *r = small;
+	if (nchunk > BIGINT_INLINE_NCHUNK+1) {
+		if (bigint_reserve(dst, nchunk) != 0) {
+			return ENOMEM;
+		}
+		r = dst->chunks;
+	}
+
+	if (subtract) {
+		chunks_sub_padded(r, a->chunks, a->nchunk, a->pad_chunk, b->chunks, b->nchunk, b->pad_chunk, nchunk);
+	} else {
+		chunks_add_padded(r, a->chunks, a->nchunk, a->pad_chunk, b->chunks, b->nchunk, b->pad_chunk, nchunk);
+	}
+
+	if (r == small) {
+		return bigint_assign_chunks(dst, small, nchunk);
+	}
+	dst->nchunk = nchunk;
+
+	bigint_identify_pad_chunk_and_trim(dst);
+	return 0;
+}
+
+
+int bigint_add_into(struct bigint *dst, const struct bigint *a, const struct bigint *b) {
+	return bigint_add_or_subtract_into(dst, a, b, 0);
+}
+
+
+int bigint_subtract_into(struct bigint *dst, const struct bigint *a, const struct bigint *b) {
+	return bigint_add_or_subtract_into(dst, a, b, 1);
+}
+
+
+struct bigint *bigint_add(const struct bigint *a, const struct bigint *b) {
+	if (a == NULL || b == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(BIGINT_MAXCHUNK(a, b) + 1, bigint_add_into(res, a, b));
+}
+
+
+struct bigint *bigint_subtract(const struct bigint *a, const struct bigint *b) {
+	if (a == NULL || b == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(BIGINT_MAXCHUNK(a, b) + 1, bigint_subtract_into(res, a, b));
+}
+
+
+void TestBigintArithmeticOperators(CuTest *tc) {
+	enum {
+		NHEXSTRING = 10,
+		RES_LEN = 32+1,
+	};
+
+	enum {
+		A,
+		B,
+		MINUS_A,
+		MINUS_B,
+		ABS_A,
+		ABS_MINUS_A,
+		ABS_B,
+		ABS_MINUS_B,
+		A_ADD_B,
+		A_MINUS_B,
+	};
+	const char *hexstrings[] = {
+		"00000000000000010000000000000000",
+		"ffffffffffffffff",
+		"ffffffffffffffff0000000000000000",
+		"0000000000000001",
+		"00000000000000010000000000000000",
+		"00000000000000010000000000000000",
+		"0000000000000001",
+		"0000000000000001",
+		"0000000000000000ffffffffffffffff",
+		"00000000000000010000000000000001",
+	};
+
+	struct bigint *bns[NHEXSTRING];
+	bns[A] = bigint_from_msb_first_hexstring(hexstrings[A], 0);
+	bns[B] = bigint_from_msb_first_hexstring(hexstrings[B], 0);
+	bns[MINUS_A] = bigint_negate(bns[A]);
+	bns[MINUS_B] = bigint_negate(bns[B]);
+	bns[ABS_A] = bigint_abs(bns[A]);
+	bns[ABS_MINUS_A] = bigint_abs(bns[MINUS_A]);
+	bns[ABS_B] = bigint_abs(bns[B]);
+	bns[ABS_MINUS_B] = bigint_abs(bns[MINUS_B]);
+	bns[A_ADD_B] = bigint_add(bns[A], bns[B]);
+	bns[A_MINUS_B] = bigint_subtract(bns[A], bns[B]);
+
+	for (int i = 0; i < NHEXSTRING; i++) {
+		char res[RES_LEN];
+		CuAssertIntEquals(tc, strlen(hexstrings[i]), bigint_to_msb_first_hexstring(bns[i], res));
+		CuAssertStrEquals(tc, hexstrings[i], res);
+		bigint_destroy(bns[i]);
+	}
+}
+
+
+/*
+ * the rest of this file operates on plain arrays of chunks, i.e. on the
+ * magnitude of bigints. they never allocate memory, so callers provide any
+ * space they need (scratch), and they are the building blocks for the
+ * arithmetic operators on struct bigint.
+ */
+
+#ifndef BIGINT_KARATSUBA_THRESHOLD
+#define BIGINT_KARATSUBA_THRESHOLD 24 // nchunk where multiplication switches from schoolbook to karatsuba, see TestBigintMultiplicationBenchmark
+#endif /*BIGINT_KARATSUBA_THRESHOLD*/
+#ifndef BIGINT_TOOM3_THRESHOLD
+#define BIGINT_TOOM3_THRESHOLD 192 // nchunk where multiplication switches from karatsuba to toom-3, see TestBigintMultiplicationBenchmark
+#endif /*BIGINT_TOOM3_THRESHOLD*/
+
+/* d^-1 mod 2^LONG_BIT for odd d, by newton iteration doubling the correct bits each step */
+static unsigned long chunk_inverse(unsigned long d) {
+	assert((d & 1) == 1);
+
+	unsigned long inverse = d; // correct to 3 bits, since d*d == 1 mod 8 for all odd d
+	for (int nbit = 3; nbit < LONG_BIT; nbit *= 2) {
+		inverse *= 2 - d*inverse;
+	}
+
+	return inverse;
+}
+
+
+static int chunks_compare(const unsigned long *a, const unsigned long *b, int n) {
+	for (int i = n-1; i >= 0; i--) {
+		if (a[i] != b[i]) {
+			return a[i] > b[i] ? 1 : -1;
+		}
+	}
+	return 0;
+}
+
+static inline int chunks_is_zero(const unsigned long *a, int n) {
+	for (int i = 0; i < n; i++) {
+		if (a[i] != 0) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* r = a+carry, returns carry. r may alias a */
+static unsigned long chunks_add_1(unsigned long *r, const unsigned long *a, int n, unsigned long carry) {
+	int i;
+	for (i = 0; i < n && carry != 0; i++) {
+		r[i] = a[i] + carry;
+		carry = r[i] < carry;
+	}
+	if (r != a) {
+		memmove(r+i, a+i, (n-i)*sizeof(*r));
+	}
+	return carry;
+}
+
+/* r = a-borrow, returns borrow. r may alias a */
+static unsigned long chunks_sub_1(unsigned long *r, const unsigned long *a, int n, unsigned long borrow) {
+	int i;
+	for (i = 0; i < n && borrow != 0; i++) {
+		unsigned long chunk = a[i];
+		r[i] = chunk - borrow;
+		borrow = chunk < borrow;
+	}
+	if (r != a) {
+		memmove(r+i, a+i, (n-i)*sizeof(*r));
+	}
+	return borrow;
+}
+
+/* r = a+b where na >= nb, returns carry. r may alias a and/or b */
+static unsigned long chunks_add(unsigned long *r, const unsigned long *a, int na, const unsigned long *b, int nb) {
+	assert(na >= nb);
+	unsigned long carry = chunks_add_n(r, a, b, nb);
+	return chunks_add_1(r+nb, a+nb, na-nb, carry);
+}
+
+/* r = a-b where na >= nb, returns borrow. r may alias a and/or b */
+static unsigned long chunks_sub(unsigned long *r, const unsigned long *a, int na, const unsigned long *b, int nb) {
+	assert(na >= nb);
+	unsigned long borrow = chunks_sub_n(r, a, b, nb);
+	return chunks_sub_1(r+nb, a+nb, na-nb, borrow);
+}
+
+/* r = -a (two's complement). r may alias a */
+static void chunks_negate(unsigned long *r, const unsigned long *a, int n) {
+	unsigned long carry = 1;
+	for (int i = 0; i < n; i++) {
+		r[i] = ~a[i] + carry;
+		carry = carry && r[i] == 0;
+	}
+}
+
+/* r = |a-b| where na >= nb, returns a < b. r may alias a and/or b */
+static int chunks_subtract_absolute(unsigned long *r, const unsigned long *a, int na, const unsigned long *b, int nb) {
+	assert(na >= nb);
+	if (!chunks_is_zero(a+nb, na-nb) || chunks_compare(a, b, nb) >= 0) {
+		chunks_sub(r, a, na, b, nb);
+		return 0;
+	}
+
+	chunks_sub_n(r, b, a, nb); // a < b, so the chunks above nb are all zero
+	memset(r+nb, 0, (na-nb)*sizeof(*r));
+	return 1;
+}
+
+/* r = a*b, returns the most significant chunk of the product. r may alias a when r <= a */
+static unsigned long chunks_mul_1(unsigned long *r, const unsigned long *a, int n, unsigned long b) {
+	unsigned long carry = 0;
+	for (int i = 0; i < n; i++) {
+		unsigned long high;
+		unsigned long low = chunk_multiply(a[i], b, &high);
+		low += carry;
+		carry = high + (low < carry);
+		r[i] = low;
+	}
+	return carry;
+}
+
+/* r += a*b, returns the chunk carried out of r[n-1] */
+static unsigned long chunks_addmul_1(unsigned long *r, const unsigned long *a, int n, unsigned long b) {
+	unsigned long carry = 0;
+	for (int i = 0; i < n; i++) {
+		unsigned long high;
+		unsigned long low = chunk_multiply(a[i], b, &high);
+		low += carry;
+		high += low < carry;
+		r[i] += low;
+		carry = high + (r[i] < low);
+	}
+	return carry;
+}
+
+/* r -= a*b, returns the chunk borrowed from r[n] */
+static unsigned long chunks_submul_1(unsigned long *r, const unsigned long *a, int n, unsigned long b) {
+	unsigned long borrow = 0;
+	for (int i = 0; i < n; i++) {
+		unsigned long high;
+		unsigned long low = chunk_multiply(a[i], b, &high);
+		low += borrow;
+		high += low < borrow;
+		unsigned long chunk = r[i];
+		r[i] = chunk - low;
+		borrow = high + (r[i] > chunk);
+	}
+	return borrow;
+}
+
+/* r = a/3 mod 2^(n*LONG_BIT), which is the quotient when a is divisible by 3. r may alias a */
+static void chunks_divexact_by3(unsigned long *r, const unsigned long *a, int n) {
+	const unsigned long inverse_of_3 = ULONG_MAX/3*2 + 1; // 3*0xaa..ab == 1 mod 2^LONG_BIT
+
+	unsigned long borrow = 0;
+	for (int i = 0; i < n; i++) {
+		unsigned long chunk = a[i];
+		unsigned long low = chunk - borrow;
+		borrow = low > chunk;
+		low *= inverse_of_3;
+		r[i] = low;
+
+		unsigned long high;
+		chunk_multiply(low, 3, &high);
+		borrow += high;
+	}
+}
+
+
+/* r[0..na+nb) = a*b. r must not overlap a or b */
+static void chunks_mul_schoolbook(unsigned long *r, const unsigned long *a, int na, const unsigned long *b, int nb) {
+	assert(na > 0 && nb > 0);
+	r[na] = chunks_mul_1(r, a, na, b[0]);
+	for (int i = 1; i < nb; i++) {
+		r[na+i] = chunks_addmul_1(r+i, a, na, b[i]);
+	}
+}
+
+/* r[0..2n) = a*a. r must not overlap a */
+static void chunks_sqr_schoolbook(unsigned long *r, const unsigned long *a, int n) {
+	assert(n > 0);
+	memset(r, 0, 2*n*sizeof(*r));
+
+	for (int i = 0; i < n-1; i++) { // a[i]*a[j] for i < j, which occur twice in the square
+		r[n+i] = chunks_addmul_1(r+2*i+1, a+i+1, n-i-1, a[i]);
+	}
+	chunks_shift_left(r, r, 2*n, 1);
+
+	unsigned long carry = 0;
+	for (int i = 0; i < n; i++) { // a[i]*a[i] along the diagonal
+		unsigned long square[2];
+		square[0] = chunk_multiply(a[i], a[i], &square[1]);
+		carry = chunks_add_1(square, square, 2, carry);
+		assert(carry == 0);
+		carry = chunks_add_n(r+2*i, r+2*i, square, 2);
+	}
+	assert(carry == 0);
+}
+
+
+/*
+ * number of chunks of scratch space needed by chunks_mul_n/chunks_sqr_n for
+ * operands of n chunks. this is a closed upper bound of the scratch used by
+ * each level of recursion, i.e. karatsuba uses 6h+1 + scratch(h) where
+ * h = ceil(n/2), and toom-3 uses 8k+10 + scratch(k+1) where k = ceil(n/3).
+ */
+static int chunks_mul_scratch(int n) {
+	return n < BIGINT_KARATSUBA_THRESHOLD ? 0 : 8*n + 64;
+}
+
+static void chunks_mul_n(unsigned long *r, const unsigned long *a, const unsigned long *b, int n, unsigned long *scratch);
+static void chunks_sqr_n(unsigned long *r, const unsigned long *a, int n, unsigned long *scratch);
+
+/*
+ * r[0..2n) = a*b using one level of karatsuba, a.k.a. the subtractive
+ * variant where a*b = z2*B^2m + (z0 + z2 - (a1-a0)(b1-b0))*B^m + z0, with
+ * a = a1*B^m + a0, b = b1*B^m + b0, z0 = a0*b0 and z2 = a1*b1.
+ * a == b computes the square. r must not overlap a or b.
+ */
+static void chunks_mul_karatsuba_n(unsigned long *r, const unsigned long *a, const unsigned long *b, int n, unsigned long *scratch) {
+	assert(n >= 2);
+	int square = a == b;
+	int m = n/2, h = n-m; // a0 := a[0..m), a1 := a[m..n)
+
+	unsigned long *da = scratch, *db = scratch+h, *z1 = scratch+2*h, *middle = scratch+4*h;
+	unsigned long *next_scratch = scratch + 6*h+1;
+
+	int negative_da = chunks_subtract_absolute(da, a+m, h, a, m);
+	int negative_db = negative_da;
+	if (square) {
+		chunks_sqr_n(r, a, m, next_scratch);
+		chunks_sqr_n(r+2*m, a+m, h, next_scratch);
+		chunks_sqr_n(z1, da, h, next_scratch);
+	} else {
+		negative_db = chunks_subtract_absolute(db, b+m, h, b, m);
+		chunks_mul_n(r, a, b, m, next_scratch);
+		chunks_mul_n(r+2*m, a+m, b+m, h, next_scratch);
+		chunks_mul_n(z1, da, db, h, next_scratch);
+	}
+
+	memmove(middle, r+2*m, 2*h*sizeof(*middle));
+	middle[2*h] = chunks_add(middle, middle, 2*h, r, 2*m);
+	if (negative_da == negative_db) {
+		chunks_sub(middle, middle, 2*h+1, z1, 2*h);
+	} else {
+		chunks_add(middle, middle, 2*h+1, z1, 2*h);
+	}
+
+	unsigned long carry = chunks_add(r+m, r+m, 2*n-m, middle, 2*h+1);
+	assert(carry == 0);
+	(void)carry;
+}
+
+/* e[0..k+2) = x(point) as two's complement, where x = x2*B^2k + x1*B^k + x0 and point is one of 1, -1, -2 */
+static void chunks_toom3_evaluate(unsigned long *e, const unsigned long *x, int n, int k, int point) {
+	const unsigned long *x0 = x, *x1 = x+k, *x2 = x+2*k;
+	int n2 = n-2*k;
+
+	memset(e, 0, (k+2)*sizeof(*e));
+	switch (point) {
+		case 1:
+			memmove(e, x0, k*sizeof(*e));
+			chunks_add(e, e, k+2, x1, k);
+			chunks_add(e, e, k+2, x2, n2);
+			break;
+		case -1:
+			memmove(e, x0, k*sizeof(*e));
+			chunks_add(e, e, k+2, x2, n2);
+			chunks_sub(e, e, k+2, x1, k);
+			break;
+		case -2:
+			memmove(e, x2, n2*sizeof(*e));
+			chunks_shift_left(e, e, k+2, 1);
+			chunks_sub(e, e, k+2, x1, k);
+			chunks_shift_left(e, e, k+2, 1);
+			chunks_add(e, e, k+2, x0, k);
+			break;
+		default:
+			assert(0 && "unsupported toom-3 evaluation point");
+	}
+}
+
+/* r[0..2k+2) = ea*eb as two's complement, where ea and eb are k+2 chunks of two's complement that get clobbered */
+static void chunks_toom3_pointwise(unsigned long *r, unsigned long *ea, unsigned long *eb, int k, unsigned long *scratch) {
+	int square = ea == eb;
+	int negative_a = ea[k+1] >> LONG_MSB, negative_b = negative_a;
+	if (negative_a) {
+		chunks_negate(ea, ea, k+2);
+	}
+	if (!square) {
+		negative_b = eb[k+1] >> LONG_MSB;
+		if (negative_b) {
+			chunks_negate(eb, eb, k+2);
+		}
+	}
+	assert(ea[k+1] == 0 && eb[k+1] == 0);
+
+	if (square) {
+		chunks_sqr_n(r, ea, k+1, scratch);
+	} else {
+		chunks_mul_n(r, ea, eb, k+1, scratch);
+	}
+
+	if (negative_a != negative_b) {
+		chunks_negate(r, r, 2*k+2);
+	}
+}
+
+/*
+ * r[0..2n) = a*b using one level of toom-3, i.e. evaluate a and b as
+ * polynomials in B^k at 0, 1, -1, -2 and infinity, multiply pointwise and
+ * interpolate back using the sequence by Marco Bodrato. a == b computes the
+ * square. r must not overlap a or b.
+ */
+static void chunks_mul_toom3_n(unsigned long *r, const unsigned long *a, const unsigned long *b, int n, unsigned long *scratch) {
+	assert(n >= 5);
+	int square = a == b;
+	int k = (n+2)/3, n2 = n-2*k; // a0 := a[0..k), a1 := a[k..2k), a2 := a[2k..n)
+	int w = 2*k+2; // chunks in the two's complement products
+
+	unsigned long *ea = scratch, *eb = square ? ea : scratch+k+2;
+	unsigned long *r1 = scratch+2*k+4, *rm1 = r1+w, *rm2 = rm1+w;
+	unsigned long *next_scratch = rm2+w;
+
+	static const int points[] = {1, -1, -2};
+	unsigned long *products[] = {r1, rm1, rm2};
+	for (int i = 0; i < 3; i++) {
+		chunks_toom3_evaluate(ea, a, n, k, points[i]);
+		if (!square) {
+			chunks_toom3_evaluate(eb, b, n, k, points[i]);
+		}
+		chunks_toom3_pointwise(products[i], ea, eb, k, next_scratch);
+	}
+
+	unsigned long *r0 = r, *rinf = r+4*k;
+	if (square) {
+		chunks_sqr_n(r0, a, k, next_scratch);
+		chunks_sqr_n(rinf, a+2*k, n2, next_scratch);
+	} else {
+		chunks_mul_n(r0, a, b, k, next_scratch);
+		chunks_mul_n(rinf, a+2*k, b+2*k, n2, next_scratch);
+	}
+
+	// interpolation, where r1, rm1 and rm2 becomes the coefficients of B^k, B^2k and B^3k respectively
+	chunks_sub_n(rm2, rm2, r1, w); // (r(-2) - r(1))/3
+	chunks_divexact_by3(rm2, rm2, w);
+	chunks_sub_n(r1, r1, rm1, w); // (r(1) - r(-1))/2
+	unsigned long sign = r1[w-1] & LONG_MSB_MASK;
+	chunks_shift_right(r1, r1, w, 1);
+	r1[w-1] |= sign;
+	chunks_sub(rm1, rm1, w, r0, 2*k); // r(-1) - r(0)
+	chunks_sub_n(rm2, rm1, rm2, w); // (rm1 - rm2)/2 + 2r(inf)
+	sign = rm2[w-1] & LONG_MSB_MASK;
+	chunks_shift_right(rm2, rm2, w, 1);
+	rm2[w-1] |= sign;
+	chunks_add(rm2, rm2, w, rinf, 2*n2);
+	chunks_add(rm2, rm2, w, rinf, 2*n2);
+	chunks_add_n(rm1, rm1, r1, w); // rm1 + r1 - r(inf)
+	chunks_sub(rm1, rm1, w, rinf, 2*n2);
+	chunks_sub_n(r1, r1, rm2, w); // r1 - rm2
+
+	// recomposition, the middle part of r is not covered by neither r0 nor r(inf)
+	memset(r+2*k, 0, 2*k*sizeof(*r));
+	unsigned long *coefficients[] = {r1, rm1, rm2};
+	for (int i = 0; i < 3; i++) {
+		int offset = (i+1)*k;
+		int ncoefficient = w < 2*n-offset ? w : 2*n-offset;
+		assert(chunks_is_zero(coefficients[i]+ncoefficient, w-ncoefficient));
+
+		unsigned long carry = chunks_add(r+offset, r+offset, 2*n-offset, coefficients[i], ncoefficient);
+		assert(carry == 0);
+		(void)carry;
+	}
+}
+
+/* r[0..2n) = a*b, dispatching on n to the fastest algorithm. r must not overlap a or b */
+static void chunks_mul_n(unsigned long *r, const unsigned long *a, const unsigned long *b, int n, unsigned long *scratch) {
+	if (a == b) {
+		chunks_sqr_n(r, a, n, scratch);
+	} else if (n < BIGINT_KARATSUBA_THRESHOLD) {
+		chunks_mul_schoolbook(r, a, n, b, n);
+	} else if (n < BIGINT_TOOM3_THRESHOLD) {
+		chunks_mul_karatsuba_n(r, a, b, n, scratch);
+	} else {
+		chunks_mul_toom3_n(r, a, b, n, scratch);
+	}
+}
+
+/* r[0..2n) = a*a, dispatching on n to the fastest algorithm. r must not overlap a */
+static void chunks_sqr_n(unsigned long *r, const unsigned long *a, int n, unsigned long *scratch) {
+	if (n < BIGINT_KARATSUBA_THRESHOLD) {
+		chunks_sqr_schoolbook(r, a, n);
+	} else if (n < BIGINT_TOOM3_THRESHOLD) {
+		chunks_mul_karatsuba_n(r, a, a, n, scratch);
+	} else {
+		chunks_mul_toom3_n(r, a, a, n, scratch);
+	}
+}
+
+/*
+ * number theoretic transform multiplication. the chunks are the coefficients
+ * of two polynomials, whose product is computed modulo three primes
+ * p = k*2^42 + 1 < 2^63. each coefficient of the product is less than
+ * 2^32 * (2^LONG_BIT-1)^2 < p0*p1*p2, so it is recovered exactly from its
+ * residues by garner's algorithm and then carried into place.
+ *
+ * the residues are kept in montgomery form, x*R mod p with R = 2^LONG_BIT,
+ * so that multiplication modulo p needs no division.
+ */
+#if ULONG_MAX == 0xffffffffffffffffUL
+#define BIGINT_HAVE_NTT
+#endif
+#ifndef BIGINT_NTT_THRESHOLD
+#define BIGINT_NTT_THRESHOLD 7168 // nchunk of the shorter operand where multiplication switches from toom-3 to the ntt, see TestBigintNttBenchmark
+#endif /*BIGINT_NTT_THRESHOLD*/
+
+#ifdef BIGINT_HAVE_NTT
+enum {
+	NTT_NPRIME = 3,
+};
+static const unsigned long ntt_primes[NTT_NPRIME][2] = { // p and a generator of the multiplicative group modulo p
+	{0x7fffe40000000001UL, 3},
+	{0x7fffe00000000001UL, 5},
+	{0x7fffcc0000000001UL, 3},
+};
+
+struct ntt_prime {
+	unsigned long p;
+	unsigned long pinv; // -p^-1 mod R
+	unsigned long r2; // R^2 mod p
+};
+
+/* a*b/R mod p where a*b < p*R */
+static inline unsigned long ntt_mul(unsigned long a, unsigned long b, const struct ntt_prime *q) {
+	unsigned long high, low = chunk_multiply(a, b, &high);
+	unsigned long mhigh;
+	chunk_multiply(low*q->pinv, q->p, &mhigh);
+	unsigned long r = high + mhigh + (low != 0); // the low halves sum to 0 mod R, with a carry unless both are 0
+	return r >= q->p ? r - q->p : r;
+}
+
+static inline unsigned long ntt_add(unsigned long a, unsigned long b, const struct ntt_prime *q) {
+	unsigned long sum = a + b;
+	return sum >= q->p ? sum - q->p : sum;
+}
+
+static inline unsigned long ntt_sub(unsigned long a, unsigned long b, const struct ntt_prime *q) {
+	return a >= b ? a - b : a + q->p - b;
+}
+
+/* base^exponent where base and the result are in montgomery form */
+static unsigned long ntt_pow(unsigned long base, unsigned long exponent, const struct ntt_prime *q) {
+	unsigned long result = ntt_mul(1, q->r2, q);
+	for (; exponent != 0; exponent >>= 1) {
+		if (exponent & 1) {
+			result = ntt_mul(result, base, q);
+		}
+		base = ntt_mul(base, base, q);
+	}
+	return result;
+}
+
+static void ntt_prime_init(struct ntt_prime *q, unsigned long p) {
+	q->p = p;
+	q->pinv = -chunk_inverse(p);
+	unsigned long r2 = -p % p; // R mod p
+	for (int i = 0; i < LONG_BIT; i++) {
+		r2 = ntt_add(r2, r2, q);
+	}
+	q->r2 = r2;
+}
+
+/* roots[j] = w^j for j < n/2, where w is a primitive n-th root of unity in montgomery form */
+static void ntt_roots(unsigned long *roots, size_t n, unsigned long w, const struct ntt_prime *q) {
+	roots[0] = ntt_mul(1, q->r2, q);
+	for (size_t j = 1; j < n/2; j++) {
+		roots[j] = ntt_mul(roots[j-1], w, q);
+	}
+}
+
+/* decimation in frequency, a is in natural order and the transform is left in bit reversed order */
+static void ntt_forward(unsigned long *a, size_t n, const unsigned long *roots, const struct ntt_prime *q) {
+	for (size_t m = n/2, stride = 1; m >= 1; m /= 2, stride *= 2) {
+		for (size_t start = 0; start < n; start += 2*m) {
+			for (size_t j = 0; j < m; j++) {
+				unsigned long x = a[start+j], y = a[start+j+m];
+				a[start+j] = ntt_add(x, y, q);
+				a[start+j+m] = ntt_mul(ntt_sub(x, y, q), roots[j*stride], q);
+			}
+		}
+	}
+}
+
+/* decimation in time with inverse roots, undoes ntt_forward except for the factor n */
+static void ntt_inverse(unsigned long *a, size_t n, const unsigned long *inverse_roots, const struct ntt_prime *q) {
+	for (size_t m = 1, stride = n/2; m < n; m *= 2, stride /= 2) {
+		for (size_t start = 0; start < n; start += 2*m) {
+			for (size_t j = 0; j < m; j++) {
+				unsigned long x = a[start+j], y = ntt_mul(a[start+j+m], inverse_roots[j*stride], q);
+				a[start+j] = ntt_add(x, y, q);
+				a[start+j+m] = ntt_sub(x, y, q);
+			}
+		}
+	}
+}
+
+/* c = the transform of a zero padded to n coefficients, in montgomery form */
+static void ntt_transform(unsigned long *c, size_t n, const unsigned long *a, int na, const unsigned long *roots, const struct ntt_prime *q) {
+	for (int i = 0; i < na; i++) {
+		c[i] = ntt_mul(a[i], q->r2, q);
+	}
+	memset(c+na, 0, (n-na)*sizeof(*c));
+	ntt_forward(c, n, roots, q);
+}
+
+/*
+ * r[0..na+nb) = a*b. a == b transforms the operand once.
+ *
+ * returns:
+ *   error --> errno
+ *   --> 0
+ */
+static int chunks_mul_ntt(unsigned long *r, const unsigned long *a, int na, const unsigned long *b, int nb) {
+	size_t ncoefficient = (size_t)na + nb - 1, n = 2;
+	while (n < ncoefficient) {
+		n *= 2;
+	}
+
+	unsigned long *buf = malloc((NTT_NPRIME+2)*n * sizeof(*buf)); // residues of the product, transform of b and the roots
+	if (buf == NULL) {
+		return ENOMEM;
+	}
+	unsigned long *residues[NTT_NPRIME] = {buf, buf+n, buf+2*n}, *work = buf+NTT_NPRIME*n;
+	unsigned long *roots = work+n, *inverse_roots = roots+n/2;
+
+	struct ntt_prime q[NTT_NPRIME];
+	for (int k = 0; k < NTT_NPRIME; k++) {
+		ntt_prime_init(&q[k], ntt_primes[k][0]);
+		unsigned long w = ntt_pow(ntt_mul(ntt_primes[k][1], q[k].r2, &q[k]), (q[k].p-1)/n, &q[k]);
+		ntt_roots(roots, n, w, &q[k]);
+		ntt_roots(inverse_roots, n, ntt_pow(w, n-1, &q[k]), &q[k]);
+
+		unsigned long *c = residues[k];
+		ntt_transform(c, n, a, na, roots, &q[k]);
+		if (a == b && na == nb) {
+			for (size_t i = 0; i < n; i++) {
+				c[i] = ntt_mul(c[i], c[i], &q[k]);
+			}
+		} else {
+			ntt_transform(work, n, b, nb, roots, &q[k]);
+			for (size_t i = 0; i < n; i++) {
+				c[i] = ntt_mul(c[i], work[i], &q[k]);
+			}
+		}
+		ntt_inverse(c, n, inverse_roots, &q[k]);
+
+		unsigned long ninv = q[k].p - (q[k].p-1)/n; // n^-1, which also leaves montgomery form since it is not in it
+		for (size_t i = 0; i < ncoefficient; i++) {
+			c[i] = ntt_mul(c[i], ninv, &q[k]);
+		}
+	}
+
+	/*
+	 * garner: x = x0 + p0*t1 + p0*p1*t2 where t1 = (x1-x0)/p0 mod p1 and
+	 * t2 = (x2-x0-p0*t1)/(p0*p1) mod p2. the constants are in montgomery form.
+	 */
+	unsigned long p0 = q[0].p, p0_mod_p2 = ntt_mul(p0-q[2].p, q[2].r2, &q[2]);
+	unsigned long inverse_p0 = ntt_pow(ntt_mul(p0-q[1].p, q[1].r2, &q[1]), q[1].p-2, &q[1]);
+	unsigned long inverse_p0p1 = ntt_pow(ntt_mul(p0_mod_p2, ntt_mul(q[1].p, q[2].r2, &q[2]), &q[2]), q[2].p-2, &q[2]);
+	unsigned long p0p1[2];
+	p0p1[0] = chunk_multiply(p0, q[1].p, &p0p1[1]);
+
+	unsigned long acc[3] = {0};
+	for (size_t i = 0; i < ncoefficient; i++) {
+		unsigned long x0 = residues[0][i], x1 = residues[1][i], x2 = residues[2][i];
+		unsigned long t1 = ntt_mul(ntt_sub(x1, x0 >= q[1].p ? x0 - q[1].p : x0, &q[1]), inverse_p0, &q[1]);
+		unsigned long u = ntt_sub(ntt_sub(x2, x0 >= q[2].p ? x0 - q[2].p : x0, &q[2]), ntt_mul(t1, p0_mod_p2, &q[2]), &q[2]);
+		unsigned long t2 = ntt_mul(u, inverse_p0p1, &q[2]);
+
+		unsigned long v[2], w[3], carry, carry_w;
+		v[0] = chunk_multiply(p0, t1, &v[1]);
+		v[0] = chunk_add_carry(v[0], x0, 0, &carry);
+		v[1] += carry; // p0*t1 + x0 < p0*p1
+		w[0] = chunk_multiply(t2, p0p1[0], &w[1]);
+		w[1] = chunk_add_carry(w[1], chunk_multiply(t2, p0p1[1], &w[2]), 0, &carry);
+		w[2] += carry;
+
+		acc[0] = chunk_add_carry(acc[0], v[0], 0, &carry);
+		acc[0] = chunk_add_carry(acc[0], w[0], 0, &carry_w);
+		acc[1] = chunk_add_carry(acc[1], v[1], carry, &carry);
+		acc[1] = chunk_add_carry(acc[1], w[1], carry_w, &carry_w);
+		acc[2] += w[2] + carry + carry_w;
+		r[i] = acc[0];
+		acc[0] = acc[1];
+		acc[1] = acc[2];
+		acc[2] = 0;
+	}
+	r[ncoefficient] = acc[0];
+	assert(acc[1] == 0);
+
+	free(buf);
+	return 0;
+}
+#endif /* BIGINT_HAVE_NTT */
+
+
+/*
+ * r[0..na+nb) = a*b where na >= nb. unbalanced operands are multiplied as
+ * a sequence of nb*nb products, or all at once by the ntt when nb is large
+ * enough. r must not overlap a or b.
+ *
+ * returns:
+ *   error --> errno
+ *   --> 0
+ */
+static int chunks_mul(unsigned long *r, const unsigned long *a, int na, const unsigned long *b, int nb) {
+	assert(na >= nb && nb > 0);
+	if (nb < BIGINT_KARATSUBA_THRESHOLD) {
+		chunks_mul_schoolbook(r, a, na, b, nb);
+		return 0;
+	}
+#ifdef BIGINT_HAVE_NTT
+	if (nb >= BIGINT_NTT_THRESHOLD) {
+		return chunks_mul_ntt(r, a, na, b, nb);
+	}
+#endif /* BIGINT_HAVE_NTT */
+
+	unsigned long *scratch = malloc((chunks_mul_scratch(nb) + 2*nb) * sizeof(*scratch));
+	if (scratch == NULL) {
+		return ENOMEM;
+	}
+	unsigned long *product = scratch + chunks_mul_scratch(nb);
+
+	int status = 0;
+	if (a == b && na == nb) {
+		chunks_sqr_n(r, a, na, scratch);
+		goto cleanup;
+	}
+
+	chunks_mul_n(r, a, b, nb, scratch);
+	int offset;
+	for (offset = nb; offset+nb <= na; offset += nb) {
+		chunks_mul_n(product, a+offset, b, nb, scratch);
+		chunks_add(r+offset, product, 2*nb, r+offset, nb);
+	}
+
+	int nrest = na-offset;
+	if (nrest > 0) {
+		if ((status = chunks_mul(product, b, nb, a+offset, nrest)) != 0) {
+			goto cleanup;
+		}
+		chunks_add(r+offset, product, nb+nrest, r+offset, nb);
+	}
+
+cleanup:
+	free(scratch);
+	return status;
+}
+
+/*
+ * a+b, or a+~b+1 when invert_b == ULONG_MAX, one chunk at a time with the
+ * carry taken from the sum of the MSBs. this is how bigint_add worked before
+ * chunks_add_padded, and it is kept as reference.
+ */
+static void chunks_add_padded_by_msb_for_test(unsigned long *r, const unsigned long *a, int na, unsigned long pad_a, const unsigned long *b, int nb, unsigned long pad_b, int n, unsigned long invert_b) {
+	for (int i = 0, carry = invert_b & 1; i < n; i++) {
+		unsigned long chunk_a = i < na ? a[i] : pad_a, chunk_b = (i < nb ? b[i] : pad_b) ^ invert_b;
+		unsigned long sum_of_all_but_msbs = (chunk_a & ~LONG_MSB_MASK) + (chunk_b & ~LONG_MSB_MASK) + carry;
+		unsigned long sum_of_msbs = (chunk_a >> LONG_MSB) + (chunk_b >> LONG_MSB) + (sum_of_all_but_msbs>>LONG_MSB);
+
+		r[i] = (sum_of_all_but_msbs & ~LONG_MSB_MASK) | sum_of_msbs<<LONG_MSB;
+		carry = sum_of_msbs>>1;
+	}
+}
+void TestChunks_add_padded(CuTest *tc) {
+	enum {
+		MAX_NCHUNK = 40,
+	};
+	unsigned long a[MAX_NCHUNK], b[MAX_NCHUNK], r[MAX_NCHUNK+1], expected[MAX_NCHUNK+1];
+
+	srand(1337);
+	for (int na = 1; na <= MAX_NCHUNK; na += 3) {
+		for (int nb = 1; nb <= MAX_NCHUNK; nb += 5) {
+			random_chunks(a, na);
+			random_chunks(b, nb);
+			unsigned long pad_a = pad_chunks[a[na-1] >> LONG_MSB], pad_b = pad_chunks[b[nb-1] >> LONG_MSB];
+			int n = (na > nb ? na : nb) + 1;
+
+			chunks_add_padded(r, a, na, pad_a, b, nb, pad_b, n);
+			chunks_add_padded_by_msb_for_test(expected, a, na, pad_a, b, nb, pad_b, n, 0);
+			CuAssertIntEquals(tc, 0, memcmp(expected, r, n*sizeof(*r)));
+
+			chunks_sub_padded(r, a, na, pad_a, b, nb, pad_b, n);
+			chunks_add_padded_by_msb_for_test(expected, a, na, pad_a, b, nb, pad_b, n, ULONG_MAX);
+			CuAssertIntEquals(tc, 0, memcmp(expected, r, n*sizeof(*r)));
+
+			memmove(r, a, na*sizeof(*a));
+			chunks_sub_padded(r, r, na, pad_a, b, nb, pad_b, n);
+			CuAssertIntEquals(tc, 0, memcmp(expected, r, n*sizeof(*r)));
+		}
+	}
+}
+void TestBigintAdditionBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		MAX_NCHUNK = 10000,
+		NITERATION = 1000,
+	};
+	static unsigned long a[MAX_NCHUNK], b[MAX_NCHUNK], r[MAX_NCHUNK+1];
+	random_chunks(a, MAX_NCHUNK);
+	random_chunks(b, MAX_NCHUNK);
+
+	const int nchunks[] = {1, 2, 4, 10, 100, 1000, 10000};
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		int n = nchunks[i], nb = n - n/4; // so that the padded tail is included
+		char description[64];
+
+		snprintf(description, sizeof(description), "add by msb %d", n);
+		TIMED_BLOCK(NITERATION, description) {
+			chunks_add_padded_by_msb_for_test(r, a, n, 0, b, nb, ULONG_MAX, n+1, 0);
+		}
+		snprintf(description, sizeof(description), "add carry chain %d", n);
+		TIMED_BLOCK(NITERATION, description) {
+			chunks_add_padded(r, a, n, 0, b, nb, ULONG_MAX, n+1);
+		}
+		snprintf(description, sizeof(description), "subtract by msb %d", n);
+		TIMED_BLOCK(NITERATION, description) {
+			chunks_add_padded_by_msb_for_test(r, a, n, 0, b, nb, ULONG_MAX, n+1, ULONG_MAX);
+		}
+		snprintf(description, sizeof(description), "subtract borrow chain %d", n);
+		TIMED_BLOCK(NITERATION, description) {
+			chunks_sub_padded(r, a, n, 0, b, nb, ULONG_MAX, n+1);
+		}
+	}
+
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		struct bigint *x = bigint_random_for_test(nchunks[i]), *y = bigint_random_for_test(nchunks[i]);
+		struct bigint *res = bigint_with_capacity(nchunks[i]+1);
+		CuAssertPtrNotNull(tc, x);
+		CuAssertPtrNotNull(tc, y);
+		CuAssertPtrNotNull(tc, res);
+
+		char description[64];
+		snprintf(description, sizeof(description), "bigint_add %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_destroy(bigint_add(x, y));
+		}
+		snprintf(description, sizeof(description), "bigint_add_into %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_add_into(res, x, y);
+		}
+
+		bigint_destroy(x);
+		bigint_destroy(y);
+		bigint_destroy(res);
+	}
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
+void TestChunks_mul(CuTest *tc) {
+	enum {
+		MAX_NCHUNK = 2*BIGINT_TOOM3_THRESHOLD + 7,
+	};
+	static unsigned long a[MAX_NCHUNK], b[MAX_NCHUNK], expected[2*MAX_NCHUNK], r[2*MAX_NCHUNK];
+	static unsigned long scratch[8*MAX_NCHUNK + 64];
+
+	const int nchunks[] = {
+		1, 2, 3, 5, 8,
+		BIGINT_KARATSUBA_THRESHOLD-1, BIGINT_KARATSUBA_THRESHOLD, BIGINT_KARATSUBA_THRESHOLD+1, 2*BIGINT_KARATSUBA_THRESHOLD+1,
+		BIGINT_TOOM3_THRESHOLD-1, BIGINT_TOOM3_THRESHOLD, BIGINT_TOOM3_THRESHOLD+1, MAX_NCHUNK,
+	};
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		int n = nchunks[i];
+		random_chunks(a, n);
+		random_chunks(b, n);
+
+		chunks_mul_schoolbook(expected, a, n, b, n);
+		chunks_mul_n(r, a, b, n, scratch);
+		CuAssertIntEquals(tc, 0, chunks_compare(expected, r, 2*n));
+		if (n >= 2) {
+			chunks_mul_karatsuba_n(r, a, b, n, scratch);
+			CuAssertIntEquals(tc, 0, chunks_compare(expected, r, 2*n));
+		}
+		if (n >= 5) {
+			chunks_mul_toom3_n(r, a, b, n, scratch);
+			CuAssertIntEquals(tc, 0, chunks_compare(expected, r, 2*n));
+		}
+
+		chunks_mul_schoolbook(expected, a, n, a, n);
+		chunks_sqr_schoolbook(r, a, n);
+		CuAssertIntEquals(tc, 0, chunks_compare(expected, r, 2*n));
+		chunks_sqr_n(r, a, n, scratch);
+		CuAssertIntEquals(tc, 0, chunks_compare(expected, r, 2*n));
+
+		for (size_t j = 0; j <= i; j++) { // unbalanced
+			int nb = nchunks[j];
+			if (nb > n) {
+				continue;
+			}
+			chunks_mul_schoolbook(expected, a, n, b, nb);
+			CuAssertIntEquals(tc, 0, chunks_mul(r, a, n, b, nb));
+			CuAssertIntEquals(tc, 0, chunks_compare(expected, r, n+nb));
+		}
+	}
+
+	for (int n = 1; n < 2*BIGINT_KARATSUBA_THRESHOLD; n++) { // all the small splits
+		random_chunks(a, n);
+		memset(b, 0xff, n*sizeof(*b)); // worst case for carries
+		chunks_mul_schoolbook(expected, a, n, b, n);
+		if (n >= 2) {
+			chunks_mul_karatsuba_n(r, a, b, n, scratch);
+			CuAssertIntEquals(tc, 0, chunks_compare(expected, r, 2*n));
+			chunks_mul_karatsuba_n(r, b, b, n, scratch);
+			chunks_mul_schoolbook(expected, b, n, b, n);
+			CuAssertIntEquals(tc, 0, chunks_compare(expected, r, 2*n));
+		}
+		if (n >= 5) {
+			chunks_mul_schoolbook(expected, a, n, b, n);
+			chunks_mul_toom3_n(r, a, b, n, scratch);
+			CuAssertIntEquals(tc, 0, chunks_compare(expected, r, 2*n));
+			chunks_mul_toom3_n(r, b, b, n, scratch);
+			chunks_mul_schoolbook(expected, b, n, b, n);
+			CuAssertIntEquals(tc, 0, chunks_compare(expected, r, 2*n));
+		}
+	}
+}
+
+
+void TestChunks_mul_ntt(CuTest *tc) {
+#ifdef BIGINT_HAVE_NTT
+	enum {
+		MAX_NCHUNK = 3000,
+	};
+	static unsigned long a[MAX_NCHUNK], b[MAX_NCHUNK], expected[2*MAX_NCHUNK], r[2*MAX_NCHUNK+1];
+	static unsigned long scratch[8*MAX_NCHUNK + 64];
+
+	const int nchunks[] = {1, 2, 3, 7, 64, 65, 100, 1000, 1024, 2047, MAX_NCHUNK};
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		int n = nchunks[i];
+		random_chunks(a, n);
+		random_chunks(b, n);
+
+		r[2*n] = 42;
+		chunks_mul_n(expected, a, b, n, scratch);
+		CuAssertIntEquals(tc, 0, chunks_mul_ntt(r, a, n, b, n));
+		CuAssertIntEquals(tc, 0, chunks_compare(expected, r, 2*n));
+		CuAssertTrue(tc, r[2*n] == 42);
+
+		chunks_sqr_n(expected, a, n, scratch);
+		CuAssertIntEquals(tc, 0, chunks_mul_ntt(r, a, n, a, n));
+		CuAssertIntEquals(tc, 0, chunks_compare(expected, r, 2*n));
+
+		memset(b, 0xff, n*sizeof(*b)); // the largest coefficients, n*(2^LONG_BIT-1)^2
+		chunks_sqr_n(expected, b, n, scratch);
+		CuAssertIntEquals(tc, 0, chunks_mul_ntt(r, b, n, b, n));
+		CuAssertIntEquals(tc, 0, chunks_compare(expected, r, 2*n));
+
+		for (size_t j = 0; j < i; j++) { // unbalanced
+			int nb = nchunks[j];
+			random_chunks(b, nb);
+			chunks_mul_schoolbook(expected, a, n, b, nb);
+			CuAssertIntEquals(tc, 0, chunks_mul_ntt(r, a, n, b, nb));
+			CuAssertIntEquals(tc, 0, chunks_compare(expected, r, n+nb));
+		}
+	}
+
+	// through bigint_multiply, which switches to the ntt at BIGINT_NTT_THRESHOLD
+	struct bigint *x = bigint_random_for_test(BIGINT_NTT_THRESHOLD+5), *y = bigint_random_for_test(BIGINT_NTT_THRESHOLD);
+	struct bigint *product = bigint_multiply(x, y), *divisor = bigint_from_long(0);
+	struct bigint *quotient = NULL, *remainder = NULL;
+	CuAssertPtrNotNull(tc, product);
+	CuAssertIntEquals(tc, 0, bigint_divmod(product, y, &quotient, &remainder));
+	CuAssertIntEquals(tc, 0, bigint_compare(x, quotient));
+	CuAssertIntEquals(tc, 0, bigint_compare(divisor, remainder));
+	bigint_destroy(x);
+	bigint_destroy(y);
+	bigint_destroy(product);
+	bigint_destroy(divisor);
+	bigint_destroy(quotient);
+	bigint_destroy(remainder);
+#else
+	(void)tc;
+#endif /* BIGINT_HAVE_NTT */
+}
+
+
+void TestBigintNttBenchmark(CuTest *tc) {
+#if defined(JCCL_BENCHMARK) && defined(BIGINT_HAVE_NTT)
+	enum {
+		MAX_NCHUNK = 1<<20,
+		MAX_TOOM3_NCHUNK = 1<<15,
+		NITERATION = 3,
+	};
+	unsigned long *a = malloc(MAX_NCHUNK * sizeof(*a)), *b = malloc(MAX_NCHUNK * sizeof(*b));
+	unsigned long *r = malloc(2*MAX_NCHUNK * sizeof(*r)), *scratch = malloc((8*MAX_TOOM3_NCHUNK + 64) * sizeof(*scratch));
+	CuAssertPtrNotNull(tc, a);
+	CuAssertPtrNotNull(tc, b);
+	CuAssertPtrNotNull(tc, r);
+	CuAssertPtrNotNull(tc, scratch);
+	random_chunks(a, MAX_NCHUNK);
+	random_chunks(b, MAX_NCHUNK);
+
+	// toom-3 is n^1.46 and the ntt n*log(n), so doubling n should about triple and about double the times respectively
+	for (int n = 1<<9; n <= MAX_NCHUNK; n *= 2) {
+		char description[64];
+		if (n <= MAX_TOOM3_NCHUNK) {
+			snprintf(description, sizeof(description), "toom-3 %d", n);
+			TIMED_BLOCK(NITERATION, description) {
+				chunks_mul_toom3_n(r, a, b, n, scratch);
+			}
+		}
+		snprintf(description, sizeof(description), "ntt %d", n);
+		TIMED_BLOCK(NITERATION, description) {
+			CuAssertIntEquals(tc, 0, chunks_mul_ntt(r, a, n, b, n));
+		}
+	}
+
+	free(a);
+	free(b);
+	free(r);
+	free(scratch);
+#else
+	(void)tc;
+#endif /* JCCL_BENCHMARK && BIGINT_HAVE_NTT */
+}
+
+
+/*
+ * the magnitude of n, i.e. n->chunks when n is positive, otherwise the
+ * negation stored in buf, which must have room for n->nchunk chunks.
+ */
+static const unsigned long *bigint_magnitude(const struct bigint *n, unsigned long *buf) {
+	if (bigint_msb(n, -1) == 0) {
+		return n->chunks;
+	}
+
+	chunks_negate(buf, n->chunks, n->nchunk);
+	return buf;
+}
+
+
+int bigint_multiply_into(struct bigint *dst, const struct bigint *a, const struct bigint *b) {
+	if (dst == NULL || a == NULL || b == NULL) {
+		return EINVAL;
+	}
+
+	if (a->nchunk < b->nchunk) {
+		const struct bigint *tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	int nchunk = a->nchunk + b->nchunk;
+	int negative_a = bigint_msb(a, -1), negative_b = bigint_msb(b, -1);
+
+	if (nchunk == 2) {
+		unsigned long small[3] = {0};
+		unsigned long a0 = negative_a ? -a->chunks[0] : a->chunks[0], b0 = negative_b ? -b->chunks[0] : b->chunks[0];
+		small[0] = chunk_multiply(a0, b0, &small[1]);
+		if (negative_a != negative_b) {
+			chunks_negate(small, small, 3);
+		}
+		return bigint_assign_chunks(dst, small, 3);
+	}
+
+	int aliased = dst == a || dst == b; // then the product is computed in buf and copied into dst afterwards
+
+	if (!aliased && bigint_reserve(dst, nchunk) != 0) {
+		return ENOMEM;
+	}
+
+	unsigned long *buf = NULL;
+	if (negative_a || negative_b || aliased) {
+		if ((buf = malloc(2*nchunk * sizeof(*buf))) == NULL) { // magnitudes and product
+			return ENOMEM;
+		}
+	}
+
+	int status = 0;
+	unsigned long *product = aliased ? buf+nchunk : dst->chunks;
+	const unsigned long *ma = bigint_magnitude(a, buf);
+	const unsigned long *mb = a == b ? ma : bigint_magnitude(b, buf+a->nchunk);
+	if ((status = chunks_mul(product, ma, a->nchunk, mb, b->nchunk)) != 0) {
+		goto cleanup;
+	}
+
+	if (negative_a != negative_b) {
+		chunks_negate(product, product, nchunk);
+	}
+
+	if (aliased) {
+		if ((status = bigint_reserve(dst, nchunk)) != 0) {
+			goto cleanup;
+		}
+		memmove(dst->chunks, product, nchunk*sizeof(*product));
+	}
+	dst->nchunk = nchunk;
+	bigint_identify_pad_chunk_and_trim(dst);
+
+cleanup:
+	free(buf);
+	return status;
+}
+
+
+int bigint_square_into(struct bigint *dst, const struct bigint *n) {
+	return bigint_multiply_into(dst, n, n);
+}
+
+
+struct bigint *bigint_multiply(const struct bigint *a, const struct bigint *b) {
+	if (a == NULL || b == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(a->nchunk + b->nchunk, bigint_multiply_into(res, a, b));
+}
+
+
+struct bigint *bigint_square(const struct bigint *n) {
+	return bigint_multiply(n, n);
+}
+
+
+void TestBigint_shl_ul(CuTest *tc) {
+	const int nchunks[] = {1, 2, 3, 5, 17};
+	const unsigned long shifts[] = {0, 1, 31, 63, 64, 65, 128, 200, 1000};
+
+	struct bigint *one = bigint_from_long(1);
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		for (size_t j = 0; j < sizeof(shifts)/sizeof(*shifts); j++) {
+			struct bigint *a = bigint_random_for_test(nchunks[i]);
+			struct bigint *power = bigint_shl_ul(one, shifts[j]);
+
+			// a<<shift == a*2^shift
+			struct bigint *expected = bigint_multiply(a, power);
+			struct bigint *left = bigint_shl_ul(a, shifts[j]);
+			CuAssertIntEquals(tc, 0, bigint_compare(expected, left));
+
+			// 0 <= a - (a>>shift)*2^shift < 2^shift, i.e. floor division
+			struct bigint *right = bigint_shr_ul(a, shifts[j]);
+			struct bigint *rest = bigint_multiply(right, power);
+			CuAssertIntEquals(tc, 0, bigint_subtract_into(rest, a, rest));
+			CuAssertIntEquals(tc, 1, bigint_msb(rest, -1) == 0);
+			CuAssertIntEquals(tc, -1, bigint_compare(rest, power));
+
+			// in place, also when the shifted value moves between inline and allocated storage
+			struct bigint in_place = BIGINT_STATIC_INIT(in_place);
+			CuAssertIntEquals(tc, 0, bigint_copy_into(&in_place, a));
+			CuAssertIntEquals(tc, 0, bigint_shl_ul_into(&in_place, &in_place, shifts[j]));
+			CuAssertIntEquals(tc, 0, bigint_compare(left, &in_place));
+			CuAssertIntEquals(tc, 0, bigint_shr_ul_into(&in_place, &in_place, shifts[j]));
+			CuAssertIntEquals(tc, 0, bigint_compare(a, &in_place));
+			CuAssertIntEquals(tc, 0, bigint_copy_into(&in_place, a));
+			CuAssertIntEquals(tc, 0, bigint_shr_ul_into(&in_place, &in_place, shifts[j]));
+			CuAssertIntEquals(tc, 0, bigint_compare(right, &in_place));
+			bigint_clear(&in_place);
+
+			bigint_destroy(a);
+			bigint_destroy(power);
+			bigint_destroy(expected);
+			bigint_destroy(left);
+			bigint_destroy(right);
+			bigint_destroy(rest);
+		}
+	}
+
+	struct bigint dst = BIGINT_STATIC_INIT(dst);
+	CuAssertIntEquals(tc, ERANGE, bigint_shl_ul_into(&dst, one, ULONG_MAX));
+	CuAssertIntEquals(tc, 0, bigint_shr_ul_into(&dst, one, ULONG_MAX));
+	CuAssertIntEquals(tc, 1, chunks_is_zero(dst.chunks, dst.nchunk));
+	bigint_clear(&dst);
+	bigint_destroy(one);
+}
+
+
+void TestBigint_multiply(CuTest *tc) {
+	enum {
+		NHEXSTRING = 10,
+		RES_LEN = 48+1,
+	};
+
+	enum {
+		A,
+		B,
+		MINUS_ONE,
+		A_MULTIPLY_A,
+		A_MULTIPLY_B,
+		B_MULTIPLY_A,
+		B_MULTIPLY_B,
+		A_MULTIPLY_MINUS_ONE,
+		B_MULTIPLY_MINUS_ONE,
+		SQUARE_B,
+	};
+	const char *hexstrings[] = {
+		"00000000000000010000000000000000",
+		"ffffffffffffffff7fffffffffffffff",
+		"ffffffffffffffff",
+		"000000000000000100000000000000000000000000000000",
+		"ffffffffffffffff7fffffffffffffff0000000000000000",
+		"ffffffffffffffff7fffffffffffffff0000000000000000",
+		"40000000000000010000000000000001",
+		"ffffffffffffffff0000000000000000",
+		"00000000000000008000000000000001",
+		"40000000000000010000000000000001",
+	};
+
+	struct bigint *bns[NHEXSTRING];
+	bns[A] = bigint_from_msb_first_hexstring(hexstrings[A], 0);
+	bns[B] = bigint_from_msb_first_hexstring(hexstrings[B], 0);
+	bns[MINUS_ONE] = bigint_from_msb_first_hexstring(hexstrings[MINUS_ONE], 0);
+	bns[A_MULTIPLY_A] = bigint_multiply(bns[A], bns[A]);
+	bns[A_MULTIPLY_B] = bigint_multiply(bns[A], bns[B]);
+	bns[B_MULTIPLY_A] = bigint_multiply(bns[B], bns[A]);
+	bns[B_MULTIPLY_B] = bigint_multiply(bns[B], bns[B]);
+	bns[A_MULTIPLY_MINUS_ONE] = bigint_multiply(bns[A], bns[MINUS_ONE]);
+	bns[B_MULTIPLY_MINUS_ONE] = bigint_multiply(bns[B], bns[MINUS_ONE]);
+	bns[SQUARE_B] = bigint_square(bns[B]);
+
+	for (int i = 0; i < NHEXSTRING; i++) {
+		char res[RES_LEN];
+		CuAssertIntEquals(tc, strlen(hexstrings[i]), bigint_to_msb_first_hexstring(bns[i], res));
+		CuAssertStrEquals(tc, hexstrings[i], res);
+		bigint_destroy(bns[i]);
+	}
+
+	const int nchunks[] = {1, 3, BIGINT_KARATSUBA_THRESHOLD+3, BIGINT_TOOM3_THRESHOLD+3, 3*BIGINT_TOOM3_THRESHOLD};
+	enum {
+		NNCHUNK = sizeof(nchunks)/sizeof(*nchunks),
+	};
+	for (int i = 0; i < NNCHUNK; i++) {
+		struct bigint *a = bigint_random_for_test(nchunks[i]);
+		struct bigint *b = bigint_random_for_test(nchunks[NNCHUNK-1-i]);
+		struct bigint *c = bigint_random_for_test(nchunks[i]);
+		struct bigint *a_add_b = bigint_add(a, b);
+		struct bigint *a_add_b_multiply_c = bigint_multiply(a_add_b, c);
+		struct bigint *a_multiply_c = bigint_multiply(a, c);
+		struct bigint *b_multiply_c = bigint_multiply(b, c);
+		struct bigint *distributed = bigint_add(a_multiply_c, b_multiply_c);
+		struct bigint *square_a_add_b = bigint_square(a_add_b);
+		struct bigint *a_add_b_multiply_a_add_b = bigint_multiply(a_add_b, a_add_b);
+		struct bigint *b_multiply_a = bigint_multiply(b, a);
+		struct bigint *a_multiply_b = bigint_multiply(a, b);
+
+		CuAssertPtrNotNull(tc, distributed);
+		CuAssertIntEquals(tc, 0, bigint_compare(a_add_b_multiply_c, distributed));
+		CuAssertPtrNotNull(tc, square_a_add_b);
+		CuAssertIntEquals(tc, 0, bigint_compare(square_a_add_b, a_add_b_multiply_a_add_b));
+		CuAssertPtrNotNull(tc, a_multiply_b);
+		CuAssertIntEquals(tc, 0, bigint_compare(a_multiply_b, b_multiply_a));
+
+		bigint_destroy(a);
+		bigint_destroy(b);
+		bigint_destroy(c);
+		bigint_destroy(a_add_b);
+		bigint_destroy(a_add_b_multiply_c);
+		bigint_destroy(a_multiply_c);
+		bigint_destroy(b_multiply_c);
+		bigint_destroy(distributed);
+		bigint_destroy(square_a_add_b);
+		bigint_destroy(a_add_b_multiply_a_add_b);
+		bigint_destroy(b_multiply_a);
+		bigint_destroy(a_multiply_b);
+	}
+}
+
+
+void TestBigintMultiplicationBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		MAX_NCHUNK = 1024,
+		NITERATION = 20,
+	};
+	static unsigned long a[MAX_NCHUNK], b[MAX_NCHUNK], r[2*MAX_NCHUNK];
+	static unsigned long scratch[8*MAX_NCHUNK + 64];
+	random_chunks(a, MAX_NCHUNK);
+	random_chunks(b, MAX_NCHUNK);
+
+	const int nchunks[] = {8, 12, 16, 20, 24, 32, 48, 64, 96, 128, 160, 192, 256, 384, 512, 768, 1024};
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		int n = nchunks[i];
+		char description[64];
+
+		snprintf(description, sizeof(description), "schoolbook %d", n);
+		TIMED_BLOCK(NITERATION, description) {
+			chunks_mul_schoolbook(r, a, n, b, n);
+		}
+		snprintf(description, sizeof(description), "karatsuba %d", n);
+		TIMED_BLOCK(NITERATION, description) {
+			chunks_mul_karatsuba_n(r, a, b, n, scratch);
+		}
+		snprintf(description, sizeof(description), "toom-3 %d", n);
+		TIMED_BLOCK(NITERATION, description) {
+			chunks_mul_toom3_n(r, a, b, n, scratch);
+		}
+		snprintf(description, sizeof(description), "square %d", n);
+		TIMED_BLOCK(NITERATION, description) {
+			chunks_sqr_n(r, a, n, scratch);
+		}
+	}
+
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		struct bigint *x = bigint_random_for_test(nchunks[i]), *y = bigint_random_for_test(nchunks[i]);
+		CuAssertPtrNotNull(tc, x);
+		CuAssertPtrNotNull(tc, y);
+
+		char description[64];
+		snprintf(description, sizeof(description), "bigint_multiply %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_destroy(bigint_multiply(x, y));
+		}
+
+		bigint_destroy(x);
+		bigint_destroy(y);
+	}
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
+
+
+/* number of chunks in a without the most significant zero chunks */
+static inline int chunks_significant(const unsigned long *a, int n) {
+	while (n > 0 && a[n-1] == 0) {
+		n--;
+	}
+	return n;
+}
+
+/* q[0..n) = a/d, returns the remainder. q may alias a */
+static unsigned long chunks_divrem_1(unsigned long *q, const unsigned long *a, int n, unsigned long d) {
+	assert(d != 0);
+	unsigned long remainder = 0;
+	for (int i = n-1; i >= 0; i--) {
+		q[i] = chunk_divide(remainder, a[i], d, &remainder);
+	}
+	return remainder;
+}
+
+/*
+ * q[0..na-nd+1) = a/d and r[0..nd) = a%d, where na >= nd and d[nd-1] != 0.
+ * this is algorithm D from Knuth's The Art of Computer Programming vol. 2,
+ * section 4.3.1. scratch has room for na+nd+1 chunks. q and r must not
+ * overlap any of the input.
+ */
+static void chunks_divrem(unsigned long *q, unsigned long *r, const unsigned long *a, int na, const unsigned long *d, int nd, unsigned long *scratch) {
+	assert(na >= nd && nd > 0 && d[nd-1] != 0);
+	if (nd == 1) {
+		r[0] = chunks_divrem_1(q, a, na, d[0]);
+		return;
+	}
+
+	unsigned long *u = scratch, *v = scratch+na+1; // normalized so that the msb of v[nd-1] is set
+	int shift = __builtin_clzl(d[nd-1]);
+	if (shift > 0) {
+		u[na] = chunks_shift_left(u, a, na, shift);
+		chunks_shift_left(v, d, nd, shift);
+	} else {
+		memmove(u, a, na*sizeof(*u));
+		u[na] = 0;
+		memmove(v, d, nd*sizeof(*v));
+	}
+
+	unsigned long vtop = v[nd-1], vnext = v[nd-2];
+	for (int j = na-nd; j >= 0; j--) {
+		unsigned long qhat, rhat;
+		int rhat_overflow = 0;
+		if (u[j+nd] >= vtop) { // then u[j+nd] == vtop, and the estimate would not fit in a chunk
+			qhat = ULONG_MAX;
+			rhat = u[j+nd-1] + vtop;
+			rhat_overflow = rhat < vtop;
+		} else {
+			qhat = chunk_divide(u[j+nd], u[j+nd-1], vtop, &rhat);
+		}
+
+		while (!rhat_overflow) { // qhat is at most 2 too large, these tests catches most such cases
+			unsigned long high, low = chunk_multiply(qhat, vnext, &high);
+			if (high < rhat || (high == rhat && low <= u[j+nd-2])) {
+				break;
+			}
+			qhat--;
+			rhat += vtop;
+			rhat_overflow = rhat < vtop;
+		}
+
+		unsigned long borrow = chunks_submul_1(u+j, v, nd, qhat);
+		unsigned long top = u[j+nd];
+		u[j+nd] = top - borrow;
+		if (top < borrow) { // qhat was still one too large, so add back
+			qhat--;
+			u[j+nd] += chunks_add_n(u+j, u+j, v, nd);
+		}
+		q[j] = qhat;
+	}
+
+	if (shift > 0) {
+		chunks_shift_right(r, u, nd, shift);
+		r[nd-1] |= u[nd] << (LONG_BIT-shift);
+	} else {
+		memmove(r, u, nd*sizeof(*r));
+	}
+}
+void TestChunks_divrem(CuTest *tc) {
+	enum {
+		MAX_NCHUNK = 64,
+	};
+	unsigned long a[MAX_NCHUNK], d[MAX_NCHUNK], q[MAX_NCHUNK], r[MAX_NCHUNK], product[2*MAX_NCHUNK];
+	unsigned long scratch[2*MAX_NCHUNK+1];
+
+	for (int na = 1; na <= MAX_NCHUNK; na += 7) {
+		for (int nd = 1; nd <= na; nd += 3) {
+			for (int i = 0; i < 4; i++) {
+				random_chunks(a, na);
+				random_chunks(d, nd);
+				switch (i) {
+					case 1: d[nd-1] = 1; break; // maximal normalization shift
+					case 2: d[nd-1] = ULONG_MAX; memset(a+na-nd, 0xff, nd*sizeof(*a)); break; // qhat == ULONG_MAX
+					case 3: d[nd-1] = LONG_MSB_MASK; break; // no normalization
+					default: d[nd-1] |= 1; break;
+				}
+
+				chunks_divrem(q, r, a, na, d, nd, scratch);
+
+				CuAssertTrue(tc, chunks_compare(r, d, nd) < 0);
+				chunks_mul_schoolbook(product, q, na-nd+1, d, nd);
+				CuAssertIntEquals(tc, 0, chunks_add(product, product, na+1, r, nd));
+				CuAssertIntEquals(tc, 0, product[na]);
+				CuAssertIntEquals(tc, 0, chunks_compare(product, a, na));
+			}
+		}
+	}
+}
+
+
+/*
+ * dst = a bigint with the given sign and magnitude m[0..n). m must not be
+ * the chunks of dst.
+ */
+static int bigint_from_magnitude_into(struct bigint *dst, const unsigned long *m, int n, int negative) {
+	if (bigint_reserve(dst, n+1) != 0) {
+		return ENOMEM;
+	}
+
+	memmove(dst->chunks, m, n*sizeof(*m));
+	dst->chunks[n] = 0;
+	dst->nchunk = n+1;
+	if (negative) {
+		chunks_negate(dst->chunks, dst->chunks, dst->nchunk);
+	}
+
+	bigint_identify_pad_chunk_and_trim(dst);
+	return 0;
+}
+
+
+/* a bigint with the given sign and magnitude m[0..n) */
+static struct bigint *bigint_from_magnitude(const unsigned long *m, int n, int negative) {
+	BIGINT_NEW_RESULT(n+1, bigint_from_magnitude_into(res, m, n, negative));
+}
+
+
+int bigint_divmod_into(struct bigint *quotient, struct bigint *remainder, const struct bigint *a, const struct bigint *b) {
+	if (a == NULL || b == NULL || (quotient != NULL && quotient == remainder)) {
+		return EINVAL;
+	}
+
+	int status = 0;
+	int negative_a = bigint_msb(a, -1), negative_b = bigint_msb(b, -1);
+	unsigned long *buf = malloc((3*a->nchunk + 2*b->nchunk + 2) * sizeof(*buf)); // magnitudes, quotient, remainder and scratch
+	if (buf == NULL) {
+		return ENOMEM;
+	}
+
+	const unsigned long *ma = bigint_magnitude(a, buf);
+	const unsigned long *mb = bigint_magnitude(b, buf+a->nchunk);
+	int na = chunks_significant(ma, a->nchunk), nb = chunks_significant(mb, b->nchunk);
+	if (nb == 0) {
+		status = EDOM;
+		goto cleanup;
+	}
+
+	if (na < nb) {
+		// the remainder is a, so it is written before a may be overwritten by the quotient
+		if (remainder != NULL && (status = bigint_copy_into(remainder, a)) != 0) {
+			goto cleanup;
+		}
+		if (quotient != NULL) {
+			status = bigint_from_long_into(quotient, 0);
+		}
+	} else {
+		unsigned long *mq = buf+a->nchunk+b->nchunk, *mr = mq+na-nb+1;
+		chunks_divrem(mq, mr, ma, na, mb, nb, mr+nb);
+		if (quotient != NULL && (status = bigint_from_magnitude_into(quotient, mq, na-nb+1, negative_a != negative_b)) != 0) {
+			goto cleanup;
+		}
+		if (remainder != NULL) {
+			status = bigint_from_magnitude_into(remainder, mr, nb, negative_a);
+		}
+	}
+
+cleanup:
+	free(buf);
+	return status;
+}
+
+
+int bigint_divmod(const struct bigint *a, const struct bigint *b, struct bigint **quotient, struct bigint **remainder) {
+	if (a == NULL || b == NULL) {
+		return EINVAL;
+	}
+
+	int status = 0;
+	struct bigint *q = NULL, *r = NULL;
+	if ((quotient != NULL && (q = bigint_init(a->nchunk+1)) == NULL) ||
+	    (remainder != NULL && (r = bigint_init(b->nchunk+1)) == NULL)) {
+		status = ENOMEM;
+	} else {
+		status = bigint_divmod_into(q, r, a, b);
+	}
+
+	if (status != 0) {
+		bigint_destroy(q);
+		bigint_destroy(r);
+		return status;
+	}
+
+	if (quotient != NULL) {
+		*quotient = q;
+	}
+	if (remainder != NULL) {
+		*remainder = r;
+	}
+	return 0;
+}
+
+
+struct bigint *bigint_divide(const struct bigint *a, const struct bigint *b) {
+	struct bigint *quotient = NULL;
+	bigint_divmod(a, b, &quotient, NULL);
+	return quotient;
+}
+
+
+struct bigint *bigint_modulo(const struct bigint *a, const struct bigint *b) {
+	struct bigint *remainder = NULL;
+	bigint_divmod(a, b, NULL, &remainder);
+	return remainder;
+}
+
+
+void TestBigintDivision(CuTest *tc) {
+	enum {
+		NHEXSTRING = 12,
+		RES_LEN = 48+1,
+	};
+
+	enum {
+		A,
+		B,
+		MINUS_A,
+		MINUS_B,
+		A_DIVIDE_B,
+		A_MODULO_B,
+		MINUS_A_DIVIDE_B,
+		MINUS_A_MODULO_B,
+		A_DIVIDE_MINUS_B,
+		A_MODULO_MINUS_B,
+		B_DIVIDE_A,
+		B_MODULO_A,
+	};
+	const char *hexstrings[] = {
+		"000000000000000300000000000000000000000000000007",
+		"00000000000000010000000000000000",
+		"fffffffffffffffcfffffffffffffffffffffffffffffff9",
+		"ffffffffffffffff0000000000000000",
+		"00000000000000030000000000000000",
+		"0000000000000007",
+		"fffffffffffffffd0000000000000000",
+		"fffffffffffffff9",
+		"fffffffffffffffd0000000000000000",
+		"0000000000000007",
+		"0000000000000000",
+		"00000000000000010000000000000000",
+	};
+
+	struct bigint *bns[NHEXSTRING];
+	bns[A] = bigint_from_msb_first_hexstring(hexstrings[A], 0);
+	bns[B] = bigint_from_msb_first_hexstring(hexstrings[B], 0);
+	bns[MINUS_A] = bigint_negate(bns[A]);
+	bns[MINUS_B] = bigint_negate(bns[B]);
+	bns[A_DIVIDE_B] = bigint_divide(bns[A], bns[B]);
+	bns[A_MODULO_B] = bigint_modulo(bns[A], bns[B]);
+	bns[MINUS_A_DIVIDE_B] = bigint_divide(bns[MINUS_A], bns[B]);
+	bns[MINUS_A_MODULO_B] = bigint_modulo(bns[MINUS_A], bns[B]);
+	bns[A_DIVIDE_MINUS_B] = bigint_divide(bns[A], bns[MINUS_B]);
+	bns[A_MODULO_MINUS_B] = bigint_modulo(bns[A], bns[MINUS_B]);
+	CuAssertIntEquals(tc, 0, bigint_divmod(bns[B], bns[A], &bns[B_DIVIDE_A], &bns[B_MODULO_A]));
+
+	for (int i = 0; i < NHEXSTRING; i++) {
+		char res[RES_LEN];
+		CuAssertIntEquals(tc, strlen(hexstrings[i]), bigint_to_msb_first_hexstring(bns[i], res));
+		CuAssertStrEquals(tc, hexstrings[i], res);
+	}
+
+	struct bigint *zero = bigint_from_long(0);
+	CuAssertIntEquals(tc, EDOM, bigint_divmod(bns[A], zero, NULL, NULL));
+	CuAssertPtrEquals(tc, NULL, bigint_divide(bns[A], zero));
+	CuAssertPtrEquals(tc, NULL, bigint_modulo(bns[A], zero));
+	bigint_destroy(zero);
+
+	for (int i = 0; i < NHEXSTRING; i++) {
+		bigint_destroy(bns[i]);
+	}
+
+	for (int na = 1; na < 3*BIGINT_KARATSUBA_THRESHOLD; na += 5) {
+		for (int nb = 1; nb <= na+2; nb += 3) {
+			struct bigint *a = bigint_random_for_test(na), *b = bigint_random_for_test(nb);
+			CuAssertPtrNotNull(tc, b);
+			b->chunks[0] |= 1;
+			struct bigint *q = NULL, *r = NULL;
+			CuAssertIntEquals(tc, 0, bigint_divmod(a, b, &q, &r));
+
+			struct bigint *q_multiply_b = bigint_multiply(q, b);
+			struct bigint *q_multiply_b_add_r = bigint_add(q_multiply_b, r);
+			struct bigint *abs_r = bigint_abs(r), *abs_b = bigint_abs(b);
+			CuAssertIntEquals(tc, 0, bigint_compare(a, q_multiply_b_add_r));
+			CuAssertIntEquals(tc, -1, bigint_compare(abs_r, abs_b));
+			CuAssertTrue(tc, bigint_msb(r, -1) == bigint_msb(a, -1) || r->chunks[0] == 0);
+
+			bigint_destroy(a);
+			bigint_destroy(b);
+			bigint_destroy(q);
+			bigint_destroy(r);
+			bigint_destroy(q_multiply_b);
+			bigint_destroy(q_multiply_b_add_r);
+			bigint_destroy(abs_r);
+			bigint_destroy(abs_b);
+		}
+	}
+}
+
+
+enum {
+	OPERATOR_NOT,
+	OPERATOR_AND,
+	OPERATOR_OR,
+	OPERATOR_XOR,
+	OPERATOR_SHIFT_LEFT,
+	OPERATOR_SHIFT_RIGHT,
+	OPERATOR_NEGATE,
+	OPERATOR_ABS,
+	OPERATOR_ADD,
+	OPERATOR_SUBTRACT,
+	OPERATOR_MULTIPLY,
+	OPERATOR_SQUARE,
+	OPERATOR_DIVIDE,
+	OPERATOR_MODULO,
+	NOPERATOR,
+};
+static struct bigint *bigint_operator_for_test(int op, const struct bigint *a, const struct bigint *b) {
+	switch (op) {
+	case OPERATOR_NOT: return bigint_not(a);
+	case OPERATOR_AND: return bigint_and(a, b);
+	case OPERATOR_OR: return bigint_or(a, b);
+	case OPERATOR_XOR: return bigint_xor(a, b);
+	case OPERATOR_SHIFT_LEFT: return bigint_shift_left(a, b);
+	case OPERATOR_SHIFT_RIGHT: return bigint_shift_right(a, b);
+	case OPERATOR_NEGATE: return bigint_negate(a);
+	case OPERATOR_ABS: return bigint_abs(a);
+	case OPERATOR_ADD: return bigint_add(a, b);
+	case OPERATOR_SUBTRACT: return bigint_subtract(a, b);
+	case OPERATOR_MULTIPLY: return bigint_multiply(a, b);
+	case OPERATOR_SQUARE: return bigint_square(a);
+	case OPERATOR_DIVIDE: return bigint_divide(a, b);
+	case OPERATOR_MODULO: return bigint_modulo(a, b);
+	default: return NULL;
+	}
+}
+static int bigint_operator_into_for_test(int op, struct bigint *dst, const struct bigint *a, const struct bigint *b) {
+	switch (op) {
+	case OPERATOR_NOT: return bigint_not_into(dst, a);
+	case OPERATOR_AND: return bigint_and_into(dst, a, b);
+	case OPERATOR_OR: return bigint_or_into(dst, a, b);
+	case OPERATOR_XOR: return bigint_xor_into(dst, a, b);
+	case OPERATOR_SHIFT_LEFT: return bigint_shift_left_into(dst, a, b);
+	case OPERATOR_SHIFT_RIGHT: return bigint_shift_right_into(dst, a, b);
+	case OPERATOR_NEGATE: return bigint_negate_into(dst, a);
+	case OPERATOR_ABS: return bigint_abs_into(dst, a);
+	case OPERATOR_ADD: return bigint_add_into(dst, a, b);
+	case OPERATOR_SUBTRACT: return bigint_subtract_into(dst, a, b);
+	case OPERATOR_MULTIPLY: return bigint_multiply_into(dst, a, b);
+	case OPERATOR_SQUARE: return bigint_square_into(dst, a);
+	case OPERATOR_DIVIDE: return bigint_divmod_into(dst, NULL, a, b);
+	case OPERATOR_MODULO: return bigint_divmod_into(NULL, dst, a, b);
+	default: return EINVAL;
+	}
+}
+void TestBigintDestinationPassing(CuTest *tc) {
+	enum {
+		NOPERAND = 6,
+	};
+
+	srand(1337);
+	struct bigint *operands[NOPERAND] = {
+		bigint_random_for_test(1),
+		bigint_random_for_test(3),
+		bigint_random_for_test(40),
+		bigint_from_long(LONG_MAX),
+		bigint_from_long(LONG_MIN),
+		bigint_from_long(-130),
+	};
+	for (int i = 0; i < NOPERAND; i++) {
+		CuAssertPtrNotNull(tc, operands[i]);
+	}
+
+	for (int op = 0; op < NOPERATOR; op++) {
+		for (int i = 0; i < NOPERAND; i++) {
+			for (int j = 0; j < NOPERAND; j++) {
+				const struct bigint *a = operands[i], *b = operands[j];
+				struct bigint *expected = bigint_operator_for_test(op, a, b);
+				struct bigint *expected_a_a = bigint_operator_for_test(op, a, a);
+
+				struct bigint *dsts[] = {bigint_with_capacity(1), bigint_copy(a), bigint_copy(b), bigint_copy(a)};
+				int status[] = {
+					bigint_operator_into_for_test(op, dsts[0], a, b),
+					bigint_operator_into_for_test(op, dsts[1], dsts[1], b),
+					bigint_operator_into_for_test(op, dsts[2], a, dsts[2]),
+					bigint_operator_into_for_test(op, dsts[3], dsts[3], dsts[3]),
+				};
+
+				for (int k = 0; k < 4; k++) {
+					struct bigint *e = k == 3 ? expected_a_a : expected;
+					CuAssertIntEquals(tc, e == NULL, status[k] != 0);
+					if (e != NULL) {
+						CuAssertIntEquals(tc, 0, bigint_compare(e, dsts[k]));
+					}
+					bigint_destroy(dsts[k]);
+				}
+
+				bigint_destroy(expected);
+				bigint_destroy(expected_a_a);
+			}
+		}
+	}
+
+	struct bigint *sum = bigint_add(operands[3], operands[3]);
+	char res[32+1];
+	CuAssertIntEquals(tc, 32, bigint_to_msb_first_hexstring(sum, res));
+	CuAssertStrEquals(tc, "0000000000000000fffffffffffffffe", res);
+	bigint_destroy(sum);
+
+	// a destination with enough capacity is reused
+	struct bigint *dst = bigint_with_capacity(2*operands[2]->nchunk);
+	CuAssertPtrNotNull(tc, dst);
+	unsigned long *chunks = dst->chunks;
+	CuAssertIntEquals(tc, 0, bigint_add_into(dst, operands[2], operands[1]));
+	CuAssertIntEquals(tc, 0, bigint_multiply_into(dst, dst, operands[1]));
+	CuAssertIntEquals(tc, 0, bigint_shift_right_into(dst, dst, operands[5]));
+	CuAssertPtrEquals(tc, chunks, dst->chunks);
+	bigint_destroy(dst);
+
+	// quotient and remainder may be the operands
+	struct bigint *q = bigint_copy(operands[2]), *r = bigint_copy(operands[1]);
+	struct bigint *expected_q = bigint_divide(q, r), *expected_r = bigint_modulo(q, r);
+	CuAssertIntEquals(tc, 0, bigint_divmod_into(q, r, q, r));
+	CuAssertIntEquals(tc, 0, bigint_compare(expected_q, q));
+	CuAssertIntEquals(tc, 0, bigint_compare(expected_r, r));
+	CuAssertIntEquals(tc, 0, bigint_divmod_into(r, q, r, q)); // |r| < |q| now, so the remainder is r
+	CuAssertIntEquals(tc, 0, bigint_compare(expected_r, q));
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(q, 0));
+	CuAssertIntEquals(tc, EDOM, bigint_divmod_into(NULL, r, r, q));
+	bigint_destroy(expected_q);
+	bigint_destroy(expected_r);
+	bigint_destroy(q);
+	bigint_destroy(r);
+
+	for (int i = 0; i < NOPERAND; i++) {
+		bigint_destroy(operands[i]);
+	}
+}
+void TestBigintInlineStorage(CuTest *tc) {
+	enum {
+		RES_LEN = 48+1,
+	};
+
+	struct bigint a = BIGINT_STATIC_INIT(a), b = BIGINT_STATIC_INIT(b), shift = BIGINT_STATIC_INIT(shift);
+	struct bigint res;
+	bigint_init_inline(&res);
+
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&a, LONG_MAX));
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&b, LONG_MIN));
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&shift, 3));
+
+	CuAssertIntEquals(tc, 1, bigint_compare(&a, &b));
+	CuAssertIntEquals(tc, 0, bigint_add_into(&res, &a, &a));
+	CuAssertIntEquals(tc, 0, bigint_subtract_into(&res, &res, &b));
+	CuAssertIntEquals(tc, 0, bigint_shift_left_into(&res, &res, &shift));
+	CuAssertIntEquals(tc, 0, bigint_negate_into(&res, &res));
+	CuAssertIntEquals(tc, 0, bigint_shift_right_into(&res, &res, &shift));
+	CuAssertIntEquals(tc, 0, bigint_multiply_into(&b, &b, &shift));
+
+	char s[RES_LEN];
+	CuAssertIntEquals(tc, 32, bigint_to_msb_first_hexstring(&res, s));
+	CuAssertStrEquals(tc, "fffffffffffffffe8000000000000002", s);
+	CuAssertIntEquals(tc, 32, bigint_to_msb_first_hexstring(&b, s));
+	CuAssertStrEquals(tc, "fffffffffffffffe8000000000000000", s);
+
+	// nothing above needed more than the inline chunks
+	CuAssertPtrEquals(tc, a.inline_chunks, a.chunks);
+	CuAssertPtrEquals(tc, b.inline_chunks, b.chunks);
+	CuAssertPtrEquals(tc, res.inline_chunks, res.chunks);
+
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&shift, 200));
+	CuAssertIntEquals(tc, 0, bigint_shift_left_into(&res, &res, &shift));
+	CuAssertTrue(tc, res.chunks != res.inline_chunks);
+	bigint_clear(&res);
+	CuAssertPtrEquals(tc, res.inline_chunks, res.chunks);
+	CuAssertIntEquals(tc, -1, bigint_compare(&res, &a));
+
+	bigint_clear(&a);
+	bigint_clear(&b);
+	bigint_clear(&shift);
+}
+
+
+
+/*
+ * conversion to and from strings in any base 2..36 is divide-and-conquer
+ * over the powers base^(ndigit*2^i), where ndigit is the number of digits
+ * that fits into a chunk. a string is split at such a power, and the parts
+ * are converted recursively, until they are small enough to be converted
+ * one chunk of digits at a time. the powers (and their reciprocals for the
+ * divisions) are computed once per conversion in a struct bigint_radix.
+ */
+#ifndef BIGINT_BASESTRING_THRESHOLD
+#define BIGINT_BASESTRING_THRESHOLD 16 // nchunk where basestring conversion switches from one chunk of digits at a time to divide-and-conquer, see TestBigintBasestringBenchmark
+#endif /*BIGINT_BASESTRING_THRESHOLD*/
+#ifndef BIGINT_RECIPROCAL_THRESHOLD
+#define BIGINT_RECIPROCAL_THRESHOLD 32 // nchunk where reciprocals are computed with newton's method instead of division, must be >= 8
+#endif /*BIGINT_RECIPROCAL_THRESHOLD*/
+
+enum {
+	BIGINT_RADIX_MAX_NPOWER = 40,
+};
+
+struct bigint_radix {
+	int base;
+	int ndigit; // digits in big_base
+	unsigned long big_base; // base^ndigit, the largest power of base that fits into a chunk
+	int npower;
+	struct bigint powers[BIGINT_RADIX_MAX_NPOWER]; // big_base^(2^i)
+	int nchunks[BIGINT_RADIX_MAX_NPOWER]; // significant chunks in powers[i]
+	struct bigint reciprocals[BIGINT_RADIX_MAX_NPOWER]; // floor(2^(2*LONG_BIT*nchunks[i]) / powers[i]), only for conversion into strings
+};
+
+
+/*
+ * mu = floor(2^(2*LONG_BIT*k) / m), where m > 0 has k significant chunks.
+ * the reciprocal of the most significant half of m is refined with one
+ * newton step, mu += mu*(2^(2*LONG_BIT*k) - m*mu) / 2^(2*LONG_BIT*k), and
+ * then corrected by at most a few units.
+ *
+ * returns:
+ *   error --> errno
+ *   --> 0
+ */
+static int bigint_reciprocal_into(struct bigint *mu, const struct bigint *m, int k) {
+	int status = 0;
+	struct bigint power = BIGINT_STATIC_INIT(power), t = BIGINT_STATIC_INIT(t), one = BIGINT_STATIC_INIT(one);
+	one.chunks[0] = 1;
+
+	if ((status = bigint_shl_ul_into(&power, &one, 2UL*LONG_BIT*k)) != 0) {
+		goto cleanup;
+	}
+
+	if (k < BIGINT_RECIPROCAL_THRESHOLD) {
+		status = bigint_divmod_into(mu, NULL, &power, m);
+		goto cleanup;
+	}
+
+	int h = (k+1)/2 + 2; // the error of the newton step is then less than a chunk
+	if ((status = bigint_shr_ul_into(&t, m, (unsigned long)LONG_BIT*(k-h))) != 0 ||
+	    (status = bigint_reciprocal_into(mu, &t, h)) != 0 ||
+	    (status = bigint_shl_ul_into(mu, mu, (unsigned long)LONG_BIT*(k-h))) != 0 ||
+	    (status = bigint_multiply_into(&t, m, mu)) != 0 ||
+	    (status = bigint_subtract_into(&t, &power, &t)) != 0 ||
+	    (status = bigint_multiply_into(&t, &t, mu)) != 0 ||
+	    (status = bigint_shr_ul_into(&t, &t, 2UL*LONG_BIT*k)) != 0 ||
+	    (status = bigint_add_into(mu, mu, &t)) != 0) {
+		goto cleanup;
+	}
+
+	// t = 2^(2*LONG_BIT*k) - m*mu must be in [0, m)
+	if ((status = bigint_multiply_into(&t, m, mu)) != 0 ||
+	    (status = bigint_subtract_into(&t, &power, &t)) != 0) {
+		goto cleanup;
+	}
+	while (status == 0 && bigint_msb(&t, -1) == 1) {
+		if ((status = bigint_add_into(&t, &t, m)) == 0) {
+			status = bigint_subtract_into(mu, mu, &one);
+		}
+	}
+	while (status == 0 && bigint_compare(&t, m) >= 0) {
+		if ((status = bigint_subtract_into(&t, &t, m)) == 0) {
+			status = bigint_add_into(mu, mu, &one);
+		}
+	}
+
+cleanup:
+	bigint_clear(&power);
+	bigint_clear(&t);
+	bigint_clear(&one);
+	return status;
+}
+
+
+static void bigint_radix_destroy(struct bigint_radix *radix) {
+	for (int i = 0; i < radix->npower; i++) {
+		bigint_clear(&radix->powers[i]);
+		bigint_clear(&radix->reciprocals[i]);
+	}
+	radix->npower = 0;
+}
+
+
+/*
+ * prepare the powers needed to convert numbers of ndigit_max digits, and
+ * their reciprocals when with_reciprocals.
+ *
+ * returns:
+ *   error --> errno
+ *   --> 0
+ */
+static int bigint_radix_init(struct bigint_radix *radix, int base, size_t ndigit_max, int with_reciprocals) {
+	radix->base = base;
+	radix->ndigit = 1;
+	radix->big_base = base;
+	while (radix->big_base <= ULONG_MAX/base) {
+		radix->big_base *= base;
+		radix->ndigit++;
+	}
+
+	int status = 0;
+	for (radix->npower = 0; radix->npower < BIGINT_RADIX_MAX_NPOWER; radix->npower++) {
+		int i = radix->npower;
+		if (((size_t)radix->ndigit << i) >= ndigit_max && i > 0) {
+			break;
+		}
+
+		bigint_init_inline(&radix->powers[i]);
+		bigint_init_inline(&radix->reciprocals[i]);
+		if (i == 0) {
+			status = bigint_from_magnitude_into(&radix->powers[i], &radix->big_base, 1, 0);
+		} else {
+			status = bigint_square_into(&radix->powers[i], &radix->powers[i-1]);
+		}
+		if (status != 0) {
+			radix->npower++;
+			break;
+		}
+
+		radix->nchunks[i] = chunks_significant(radix->powers[i].chunks, radix->powers[i].nchunk);
+		if (with_reciprocals && (status = bigint_reciprocal_into(&radix->reciprocals[i], &radix->powers[i], radix->nchunks[i])) != 0) {
+			radix->npower++;
+			break;
+		}
+	}
+
+	if (status != 0) {
+		bigint_radix_destroy(radix);
+	}
+	return status;
+}
+
+
+/* the largest i where powers[i] has less than ndigit digits */
+static int bigint_radix_split(const struct bigint_radix *radix, size_t ndigit) {
+	int i = 0;
+	while (i+1 < radix->npower && ((size_t)radix->ndigit << (i+1)) < ndigit) {
+		i++;
+	}
+	return i;
+}
+
+
+/*
+ * q = a / powers[i] and r = a % powers[i], where 0 <= a < 2^(2*LONG_BIT*k)
+ * and k = nchunks[i]. this is barrett's quotient estimate from algorithm
+ * 14.42 in the Handbook of Applied Cryptography, followed by at most two
+ * corrections.
+ */
+static int bigint_radix_divmod(const struct bigint_radix *radix, int i, struct bigint *q, struct bigint *r, const struct bigint *a) {
+	int status = 0, k = radix->nchunks[i];
+	const struct bigint *m = &radix->powers[i];
+	struct bigint one = BIGINT_STATIC_INIT(one);
+	one.chunks[0] = 1;
+
+	if ((status = bigint_shr_ul_into(q, a, (unsigned long)LONG_BIT*(k-1))) != 0 ||
+	    (status = bigint_multiply_into(q, q, &radix->reciprocals[i])) != 0 ||
+	    (status = bigint_shr_ul_into(q, q, (unsigned long)LONG_BIT*(k+1))) != 0 ||
+	    (status = bigint_multiply_into(r, q, m)) != 0 ||
+	    (status = bigint_subtract_into(r, a, r)) != 0) {
+		return status;
+	}
+	while (status == 0 && bigint_compare(r, m) >= 0) {
+		if ((status = bigint_subtract_into(r, r, m)) == 0) {
+			status = bigint_add_into(q, q, &one);
+		}
+	}
+	return status;
+}
+
+
+/*
+ * s[0..width) = the digits of 0 <= a < base^width, with leading zeros.
+ *
+ * returns:
+ *   error --> errno
+ *   --> 0
+ */
+static int bigint_radix_to_digits(const struct bigint_radix *radix, const struct bigint *a, char *s, size_t width) {
+	if (width <= (size_t)radix->ndigit * BIGINT_BASESTRING_THRESHOLD) {
+		unsigned long m[BIGINT_BASESTRING_THRESHOLD+2];
+		assert(a->nchunk <= BIGINT_BASESTRING_THRESHOLD+2);
+		int nm = chunks_significant(memmove(m, a->chunks, a->nchunk*sizeof(*m)), a->nchunk);
+
+		char *p = s+width;
+		while (nm > 0 && p > s) {
+			unsigned long digits = chunks_divrem_1(m, m, nm, radix->big_base);
+			nm = chunks_significant(m, nm);
+			for (int j = 0; j < radix->ndigit && p > s; j++) {
+				*--p = basestring_alphabet[digits % radix->base];
+				digits /= radix->base;
+			}
+		}
+		memset(s, basestring_alphabet[0], p-s);
+		return 0;
+	}
+
+	int i = bigint_radix_split(radix, width);
+	size_t nlow = (size_t)radix->ndigit << i;
+	struct bigint q = BIGINT_STATIC_INIT(q), r = BIGINT_STATIC_INIT(r);
+
+	int status = bigint_radix_divmod(radix, i, &q, &r, a);
+	if (status == 0) {
+		status = bigint_radix_to_digits(radix, &q, s, width-nlow);
+	}
+	if (status == 0) {
+		status = bigint_radix_to_digits(radix, &r, s+width-nlow, nlow);
+	}
+
+	bigint_clear(&q);
+	bigint_clear(&r);
+	return status;
+}
+
+
+/*
+ * dst = the number in the digits s[0..ns), which are all valid in base.
+ *
+ * returns:
+ *   error --> errno
+ *   --> 0
+ */
+static int bigint_radix_from_digits(const struct bigint_radix *radix, struct bigint *dst, const char *s, size_t ns) {
+	if (ns <= (size_t)radix->ndigit * BIGINT_BASESTRING_THRESHOLD) {
+		unsigned long m[BIGINT_BASESTRING_THRESHOLD+1];
+		int nm = 0;
+
+		for (size_t i = 0; i < ns;) {
+			size_t ngroup = i == 0 && ns % radix->ndigit != 0 ? ns % radix->ndigit : (size_t)radix->ndigit;
+			unsigned long group = 0, scale = 1;
+			for (size_t j = 0; j < ngroup; j++, i++) {
+				group = group*radix->base + basestring_char_to_int(s[i]);
+				scale *= radix->base;
+			}
+
+			unsigned long high = chunks_mul_1(m, m, nm, scale);
+			high += chunks_add_1(m, m, nm, group);
+			if (high != 0) {
+				m[nm++] = high;
+			}
+		}
+
+		return bigint_from_magnitude_into(dst, m, nm, 0);
+	}
+
+	int i = bigint_radix_split(radix, ns);
+	size_t nlow = (size_t)radix->ndigit << i;
+	struct bigint high = BIGINT_STATIC_INIT(high), low = BIGINT_STATIC_INIT(low);
+
+	int status = bigint_radix_from_digits(radix, &high, s, ns-nlow);
+	if (status == 0) {
+		status = bigint_radix_from_digits(radix, &low, s+ns-nlow, nlow);
+	}
+	if (status == 0) {
+		status = bigint_multiply_into(dst, &high, &radix->powers[i]);
+	}
+	if (status == 0) {
+		status = bigint_add_into(dst, dst, &low);
+	}
+
+	bigint_clear(&high);
+	bigint_clear(&low);
+	return status;
+}
+
+
+/* log2(base) when base is a power of 2, otherwise 0 */
+static int bigint_base_bits(int base) {
+	return (base & (base-1)) == 0 ? __builtin_ctz(base) : 0;
+}
+
+
+/* the number of digits in base that is enough for any number of nchunk chunks */
+static size_t bigint_base_width(int nchunk, int base) {
+	return (size_t)((double)nchunk*LONG_BIT / log2(base)) + 2;
+}
+
+
+int bigint_nbasechar(const struct bigint *n, int base) {
+	if (n == NULL) {
+		return -EINVAL;
+	}
+	if (base < 2 || base > 36) {
+		return -ERANGE;
+	}
+
+	size_t width = bigint_base_width(bigint_normalised_nchunk(n), base) + 1; // and a '-'
+	return width > INT_MAX ? -ERANGE : (int)width;
+}
+
+
+struct bigint *bigint_from_basestring(const char *s, size_t ns, int base) {
+	if (s == NULL || base < 2 || base > 36) {
+		return NULL;
+	}
+
+	if (ns == 0) {
+		ns = strlen(s);
+	}
+
+	int negative = ns > 0 && s[0] == '-';
+	if (negative) {
+		s++;
+		ns--;
+	}
+	if (ns == 0) {
+		return NULL;
+	}
+	for (size_t i = 0; i < ns; i++) {
+		int digit = basestring_char_to_int(s[i]);
+		if (digit < 0 || digit >= base) {
+			return NULL;
+		}
+	}
+
+	struct bigint *res = NULL;
+	int status = 0, nbit = bigint_base_bits(base);
+	if (nbit != 0) {
+		int nchunk = (ns*nbit + LONG_BIT-1)/LONG_BIT + 1;
+		if ((res = bigint_init(nchunk)) == NULL) {
+			return NULL;
+		}
+		for (size_t i = 0; i < ns; i++) {
+			unsigned long digit = basestring_char_to_int(s[ns-1-i]), bit = i*nbit;
+			res->chunks[bit/LONG_BIT] |= digit << bit%LONG_BIT;
+			if (bit%LONG_BIT + nbit > LONG_BIT) {
+				res->chunks[bit/LONG_BIT+1] |= digit >> (LONG_BIT - bit%LONG_BIT);
+			}
+		}
+		bigint_identify_pad_chunk_and_trim(res);
+	} else {
+		struct bigint_radix radix;
+		if ((res = bigint_init(1)) == NULL) {
+			return NULL;
+		}
+		if ((status = bigint_radix_init(&radix, base, ns, 0)) == 0) {
+			status = bigint_radix_from_digits(&radix, res, s, ns);
+			bigint_radix_destroy(&radix);
+		}
+	}
+
+	if (status == 0 && negative) {
+		status = bigint_negate_into(res, res);
+	}
+	if (status != 0) {
+		bigint_destroy(res);
+		return NULL;
+	}
+	return res;
+}
+
+
+struct bigint *bigint_from_decimal(const char *s, size_t ns) {
+	return bigint_from_basestring(s, ns, 10);
+}
+
+
+int bigint_to_basestring(const struct bigint *n, char *s, int base) {
+	if (n == NULL || s == NULL) {
+		return -EINVAL;
+	}
+	if (base < 2 || base > 36) {
+		return -ERANGE;
+	}
+
+	int status = 0;
+	struct bigint magnitude = BIGINT_STATIC_INIT(magnitude);
+	if ((status = bigint_abs_into(&magnitude, n)) != 0) {
+		return -status;
+	}
+
+	char *digits = s;
+	if (bigint_msb(n, -1) == 1) {
+		*digits++ = '-';
+	}
+
+	size_t width = bigint_base_width(bigint_normalised_nchunk(n), base); // |n| < 2^(LONG_BIT*nchunk) also for the most negative n
+	int nbit = bigint_base_bits(base);
+	if (nbit != 0) {
+		for (size_t i = 0; i < width; i++) {
+			unsigned long bit = i*nbit, digit = bigint_index_with_padding(&magnitude, bit/LONG_BIT) >> bit%LONG_BIT;
+			if (bit%LONG_BIT + nbit > LONG_BIT) {
+				digit |= bigint_index_with_padding(&magnitude, bit/LONG_BIT+1) << (LONG_BIT - bit%LONG_BIT);
+			}
+			digits[width-1-i] = basestring_alphabet[digit & (base-1)];
+		}
+	} else {
+		struct bigint_radix radix;
+		if ((status = bigint_radix_init(&radix, base, width, 1)) == 0) {
+			status = bigint_radix_to_digits(&radix, &magnitude, digits, width);
+			bigint_radix_destroy(&radix);
+		}
+	}
+	bigint_clear(&magnitude);
+	if (status != 0) {
+		return -status;
+	}
+
+	size_t nzero = 0;
+	while (nzero+1 < width && digits[nzero] == basestring_alphabet[0]) {
+		nzero++;
+	}
+	memmove(digits, digits+nzero, width-nzero);
+	digits[width-nzero] = '\0';
+
+	return digits+width-nzero - s;
+}
+
+
+int bigint_to_decimal(const struct bigint *n, char *s) {
+	return bigint_to_basestring(n, s, 10);
+}
+void TestBigint_reciprocal(CuTest *tc) {
+	srand(1337);
+	for (int k = 1; k <= 90; k += 7) {
+		struct bigint *m = bigint_random_for_test(k), *power = bigint_from_long(1);
+		struct bigint mu = BIGINT_STATIC_INIT(mu);
+		CuAssertPtrNotNull(tc, m);
+		CuAssertPtrNotNull(tc, power);
+		CuAssertIntEquals(tc, 0, bigint_abs_into(m, m));
+		m->chunks[k-1] |= 1; // k significant chunks
+		CuAssertIntEquals(tc, 0, bigint_shl_ul_into(power, power, 2UL*LONG_BIT*k));
+
+		struct bigint *expected = bigint_divide(power, m);
+		CuAssertPtrNotNull(tc, expected);
+		CuAssertIntEquals(tc, 0, bigint_reciprocal_into(&mu, m, k));
+		CuAssertIntEquals(tc, 0, bigint_compare(expected, &mu));
+
+		bigint_clear(&mu);
+		bigint_destroy(expected);
+		bigint_destroy(power);
+		bigint_destroy(m);
+	}
+}
+void TestBigintBasestring(CuTest *tc) {
+	enum {
+		RES_LEN = 2*64+1,
+	};
+
+	const struct {
+		const char *hexstring;
+		int base;
+		const char *basestring;
+	} cases[] = {
+		{"0000000000000000", 10, "0"},
+		{"ffffffffffffffff", 10, "-1"},
+		{"8000000000000000", 10, "-9223372036854775808"},
+		{"00000000000000010000000000000000", 10, "18446744073709551616"},
+		{"ffffffffffffffff0000000000000000", 10, "-18446744073709551616"},
+		{"00000000000000010000000000000000", 16, "10000000000000000"},
+		{"ffffffffffffffff0000000000000000", 32, "-g000000000000"},
+		{"0000000000000539", 2, "10100111001"},
+		{"0000000000000539", 36, "115"},
+		{"fffffffffffffac7", 36, "-115"},
+		{"000000000000050f", 36, "zz"},
+	};
+
+	for (size_t i = 0; i < sizeof(cases)/sizeof(*cases); i++) {
+		struct bigint *n = bigint_from_msb_first_hexstring(cases[i].hexstring, 0);
+		CuAssertPtrNotNull(tc, n);
+
+		char s[RES_LEN];
+		CuAssertTrue(tc, bigint_nbasechar(n, cases[i].base) < RES_LEN);
+		CuAssertIntEquals(tc, strlen(cases[i].basestring), bigint_to_basestring(n, s, cases[i].base));
+		CuAssertStrEquals(tc, cases[i].basestring, s);
+
+		struct bigint *m = bigint_from_basestring(cases[i].basestring, 0, cases[i].base);
+		CuAssertPtrNotNull(tc, m);
+		CuAssertIntEquals(tc, 0, bigint_compare(n, m));
+
+		bigint_destroy(n);
+		bigint_destroy(m);
+	}
+
+	CuAssertPtrEquals(tc, NULL, bigint_from_decimal("12a", 0));
+	CuAssertPtrEquals(tc, NULL, bigint_from_decimal("-", 0));
+	CuAssertPtrEquals(tc, NULL, bigint_from_basestring("102", 0, 2));
+	CuAssertPtrEquals(tc, NULL, bigint_from_basestring("z", 0, 37));
+
+	// large numbers round trip through every base, also through the divide-and-conquer steps
+	srand(1337);
+	const int nchunks[] = {1, 2, 3, 40, 150, 400};
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		struct bigint *n = bigint_random_for_test(nchunks[i]);
+		CuAssertPtrNotNull(tc, n);
+
+		for (int base = 2; base <= 36; base += (nchunks[i] > 3 ? 7 : 1)) {
+			char *s = malloc(bigint_nbasechar(n, base)+1);
+			CuAssertPtrNotNull(tc, s);
+			int ns = bigint_to_basestring(n, s, base);
+			CuAssertTrue(tc, ns > 0 && ns <= bigint_nbasechar(n, base));
+			CuAssertTrue(tc, s[s[0] == '-'] != '0' || strcmp(s, "0") == 0);
+
+			struct bigint *m = bigint_from_basestring(s, ns, base);
+			CuAssertPtrNotNull(tc, m);
+			CuAssertIntEquals(tc, 0, bigint_compare(n, m));
+
+			bigint_destroy(m);
+			free(s);
+		}
+		bigint_destroy(n);
+	}
+
+	// and agree with repeated division by 10^18
+	struct bigint *n = bigint_random_for_test(200), *ten_to_18 = bigint_from_long(1000000000000000000UL);
+	struct bigint *q = bigint_with_capacity(200), *r = bigint_with_capacity(1);
+	CuAssertIntEquals(tc, 0, bigint_abs_into(n, n));
+	int nchar = bigint_nbasechar(n, 10);
+	CuAssertTrue(tc, nchar > 0);
+	char *s = malloc((size_t)nchar+1), *expected = malloc((size_t)nchar+18+1);
+	CuAssertPtrNotNull(tc, s);
+	CuAssertPtrNotNull(tc, expected);
+	CuAssertIntEquals(tc, 0, bigint_copy_into(q, n));
+	char *p = expected+nchar+18;
+	*p = '\0';
+	do {
+		CuAssertIntEquals(tc, 0, bigint_divmod_into(q, r, q, ten_to_18));
+		unsigned long digits = r->chunks[0];
+		for (int i = 0; i < 18; i++, digits /= 10) {
+			*--p = '0' + digits%10;
+		}
+	} while (q->nchunk > 1 || q->chunks[0] != 0);
+	while (*p == '0') {
+		p++;
+	}
+	CuAssertIntEquals(tc, strlen(p), bigint_to_decimal(n, s));
+	CuAssertStrEquals(tc, p, s);
+
+	free(s);
+	free(expected);
+	bigint_destroy(n);
+	bigint_destroy(ten_to_18);
+	bigint_destroy(q);
+	bigint_destroy(r);
+}
+void TestBigintBasestringBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		NITERATION = 1,
+	};
+
+	const int ndigits[] = {1000, 10000, 100000, 1000000};
+	for (size_t i = 0; i < sizeof(ndigits)/sizeof(*ndigits); i++) {
+		char *s = malloc(ndigits[i]+1);
+		CuAssertPtrNotNull(tc, s);
+		for (int j = 0; j < ndigits[i]; j++) {
+			s[j] = '1' + rand()%9;
+		}
+		s[ndigits[i]] = '\0';
+
+		struct bigint *n = NULL;
+		char description[64];
+		snprintf(description, sizeof(description), "bigint_from_decimal %d", ndigits[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_destroy(n);
+			n = bigint_from_decimal(s, ndigits[i]);
+		}
+		CuAssertPtrNotNull(tc, n);
+
+		char *res = malloc(bigint_nbasechar(n, 10)+1);
+		CuAssertPtrNotNull(tc, res);
+		snprintf(description, sizeof(description), "bigint_to_decimal %d", ndigits[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			CuAssertIntEquals(tc, ndigits[i], bigint_to_decimal(n, res));
+		}
+		CuAssertStrEquals(tc, s, res);
+
+		bigint_destroy(n);
+		free(res);
+		free(s);
+	}
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
+
+
+
+/*
+ * r[0..k) = a mod m where m[k-1] != 0.
+ *
+ * returns:
+ *   error --> errno
+ *   --> 0
+ */
+static int chunks_mod(unsigned long *r, const unsigned long *a, int na, const unsigned long *m, int k) {
+	na = chunks_significant(a, na);
+	if (na < k || (na == k && chunks_compare(a, m, k) < 0)) {
+		memmove(r, a, na*sizeof(*r));
+		memset(r+na, 0, (k-na)*sizeof(*r));
+		return 0;
+	}
+
+	unsigned long *scratch = malloc((na-k+1 + na+k+1) * sizeof(*scratch));
+	if (scratch == NULL) {
+		return ENOMEM;
+	}
+
+	chunks_divrem(scratch, r, a, na, m, k, scratch+na-k+1);
+
+	free(scratch);
+	return 0;
+}
+
+
+/*
+ * the reduction contexts store the magnitude of the modulus, m, in nchunk
+ * chunks where m[nchunk-1] != 0, followed by the precomputed constants.
+ */
+struct bigint_barrett {
+	int nchunk;
+	unsigned long *mu; // floor(B^2nchunk / m), nchunk+2 chunks
+	unsigned long modulus[];
+};
+
+struct bigint_montgomery {
+	int nchunk;
+	unsigned long inverse; // -m^-1 mod B
+	unsigned long *r2; // R^2 mod m, where R = B^nchunk
+	unsigned long modulus[];
+};
+
+
+/* the magnitude of a positive modulus is the chunks of modulus up to *nchunk */
+static int bigint_modulus_nchunk(const struct bigint *modulus, int *nchunk) {
+	if (modulus == NULL) {
+		return EINVAL;
+	}
+
+	*nchunk = chunks_significant(modulus->chunks, modulus->nchunk);
+	return bigint_msb(modulus, -1) == 1 || *nchunk == 0 ? EDOM : 0;
+}
+
+
+/*
+ * r[0..k) = n mod m for any n, scratch has room for n->nchunk chunks.
+ *
+ * returns:
+ *   error --> errno
+ *   --> 0
+ */
+static int bigint_reduced_magnitude(unsigned long *r, const struct bigint *n, const unsigned long *m, int k, unsigned long *scratch) {
+	int status = chunks_mod(r, bigint_magnitude(n, scratch), n->nchunk, m, k);
+	if (status == 0 && bigint_msb(n, -1) == 1 && !chunks_is_zero(r, k)) {
+		chunks_sub_n(r, m, r, k);
+	}
+	return status;
+}
+
+
+struct bigint_barrett *bigint_barrett_init(const struct bigint *modulus) {
+	int k;
+	if (bigint_modulus_nchunk(modulus, &k) != 0) {
+		return NULL;
+	}
+
+	struct bigint_barrett *ctx = malloc(sizeof(*ctx) + (2*k+2) * sizeof(*ctx->modulus));
+	unsigned long *b2k = calloc(2*k+1 + k + 3*k+2, sizeof(*b2k));
+	if (ctx == NULL || b2k == NULL) {
+		free(ctx);
+		free(b2k);
+		return NULL;
+	}
+
+	ctx->nchunk = k;
+	ctx->mu = ctx->modulus + k;
+	memmove(ctx->modulus, modulus->chunks, k*sizeof(*ctx->modulus));
+
+	unsigned long *remainder = b2k+2*k+1;
+	b2k[2*k] = 1;
+	ctx->mu[k+1] = 0;
+	chunks_divrem(ctx->mu, remainder, b2k, 2*k+1, ctx->modulus, k, remainder+k);
+
+	free(b2k);
+	return ctx;
+}
+
+
+void bigint_barrett_destroy(struct bigint_barrett *ctx) {
+	free(ctx);
+}
+
+
+/*
+ * r[0..k) = x mod m for x[0..2k), see algorithm 14.42 in Handbook of Applied
+ * Cryptography. scratch has room for 5k+5 chunks. r may alias x.
+ */
+static void chunks_barrett_reduce(unsigned long *r, const unsigned long *x, const struct bigint_barrett *ctx, unsigned long *scratch) {
+	int k = ctx->nchunk;
+	unsigned long *q2 = scratch, *q3m = q2+2*k+3, *remainder = q3m+2*k+1;
+
+	const unsigned long *q1 = x+k-1; // floor(x / B^(k-1)), k+1 chunks
+	chunks_mul_schoolbook(q2, ctx->mu, k+2, q1, k+1);
+	const unsigned long *q3 = q2+k+1; // floor(q2 / B^(k+1)), which is less than B^(k+1)
+	chunks_mul_schoolbook(q3m, q3, k+1, ctx->modulus, k);
+
+	chunks_sub_n(remainder, x, q3m, k+1); // modulo B^(k+1), and less than 3m
+	while (remainder[k] != 0 || chunks_compare(remainder, ctx->modulus, k) >= 0) {
+		remainder[k] -= chunks_sub_n(remainder, remainder, ctx->modulus, k);
+	}
+
+	memmove(r, remainder, k*sizeof(*r));
+}
+
+
+struct bigint *bigint_barrett_reduce(const struct bigint_barrett *ctx, const struct bigint *n) {
+	if (ctx == NULL || n == NULL) {
+		return NULL;
+	}
+
+	int k = ctx->nchunk;
+	unsigned long *x = calloc(2*k + 5*k+5 + n->nchunk, sizeof(*x));
+	if (x == NULL) {
+		return NULL;
+	}
+	unsigned long *scratch = x+2*k, *magnitude = scratch+5*k+5;
+
+	struct bigint *res = NULL;
+	const unsigned long *mn = bigint_magnitude(n, magnitude);
+	int nn = chunks_significant(mn, n->nchunk);
+	if (nn <= 2*k) {
+		memmove(x, mn, nn*sizeof(*x));
+		chunks_barrett_reduce(x, x, ctx, scratch);
+		if (bigint_msb(n, -1) == 1 && !chunks_is_zero(x, k)) {
+			chunks_sub_n(x, ctx->modulus, x, k);
+		}
+	} else if (bigint_reduced_magnitude(x, n, ctx->modulus, k, magnitude) != 0) { // out of range for barrett
+		goto cleanup;
+	}
+
+	res = bigint_from_magnitude(x, k, 0);
+
+cleanup:
+	free(x);
+	return res;
+}
+
+
+/* r[0..k) = t*R^-1 mod m for t[0..2k) < m*R, where t[0..2k+1) is clobbered. r may alias t */
+static void chunks_montgomery_redc(unsigned long *r, unsigned long *t, const struct bigint_montgomery *ctx) {
+	int k = ctx->nchunk;
+	t[2*k] = 0;
+	for (int i = 0; i < k; i++) {
+		unsigned long u = t[i] * ctx->inverse; // makes t[i] zero
+		unsigned long carry = chunks_addmul_1(t+i, ctx->modulus, k, u);
+		chunks_add_1(t+i+k, t+i+k, k+1-i, carry);
+	}
+
+	if (t[2*k] != 0 || chunks_compare(t+k, ctx->modulus, k) >= 0) {
+		chunks_sub_n(t+k, t+k, ctx->modulus, k);
+	}
+	memmove(r, t+k, k*sizeof(*r));
+}
+
+/*
+ * r[0..k) = a*b*R^-1 mod m for a, b < m. scratch has room for
+ * 2k+1 + chunks_mul_scratch(k) chunks. r may alias a and/or b.
+ */
+static void chunks_montgomery_multiply(unsigned long *r, const unsigned long *a, const unsigned long *b, const struct bigint_montgomery *ctx, unsigned long *scratch) {
+	chunks_mul_n(scratch, a, b, ctx->nchunk, scratch+2*ctx->nchunk+1);
+	chunks_montgomery_redc(r, scratch, ctx);
+}
+
+
+struct bigint_montgomery *bigint_montgomery_init(const struct bigint *modulus) {
+	int k;
+	if (bigint_modulus_nchunk(modulus, &k) != 0 || (modulus->chunks[0] & 1) == 0) {
+		return NULL;
+	}
+
+	struct bigint_montgomery *ctx = malloc(sizeof(*ctx) + 2*k*sizeof(*ctx->modulus));
+	unsigned long *b2k = calloc(2*k+1 + k+2 + 3*k+2, sizeof(*b2k));
+	if (ctx == NULL || b2k == NULL) {
+		free(ctx);
+		free(b2k);
+		return NULL;
+	}
+
+	ctx->nchunk = k;
+	ctx->inverse = -chunk_inverse(modulus->chunks[0]);
+	ctx->r2 = ctx->modulus + k;
+	memmove(ctx->modulus, modulus->chunks, k*sizeof(*ctx->modulus));
+
+	unsigned long *quotient = b2k+2*k+1;
+	b2k[2*k] = 1;
+	chunks_divrem(quotient, ctx->r2, b2k, 2*k+1, ctx->modulus, k, quotient+k+2);
+
+	free(b2k);
+	return ctx;
+}
+
+
+void bigint_montgomery_destroy(struct bigint_montgomery *ctx) {
+	free(ctx);
+}
+
+
+/*
+ * operand for the bigint_montgomery_* functions, i.e. a new array where
+ * [0..k) = n mod m, followed by room for 2k+1 + chunks_mul_scratch(k) chunks
+ * of scratch.
+ */
+static unsigned long *bigint_montgomery_operand(const struct bigint_montgomery *ctx, const struct bigint *n) {
+	int k = ctx->nchunk;
+	int nscratch = 2*k+1 + chunks_mul_scratch(k);
+	unsigned long *x = malloc((k + (nscratch > n->nchunk ? nscratch : n->nchunk)) * sizeof(*x));
+	if (x != NULL && bigint_reduced_magnitude(x, n, ctx->modulus, k, x+k) != 0) {
+		free(x);
+		return NULL;
+	}
+	return x;
+}
+
+
+struct bigint *bigint_to_montgomery(const struct bigint_montgomery *ctx, const struct bigint *n) {
+	if (ctx == NULL || n == NULL) {
+		return NULL;
+	}
+
+	unsigned long *x = bigint_montgomery_operand(ctx, n);
+	if (x == NULL) {
+		return NULL;
+	}
+
+	chunks_montgomery_multiply(x, x, ctx->r2, ctx, x+ctx->nchunk);
+	struct bigint *res = bigint_from_magnitude(x, ctx->nchunk, 0);
+
+	free(x);
+	return res;
+}
+
+
+struct bigint *bigint_from_montgomery(const struct bigint_montgomery *ctx, const struct bigint *n) {
+	if (ctx == NULL || n == NULL) {
+		return NULL;
+	}
+
+	unsigned long *x = bigint_montgomery_operand(ctx, n);
+	if (x == NULL) {
+		return NULL;
+	}
+
+	int k = ctx->nchunk;
+	unsigned long *t = x+k;
+	memmove(t, x, k*sizeof(*t));
+	memset(t+k, 0, k*sizeof(*t));
+	chunks_montgomery_redc(x, t, ctx);
+	struct bigint *res = bigint_from_magnitude(x, k, 0);
+
+	free(x);
+	return res;
+}
+
+
+struct bigint *bigint_montgomery_multiply(const struct bigint_montgomery *ctx, const struct bigint *a, const struct bigint *b) {
+	if (ctx == NULL || a == NULL || b == NULL) {
+		return NULL;
+	}
+
+	struct bigint *res = NULL;
+	unsigned long *x = bigint_montgomery_operand(ctx, a);
+	unsigned long *y = bigint_montgomery_operand(ctx, b);
+	if (x != NULL && y != NULL) {
+		chunks_montgomery_multiply(x, x, y, ctx, x+ctx->nchunk);
+		res = bigint_from_magnitude(x, ctx->nchunk, 0);
+	}
+
+	free(x);
+	free(y);
+	return res;
+}
+
+
+struct bigint *bigint_montgomery_reduce(const struct bigint_montgomery *ctx, const struct bigint *n) {
+	if (ctx == NULL || n == NULL) {
+		return NULL;
+	}
+
+	int k = ctx->nchunk;
+	int nscratch = 2*k+1 + chunks_mul_scratch(k);
+	unsigned long *x = calloc(2*k+1 + nscratch + n->nchunk, sizeof(*x));
+	if (x == NULL) {
+		return NULL;
+	}
+	unsigned long *scratch = x+2*k+1, *magnitude = scratch+nscratch;
+
+	struct bigint *res = NULL;
+	const unsigned long *mn = bigint_magnitude(n, magnitude);
+	int nn = chunks_significant(mn, n->nchunk);
+	if (nn < 2*k || (nn == 2*k && chunks_compare(mn+k, ctx->modulus, k) < 0)) { // |n| < m*R
+		memmove(x, mn, nn*sizeof(*x));
+		chunks_montgomery_redc(x, x, ctx); // n*R^-1
+		chunks_montgomery_multiply(x, x, ctx->r2, ctx, scratch); // n*R^-1 * R^2 * R^-1
+		if (bigint_msb(n, -1) == 1 && !chunks_is_zero(x, k)) {
+			chunks_sub_n(x, ctx->modulus, x, k);
+		}
+	} else if (bigint_reduced_magnitude(x, n, ctx->modulus, k, magnitude) != 0) { // out of range for montgomery
+		goto cleanup;
+	}
+
+	res = bigint_from_magnitude(x, k, 0);
+
+cleanup:
+	free(x);
+	return res;
+}
+
+/*
+ * modular exponentiation is sliding window exponentiation, algorithm 14.85
+ * in the Handbook of Applied Cryptography, with montgomery multiplication
+ * for odd moduli and barrett reduction for even ones. the context keeps the
+ * reduction context, the table of odd powers of the last base and scratch,
+ * so that repeated exponentiations does not allocate.
+ */
+enum {
+	BIGINT_MODPOW_MAX_WINDOW = 6,
+};
+
+struct bigint_modpow_ctx {
+	int nchunk;
+	struct bigint_montgomery *montgomery; // odd modulus
+	struct bigint_barrett *barrett; // even modulus
+	const unsigned long *modulus;
+	struct bigint base; // the base of the powers in table
+	int window; // the table has base^1, base^3, .., base^(2^window-1), or is empty when 0
+	unsigned long *table;
+	unsigned long *scratch;
+	int nscratch;
+};
+
+
+struct bigint_modpow_ctx *bigint_modpow_ctx_init(const struct bigint *modulus) {
+	int k;
+	if (bigint_modulus_nchunk(modulus, &k) != 0) {
+		return NULL;
+	}
+
+	struct bigint_modpow_ctx *ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		return NULL;
+	}
+
+	ctx->nchunk = k;
+	bigint_init_inline(&ctx->base);
+	if (modulus->chunks[0] & 1) {
+		ctx->montgomery = bigint_montgomery_init(modulus);
+	} else {
+		ctx->barrett = bigint_barrett_init(modulus);
+	}
+	int nreduce = ctx->montgomery != NULL ? 0 : 5*k+5;
+	int nmul = chunks_mul_scratch(k);
+	ctx->nscratch = 2*k+1 + (nreduce > nmul ? nreduce : nmul);
+	ctx->table = malloc(((1 << (BIGINT_MODPOW_MAX_WINDOW-1)) + 2) * k * sizeof(*ctx->table)); // and base^2 and the result
+	ctx->scratch = malloc(ctx->nscratch * sizeof(*ctx->scratch));
+
+	if ((ctx->montgomery == NULL && ctx->barrett == NULL) || ctx->table == NULL || ctx->scratch == NULL) {
+		bigint_modpow_ctx_destroy(ctx);
+		return NULL;
+	}
+
+	ctx->modulus = ctx->montgomery != NULL ? ctx->montgomery->modulus : ctx->barrett->modulus;
+	return ctx;
+}
+
+
+void bigint_modpow_ctx_destroy(struct bigint_modpow_ctx *ctx) {
+	if (ctx != NULL) {
+		bigint_montgomery_destroy(ctx->montgomery);
+		bigint_barrett_destroy(ctx->barrett);
+		bigint_clear(&ctx->base);
+		free(ctx->table);
+		free(ctx->scratch);
+		free(ctx);
+	}
+}
+
+
+/* r[0..k) = a*b, where a, b and r are in montgomery form for odd moduli. r may alias a and/or b */
+static void bigint_modpow_multiply(struct bigint_modpow_ctx *ctx, unsigned long *r, const unsigned long *a, const unsigned long *b) {
+	int k = ctx->nchunk;
+	unsigned long *product = ctx->scratch, *scratch = product+2*k+1;
+	if (a == b) {
+		chunks_sqr_n(product, a, k, scratch);
+	} else {
+		chunks_mul_n(product, a, b, k, scratch);
+	}
+
+	if (ctx->montgomery != NULL) {
+		chunks_montgomery_redc(r, product, ctx->montgomery);
+	} else {
+		chunks_barrett_reduce(r, product, ctx->barrett, scratch);
+	}
+}
+
+
+/* the window size that minimizes the number of multiplications for an exponent of nbit bits */
+static int bigint_modpow_window(unsigned long nbit) {
+	const unsigned long max_nbit[BIGINT_MODPOW_MAX_WINDOW-1] = {8, 24, 80, 240, 672};
+	int window = 1;
+	while (window < BIGINT_MODPOW_MAX_WINDOW && nbit > max_nbit[window-1]) {
+		window++;
+	}
+	return window;
+}
+
+
+/*
+ * fill the table with the odd powers of base up to base^(2^window-1),
+ * unless it already has them.
+ *
+ * returns:
+ *   error --> errno
+ *   --> 0
+ */
+static int bigint_modpow_table(struct bigint_modpow_ctx *ctx, const struct bigint *base, int window) {
+	if (ctx->window >= window && bigint_compare(&ctx->base, base) == 0) {
+		return 0;
+	}
+
+	int k = ctx->nchunk;
+	ctx->window = 0;
+	if (bigint_copy_into(&ctx->base, base) != 0) {
+		return ENOMEM;
+	}
+
+	unsigned long *magnitude = NULL;
+	if (base->nchunk > ctx->nscratch && (magnitude = malloc(base->nchunk * sizeof(*magnitude))) == NULL) {
+		return ENOMEM;
+	}
+	int status = bigint_reduced_magnitude(ctx->table, base, ctx->modulus, k, magnitude != NULL ? magnitude : ctx->scratch);
+	free(magnitude);
+	if (status != 0) {
+		return status;
+	}
+
+	unsigned long *square = ctx->table + ((1 << (BIGINT_MODPOW_MAX_WINDOW-1)) * k);
+	if (ctx->montgomery != NULL) {
+		bigint_modpow_multiply(ctx, ctx->table, ctx->table, ctx->montgomery->r2); // base*R
+	}
+	bigint_modpow_multiply(ctx, square, ctx->table, ctx->table);
+	for (int i = 1; i < 1 << (window-1); i++) {
+		bigint_modpow_multiply(ctx, ctx->table + i*k, ctx->table + (i-1)*k, square);
+	}
+
+	ctx->window = window;
+	return 0;
+}
+
+
+int bigint_modpow_ctx_into(struct bigint_modpow_ctx *ctx, struct bigint *dst, const struct bigint *base, const struct bigint *exponent) {
+	if (ctx == NULL || dst == NULL || base == NULL || exponent == NULL) {
+		return EINVAL;
+	}
+	if (bigint_msb(exponent, -1) == 1) {
+		return EDOM;
+	}
+
+	int k = ctx->nchunk;
+	int nechunk = chunks_significant(exponent->chunks, exponent->nchunk);
+	unsigned long nbit = nechunk == 0 ? 0 : (unsigned long)LONG_BIT*nechunk - __builtin_clzl(exponent->chunks[nechunk-1]);
+	if (nbit == 0 || (k == 1 && ctx->modulus[0] == 1)) {
+		unsigned long one = ctx->modulus[0] != 1 || k > 1;
+		return bigint_from_magnitude_into(dst, &one, 1, 0);
+	}
+
+	int window = bigint_modpow_window(nbit), status;
+	if ((status = bigint_modpow_table(ctx, base, window)) != 0) {
+		return status;
+	}
+
+	unsigned long *result = ctx->table + ((1 << (BIGINT_MODPOW_MAX_WINDOW-1)) + 1) * k;
+	int started = 0;
+	for (long i = nbit-1; i >= 0;) {
+		if (((exponent->chunks[i/LONG_BIT] >> i%LONG_BIT) & 1) == 0) {
+			bigint_modpow_multiply(ctx, result, result, result);
+			i--;
+			continue;
+		}
+
+		// the longest window exponent[l..i] that ends with a one
+		long l = i-window+1 < 0 ? 0 : i-window+1;
+		while (((exponent->chunks[l/LONG_BIT] >> l%LONG_BIT) & 1) == 0) {
+			l++;
+		}
+		unsigned long value = 0;
+		for (long j = i; j >= l; j--) {
+			value = value<<1 | ((exponent->chunks[j/LONG_BIT] >> j%LONG_BIT) & 1);
+		}
+
+		const unsigned long *power = ctx->table + (value >> 1)*k;
+		if (started) {
+			for (long j = i; j >= l; j--) {
+				bigint_modpow_multiply(ctx, result, result, result);
+			}
+			bigint_modpow_multiply(ctx, result, result, power);
+		} else {
+			memmove(result, power, k*sizeof(*result));
+			started = 1;
+		}
+		i = l-1;
+	}
+
+	if (ctx->montgomery != NULL) {
+		unsigned long *t = ctx->scratch;
+		memmove(t, result, k*sizeof(*t));
+		memset(t+k, 0, k*sizeof(*t));
+		chunks_montgomery_redc(result, t, ctx->montgomery);
+	}
+
+	return bigint_from_magnitude_into(dst, result, k, 0);
+}
+
+
+struct bigint *bigint_modpow(const struct bigint *base, const struct bigint *exponent, const struct bigint *modulus) {
+	if (base == NULL || exponent == NULL) {
+		return NULL;
+	}
+
+	struct bigint_modpow_ctx *ctx = bigint_modpow_ctx_init(modulus);
+	if (ctx == NULL) {
+		return NULL;
+	}
+
+	struct bigint *res = bigint_init(ctx->nchunk+1);
+	if (res != NULL && bigint_modpow_ctx_into(ctx, res, base, exponent) != 0) {
+		bigint_destroy(res);
+		res = NULL;
+	}
+
+	bigint_modpow_ctx_destroy(ctx);
+	return res;
+}
+
+
+/* n mod m in [0, m) as computed by division, for comparing with the reduction contexts */
+static struct bigint *bigint_mod_for_test(const struct bigint *n, const struct bigint *m) {
+	struct bigint *remainder = bigint_modulo(n, m);
+	if (remainder != NULL && bigint_msb(remainder, -1) == 1) {
+		struct bigint *positive = bigint_add(remainder, m);
+		bigint_destroy(remainder);
+		remainder = positive;
+	}
+	return remainder;
+}
+void TestBigintReductionContexts(CuTest *tc) {
+	const int nchunks[] = {1, 2, 5, BIGINT_KARATSUBA_THRESHOLD+1};
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		struct bigint *m = bigint_random_for_test(nchunks[i]);
+		m->chunks[0] |= 1;
+		m->chunks[m->nchunk-1] &= ~LONG_MSB_MASK;
+		m->chunks[m->nchunk-1] |= 1UL << (LONG_MSB-1);
+		bigint_identify_pad_chunk_and_trim(m);
+
+		struct bigint_barrett *barrett = bigint_barrett_init(m);
+		CuAssertPtrNotNull(tc, barrett);
+		struct bigint_montgomery *montgomery = bigint_montgomery_init(m);
+		CuAssertPtrNotNull(tc, montgomery);
+
+		for (int nn = 1; nn <= 3*nchunks[i]; nn++) {
+			struct bigint *a = bigint_random_for_test(nn), *b = bigint_random_for_test(nchunks[i]);
+			struct bigint *expected = bigint_mod_for_test(a, m);
+			struct bigint *a_barrett = bigint_barrett_reduce(barrett, a);
+			struct bigint *a_montgomery = bigint_montgomery_reduce(montgomery, a);
+			CuAssertIntEquals(tc, 0, bigint_compare(expected, a_barrett));
+			CuAssertIntEquals(tc, 0, bigint_compare(expected, a_montgomery));
+
+			struct bigint *a_multiply_b = bigint_multiply(a, b);
+			struct bigint *a_multiply_b_mod_m = bigint_mod_for_test(a_multiply_b, m);
+			struct bigint *am = bigint_to_montgomery(montgomery, a), *bm = bigint_to_montgomery(montgomery, b);
+			struct bigint *am_multiply_bm = bigint_montgomery_multiply(montgomery, am, bm);
+			struct bigint *a_roundtrip = bigint_from_montgomery(montgomery, am);
+			struct bigint *a_multiply_b_roundtrip = bigint_from_montgomery(montgomery, am_multiply_bm);
+			CuAssertIntEquals(tc, 0, bigint_compare(expected, a_roundtrip));
+			CuAssertIntEquals(tc, 0, bigint_compare(a_multiply_b_mod_m, a_multiply_b_roundtrip));
+
+			bigint_destroy(a);
+			bigint_destroy(b);
+			bigint_destroy(expected);
+			bigint_destroy(a_barrett);
+			bigint_destroy(a_montgomery);
+			bigint_destroy(a_multiply_b);
+			bigint_destroy(a_multiply_b_mod_m);
+			bigint_destroy(am);
+			bigint_destroy(bm);
+			bigint_destroy(am_multiply_bm);
+			bigint_destroy(a_roundtrip);
+			bigint_destroy(a_multiply_b_roundtrip);
+		}
+
+		bigint_barrett_destroy(barrett);
+		bigint_montgomery_destroy(montgomery);
+		bigint_destroy(m);
+	}
+
+	struct bigint *even = bigint_from_long(1336), *negative = bigint_from_long(-1337);
+	CuAssertPtrEquals(tc, NULL, bigint_montgomery_init(even));
+	CuAssertPtrEquals(tc, NULL, bigint_montgomery_init(negative));
+	CuAssertPtrEquals(tc, NULL, bigint_barrett_init(negative));
+	bigint_destroy(even);
+	bigint_destroy(negative);
+}
+/* base^exponent mod m by square-and-multiply with division, for comparing with bigint_modpow */
+static struct bigint *bigint_modpow_for_test(const struct bigint *base, const struct bigint *exponent, const struct bigint *m) {
+	struct bigint *res = bigint_from_long(1), *power = bigint_mod_for_test(base, m);
+	for (int i = 0; i < exponent->nchunk*LONG_BIT; i++) {
+		if ((exponent->chunks[i/LONG_BIT] >> i%LONG_BIT) & 1) {
+			struct bigint *product = bigint_multiply(res, power);
+			bigint_destroy(res);
+			res = bigint_mod_for_test(product, m);
+			bigint_destroy(product);
+		}
+		struct bigint *square = bigint_square(power);
+		bigint_destroy(power);
+		power = bigint_mod_for_test(square, m);
+		bigint_destroy(square);
+	}
+	bigint_destroy(power);
+
+	struct bigint *reduced = bigint_mod_for_test(res, m);
+	bigint_destroy(res);
+	return reduced;
+}
+void TestBigint_modpow(CuTest *tc) {
+	struct bigint *base = bigint_from_long(4), *exponent = bigint_from_long(13), *m = bigint_from_long(497);
+	struct bigint *res = bigint_modpow(base, exponent, m);
+	unsigned long result = 0;
+	CuAssertIntEquals(tc, 0, bigint_to_long(res, &result));
+	CuAssertIntEquals(tc, 445, result);
+	bigint_destroy(res);
+
+	// fermat's little theorem with the mersenne prime 2^127-1
+	struct bigint *p = bigint_from_msb_first_hexstring("7fffffffffffffffffffffffffffffff", 0);
+	struct bigint *p_minus_1 = bigint_from_msb_first_hexstring("7ffffffffffffffffffffffffffffffe", 0);
+	struct bigint *a = bigint_random_for_test(7);
+	res = bigint_modpow(a, p_minus_1, p);
+	CuAssertIntEquals(tc, 0, bigint_to_long(res, &result));
+	CuAssertIntEquals(tc, 1, result);
+	bigint_destroy(res);
+
+	// zero exponent, modulus one and negative exponent
+	struct bigint *zero = bigint_from_long(0), *one = bigint_from_long(1), *minus_one = bigint_from_long(-1);
+	res = bigint_modpow(a, zero, p);
+	CuAssertIntEquals(tc, 0, bigint_compare(one, res));
+	bigint_destroy(res);
+	res = bigint_modpow(a, p, one);
+	CuAssertIntEquals(tc, 0, bigint_compare(zero, res));
+	bigint_destroy(res);
+	CuAssertPtrEquals(tc, NULL, bigint_modpow(a, minus_one, p));
+	CuAssertPtrEquals(tc, NULL, bigint_modpow(a, one, zero));
+	CuAssertPtrEquals(tc, NULL, bigint_modpow(a, one, minus_one));
+
+	// odd and even moduli, with the table reused for the same base
+	srand(1337);
+	const int nchunks[] = {1, 2, 5, BIGINT_KARATSUBA_THRESHOLD+1};
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		for (int even = 0; even <= 1; even++) {
+			struct bigint *modulus = bigint_random_for_test(nchunks[i]);
+			CuAssertIntEquals(tc, 0, bigint_abs_into(modulus, modulus));
+			modulus->chunks[0] = even ? modulus->chunks[0] & ~1UL : modulus->chunks[0] | 1;
+			modulus->chunks[modulus->nchunk-1] |= 2;
+
+			struct bigint_modpow_ctx *ctx = bigint_modpow_ctx_init(modulus);
+			CuAssertPtrNotNull(tc, ctx);
+			struct bigint *x = bigint_random_for_test(2*nchunks[i]);
+			struct bigint dst = BIGINT_STATIC_INIT(dst);
+			for (int nbit = 1; nbit <= 700; nbit = 3*nbit + 1) {
+				struct bigint *e = bigint_random_for_test(nbit/LONG_BIT + 1);
+				CuAssertIntEquals(tc, 0, bigint_abs_into(e, e));
+
+				struct bigint *expected = bigint_modpow_for_test(x, e, modulus);
+				CuAssertIntEquals(tc, 0, bigint_modpow_ctx_into(ctx, &dst, x, e));
+				CuAssertIntEquals(tc, 0, bigint_compare(expected, &dst));
+				bigint_destroy(expected);
+
+				expected = bigint_modpow_for_test(e, e, modulus);
+				CuAssertIntEquals(tc, 0, bigint_modpow_ctx_into(ctx, &dst, e, e));
+				CuAssertIntEquals(tc, 0, bigint_compare(expected, &dst));
+				bigint_destroy(expected);
+				bigint_destroy(e);
+			}
+
+			bigint_clear(&dst);
+			bigint_destroy(x);
+			bigint_modpow_ctx_destroy(ctx);
+			bigint_destroy(modulus);
+		}
+	}
+
+	bigint_destroy(base);
+	bigint_destroy(exponent);
+	bigint_destroy(m);
+	bigint_destroy(p);
+	bigint_destroy(p_minus_1);
+	bigint_destroy(a);
+	bigint_destroy(zero);
+	bigint_destroy(one);
+	bigint_destroy(minus_one);
+}
+void TestBigintModpowBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		NITERATION = 10,
+	};
+
+	const int nbits[] = {512, 1024, 2048, 4096};
+	for (size_t i = 0; i < sizeof(nbits)/sizeof(*nbits); i++) {
+		int nchunk = nbits[i]/LONG_BIT;
+		struct bigint *m = bigint_random_for_test(nchunk), *base = bigint_random_for_test(nchunk), *e = bigint_random_for_test(nchunk);
+		struct bigint *msb = bigint_from_long(1);
+		CuAssertIntEquals(tc, 0, bigint_shl_ul_into(msb, msb, nbits[i]-1));
+		CuAssertIntEquals(tc, 0, bigint_abs_into(m, m));
+		CuAssertIntEquals(tc, 0, bigint_or_into(m, m, msb));
+		CuAssertIntEquals(tc, 0, bigint_abs_into(e, e));
+		m->chunks[0] |= 1;
+		bigint_destroy(msb);
+
+		struct bigint_modpow_ctx *ctx = bigint_modpow_ctx_init(m);
+		struct bigint dst = BIGINT_STATIC_INIT(dst);
+		CuAssertPtrNotNull(tc, ctx);
+
+		char description[64];
+		snprintf(description, sizeof(description), "bigint_modpow %d", nbits[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_destroy(bigint_modpow(base, e, m));
+		}
+		snprintf(description, sizeof(description), "bigint_modpow_ctx_into %d", nbits[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_modpow_ctx_into(ctx, &dst, base, e);
+		}
+
+		bigint_clear(&dst);
+		bigint_modpow_ctx_destroy(ctx);
+		bigint_destroy(m);
+		bigint_destroy(base);
+		bigint_destroy(e);
+	}
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
+
+
+/*
+ * greatest common divisor is lehmer's algorithm, algorithm L in Knuth's The
+ * Art of Computer Programming vol. 2, section 4.5.2. euclidean steps are
+ * simulated on the leading GCD_LEHMER_BIT bits of the operands for as long
+ * as the quotients are certain to be the true ones, and then applied to the
+ * whole operands at once as a matrix of single chunks. when no quotient is
+ * certain a full division step is done instead, and once both operands fit
+ * in a chunk the binary algorithm finishes.
+ *
+ * the extended variant also keeps the cofactors of a, u_i = s_i*a + t_i*b.
+ * the signs of s_i alternate, so only their magnitudes are kept, the matrix
+ * steps only add, and the sign is the parity of the number of steps. t is
+ * computed from s at the end.
+ */
+enum {
+	GCD_LEHMER_BIT = LONG_BIT-2, // the leading bits, so the sums in algorithm L never overflow a long
+};
+
+struct gcd_state {
+	unsigned long *u, *v, *w, *x; // u >= v, and w and x are the next u and v
+	int nu, nv;
+	unsigned long *q, *scratch; // quotient and scratch for division steps
+	unsigned long *s[4], *product; // cofactor magnitudes of s_i and s_(i+1), the next ones and q*s_(i+1), NULL when not extended
+	int ns0, ns1;
+	int parity; // s_i is negative when parity is odd
+};
+
+/* binary gcd of single chunks */
+static unsigned long chunk_gcd(unsigned long a, unsigned long b) {
+	if (a == 0 || b == 0) {
+		return a | b;
+	}
+
+	int shift = __builtin_ctzl(a | b);
+	a >>= __builtin_ctzl(a);
+	do {
+		b >>= __builtin_ctzl(b);
+		if (a > b) {
+			unsigned long t = a;
+			a = b;
+			b = t;
+		}
+		b -= a;
+	} while (b != 0);
+	return a << shift;
+}
+
+/* GCD_LEHMER_BIT bits of a[0..n) starting at bit shift, the chunks above n are zero */
+static unsigned long chunks_lehmer_bits(const unsigned long *a, int n, int shift) {
+	int i = shift/LONG_BIT, offset = shift%LONG_BIT;
+	unsigned long bits = i < n ? a[i] >> offset : 0;
+	if (offset != 0 && i+1 < n) {
+		bits |= a[i+1] << (LONG_BIT-offset);
+	}
+	return bits & ((1UL << GCD_LEHMER_BIT) - 1);
+}
+
+/* r[0..n] = x*a + y*b where x and y have opposite signs or are zero, and the result is nonnegative */
+static void chunks_lehmer_combine(unsigned long *r, const unsigned long *a, long x, const unsigned long *b, long y, int n) {
+	if (y <= 0) {
+		r[n] = chunks_mul_1(r, a, n, x);
+		r[n] -= chunks_submul_1(r, b, n, -y);
+	} else {
+		r[n] = chunks_mul_1(r, b, n, y);
+		r[n] -= chunks_submul_1(r, a, n, -x);
+	}
+}
+
+/* r = a+b with room for max(na, nb)+1 chunks, returns the significant chunks of r */
+static int chunks_gcd_add(unsigned long *r, const unsigned long *a, int na, const unsigned long *b, int nb) {
+	if (na < nb) {
+		const unsigned long *t = a;
+		a = b;
+		b = t;
+		int nt = na;
+		na = nb;
+		nb = nt;
+	}
+	r[na] = chunks_add(r, a, na, b, nb);
+	return chunks_significant(r, na+1);
+}
+
+/* (u, v) = (v, u mod v), and (s_i, s_(i+1)) = (s_(i+1), s_i + q*s_(i+1)) */
+static int gcd_division_step(struct gcd_state *g) {
+	int nq = g->nu - g->nv + 1;
+	chunks_divrem(g->q, g->w, g->u, g->nu, g->v, g->nv, g->scratch);
+	nq = chunks_significant(g->q, nq);
+	int nw = chunks_significant(g->w, g->nv);
+
+	unsigned long *t = g->u;
+	g->u = g->v;
+	g->v = g->w;
+	g->w = t;
+	g->nu = g->nv;
+	g->nv = nw;
+
+	if (g->product == NULL) {
+		return 0;
+	}
+
+	unsigned long **s = g->s;
+	int ns2;
+	if (nq == 0 || g->ns1 == 0) {
+		ns2 = chunks_gcd_add(s[2], s[0], g->ns0, s[1], 0);
+	} else {
+		int status = nq >= g->ns1 ? chunks_mul(g->product, g->q, nq, s[1], g->ns1) : chunks_mul(g->product, s[1], g->ns1, g->q, nq);
+		if (status != 0) {
+			return status;
+		}
+		ns2 = chunks_gcd_add(s[2], g->product, nq + g->ns1, s[0], g->ns0);
+	}
+
+	t = s[0];
+	s[0] = s[1];
+	s[1] = s[2];
+	s[2] = t;
+	g->ns0 = g->ns1;
+	g->ns1 = ns2;
+	g->parity ^= 1;
+	return 0;
+}
+
+/*
+ * euclidean steps on the leading bits of u and v, applied to u and v as a
+ * matrix. returns 0 when no step could be simulated.
+ */
+static int gcd_lehmer_step(struct gcd_state *g) {
+	int shift = g->nu*LONG_BIT - __builtin_clzl(g->u[g->nu-1]) - GCD_LEHMER_BIT;
+	long uhat = chunks_lehmer_bits(g->u, g->nu, shift), vhat = chunks_lehmer_bits(g->v, g->nv, shift);
+	long a = 1, b = 0, c = 0, d = 1;
+	int nstep = 0;
+	while (vhat + c != 0 && vhat + d != 0) {
+		long q = (uhat + a) / (vhat + c);
+		if (q != (uhat + b) / (vhat + d)) {
+			break;
+		}
+
+		long t = a - q*c;
+		a = c;
+		c = t;
+		t = b - q*d;
+		b = d;
+		d = t;
+		t = uhat - q*vhat;
+		uhat = vhat;
+		vhat = t;
+		nstep++;
+	}
+
+	if (b == 0) {
+		return 0;
+	}
+
+	int n = g->nu;
+	memset(g->v + g->nv, 0, (n - g->nv)*sizeof(*g->v));
+	chunks_lehmer_combine(g->w, g->u, a, g->v, b, n);
+	chunks_lehmer_combine(g->x, g->u, c, g->v, d, n);
+
+	unsigned long *t = g->u;
+	g->u = g->w;
+	g->w = t;
+	t = g->v;
+	g->v = g->x;
+	g->x = t;
+	g->nu = chunks_significant(g->u, n+1);
+	g->nv = chunks_significant(g->v, n+1);
+
+	if (g->product != NULL) {
+		unsigned long **s = g->s;
+		int ns = g->ns0 > g->ns1 ? g->ns0 : g->ns1;
+		memset(s[0] + g->ns0, 0, (ns - g->ns0)*sizeof(*s[0]));
+		memset(s[1] + g->ns1, 0, (ns - g->ns1)*sizeof(*s[1]));
+		s[2][ns] = chunks_mul_1(s[2], s[0], ns, labs(a));
+		s[2][ns] += chunks_addmul_1(s[2], s[1], ns, labs(b));
+		s[3][ns] = chunks_mul_1(s[3], s[0], ns, labs(c));
+		s[3][ns] += chunks_addmul_1(s[3], s[1], ns, labs(d));
+
+		t = s[0];
+		s[0] = s[2];
+		s[2] = t;
+		t = s[1];
+		s[1] = s[3];
+		s[3] = t;
+		g->ns0 = chunks_significant(s[0], ns+1);
+		g->ns1 = chunks_significant(s[1], ns+1);
+		g->parity ^= nstep & 1;
+	}
+	return 1;
+}
+
+/* m = |n|, returns the significant chunks of m */
+static int bigint_gcd_magnitude(unsigned long *m, const struct bigint *n) {
+	const unsigned long *magnitude = bigint_magnitude(n, m);
+	if (magnitude != m) {
+		memcpy(m, magnitude, n->nchunk*sizeof(*m));
+	}
+	return chunks_significant(m, n->nchunk);
+}
+
+/*
+ * gcd of a and b, and the cofactor s of a when s != NULL. the buffers are
+ * allocated here, so dst and s may be a or b.
+ */
+static int bigint_gcd_cofactor_into(struct bigint *dst, struct bigint *s, const struct bigint *a, const struct bigint *b) {
+	int n = a->nchunk > b->nchunk ? a->nchunk : b->nchunk;
+	int extended = s != NULL;
+	int nbuf = 4*(n+1) + (n+1) + (2*n+2) + (extended ? 4*(n+2) + (2*n+2) : 0);
+	unsigned long *buf = malloc(nbuf*sizeof(*buf));
+	if (buf == NULL) {
+		return ENOMEM;
+	}
+
+	struct gcd_state g = {
+		.u = buf, .v = buf + (n+1), .w = buf + 2*(n+1), .x = buf + 3*(n+1),
+		.q = buf + 4*(n+1), .scratch = buf + 5*(n+1),
+	};
+	g.nu = bigint_gcd_magnitude(g.u, a);
+	g.nv = bigint_gcd_magnitude(g.v, b);
+	if (extended) {
+		for (int i = 0; i < 4; i++) {
+			g.s[i] = g.scratch + (2*n+2) + i*(n+2);
+		}
+		g.product = g.s[3] + (n+2);
+		g.s[0][0] = 1;
+		g.ns0 = 1;
+		g.ns1 = 0;
+	}
+
+	if (g.nu < g.nv || (g.nu == g.nv && chunks_compare(g.u, g.v, g.nu) < 0)) {
+		// the division step with quotient 0
+		unsigned long *t = g.u;
+		g.u = g.v;
+		g.v = t;
+		int nt = g.nu;
+		g.nu = g.nv;
+		g.nv = nt;
+		t = g.s[0];
+		g.s[0] = g.s[1];
+		g.s[1] = t;
+		g.ns0 = 0;
+		g.ns1 = extended;
+		g.parity = 1;
+	}
+
+	int status = 0;
+	while (g.nv > 0 && status == 0) {
+		if (g.nu == 1 && !extended) {
+			g.u[0] = chunk_gcd(g.u[0], g.v[0]);
+			break;
+		} else if (g.nv == 1 && !extended) {
+			g.u[0] = chunk_gcd(g.v[0], chunks_divrem_1(g.q, g.u, g.nu, g.v[0]));
+			g.nu = 1;
+			break;
+		} else if (g.nu == 1 || !gcd_lehmer_step(&g)) {
+			status = gcd_division_step(&g);
+		}
+	}
+
+	if (status == 0) {
+		status = bigint_from_magnitude_into(dst, g.u, g.nu, 0);
+	}
+	if (status == 0 && extended) {
+		int negative = g.parity ^ bigint_msb(a, -1);
+		status = bigint_from_magnitude_into(s, g.s[0], g.ns0, negative && g.ns0 > 0);
+	}
+
+	free(buf);
+	return status;
+}
+
+
+int bigint_gcd_into(struct bigint *dst, const struct bigint *a, const struct bigint *b) {
+	if (dst == NULL || a == NULL || b == NULL) {
+		return EINVAL;
+	}
+
+	return bigint_gcd_cofactor_into(dst, NULL, a, b);
+}
+
+
+struct bigint *bigint_gcd(const struct bigint *a, const struct bigint *b) {
+	if (a == NULL || b == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(BIGINT_MAXCHUNK(a, b), bigint_gcd_into(res, a, b));
+}
+
+
+int bigint_extended_gcd_into(struct bigint *g, struct bigint *s, struct bigint *t, const struct bigint *a, const struct bigint *b) {
+	if (a == NULL || b == NULL || (g != NULL && (g == s || g == t)) || (s != NULL && s == t)) {
+		return EINVAL;
+	}
+
+	struct bigint gcd = BIGINT_STATIC_INIT(gcd), cofactor = BIGINT_STATIC_INIT(cofactor), product = BIGINT_STATIC_INIT(product);
+	int status = bigint_gcd_cofactor_into(&gcd, &cofactor, a, b);
+	if (status == 0 && t != NULL) {
+		// t = (gcd - s*a)/b, which is exact, or 0 when b == 0
+		if (bigint_normalised_nchunk(b) == 1 && b->chunks[0] == 0) {
+			status = bigint_from_long_into(&product, 0);
+		} else if ((status = bigint_multiply_into(&product, &cofactor, a)) == 0 &&
+		           (status = bigint_subtract_into(&product, &gcd, &product)) == 0) {
+			status = bigint_divmod_into(&product, NULL, &product, b);
+		}
+	}
+
+	// the outputs are written last since they may be a or b
+	if (status == 0 && t != NULL) {
+		status = bigint_copy_into(t, &product);
+	}
+	if (status == 0 && s != NULL) {
+		status = bigint_copy_into(s, &cofactor);
+	}
+	if (status == 0 && g != NULL) {
+		status = bigint_copy_into(g, &gcd);
+	}
+
+	bigint_clear(&gcd);
+	bigint_clear(&cofactor);
+	bigint_clear(&product);
+	return status;
+}
+
+
+/* gcd of |a| and |b| by the euclidean algorithm with division, for comparing with bigint_gcd */
+static struct bigint *bigint_gcd_for_test(const struct bigint *a, const struct bigint *b) {
+	struct bigint *u = bigint_abs(a), *v = bigint_abs(b);
+	while (v->nchunk > 1 || v->chunks[0] != 0) {
+		struct bigint *r = bigint_modulo(u, v);
+		bigint_destroy(u);
+		u = v;
+		v = bigint_abs(r);
+		bigint_destroy(r);
+	}
+	bigint_destroy(v);
+	return u;
+}
+/* checks that g is the gcd of a and b, and that s*a + t*b == g */
+static void bigint_assert_gcd_for_test(CuTest *tc, const struct bigint *a, const struct bigint *b) {
+	struct bigint *expected = bigint_gcd_for_test(a, b), *g = bigint_gcd(a, b);
+	CuAssertPtrNotNull(tc, g);
+	CuAssertIntEquals(tc, 0, bigint_compare(expected, g));
+
+	struct bigint eg = BIGINT_STATIC_INIT(eg), s = BIGINT_STATIC_INIT(s), t = BIGINT_STATIC_INIT(t);
+	CuAssertIntEquals(tc, 0, bigint_extended_gcd_into(&eg, &s, &t, a, b));
+	CuAssertIntEquals(tc, 0, bigint_compare(expected, &eg));
+	struct bigint *sa = bigint_multiply(&s, a), *tb = bigint_multiply(&t, b);
+	struct bigint *sum = bigint_add(sa, tb);
+	CuAssertIntEquals(tc, 0, bigint_compare(expected, sum));
+
+	bigint_clear(&eg);
+	bigint_clear(&s);
+	bigint_clear(&t);
+	bigint_destroy(sa);
+	bigint_destroy(tb);
+	bigint_destroy(sum);
+	bigint_destroy(expected);
+	bigint_destroy(g);
+}
+void TestBigint_gcd(CuTest *tc) {
+	const long longs[] = {0, 1, -1, 2, 6, -15, 35, 1337, 1 << 20, 3 << 19, LONG_MAX, LONG_MIN, LONG_MIN+1};
+	for (size_t i = 0; i < sizeof(longs)/sizeof(*longs); i++) {
+		for (size_t j = 0; j < sizeof(longs)/sizeof(*longs); j++) {
+			struct bigint *a = bigint_from_long(longs[i]), *b = bigint_from_long(longs[j]);
+			if (longs[i] != 0 && longs[j] != 0 && longs[i] != LONG_MIN && longs[j] != LONG_MIN) {
+				struct bigint *g = bigint_gcd(a, b), *expected = bigint_from_long(gcd(labs(longs[i]), labs(longs[j])));
+				CuAssertIntEquals(tc, 0, bigint_compare(expected, g));
+				bigint_destroy(g);
+				bigint_destroy(expected);
+			}
+			bigint_assert_gcd_for_test(tc, a, b);
+			bigint_destroy(a);
+			bigint_destroy(b);
+		}
+	}
+
+	// random operands with a common factor, of equal and different sizes
+	srand(1337);
+	const int nchunks[] = {1, 2, 3, 5, 17, 40};
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		for (size_t j = 0; j <= i; j++) {
+			struct bigint *factor = bigint_random_for_test(1 + nchunks[j]/4);
+			struct bigint *x = bigint_random_for_test(nchunks[i]), *y = bigint_random_for_test(nchunks[j]);
+			struct bigint *a = bigint_multiply(x, factor), *b = bigint_multiply(y, factor);
+			bigint_assert_gcd_for_test(tc, a, b);
+			bigint_assert_gcd_for_test(tc, b, a);
+			bigint_assert_gcd_for_test(tc, x, y);
+			bigint_destroy(factor);
+			bigint_destroy(x);
+			bigint_destroy(y);
+			bigint_destroy(a);
+			bigint_destroy(b);
+		}
+	}
+
+	// consecutive fibonacci numbers have only quotients of 1, and powers of two only even factors
+	struct bigint *f0 = bigint_from_long(0), *f1 = bigint_from_long(1);
+	for (int i = 0; i < 1000; i++) {
+		struct bigint *f2 = bigint_add(f0, f1);
+		bigint_destroy(f0);
+		f0 = f1;
+		f1 = f2;
+	}
+	bigint_assert_gcd_for_test(tc, f1, f0);
+	struct bigint *p = bigint_shl_ul(f1, 300), *q = bigint_shl_ul(f0, 200);
+	bigint_assert_gcd_for_test(tc, p, q);
+	bigint_assert_gcd_for_test(tc, p, f1);
+
+	// the results may be the operands
+	struct bigint *g = bigint_gcd(p, q), *s = bigint_copy(p), *t = bigint_copy(q);
+	CuAssertIntEquals(tc, 0, bigint_gcd_into(s, s, t));
+	CuAssertIntEquals(tc, 0, bigint_compare(g, s));
+	CuAssertIntEquals(tc, 0, bigint_copy_into(s, p));
+	CuAssertIntEquals(tc, 0, bigint_extended_gcd_into(t, s, NULL, s, t));
+	CuAssertIntEquals(tc, 0, bigint_compare(g, t));
+	struct bigint *sp = bigint_multiply(s, p), *rest = bigint_subtract(g, sp);
+	struct bigint *remainder = bigint_modulo(rest, q), *zero = bigint_from_long(0);
+	CuAssertIntEquals(tc, 0, bigint_compare(zero, remainder));
+	CuAssertIntEquals(tc, EINVAL, bigint_extended_gcd_into(s, s, NULL, p, q));
+
+	bigint_destroy(f0);
+	bigint_destroy(f1);
+	bigint_destroy(p);
+	bigint_destroy(q);
+	bigint_destroy(g);
+	bigint_destroy(s);
+	bigint_destroy(t);
+	bigint_destroy(sp);
+	bigint_destroy(rest);
+	bigint_destroy(remainder);
+	bigint_destroy(zero);
+}
+void TestBigintGcdBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		NITERATION = 10,
+	};
+
+	const int nchunks[] = {1, 4, 16, 64, 256, 1024};
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		struct bigint *a = bigint_random_for_test(nchunks[i]), *b = bigint_random_for_test(nchunks[i]);
+		struct bigint g = BIGINT_STATIC_INIT(g), s = BIGINT_STATIC_INIT(s), t = BIGINT_STATIC_INIT(t);
+		struct bigint *expected = bigint_gcd_for_test(a, b);
+		CuAssertPtrNotNull(tc, expected);
+
+		char description[64];
+		snprintf(description, sizeof(description), "bigint_gcd_for_test %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_destroy(bigint_gcd_for_test(a, b));
+		}
+		int status = 0;
+		snprintf(description, sizeof(description), "bigint_gcd_into %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			status |= bigint_gcd_into(&g, a, b);
+		}
+		CuAssertIntEquals(tc, 0, status);
+		CuAssertIntEquals(tc, 0, bigint_compare(expected, &g));
+		snprintf(description, sizeof(description), "bigint_extended_gcd_into %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			status |= bigint_extended_gcd_into(&g, &s, &t, a, b);
+		}
+		CuAssertIntEquals(tc, 0, status);
+		CuAssertIntEquals(tc, 0, bigint_compare(expected, &g));
+
+		bigint_destroy(expected);
+		bigint_clear(&g);
+		bigint_clear(&s);
+		bigint_clear(&t);
+		bigint_destroy(a);
+		bigint_destroy(b);
+	}
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
+
+int bigint_pow_into(struct bigint *dst, const struct bigint *base, unsigned long exponent) {
+	if (dst == NULL || base == NULL) {
+		return EINVAL;
+	}
+
+	// 0, 1 and -1 stay small for any exponent, and x^0 = 1
+	if (exponent == 0 || (base->nchunk == 1 && (long)base->chunks[0] >= -1 && (long)base->chunks[0] <= 1)) {
+		long n = exponent == 0 ? 1 : (long)base->chunks[0];
+		return bigint_from_long_into(dst, n == -1 && exponent%2 == 0 ? 1 : n);
+	}
+
+	// |base| < 2^nbit, so |base^exponent| < 2^(nbit*exponent)
+	size_t nbit = chunks_nbit_above_pad(base->chunks, base->nchunk, base->pad_chunk) + 1;
+	if (exponent > ((size_t)INT_MAX-1)*LONG_BIT/nbit) {
+		return ERANGE;
+	}
+
+	// square and multiply, from the most significant bit of the exponent
+	struct bigint b = BIGINT_STATIC_INIT(b), x0 = BIGINT_STATIC_INIT(x0), x1 = BIGINT_STATIC_INIT(x1);
+	struct bigint *x = &x0, *t = &x1;
+	int status = bigint_copy_into(&b, base);
+	if (status == 0) {
+		status = bigint_copy_into(x, base);
+	}
+	for (int i = LONG_MSB - __builtin_clzl(exponent) - 1; status == 0 && i >= 0; i--) {
+		if ((status = bigint_square_into(t, x)) != 0) {
+			break;
+		}
+		struct bigint *tmp = x;
+		x = t;
+		t = tmp;
+		if ((exponent >> i) & 1) {
+			if ((status = bigint_multiply_into(t, x, &b)) != 0) {
+				break;
+			}
+			tmp = x;
+			x = t;
+			t = tmp;
+		}
+	}
+	if (status == 0) {
+		status = bigint_copy_into(dst, x);
+	}
+
+	bigint_clear(&b);
+	bigint_clear(&x0);
+	bigint_clear(&x1);
+	return status;
+}
+
+
+struct bigint *bigint_pow(const struct bigint *base, unsigned long exponent) {
+	if (base == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(1, bigint_pow_into(res, base, exponent));
+}
+
+
+/* the bits of the roots that are estimated with doubles */
+enum {
+	BIGINT_ROOT_ESTIMATE_NBIT = 32,
+};
+
+/*
+ * x = floor(n^(1/k)) for n > 0 and k >= 2, where x is not n. newton's method
+ *   x' = ((k-1)*x + n/x^(k-1)) / k
+ * decreases from any x above the root until x is the root, and doubles the
+ * number of correct bits at each step. the first x is the root of the top
+ * half of the bits of the root, n >> k*s, plus one and shifted by s, so it
+ * is above the root and already has half of its bits right. the top bits
+ * are estimated with doubles.
+ *
+ * returns:
+ *   error --> errno
+ *   --> 0
+ */
+static int bigint_root_into(struct bigint *x, const struct bigint *n, unsigned long k) {
+	size_t nbit = chunks_nbit_above_pad(n->chunks, n->nchunk, 0);
+	if (k >= nbit) { // n < 2^nbit <= 2^k
+		return bigint_from_long_into(x, 1);
+	}
+
+	struct bigint y = BIGINT_STATIC_INIT(y), t = BIGINT_STATIC_INIT(t), q = BIGINT_STATIC_INIT(q), kk = BIGINT_STATIC_INIT(kk);
+	size_t nroot = (nbit + k-1)/k;
+	int status;
+	if (nroot <= BIGINT_ROOT_ESTIMATE_NBIT) {
+		// a relative error of 2^-40 is well above that of the doubles
+		unsigned long shift = nbit > LONG_BIT ? nbit - LONG_BIT : 0;
+		if ((status = bigint_shr_ul_into(&t, n, shift)) == 0) {
+			double estimate = exp2((log2((double)t.chunks[0]) + shift) / k);
+			status = bigint_from_long_into(x, (unsigned long)(estimate * (1 + 0x1p-40)) + 1);
+		}
+	} else {
+		unsigned long s = nroot/2;
+		if ((status = bigint_shr_ul_into(&t, n, k*s)) == 0 &&
+		    (status = bigint_root_into(&y, &t, k)) == 0 &&
+		    (status = bigint_from_long_into(&q, 1)) == 0 &&
+		    (status = bigint_add_into(&y, &y, &q)) == 0) {
+			status = bigint_shl_ul_into(x, &y, s);
+		}
+	}
+
+	if (status == 0 && k > 2) {
+		status = bigint_from_long_into(&kk, k-1);
+	}
+	while (status == 0) {
+		if (k == 2) {
+			if ((status = bigint_divmod_into(&q, NULL, n, x)) != 0 ||
+			    (status = bigint_add_into(&y, &q, x)) != 0 ||
+			    (status = bigint_shr_ul_into(&y, &y, 1)) != 0) {
+				break;
+			}
+		} else {
+			if ((status = bigint_pow_into(&t, x, k-1)) != 0 ||
+			    (status = bigint_divmod_into(&q, NULL, n, &t)) != 0 ||
+			    (status = bigint_multiply_into(&y, x, &kk)) != 0 ||
+			    (status = bigint_add_into(&y, &y, &q)) != 0 ||
+			    (status = bigint_from_long_into(&t, k)) != 0 ||
+			    (status = bigint_divmod_into(&y, NULL, &y, &t)) != 0) {
+				break;
+			}
+		}
+
+		if (bigint_compare(&y, x) >= 0) {
+			break;
+		}
+		status = bigint_copy_into(x, &y);
+	}
+
+	bigint_clear(&y);
+	bigint_clear(&t);
+	bigint_clear(&q);
+	bigint_clear(&kk);
+	return status;
+}
+
+
+int bigint_iroot_into(struct bigint *dst, const struct bigint *n, unsigned long k) {
+	if (dst == NULL || n == NULL) {
+		return EINVAL;
+	}
+
+	int negative = bigint_msb(n, -1);
+	if (k == 0 || (negative && k%2 == 0)) {
+		return EDOM;
+	}
+	if (k == 1) {
+		return bigint_copy_into(dst, n);
+	}
+
+	struct bigint magnitude = BIGINT_STATIC_INIT(magnitude), root = BIGINT_STATIC_INIT(root);
+	int status = bigint_abs_into(&magnitude, n);
+	if (status == 0) {
+		if (chunks_is_zero(magnitude.chunks, magnitude.nchunk)) {
+			status = bigint_from_long_into(&root, 0);
+		} else if ((status = bigint_root_into(&root, &magnitude, k)) == 0 && negative) {
+			status = bigint_negate_into(&root, &root);
+		}
+	}
+	if (status == 0) {
+		status = bigint_copy_into(dst, &root);
+	}
+
+	bigint_clear(&magnitude);
+	bigint_clear(&root);
+	return status;
+}
+
+
+struct bigint *bigint_iroot(const struct bigint *n, unsigned long k) {
+	if (n == NULL) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(1, bigint_iroot_into(res, n, k));
+}
+
+
+int bigint_isqrt_into(struct bigint *dst, const struct bigint *n) {
+	return bigint_iroot_into(dst, n, 2);
+}
+
+
+struct bigint *bigint_isqrt(const struct bigint *n) {
+	return bigint_iroot(n, 2);
+}
+
+
+/* floor(n^(1/k)) by binary search on the bits of the root, for comparison */
+static struct bigint *bigint_iroot_for_test(const struct bigint *n, unsigned long k) {
+	size_t nbit = chunks_nbit_above_pad(n->chunks, n->nchunk, 0);
+	struct bigint *root = bigint_from_long(0), *one = bigint_from_long(1);
+	for (size_t i = (nbit + k-1)/k + 1; i-- > 0;) {
+		struct bigint *bit = bigint_shl_ul(one, i), *candidate = bigint_add(root, bit), *power = bigint_pow(candidate, k);
+		if (bigint_compare(power, n) <= 0) {
+			bigint_destroy(root);
+			root = candidate;
+			candidate = NULL;
+		}
+		bigint_destroy(bit);
+		bigint_destroy(candidate);
+		bigint_destroy(power);
+	}
+	bigint_destroy(one);
+	return root;
+}
+void TestBigint_pow(CuTest *tc) {
+	const long bases[] = {0, 1, -1, 2, -2, 3, 10, -7, 1337, LONG_MAX, LONG_MIN};
+	for (size_t i = 0; i < sizeof(bases)/sizeof(*bases); i++) {
+		struct bigint *base = bigint_from_long(bases[i]), *expected = bigint_from_long(1);
+		for (unsigned long e = 0; e < 40; e++) {
+			struct bigint *power = bigint_pow(base, e);
+			CuAssertPtrNotNull(tc, power);
+			CuAssertIntEquals(tc, 0, bigint_compare(expected, power));
+			CuAssertIntEquals(tc, 0, bigint_multiply_into(expected, expected, base));
+			bigint_destroy(power);
+		}
+		bigint_destroy(base);
+		bigint_destroy(expected);
+	}
+
+	srand(1337);
+	for (int i = 0; i < 50; i++) {
+		struct bigint *base = bigint_random_for_test(1 + rand()%5), *expected = bigint_from_long(1);
+		unsigned long exponent = rand()%30;
+		for (unsigned long e = 0; e < exponent; e++) {
+			CuAssertIntEquals(tc, 0, bigint_multiply_into(expected, expected, base));
+		}
+		CuAssertIntEquals(tc, 0, bigint_pow_into(base, base, exponent)); // dst may be base
+		CuAssertIntEquals(tc, 0, bigint_compare(expected, base));
+		bigint_destroy(base);
+		bigint_destroy(expected);
+	}
+
+	// small bases take no time for any exponent, others do not fit
+	struct bigint *x = bigint_from_long(-1);
+	unsigned long result = 0;
+	CuAssertIntEquals(tc, 0, bigint_pow_into(x, x, ULONG_MAX));
+	CuAssertIntEquals(tc, 0, bigint_to_long(x, &result));
+	CuAssertIntEquals(tc, -1, (long)result);
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(x, 2));
+	CuAssertIntEquals(tc, ERANGE, bigint_pow_into(x, x, ULONG_MAX));
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(x, 0));
+	CuAssertIntEquals(tc, 0, bigint_pow_into(x, x, ULONG_MAX));
+	bigint_destroy(x);
+}
+void TestBigint_iroot(CuTest *tc) {
+	srand(1337);
+	for (int i = 0; i < 300; i++) {
+		struct bigint *n = bigint_random_for_test(1 + rand()%(i < 200 ? 3 : 12));
+		CuAssertIntEquals(tc, 0, bigint_abs_into(n, n));
+		unsigned long k = 1 + rand()%(i%3 == 0 ? 2 : 12);
+		if (i%5 == 0) { // perfect powers, and one below them
+			struct bigint *one = bigint_from_long(1);
+			CuAssertIntEquals(tc, 0, bigint_add_into(n, n, one));
+			CuAssertIntEquals(tc, 0, bigint_pow_into(n, n, k));
+			if (i%10 == 0) {
+				CuAssertIntEquals(tc, 0, bigint_subtract_into(n, n, one));
+			}
+			bigint_destroy(one);
+		}
+
+		struct bigint *root = bigint_iroot(n, k), *expected = bigint_iroot_for_test(n, k);
+		CuAssertPtrNotNull(tc, root);
+		CuAssertIntEquals(tc, 0, bigint_compare(expected, root));
+
+		// odd roots of negative numbers are rounded towards zero, and dst may be n
+		if (k%2 == 1) {
+			CuAssertIntEquals(tc, 0, bigint_negate_into(n, n));
+			CuAssertIntEquals(tc, 0, bigint_negate_into(expected, expected));
+			CuAssertIntEquals(tc, 0, bigint_iroot_into(n, n, k));
+			CuAssertIntEquals(tc, 0, bigint_compare(expected, n));
+		} else if (k == 2) {
+			CuAssertIntEquals(tc, 0, bigint_isqrt_into(n, n));
+			CuAssertIntEquals(tc, 0, bigint_compare(expected, n));
+		}
+		bigint_destroy(n);
+		bigint_destroy(root);
+		bigint_destroy(expected);
+	}
+
+	// large roots, where the estimates come from the roots of the top bits
+	struct bigint *x = bigint_from_long(0);
+	for (int i = 0; i < 10; i++) {
+		struct bigint *r = bigint_random_for_test(20 + 30*i), *power = NULL, *root = NULL;
+		CuAssertIntEquals(tc, 0, bigint_abs_into(r, r));
+		unsigned long k = 2 + i%4;
+		CuAssertPtrNotNull(tc, (power = bigint_pow(r, k)));
+		CuAssertPtrNotNull(tc, (root = bigint_iroot(power, k)));
+		CuAssertIntEquals(tc, 0, bigint_compare(r, root));
+		CuAssertIntEquals(tc, 0, bigint_from_long_into(x, 1));
+		CuAssertIntEquals(tc, 0, bigint_subtract_into(power, power, x));
+		CuAssertIntEquals(tc, 0, bigint_iroot_into(root, power, k));
+		CuAssertIntEquals(tc, 0, bigint_subtract_into(root, r, root));
+		CuAssertIntEquals(tc, 0, bigint_compare(x, root));
+		bigint_destroy(r);
+		bigint_destroy(power);
+		bigint_destroy(root);
+	}
+
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(x, -8));
+	CuAssertIntEquals(tc, EDOM, bigint_isqrt_into(x, x));
+	CuAssertIntEquals(tc, EDOM, bigint_iroot_into(x, x, 0));
+	CuAssertIntEquals(tc, 0, bigint_iroot_into(x, x, 3));
+	unsigned long result = 0;
+	CuAssertIntEquals(tc, 0, bigint_to_long(x, &result));
+	CuAssertIntEquals(tc, -2, (long)result);
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(x, 0));
+	CuAssertIntEquals(tc, 0, bigint_iroot_into(x, x, 7));
+	CuAssertIntEquals(tc, 0, bigint_to_long(x, &result));
+	CuAssertIntEquals(tc, 0, result);
+	bigint_destroy(x);
+}
+
+
+void TestBigintRootBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		NITERATION = 10,
+	};
+
+	srand(1337);
+	const int nchunks[] = {4, 16, 64};
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		struct bigint *n = bigint_random_for_test(nchunks[i]), *root = bigint_from_long(0);
+		CuAssertIntEquals(tc, 0, bigint_abs_into(n, n));
+
+		char description[64];
+		snprintf(description, sizeof(description), "bigint_iroot_for_test 2 %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_destroy(bigint_iroot_for_test(n, 2));
+		}
+		snprintf(description, sizeof(description), "bigint_isqrt_into %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_isqrt_into(root, n);
+		}
+		snprintf(description, sizeof(description), "bigint_iroot_for_test 5 %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_destroy(bigint_iroot_for_test(n, 5));
+		}
+		snprintf(description, sizeof(description), "bigint_iroot_into 5 %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_iroot_into(root, n, 5);
+		}
+		snprintf(description, sizeof(description), "bigint_pow_into 7 %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_pow_into(root, n, 7);
+		}
+
+		bigint_destroy(n);
+		bigint_destroy(root);
+	}
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
+
+
+/*
+ * random bigints are generated with splitmix64, see Steele, Lea and Flood,
+ * Fast Splittable Pseudorandom Number Generators. it is one add and a few
+ * multiplies per chunk, and the state is a single word owned by the caller.
+ */
+static uint64_t splitmix64(uint64_t *state) {
+	uint64_t z = (*state += 0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	return z ^ (z >> 31);
+}
+
+
+int bigint_random_into(struct bigint *dst, unsigned long nbit, uint64_t *state) {
+	if (dst == NULL || state == NULL) {
+		return EINVAL;
+	}
+	if (nbit/LONG_BIT >= (unsigned long)INT_MAX) {
+		return ERANGE;
+	}
+
+	int nchunk = nbit/LONG_BIT + 1;
+	if (bigint_reserve(dst, nchunk) != 0) {
+		return ENOMEM;
+	}
+
+	for (int i = 0; i < nchunk; i++) {
+		dst->chunks[i] = splitmix64(state);
+	}
+	dst->chunks[nchunk-1] &= (1UL << nbit%LONG_BIT) - 1;
+	dst->nchunk = nchunk;
+
+	bigint_identify_pad_chunk_and_trim(dst);
+	return 0;
+}
+
+
+struct bigint *bigint_random(unsigned long nbit, uint64_t *state) {
+	if (nbit/LONG_BIT >= (unsigned long)INT_MAX) {
+		return NULL;
+	}
+
+	BIGINT_NEW_RESULT(nbit/LONG_BIT + 1, bigint_random_into(res, nbit, state));
+}
+
+
+void TestBigint_random(CuTest *tc) {
+	uint64_t state = 1337;
+	const unsigned long nbits[] = {0, 1, 63, 64, 65, 1000};
+	for (size_t i = 0; i < sizeof(nbits)/sizeof(*nbits); i++) {
+		uint64_t same_state = state;
+		struct bigint *a = bigint_random(nbits[i], &state), *b = bigint_random(nbits[i], &same_state);
+		CuAssertPtrNotNull(tc, a);
+		CuAssertIntEquals(tc, 0, bigint_compare(a, b));
+		CuAssertIntEquals(tc, 0, bigint_msb(a, -1));
+
+		// below 2^nbit, and with the top bit set about half of the time
+		int ntop = 0;
+		for (int j = 0; j < 100; j++) {
+			CuAssertIntEquals(tc, 0, bigint_random_into(a, nbits[i], &state));
+			struct bigint *above = bigint_shr_ul(a, nbits[i]);
+			CuAssertPtrNotNull(tc, above);
+			CuAssertIntEquals(tc, 0, bigint_msb(above, -1));
+			CuAssertIntEquals(tc, 1, above->nchunk);
+			CuAssertIntEquals(tc, 0, above->chunks[0]);
+			if (nbits[i] > 0) {
+				struct bigint *top = bigint_shr_ul(a, nbits[i]-1);
+				CuAssertPtrNotNull(tc, top);
+				ntop += top->chunks[0] == 1;
+				bigint_destroy(top);
+			}
+			bigint_destroy(above);
+		}
+		if (nbits[i] > 0) {
+			CuAssertTrue(tc, ntop > 25 && ntop < 75);
+		}
+
+		bigint_destroy(a);
+		bigint_destroy(b);
+	}
+	CuAssertPtrEquals(tc, NULL, bigint_random(ULONG_MAX, &state));
+	CuAssertPtrEquals(tc, NULL, bigint_random(1, NULL));
+}
+
+
+/*
+ * probable primes are the baillie-psw test: trial division by the small
+ * primes, a strong fermat test (miller-rabin) to base 2 and a strong lucas
+ * test with selfridge's parameters, see Baillie and Wagstaff, Lucas
+ * Pseudoprimes, and FIPS 186-4 appendix C.3. no composite is known to pass
+ * it. optional miller-rabin rounds with random bases follow, spread across
+ * threads. all arithmetic modulo n is in montgomery form, on n's chunks.
+ */
+static const unsigned short bigint_small_primes[] = { // the odd primes below 1000
+	3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73,
+	79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131, 137, 139, 149, 151, 157, 163, 167, 173, 179,
+	181, 191, 193, 197, 199, 211, 223, 227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283,
+	293, 307, 311, 313, 317, 331, 337, 347, 349, 353, 359, 367, 373, 379, 383, 389, 397, 401, 409, 419,
+	421, 431, 433, 439, 443, 449, 457, 461, 463, 467, 479, 487, 491, 499, 503, 509, 521, 523, 541, 547,
+	557, 563, 569, 571, 577, 587, 593, 599, 601, 607, 613, 617, 619, 631, 641, 643, 647, 653, 659, 661,
+	673, 677, 683, 691, 701, 709, 719, 727, 733, 739, 743, 751, 757, 761, 769, 773, 787, 797, 809, 811,
+	821, 823, 827, 829, 839, 853, 857, 859, 863, 877, 881, 883, 887, 907, 911, 919, 929, 937, 941, 947,
+	953, 967, 971, 977, 983, 991, 997,
+};
+
+enum {
+	BIGINT_NSMALL_PRIME = sizeof(bigint_small_primes)/sizeof(*bigint_small_primes),
+	BIGINT_SMALL_PRIME_MAX = 997,
+};
+
+struct bigint_prime {
+	int nchunk;
+	const struct bigint *n;
+	struct bigint n_minus_1;
+	struct bigint d; // n-1 = d*2^s, where d is odd
+	unsigned long s;
+	struct bigint_montgomery *montgomery;
+	unsigned long *one; // R mod n, i.e. 1 in montgomery form
+	unsigned long *minus_one; // n - (R mod n)
+	int nscratch; // for chunks_montgomery_multiply
+};
+
+/* a mod d */
+static unsigned long chunks_remainder_1(const unsigned long *a, int n, unsigned long d) {
+	unsigned long remainder = 0;
+	for (int i = n-1; i >= 0; i--) {
+		chunk_divide(remainder, a[i], d, &remainder);
+	}
+	return remainder;
+}
+
+/*
+ * trial division of n[0..k) by the small primes, with as many primes as
+ * fit in a chunk for each pass over n.
+ *
+ * returns:
+ *   n has a small factor other than itself --> 0
+ *   n is prime, i.e. small enough that trial division decides --> 1
+ *   --> -1
+ */
+static int chunks_trial_division(const unsigned long *n, int k) {
+	for (int i = 0; i < BIGINT_NSMALL_PRIME;) {
+		unsigned long product = 1;
+		int j = i;
+		while (j < BIGINT_NSMALL_PRIME && product <= ULONG_MAX/bigint_small_primes[j]) {
+			product *= bigint_small_primes[j++];
+		}
+
+		unsigned long remainder = chunks_remainder_1(n, k, product);
+		for (; i < j; i++) {
+			if (remainder % bigint_small_primes[i] == 0) {
+				return k == 1 && n[0] == bigint_small_primes[i];
+			}
+		}
+	}
+	return k == 1 && n[0] < (unsigned long)BIGINT_SMALL_PRIME_MAX*BIGINT_SMALL_PRIME_MAX ? 1 : -1;
+}
+
+/* jacobi symbol (a/n) for odd n */
+static int chunk_jacobi(unsigned long a, unsigned long n) {
+	int jacobi = 1;
+	a %= n;
+	while (a != 0) {
+		int ntwo = __builtin_ctzl(a);
+		a >>= ntwo;
+		if ((ntwo & 1) && (n%8 == 3 || n%8 == 5)) {
+			jacobi = -jacobi;
+		}
+		if (a%4 == 3 && n%4 == 3) {
+			jacobi = -jacobi;
+		}
+		unsigned long t = a;
+		a = n%a;
+		n = t;
+	}
+	return n == 1 ? jacobi : 0;
+}
+
+/* jacobi symbol (d/n) for odd d and odd n[0..k), by quadratic reciprocity */
+static int chunks_jacobi(long d, const unsigned long *n, int k) {
+	unsigned long m = labs(d);
+	int jacobi = chunk_jacobi(chunks_remainder_1(n, k, m), m);
+	if (m%4 == 3 && n[0]%4 == 3) {
+		jacobi = -jacobi;
+	}
+	if (d < 0 && n[0]%4 == 3) { // (-1/n)
+		jacobi = -jacobi;
+	}
+	return jacobi;
+}
+
+/* r = a+b mod m[0..k), for a, b < m. r may alias a and/or b */
+static void chunks_mod_add(unsigned long *r, const unsigned long *a, const unsigned long *b, const unsigned long *m, int k) {
+	if (chunks_add_n(r, a, b, k) != 0 || chunks_compare(r, m, k) >= 0) {
+		chunks_sub_n(r, r, m, k);
+	}
+}
+
+/* r = a-b mod m[0..k), for a, b < m. r may alias a and/or b */
+static void chunks_mod_sub(unsigned long *r, const unsigned long *a, const unsigned long *b, const unsigned long *m, int k) {
+	if (chunks_sub_n(r, a, b, k) != 0) {
+		chunks_add_n(r, r, m, k);
+	}
+}
+
+/* r = a/2 mod m[0..k), for a < m and odd m. r may alias a */
+static void chunks_mod_half(unsigned long *r, const unsigned long *a, const unsigned long *m, int k) {
+	unsigned long carry = 0;
+	if (a[0] & 1) {
+		carry = chunks_add_n(r, a, m, k);
+	} else {
+		memmove(r, a, k*sizeof(*r));
+	}
+	chunks_shift_right(r, r, k, 1);
+	r[k-1] |= carry << LONG_MSB;
+}
+
+/* r = x*R mod n, x in montgomery form, for |x| < n */
+static void bigint_prime_to_montgomery(const struct bigint_prime *ctx, unsigned long *r, long x, unsigned long *scratch) {
+	int k = ctx->nchunk;
+	memset(r, 0, k*sizeof(*r));
+	r[0] = labs(x);
+	chunks_montgomery_multiply(r, r, ctx->montgomery->r2, ctx->montgomery, scratch);
+	if (x < 0 && !chunks_is_zero(r, k)) {
+		chunks_sub_n(r, ctx->montgomery->modulus, r, k);
+	}
+}
+
+/* n is a perfect square */
+static int bigint_prime_is_square(const struct bigint *n, int *square) {
+	struct bigint x = BIGINT_STATIC_INIT(x), y = BIGINT_STATIC_INIT(y);
+	int status = bigint_isqrt_into(&x, n);
+	if (status == 0 && (status = bigint_square_into(&y, &x)) == 0) {
+		*square = bigint_compare(&y, n) == 0;
+	}
+	bigint_clear(&x);
+	bigint_clear(&y);
+	return status;
+}
+
+/*
+ * miller-rabin for the witness 1 < a < n-1, x is a bigint for the power and
+ * scratch has room for k + ctx->nscratch chunks.
+ *
+ * returns:
+ *   n is a strong probable prime to base a --> 1
+ *   n is composite --> 0
+ *   error --> -errno
+ */
+static int bigint_prime_miller_rabin(const struct bigint_prime *ctx, struct bigint_modpow_ctx *pow, const struct bigint *a, struct bigint *x, unsigned long *scratch) {
+	int k = ctx->nchunk, status = bigint_modpow_ctx_into(pow, x, a, &ctx->d);
+	if (status != 0) {
+		return -status;
+	}
+
+	unsigned long *y = scratch;
+	int nx = chunks_significant(x->chunks, x->nchunk);
+	memmove(y, x->chunks, nx*sizeof(*y));
+	memset(y+nx, 0, (k-nx)*sizeof(*y));
+	chunks_montgomery_multiply(y, y, ctx->montgomery->r2, ctx->montgomery, y+k);
+	if (chunks_compare(y, ctx->one, k) == 0 || chunks_compare(y, ctx->minus_one, k) == 0) {
+		return 1;
+	}
+
+	for (unsigned long i = 1; i < ctx->s; i++) {
+		chunks_montgomery_multiply(y, y, y, ctx->montgomery, y+k);
+		if (chunks_compare(y, ctx->minus_one, k) == 0) {
+			return 1;
+		}
+		if (chunks_compare(y, ctx->one, k) == 0) {
+			return 0;
+		}
+	}
+	return 0;
+}
+
+/*
+ * strong lucas test with P = 1 and Q = (1-D)/4, where D is the first of
+ * 5, -7, 9, -11, .. with jacobi symbol (D/n) = -1.
+ *
+ * returns:
+ *   n is a strong lucas probable prime --> 1
+ *   n is composite --> 0
+ *   error --> -errno
+ */
+static int bigint_prime_lucas(const struct bigint_prime *ctx) {
+	int k = ctx->nchunk, status, square = 0;
+	const unsigned long *n = ctx->montgomery->modulus;
+	long d = 5;
+	for (int jacobi; (jacobi = chunks_jacobi(d, n, k)) != -1; d = d > 0 ? -d-2 : -d+2) {
+		if (jacobi == 0) { // n > |d|, which has a common factor with n
+			return 0;
+		}
+		// no such d exists for squares, so check after a few tries
+		if (d == 13 && ((status = bigint_prime_is_square(ctx->n, &square)) != 0 || square)) {
+			return status != 0 ? -status : 0;
+		}
+	}
+
+	// n+1 = e*2^s, where e is odd
+	struct bigint e = BIGINT_STATIC_INIT(e);
+	unsigned long s = 0;
+	if ((status = bigint_from_long_into(&e, 1)) != 0 || (status = bigint_add_into(&e, &e, ctx->n)) != 0) {
+		bigint_clear(&e);
+		return -status;
+	}
+	while (((e.chunks[s/LONG_BIT] >> s%LONG_BIT) & 1) == 0) {
+		s++;
+	}
+	if ((status = bigint_shr_ul_into(&e, &e, s)) != 0) {
+		bigint_clear(&e);
+		return -status;
+	}
+
+	unsigned long *u = malloc((6*k + ctx->nscratch) * sizeof(*u));
+	if (u == NULL) {
+		bigint_clear(&e);
+		return -ENOMEM;
+	}
+	unsigned long *v = u+k, *qk = v+k, *dm = qk+k, *qm = dm+k, *t = qm+k, *scratch = t+k;
+	bigint_prime_to_montgomery(ctx, dm, d, scratch);
+	bigint_prime_to_montgomery(ctx, qm, (1-d)/4, scratch);
+	memmove(u, ctx->one, k*sizeof(*u));
+	memmove(v, ctx->one, k*sizeof(*v));
+	memmove(qk, qm, k*sizeof(*qk));
+
+	// U_1 = 1, V_1 = P = 1 and Q^1, then from the most significant bit of e down
+	int ne = chunks_significant(e.chunks, e.nchunk);
+	for (long i = (long)LONG_BIT*ne - __builtin_clzl(e.chunks[ne-1]) - 2; i >= 0; i--) {
+		// U_2j = U_j*V_j, V_2j = V_j^2 - 2Q^j
+		chunks_montgomery_multiply(u, u, v, ctx->montgomery, scratch);
+		chunks_montgomery_multiply(v, v, v, ctx->montgomery, scratch);
+		chunks_mod_sub(v, v, qk, n, k);
+		chunks_mod_sub(v, v, qk, n, k);
+		chunks_montgomery_multiply(qk, qk, qk, ctx->montgomery, scratch);
+		if ((e.chunks[i/LONG_BIT] >> i%LONG_BIT) & 1) {
+			// U_(j+1) = (P*U_j + V_j)/2, V_(j+1) = (D*U_j + P*V_j)/2
+			chunks_montgomery_multiply(t, dm, u, ctx->montgomery, scratch);
+			chunks_mod_add(u, u, v, n, k);
+			chunks_mod_half(u, u, n, k);
+			chunks_mod_add(v, v, t, n, k);
+			chunks_mod_half(v, v, n, k);
+			chunks_montgomery_multiply(qk, qk, qm, ctx->montgomery, scratch);
+		}
+	}
+
+	// U_e = 0, or V_(e*2^r) = 0 for some 0 <= r < s
+	int prime = chunks_is_zero(u, k) || chunks_is_zero(v, k);
+	for (unsigned long r = 1; r < s && !prime; r++) {
+		chunks_montgomery_multiply(v, v, v, ctx->montgomery, scratch);
+		chunks_mod_sub(v, v, qk, n, k);
+		chunks_mod_sub(v, v, qk, n, k);
+		chunks_montgomery_multiply(qk, qk, qk, ctx->montgomery, scratch);
+		prime = chunks_is_zero(v, k);
+	}
+
+	free(u);
+	bigint_clear(&e);
+	return prime;
+}
+
+static void bigint_prime_clear(struct bigint_prime *ctx) {
+	bigint_clear(&ctx->n_minus_1);
+	bigint_clear(&ctx->d);
+	bigint_montgomery_destroy(ctx->montgomery);
+	free(ctx->one);
+}
+
+/* the context for an odd n > 3 */
+static int bigint_prime_init(struct bigint_prime *ctx, const struct bigint *n) {
+	int k = chunks_significant(n->chunks, n->nchunk);
+	*ctx = (struct bigint_prime){
+		.nchunk = k,
+		.n = n,
+		.nscratch = 2*k+1 + chunks_mul_scratch(k),
+	};
+	bigint_init_inline(&ctx->n_minus_1);
+	bigint_init_inline(&ctx->d);
+
+	if (bigint_copy_into(&ctx->n_minus_1, n) != 0) {
+		return ENOMEM;
+	}
+	ctx->n_minus_1.chunks[0]--; // n is odd
+	while (((ctx->n_minus_1.chunks[ctx->s/LONG_BIT] >> ctx->s%LONG_BIT) & 1) == 0) {
+		ctx->s++;
+	}
+
+	ctx->montgomery = bigint_montgomery_init(n);
+	ctx->one = malloc((2*k + 2*k+1) * sizeof(*ctx->one));
+	if (bigint_shr_ul_into(&ctx->d, &ctx->n_minus_1, ctx->s) != 0 || ctx->montgomery == NULL || ctx->one == NULL) {
+		return ENOMEM;
+	}
+
+	// R mod n = R^2 * R^-1 mod n
+	unsigned long *t = ctx->one + 2*k;
+	memmove(t, ctx->montgomery->r2, k*sizeof(*t));
+	memset(t+k, 0, k*sizeof(*t));
+	chunks_montgomery_redc(ctx->one, t, ctx->montgomery);
+	ctx->minus_one = ctx->one + k;
+	chunks_sub_n(ctx->minus_one, ctx->montgomery->modulus, ctx->one, k);
+	return 0;
+}
+
+/* the random miller-rabin rounds first, first+stride, .. below nround */
+struct bigint_prime_worker {
+	const struct bigint_prime *ctx;
+	int first, stride, nround;
+	uint64_t seed;
+	atomic_int *composite; // set by the first worker that finds a witness
+	int status; // 1, 0 or -errno like bigint_prime_miller_rabin
+	pthread_t thread;
+};
+
+static void *bigint_prime_worker_run(void *arg) {
+	struct bigint_prime_worker *worker = arg;
+	const struct bigint_prime *ctx = worker->ctx;
+	struct bigint witness = BIGINT_STATIC_INIT(witness), x = BIGINT_STATIC_INIT(x);
+	struct bigint_modpow_ctx *pow = bigint_modpow_ctx_init(ctx->n);
+	unsigned long *scratch = malloc((ctx->nchunk + ctx->nscratch) * sizeof(*scratch));
+	unsigned long nbit = (unsigned long)LONG_BIT*ctx->nchunk - __builtin_clzl(ctx->n->chunks[ctx->nchunk-1]);
+
+	worker->status = pow == NULL || scratch == NULL ? -ENOMEM : 1;
+	for (int i = worker->first; i < worker->nround && worker->status == 1 && !atomic_load(worker->composite); i += worker->stride) {
+		// a witness in [2, n-1) from a stream of its own, so the witnesses do not depend on the threads
+		uint64_t state = worker->seed + i;
+		state = splitmix64(&state);
+		int status;
+		do {
+			status = bigint_random_into(&witness, nbit, &state);
+		} while (status == 0 && ((witness.nchunk == 1 && witness.chunks[0] < 2) || bigint_compare(&witness, &ctx->n_minus_1) >= 0));
+
+		worker->status = status != 0 ? -status : bigint_prime_miller_rabin(ctx, pow, &witness, &x, scratch);
+	}
+	if (worker->status == 0) {
+		atomic_store(worker->composite, 1);
+	}
+
+	bigint_clear(&witness);
+	bigint_clear(&x);
+	bigint_modpow_ctx_destroy(pow);
+	free(scratch);
+	return NULL;
+}
+
+/* nround random miller-rabin rounds on nthread threads, returns like bigint_prime_miller_rabin */
+static int bigint_prime_random_rounds(const struct bigint_prime *ctx, int nround, int nthread) {
+	if (nthread > nround) {
+		nthread = nround > 0 ? nround : 1;
+	}
+	struct bigint_prime_worker *workers = calloc(nthread, sizeof(*workers));
+	if (workers == NULL) {
+		return -ENOMEM;
+	}
+
+	atomic_int composite = 0;
+	uint64_t seed = 0;
+	for (int i = 0; i < ctx->nchunk; i++) {
+		seed = seed*0x100000001b3 ^ ctx->n->chunks[i];
+	}
+
+	// worker 0 runs on this thread, and so does any worker whose thread could not be created
+	int *started = calloc(nthread, sizeof(*started));
+	for (int i = 0; i < nthread; i++) {
+		workers[i] = (struct bigint_prime_worker){
+			.ctx = ctx, .first = i, .stride = nthread, .nround = nround, .seed = seed, .composite = &composite,
+		};
+		if (i > 0 && started != NULL) {
+			started[i] = pthread_create(&workers[i].thread, NULL, bigint_prime_worker_run, &workers[i]) == 0;
+		}
+	}
+	bigint_prime_worker_run(&workers[0]);
+
+	int status = 1;
+	for (int i = 0; i < nthread; i++) {
+		if (i > 0 && started != NULL && started[i]) {
+			pthread_join(workers[i].thread, NULL);
+		} else if (i > 0) {
+			bigint_prime_worker_run(&workers[i]);
+		}
+		if (workers[i].status < status) {
+			status = workers[i].status;
+		}
+	}
+
+	free(started);
+	free(workers);
+	return status;
+}
+
+
+int bigint_is_probable_prime(const struct bigint *n, int nround, int nthread) {
+	if (n == NULL || nround < 0 || nthread < 1) {
+		return -EINVAL;
+	}
+
+	int k = chunks_significant(n->chunks, n->nchunk);
+	if (bigint_msb(n, -1) == 1 || k == 0 || (k == 1 && n->chunks[0] < 2)) {
+		return 0;
+	}
+	if ((n->chunks[0] & 1) == 0) {
+		return k == 1 && n->chunks[0] == 2;
+	}
+
+	int status = chunks_trial_division(n->chunks, k);
+	if (status >= 0) {
+		return status;
+	}
+
+	struct bigint_prime ctx;
+	if ((status = bigint_prime_init(&ctx, n)) != 0) {
+		bigint_prime_clear(&ctx);
+		return -status;
+	}
+
+	struct bigint_modpow_ctx *pow = bigint_modpow_ctx_init(n);
+	struct bigint two = BIGINT_STATIC_INIT(two), x = BIGINT_STATIC_INIT(x);
+	unsigned long *scratch = malloc((k + ctx.nscratch) * sizeof(*scratch));
+	if (pow == NULL || scratch == NULL || bigint_from_long_into(&two, 2) != 0) {
+		status = -ENOMEM;
+	} else if ((status = bigint_prime_miller_rabin(&ctx, pow, &two, &x, scratch)) == 1 &&
+	           (status = bigint_prime_lucas(&ctx)) == 1 && nround > 0) {
+		status = bigint_prime_random_rounds(&ctx, nround, nthread);
+	}
+
+	bigint_modpow_ctx_destroy(pow);
+	bigint_clear(&two);
+	bigint_clear(&x);
+	free(scratch);
+	bigint_prime_clear(&ctx);
+	return status;
+}
+
+
+void TestBigint_is_probable_prime(CuTest *tc) {
+	// trial division alone and the full test, against isprime
+	const unsigned long ranges[][2] = {{0, 3000}, {994000, 996000}, {4294966000, 4294968000}};
+	for (size_t i = 0; i < sizeof(ranges)/sizeof(*ranges); i++) {
+		for (unsigned long j = ranges[i][0]; j < ranges[i][1]; j++) {
+			struct bigint *n = bigint_from_long(j);
+			CuAssertIntEquals(tc, isprime(j), bigint_is_probable_prime(n, 1, 1));
+			bigint_destroy(n);
+		}
+	}
+
+	// strong pseudoprimes to base 2 are caught by the lucas test
+	const long spsps[] = {1373653, 25326001, 3215031751, 2152302898747, 3474749660383, 341550071728321, 3825123056546413051};
+	for (size_t i = 0; i < sizeof(spsps)/sizeof(*spsps); i++) {
+		struct bigint *n = bigint_from_long(spsps[i]);
+		CuAssertIntEquals(tc, 0, bigint_is_probable_prime(n, 0, 1));
+		bigint_destroy(n);
+	}
+
+	// and strong lucas pseudoprimes by the miller-rabin test to base 2
+	const long slpsps[] = {5459, 5777, 10877, 16109, 18971, 22499, 24569, 25199, 40309, 58519};
+	struct bigint *two = bigint_from_long(2), x = BIGINT_STATIC_INIT(x);
+	for (size_t i = 0; i < sizeof(slpsps)/sizeof(*slpsps); i++) {
+		struct bigint *n = bigint_from_long(slpsps[i]);
+		struct bigint_prime ctx;
+		CuAssertIntEquals(tc, 0, bigint_prime_init(&ctx, n));
+		struct bigint_modpow_ctx *pow = bigint_modpow_ctx_init(n);
+		unsigned long *scratch = malloc((ctx.nchunk + ctx.nscratch) * sizeof(*scratch));
+		CuAssertIntEquals(tc, 1, bigint_prime_lucas(&ctx));
+		CuAssertIntEquals(tc, 0, bigint_prime_miller_rabin(&ctx, pow, two, &x, scratch));
+		free(scratch);
+		bigint_modpow_ctx_destroy(pow);
+		bigint_prime_clear(&ctx);
+		bigint_destroy(n);
+	}
+	bigint_destroy(two);
+	bigint_clear(&x);
+
+	// mersenne primes and composites, fermat composites and a square
+	const int mersennes[] = {61, 67, 89, 127, 257, 521, 607};
+	const int prime[] = {1, 0, 1, 1, 0, 1, 1};
+	for (size_t i = 0; i < sizeof(mersennes)/sizeof(*mersennes); i++) {
+		struct bigint *one = bigint_from_long(1), *power = bigint_shl_ul(one, mersennes[i]);
+		struct bigint *mersenne = bigint_subtract(power, one), *fermat = bigint_add(power, one);
+		CuAssertIntEquals(tc, prime[i], bigint_is_probable_prime(mersenne, 4, 2));
+		CuAssertIntEquals(tc, 0, bigint_is_probable_prime(fermat, 4, 2));
+		bigint_destroy(one);
+		bigint_destroy(power);
+		bigint_destroy(mersenne);
+		bigint_destroy(fermat);
+	}
+	struct bigint *p = bigint_from_long(1000003), *square = bigint_square(p);
+	CuAssertIntEquals(tc, 0, bigint_is_probable_prime(square, 0, 1));
+	bigint_destroy(square);
+
+	// a random prime as in a key search, and products of primes with any number of threads
+	uint64_t state = 1337;
+	struct bigint *q = bigint_random(256, &state), *step = bigint_from_long(2);
+	CuAssertPtrNotNull(tc, q);
+	CuAssertPtrNotNull(tc, step);
+	q->chunks[0] |= 1;
+	while (bigint_is_probable_prime(q, 0, 1) == 0) {
+		CuAssertIntEquals(tc, 0, bigint_add_into(q, q, step));
+	}
+	struct bigint *pq = bigint_multiply(p, q), *qq = bigint_multiply(q, q);
+	CuAssertPtrNotNull(tc, pq);
+	CuAssertPtrNotNull(tc, qq);
+	for (int nthread = 1; nthread <= 4; nthread++) {
+		CuAssertIntEquals(tc, 1, bigint_is_probable_prime(q, 16, nthread));
+		CuAssertIntEquals(tc, 0, bigint_is_probable_prime(pq, 16, nthread));
+		CuAssertIntEquals(tc, 0, bigint_is_probable_prime(qq, 16, nthread));
+	}
+	struct bigint *minus_q = bigint_negate(q);
+	CuAssertIntEquals(tc, 0, bigint_is_probable_prime(minus_q, 0, 1));
+	CuAssertIntEquals(tc, -EINVAL, bigint_is_probable_prime(q, -1, 1));
+	CuAssertIntEquals(tc, -EINVAL, bigint_is_probable_prime(q, 1, 0));
+
+	bigint_destroy(p);
+	bigint_destroy(q);
+	bigint_destroy(step);
+	bigint_destroy(pq);
+	bigint_destroy(qq);
+	bigint_destroy(minus_q);
+}
+void TestBigintPrimeBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		NITERATION = 10,
+	};
+
+	uint64_t state = 1337;
+	const int nbits[] = {512, 1024, 2048};
+	for (size_t i = 0; i < sizeof(nbits)/sizeof(*nbits); i++) {
+		struct bigint *n = bigint_random(nbits[i], &state), *step = bigint_from_long(2);
+		CuAssertPtrNotNull(tc, n);
+		CuAssertPtrNotNull(tc, step);
+		n->chunks[0] |= 1;
+		while (bigint_is_probable_prime(n, 0, 1) == 0) {
+			CuAssertIntEquals(tc, 0, bigint_add_into(n, n, step));
+		}
+
+		char description[64];
+		int nprime = 0;
+		snprintf(description, sizeof(description), "bigint_is_probable_prime %d bpsw", nbits[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			nprime += bigint_is_probable_prime(n, 0, 1);
+		}
+		CuAssertIntEquals(tc, NITERATION, nprime);
+		for (int nthread = 1; nthread <= 4; nthread *= 2) {
+			nprime = 0;
+			snprintf(description, sizeof(description), "bigint_is_probable_prime %d bpsw+16 rounds %d threads", nbits[i], nthread);
+			TIMED_BLOCK(NITERATION, description) {
+				nprime += bigint_is_probable_prime(n, 16, nthread);
+			}
+			CuAssertIntEquals(tc, NITERATION, nprime);
+		}
+
+		bigint_destroy(n);
+		bigint_destroy(step);
+	}
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
+
+/*
+ * batched arithmetic keeps n numbers of nchunk chunks as a structure of
+ * arrays, chunk j of number i at [j*n + i]. the kernels walk the chunks of
+ * a group of numbers from the least significant one with the carries of the
+ * group in a vector, so each chunk of the group is one contiguous load.
+ * each kernel returns how many numbers it did, a multiple of its vector
+ * width, and the scalar kernel does the rest from first.
+ */
+static void chunks_batch_add_scalar(unsigned long *r, unsigned long *carry, const unsigned long *a, const unsigned long *b, size_t n, int nchunk, size_t first) {
+	for (size_t i = first; i < n; i++) {
+		unsigned long c = 0;
+		for (int j = 0; j < nchunk; j++) {
+			r[j*n + i] = chunk_add_carry(a[j*n + i], b[j*n + i], c, &c);
+		}
+		if (carry != NULL) {
+			carry[i] = c;
+		}
+	}
+}
+
+static void chunks_batch_sub_scalar(unsigned long *r, unsigned long *borrow, const unsigned long *a, const unsigned long *b, size_t n, int nchunk, size_t first) {
+	for (size_t i = first; i < n; i++) {
+		unsigned long c = 0;
+		for (int j = 0; j < nchunk; j++) {
+			r[j*n + i] = chunk_sub_borrow(a[j*n + i], b[j*n + i], c, &c);
+		}
+		if (borrow != NULL) {
+			borrow[i] = c;
+		}
+	}
+}
+
+static void chunks_batch_compare_scalar(int *r, const unsigned long *a, const unsigned long *b, size_t n, int nchunk, enum bigint_format format, size_t first) {
+	for (size_t i = first; i < n; i++) {
+		int j = nchunk-1;
+		while (j >= 0 && a[j*n + i] == b[j*n + i]) {
+			j--;
+		}
+
+		if (j < 0) {
+			r[i] = 0;
+		} else if (j == nchunk-1 && format == BIGINT_TWOS_COMPLEMENT) {
+			r[i] = (long)a[j*n + i] > (long)b[j*n + i] ? 1 : -1;
+		} else {
+			r[i] = a[j*n + i] > b[j*n + i] ? 1 : -1;
+		}
+	}
+}
+
+#ifdef BIGINT_HAVE_X86_SIMD
+/* avx2 has no unsigned compare, so the sign bits are flipped for a signed one */
+__attribute__((target("avx2")))
+static size_t chunks_batch_add_avx2(unsigned long *r, unsigned long *carry, const unsigned long *a, const unsigned long *b, size_t n, int nchunk) {
+	const __m256i sign = _mm256_set1_epi64x(LLONG_MIN), ones = _mm256_set1_epi64x(-1);
+	size_t i = 0;
+	for (; i+4 <= n; i += 4) {
+		__m256i c = _mm256_setzero_si256(); // 0 or all ones
+		for (int j = 0; j < nchunk; j++) {
+			__m256i x = _mm256_loadu_si256((const void *)(a + j*n + i)), y = _mm256_loadu_si256((const void *)(b + j*n + i));
+			__m256i sum = _mm256_add_epi64(x, y);
+			__m256i overflow = _mm256_cmpgt_epi64(_mm256_xor_si256(x, sign), _mm256_xor_si256(sum, sign));
+			overflow = _mm256_or_si256(overflow, _mm256_and_si256(c, _mm256_cmpeq_epi64(sum, ones)));
+			_mm256_storeu_si256((void *)(r + j*n + i), _mm256_sub_epi64(sum, c));
+			c = overflow;
+		}
+		if (carry != NULL) {
+			_mm256_storeu_si256((void *)(carry+i), _mm256_srli_epi64(c, LONG_MSB));
+		}
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t chunks_batch_sub_avx2(unsigned long *r, unsigned long *borrow, const unsigned long *a, const unsigned long *b, size_t n, int nchunk) {
+	const __m256i sign = _mm256_set1_epi64x(LLONG_MIN), zero = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i+4 <= n; i += 4) {
+		__m256i c = zero; // 0 or all ones
+		for (int j = 0; j < nchunk; j++) {
+			__m256i x = _mm256_loadu_si256((const void *)(a + j*n + i)), y = _mm256_loadu_si256((const void *)(b + j*n + i));
+			__m256i difference = _mm256_sub_epi64(x, y);
+			__m256i underflow = _mm256_cmpgt_epi64(_mm256_xor_si256(y, sign), _mm256_xor_si256(x, sign));
+			underflow = _mm256_or_si256(underflow, _mm256_and_si256(c, _mm256_cmpeq_epi64(difference, zero)));
+			_mm256_storeu_si256((void *)(r + j*n + i), _mm256_add_epi64(difference, c));
+			c = underflow;
+		}
+		if (borrow != NULL) {
+			_mm256_storeu_si256((void *)(borrow+i), _mm256_srli_epi64(c, LONG_MSB));
+		}
+	}
+	return i;
+}
+
+/* from the most significant chunk, until every number in the group is decided */
+__attribute__((target("avx2")))
+static size_t chunks_batch_compare_avx2(int *r, const unsigned long *a, const unsigned long *b, size_t n, int nchunk, enum bigint_format format) {
+	const __m256i sign = _mm256_set1_epi64x(LLONG_MIN), one = _mm256_set1_epi64x(1);
+	const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+	size_t i = 0;
+	for (; i+4 <= n; i += 4) {
+		__m256i result = _mm256_setzero_si256(), undecided = _mm256_set1_epi64x(-1);
+		for (int j = nchunk-1; j >= 0 && !_mm256_testz_si256(undecided, undecided); j--) {
+			__m256i x = _mm256_loadu_si256((const void *)(a + j*n + i)), y = _mm256_loadu_si256((const void *)(b + j*n + i));
+			if (j < nchunk-1 || format != BIGINT_TWOS_COMPLEMENT) {
+				x = _mm256_xor_si256(x, sign);
+				y = _mm256_xor_si256(y, sign);
+			}
+			__m256i greater = _mm256_cmpgt_epi64(x, y), less = _mm256_cmpgt_epi64(y, x);
+			__m256i sign_of = _mm256_or_si256(_mm256_and_si256(greater, one), less); // 1, -1 or 0
+			result = _mm256_or_si256(result, _mm256_and_si256(undecided, sign_of));
+			undecided = _mm256_andnot_si256(_mm256_or_si256(greater, less), undecided);
+		}
+		_mm_storeu_si128((void *)(r+i), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(result, low_halves)));
+	}
+	return i;
+}
+
+__attribute__((target("avx512f")))
+static size_t chunks_batch_add_avx512(unsigned long *r, unsigned long *carry, const unsigned long *a, const unsigned long *b, size_t n, int nchunk) {
+	const __m512i one = _mm512_set1_epi64(1), ones = _mm512_set1_epi64(-1);
+	size_t i = 0;
+	for (; i+8 <= n; i += 8) {
+		__mmask8 c = 0;
+		for (int j = 0; j < nchunk; j++) {
+			__m512i x = _mm512_loadu_si512((const void *)(a + j*n + i)), y = _mm512_loadu_si512((const void *)(b + j*n + i));
+			__m512i sum = _mm512_add_epi64(x, y);
+			__mmask8 overflow = _mm512_cmplt_epu64_mask(sum, x) | _mm512_mask_cmpeq_epu64_mask(c, sum, ones);
+			_mm512_storeu_si512((void *)(r + j*n + i), _mm512_mask_add_epi64(sum, c, sum, one));
+			c = overflow;
+		}
+		if (carry != NULL) {
+			_mm512_storeu_si512((void *)(carry+i), _mm512_maskz_mov_epi64(c, one));
+		}
+	}
+	return i;
+}
+
+__attribute__((target("avx512f")))
+static size_t chunks_batch_sub_avx512(unsigned long *r, unsigned long *borrow, const unsigned long *a, const unsigned long *b, size_t n, int nchunk) {
+	const __m512i one = _mm512_set1_epi64(1), zero = _mm512_setzero_si512();
+	size_t i = 0;
+	for (; i+8 <= n; i += 8) {
+		__mmask8 c = 0;
+		for (int j = 0; j < nchunk; j++) {
+			__m512i x = _mm512_loadu_si512((const void *)(a + j*n + i)), y = _mm512_loadu_si512((const void *)(b + j*n + i));
+			__m512i difference = _mm512_sub_epi64(x, y);
+			__mmask8 underflow = _mm512_cmplt_epu64_mask(x, y) | _mm512_mask_cmpeq_epu64_mask(c, difference, zero);
+			_mm512_storeu_si512((void *)(r + j*n + i), _mm512_mask_sub_epi64(difference, c, difference, one));
+			c = underflow;
+		}
+		if (borrow != NULL) {
+			_mm512_storeu_si512((void *)(borrow+i), _mm512_maskz_mov_epi64(c, one));
+		}
+	}
+	return i;
+}
+
+__attribute__((target("avx512f")))
+static size_t chunks_batch_compare_avx512(int *r, const unsigned long *a, const unsigned long *b, size_t n, int nchunk, enum bigint_format format) {
+	const __m512i one = _mm512_set1_epi64(1), minus_one = _mm512_set1_epi64(-1);
+	size_t i = 0;
+	for (; i+8 <= n; i += 8) {
+		__m512i result = _mm512_setzero_si512();
+		__mmask8 undecided = 0xff;
+		for (int j = nchunk-1; j >= 0 && undecided != 0; j--) {
+			__m512i x = _mm512_loadu_si512((const void *)(a + j*n + i)), y = _mm512_loadu_si512((const void *)(b + j*n + i));
+			__mmask8 greater, less;
+			if (j == nchunk-1 && format == BIGINT_TWOS_COMPLEMENT) {
+				greater = _mm512_mask_cmpgt_epi64_mask(undecided, x, y);
+				less = _mm512_mask_cmplt_epi64_mask(undecided, x, y);
+			} else {
+				greater = _mm512_mask_cmpgt_epu64_mask(undecided, x, y);
+				less = _mm512_mask_cmplt_epu64_mask(undecided, x, y);
+			}
+			result = _mm512_mask_mov_epi64(result, greater, one);
+			result = _mm512_mask_mov_epi64(result, less, minus_one);
+			undecided &= ~(greater | less);
+		}
+		_mm256_storeu_si256((void *)(r+i), _mm512_cvtepi64_epi32(result));
+	}
+	return i;
+}
+#endif /* BIGINT_HAVE_X86_SIMD */
+
+
+int bigint_batch_add(unsigned long *r, unsigned long *carry, const unsigned long *a, const unsigned long *b, size_t n, int nchunk) {
+	if (nchunk < 0 || (n > 0 && nchunk > 0 && (r == NULL || a == NULL || b == NULL))) {
+		return EINVAL;
+	}
+
+	size_t first = 0;
+	switch (bigint_simd_level()) {
+#ifdef BIGINT_HAVE_X86_SIMD
+		case BIGINT_SIMD_AVX512: first = chunks_batch_add_avx512(r, carry, a, b, n, nchunk); break;
+		case BIGINT_SIMD_AVX2: first = chunks_batch_add_avx2(r, carry, a, b, n, nchunk); break;
+#endif /* BIGINT_HAVE_X86_SIMD */
+		default: break;
+	}
+	chunks_batch_add_scalar(r, carry, a, b, n, nchunk, first);
+	return 0;
+}
+
+
+int bigint_batch_subtract(unsigned long *r, unsigned long *borrow, const unsigned long *a, const unsigned long *b, size_t n, int nchunk) {
+	if (nchunk < 0 || (n > 0 && nchunk > 0 && (r == NULL || a == NULL || b == NULL))) {
+		return EINVAL;
+	}
+
+	size_t first = 0;
+	switch (bigint_simd_level()) {
+#ifdef BIGINT_HAVE_X86_SIMD
+		case BIGINT_SIMD_AVX512: first = chunks_batch_sub_avx512(r, borrow, a, b, n, nchunk); break;
+		case BIGINT_SIMD_AVX2: first = chunks_batch_sub_avx2(r, borrow, a, b, n, nchunk); break;
+#endif /* BIGINT_HAVE_X86_SIMD */
+		default: break;
+	}
+	chunks_batch_sub_scalar(r, borrow, a, b, n, nchunk, first);
+	return 0;
+}
+
+
+int bigint_batch_compare(int *r, const unsigned long *a, const unsigned long *b, size_t n, int nchunk, enum bigint_format format) {
+	if (nchunk < 0 || (n > 0 && (r == NULL || (nchunk > 0 && (a == NULL || b == NULL))))) {
+		return EINVAL;
+	}
+
+	size_t first = 0;
+	switch (bigint_simd_level()) {
+#ifdef BIGINT_HAVE_X86_SIMD
+		case BIGINT_SIMD_AVX512: first = chunks_batch_compare_avx512(r, a, b, n, nchunk, format); break;
+		case BIGINT_SIMD_AVX2: first = chunks_batch_compare_avx2(r, a, b, n, nchunk, format); break;
+#endif /* BIGINT_HAVE_X86_SIMD */
+		default: break;
+	}
+	chunks_batch_compare_scalar(r, a, b, n, nchunk, format, first);
+	return 0;
+}
+
+
+int bigint_batch_get_into(struct bigint *dst, const unsigned long *a, size_t n, int nchunk, size_t i, enum bigint_format format) {
+	if (dst == NULL || a == NULL || nchunk < 1 || i >= n) {
+		return EINVAL;
+	}
+	if (nchunk == INT_MAX) {
+		return ERANGE;
+	}
+
+	if (bigint_reserve(dst, nchunk+1) != 0) {
+		return ENOMEM;
+	}
 
-	for (int i = 0; i < n->nchunk; i++) {
-		res->chunks[i] = ~n->chunks[i];
+	for (int j = 0; j < nchunk; j++) {
+		dst->chunks[j] = a[j*n + i];
 	}
+	dst->chunks[nchunk] = format == BIGINT_TWOS_COMPLEMENT ? pad_chunks[dst->chunks[nchunk-1] >> LONG_MSB] : 0;
+	dst->nchunk = nchunk+1;
 
-	bigint_identify_pad_chunk_and_trim(res);
-	return res;
+	bigint_identify_pad_chunk_and_trim(dst);
+	return 0;
 }
 
-#define BIGINT_BINOP(a, b, op) do { \
-		if ((a) == NULL || (b) == NULL) {\
-			return NULL;\
-		}\
-		\
-		int maxchunks = (a)->nchunk > (b)->nchunk ? (a)->nchunk : (b)->nchunk;\
-		\
-		struct bigint *res = bigint_init(maxchunks);\
-		if (res == NULL) {\
-			return NULL;\
-		}\
-		\
-		for (int i = 0; i < maxchunks; i++) {\
-			res->chunks[i] = bigint_index_with_padding((a), i) op bigint_index_with_padding((b), i);\
-		}\
-		\
-		bigint_identify_pad_chunk_and_trim(res);\
-		return res;\
-	} while(0)
 
-struct bigint *bigint_and(const struct bigint *a, const struct bigint *b) {
-	BIGINT_BINOP(a, b, &);
+/* chunk j of src, or of |src| when negate, where carry starts at 1 and is updated since |src| = ~src + 1 */
+static unsigned long bigint_batch_chunk(const struct bigint *src, int j, int negate, unsigned long *carry) {
+	unsigned long chunk = bigint_index_with_padding(src, j);
+	if (negate) {
+		chunk = ~chunk + *carry;
+		*carry = *carry && chunk == 0;
+	}
+	return chunk;
 }
 
+int bigint_batch_set(unsigned long *a, size_t n, int nchunk, size_t i, const struct bigint *src, enum bigint_format format) {
+	if (a == NULL || src == NULL || nchunk < 1 || i >= n) {
+		return EINVAL;
+	}
 
-struct bigint *bigint_or(const struct bigint *a, const struct bigint *b) {
-	BIGINT_BINOP(a, b, |);
-}
-
+	int negate = format == BIGINT_MAGNITUDE && bigint_msb(src, -1) == 1;
+	int nsignificant = bigint_normalised_nchunk(src); // as short as two's complement gets
+	if (format == BIGINT_MAGNITUDE) {
+		unsigned long carry = 1;
+		nsignificant = 0;
+		for (int j = 0; j < src->nchunk; j++) {
+			if (bigint_batch_chunk(src, j, negate, &carry) != 0) {
+				nsignificant = j+1;
+			}
+		}
+	}
+	if (nsignificant > nchunk) {
+		return ERANGE;
+	}
 
-struct bigint *bigint_xor(const struct bigint *a, const struct bigint *b) {
-	BIGINT_BINOP(a, b, ^);
+	unsigned long carry = 1;
+	for (int j = 0; j < nchunk; j++) {
+		a[j*n + i] = bigint_batch_chunk(src, j, negate, &carry);
+	}
+	return 0;
 }
 
 
-void TestBigintBitwiseOperators(CuTest *tc) {
+void TestBigintBatch(CuTest *tc) {
 	enum {
-		NHEXSTRING=7,
-		RES_LEN = 32+1,
+		MAX_N = 33,
+		MAX_NCHUNK = 8,
 	};
-
+	unsigned long a[MAX_N*MAX_NCHUNK], b[MAX_N*MAX_NCHUNK], r[MAX_N*MAX_NCHUNK], carry[MAX_N];
+	int order[MAX_N];
+	struct bigint x = BIGINT_STATIC_INIT(x), y = BIGINT_STATIC_INIT(y), z = BIGINT_STATIC_INIT(z);
+	struct bigint *modulus = bigint_from_long(1);
+	const int nchunks[] = {1, 2, 3, 4, 8};
+	const size_t ns[] = {0, 1, 3, 4, 5, 8, 9, 17, 33};
+
+	srand(1337);
+	enum bigint_simd supported = bigint_simd_supported();
+	for (enum bigint_simd simd = BIGINT_SIMD_NONE; simd <= supported; simd++) {
+		bigint_simd_max = simd;
+		for (size_t k = 0; k < sizeof(nchunks)/sizeof(*nchunks); k++) {
+			int nchunk = nchunks[k];
+			CuAssertIntEquals(tc, 0, bigint_from_long_into(modulus, 1));
+			CuAssertIntEquals(tc, 0, bigint_shl_ul_into(modulus, modulus, nchunk*LONG_BIT));
+			for (size_t l = 0; l < sizeof(ns)/sizeof(*ns); l++) {
+				size_t n = ns[l];
+				random_chunks(a, n*nchunk);
+				random_chunks(b, n*nchunk);
+				// carries through every chunk, equal numbers and numbers that differ in the least significant chunk
+				for (size_t i = 0; i < n; i += 3) {
+					for (int j = 0; j < nchunk; j++) {
+						a[j*n + i] = i%2 == 0 ? ULONG_MAX : b[j*n + i];
+						b[j*n + i] = i%2 == 0 ? (j == 0) : b[j*n + i] + (j == 0 && i%4 == 1);
+					}
+				}
+
+				CuAssertIntEquals(tc, 0, bigint_batch_add(r, carry, a, b, n, nchunk));
+				for (size_t i = 0; i < n; i++) {
+					CuAssertIntEquals(tc, 0, bigint_batch_get_into(&x, a, n, nchunk, i, BIGINT_MAGNITUDE));
+					CuAssertIntEquals(tc, 0, bigint_batch_get_into(&y, b, n, nchunk, i, BIGINT_MAGNITUDE));
+					CuAssertIntEquals(tc, 0, bigint_add_into(&x, &x, &y));
+					CuAssertIntEquals(tc, 0, bigint_batch_get_into(&z, r, n, nchunk, i, BIGINT_MAGNITUDE));
+					CuAssertIntEquals(tc, carry[i], bigint_compare(&x, modulus) >= 0);
+					if (carry[i]) {
+						CuAssertIntEquals(tc, 0, bigint_subtract_into(&x, &x, modulus));
+					}
+					CuAssertIntEquals(tc, 0, bigint_compare(&x, &z));
+				}
+
+				memcpy(r, a, n*nchunk*sizeof(*r));
+				CuAssertIntEquals(tc, 0, bigint_batch_subtract(r, carry, r, b, n, nchunk));
+				for (size_t i = 0; i < n; i++) {
+					CuAssertIntEquals(tc, 0, bigint_batch_get_into(&x, a, n, nchunk, i, BIGINT_MAGNITUDE));
+					CuAssertIntEquals(tc, 0, bigint_batch_get_into(&y, b, n, nchunk, i, BIGINT_MAGNITUDE));
+					CuAssertIntEquals(tc, 0, bigint_subtract_into(&x, &x, &y));
+					CuAssertIntEquals(tc, 0, bigint_batch_get_into(&z, r, n, nchunk, i, BIGINT_MAGNITUDE));
+					CuAssertIntEquals(tc, carry[i], bigint_msb(&x, -1));
+					if (carry[i]) {
+						CuAssertIntEquals(tc, 0, bigint_add_into(&x, &x, modulus));
+					}
+					CuAssertIntEquals(tc, 0, bigint_compare(&x, &z));
+				}
+
+				const enum bigint_format formats[] = {BIGINT_MAGNITUDE, BIGINT_TWOS_COMPLEMENT};
+				for (size_t f = 0; f < sizeof(formats)/sizeof(*formats); f++) {
+					CuAssertIntEquals(tc, 0, bigint_batch_compare(order, a, b, n, nchunk, formats[f]));
+					for (size_t i = 0; i < n; i++) {
+						CuAssertIntEquals(tc, 0, bigint_batch_get_into(&x, a, n, nchunk, i, formats[f]));
+						CuAssertIntEquals(tc, 0, bigint_batch_get_into(&y, b, n, nchunk, i, formats[f]));
+						CuAssertIntEquals(tc, bigint_compare(&x, &y), order[i]);
+					}
+				}
+			}
+		}
+	}
+	bigint_simd_max = BIGINT_SIMD_AVX512;
+
+	// round trips, and values that do not fit
+	const long values[] = {0, 1, -1, LONG_MAX, LONG_MIN};
+	for (size_t i = 0; i < sizeof(values)/sizeof(*values); i++) {
+		CuAssertIntEquals(tc, 0, bigint_from_long_into(&x, values[i]));
+		CuAssertIntEquals(tc, 0, bigint_batch_set(a, 3, 2, 1, &x, BIGINT_TWOS_COMPLEMENT));
+		CuAssertIntEquals(tc, 0, bigint_batch_get_into(&y, a, 3, 2, 1, BIGINT_TWOS_COMPLEMENT));
+		CuAssertIntEquals(tc, 0, bigint_compare(&x, &y));
+		CuAssertIntEquals(tc, 0, bigint_batch_set(a, 3, 1, 2, &x, BIGINT_MAGNITUDE));
+		CuAssertIntEquals(tc, 0, bigint_batch_get_into(&y, a, 3, 1, 2, BIGINT_MAGNITUDE));
+		CuAssertIntEquals(tc, 0, bigint_abs_into(&x, &x));
+		CuAssertIntEquals(tc, 0, bigint_compare(&x, &y));
+	}
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&x, LONG_MIN));
+	CuAssertIntEquals(tc, 0, bigint_batch_set(a, 3, 1, 0, &x, BIGINT_TWOS_COMPLEMENT));
+	CuAssertIntEquals(tc, 0, bigint_shl_ul_into(&x, &x, 1)); // -2^64
+	CuAssertIntEquals(tc, ERANGE, bigint_batch_set(a, 3, 1, 0, &x, BIGINT_TWOS_COMPLEMENT));
+	CuAssertIntEquals(tc, ERANGE, bigint_batch_set(a, 3, 1, 0, &x, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, 0, bigint_batch_set(a, 3, 2, 0, &x, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, 0, bigint_negate_into(&x, &x));
+	CuAssertIntEquals(tc, 0, bigint_batch_get_into(&y, a, 3, 2, 0, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, 0, bigint_compare(&x, &y));
+	CuAssertIntEquals(tc, EINVAL, bigint_batch_get_into(&y, a, 3, 2, 3, BIGINT_MAGNITUDE));
+
+	bigint_clear(&x);
+	bigint_clear(&y);
+	bigint_clear(&z);
+	bigint_destroy(modulus);
+}
+void TestBigintBatchBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
 	enum {
-		A,
-		B,
-		NOT_A,
-		NOT_B,
-		A_AND_B,
-		A_OR_B,
-		A_XOR_B,
-	};
-	const char *hexstrings[] = {
-		"0000000000007fff0000000000007fff",
-		                "ffffffffffff1337",
-		"ffffffffffff8000ffffffffffff8000",
-		                "000000000000ecc8",
-		"0000000000007fff0000000000001337",
-		                "ffffffffffff7fff",
-		"ffffffffffff8000ffffffffffff6cc8",
+		N = 1 << 16,
+		NITERATION = 100,
 	};
+	const char *simd_names[] = {"scalar", "sse4.1", "avx2", "avx512"};
+
+	const int nchunks[] = {4, 8};
+	for (size_t k = 0; k < sizeof(nchunks)/sizeof(*nchunks); k++) {
+		int nchunk = nchunks[k];
+		unsigned long *a = malloc(3*N*nchunk * sizeof(*a)), *b = a + N*nchunk, *r = b + N*nchunk;
+		unsigned long *carry = malloc(N * sizeof(*carry));
+		int *order = malloc(N * sizeof(*order));
+		struct bigint *xs = malloc(3*N * sizeof(*xs)), *ys = xs + N, *zs = ys + N;
+		CuAssertPtrNotNull(tc, a);
+		CuAssertPtrNotNull(tc, carry);
+		CuAssertPtrNotNull(tc, order);
+		CuAssertPtrNotNull(tc, xs);
+		random_chunks(a, 2*N*nchunk);
+		for (size_t i = 0; i < N; i++) {
+			bigint_init_inline(&xs[i]);
+			bigint_init_inline(&ys[i]);
+			bigint_init_inline(&zs[i]);
+			bigint_batch_get_into(&xs[i], a, N, nchunk, i, BIGINT_MAGNITUDE);
+			bigint_batch_get_into(&ys[i], b, N, nchunk, i, BIGINT_MAGNITUDE);
+			bigint_reserve(&zs[i], nchunk+2);
+		}
 
-	struct bigint *bns[NHEXSTRING];
-	bns[A] = bigint_from_msb_first_hexstring(hexstrings[A], 0);
-	bns[B] = bigint_from_msb_first_hexstring(hexstrings[B], 0);
-	bns[NOT_A] = bigint_not(bns[A]);
-	bns[NOT_B] = bigint_not(bns[B]);
-	bns[A_AND_B] = bigint_and(bns[A], bns[B]);
-	bns[A_OR_B] = bigint_or(bns[A], bns[B]);
-	bns[A_XOR_B] = bigint_xor(bns[A], bns[B]);
+		char description[64];
+		snprintf(description, sizeof(description), "bigint_add_into %d numbers %d", N, nchunk);
+		TIMED_BLOCK(NITERATION, description) {
+			for (size_t i = 0; i < N; i++) {
+				bigint_add_into(&zs[i], &xs[i], &ys[i]);
+			}
+		}
+		snprintf(description, sizeof(description), "bigint_compare %d numbers %d", N, nchunk);
+		TIMED_BLOCK(NITERATION, description) {
+			for (size_t i = 0; i < N; i++) {
+				order[i] = bigint_compare(&xs[i], &ys[i]);
+			}
+		}
 
-	for (int i = 0; i < NHEXSTRING; i++) {
-		char res[RES_LEN];
-		CuAssertIntEquals(tc, strlen(hexstrings[i]), bigint_to_msb_first_hexstring(bns[i], res));
-		CuAssertStrEquals(tc, hexstrings[i], res);
-		bigint_destroy(bns[i]);
+		enum bigint_simd supported = bigint_simd_supported();
+		for (enum bigint_simd simd = BIGINT_SIMD_NONE; simd <= supported; simd++) {
+			bigint_simd_max = simd;
+			snprintf(description, sizeof(description), "%s bigint_batch_add %d numbers %d", simd_names[simd], N, nchunk);
+			TIMED_BLOCK(NITERATION, description) {
+				bigint_batch_add(r, carry, a, b, N, nchunk);
+			}
+			snprintf(description, sizeof(description), "%s bigint_batch_subtract %d numbers %d", simd_names[simd], N, nchunk);
+			TIMED_BLOCK(NITERATION, description) {
+				bigint_batch_subtract(r, carry, a, b, N, nchunk);
+			}
+			snprintf(description, sizeof(description), "%s bigint_batch_compare %d numbers %d", simd_names[simd], N, nchunk);
+			TIMED_BLOCK(NITERATION, description) {
+				bigint_batch_compare(order, a, b, N, nchunk, BIGINT_MAGNITUDE);
+			}
+		}
+		bigint_simd_max = BIGINT_SIMD_AVX512;
+
+		for (size_t i = 0; i < N; i++) {
+			bigint_clear(&xs[i]);
+			bigint_clear(&ys[i]);
+			bigint_clear(&zs[i]);
+		}
+		free(xs);
+		free(a);
+		free(carry);
+		free(order);
 	}
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
 }
 
 
-struct bigint *bigint_shift_left(const struct bigint *a, const struct bigint *b) {
-	if (a == NULL || b == NULL) {
-		return NULL;
-	}
+enum {
+	BIGINT_EXPR_PUSH = -1,
+	BIGINT_EXPR_SHL = -2,
+	BIGINT_EXPR_SHR = -3,
+};
 
-	if (bigint_msb(b, -1) == 1) {
-		struct bigint *minus_b = bigint_negate(b);
-		struct bigint *right_shifted_a = bigint_shift_right(a, minus_b);
+struct bigint_expr_step {
+	int op; // an enum bigint_expr_op, or one of the steps above
+	const struct bigint *operand; // BIGINT_EXPR_PUSH
+	unsigned long shift; // BIGINT_EXPR_SHL and BIGINT_EXPR_SHR
+};
 
-		bigint_destroy(minus_b);
-		return right_shifted_a;
-	}
+/* a value on the stack, an operand that is read in place or a two's complement number in the scratch */
+struct bigint_expr_value {
+	const struct bigint *operand; // NULL when the value is in the scratch
+	long offset;
+	long nchunk;
+};
 
-	if (b->nchunk > 1) {
-		return NULL; // left shift with more than ULONG_MAX would in most cases result in out of memory, so do not try
-	}
+struct bigint_expr {
+	struct bigint_expr_step *steps;
+	struct bigint_expr_value *stack; // as deep as there are steps
+	int nstep;
+	int nalloc;
+	int ndepth; // of the stack after the steps
+	unsigned long *scratch;
+	size_t nscratch;
+};
 
-	int npre_chunks = b->chunks[0]/LONG_BIT;
-	int non_chunk_shift = b->chunks[0]%LONG_BIT;
 
-	struct bigint *res = bigint_init(a->nchunk+npre_chunks + (non_chunk_shift != 0));
-	if (res == NULL) {
-		return NULL;
-	}
+struct bigint_expr *bigint_expr_create(void) {
+	return calloc(1, sizeof(struct bigint_expr));
+}
 
-	unsigned long carry = 0;
-	for (int i = 0; i < a->nchunk; i++) {
-		res->chunks[npre_chunks + i] = (a->chunks[i]<<non_chunk_shift) | carry;
-		carry = a->chunks[i] >> (LONG_BIT-non_chunk_shift);
-	}
-	res->chunks[npre_chunks+a->nchunk] = carry | (a->pad_chunk<<non_chunk_shift);
 
-	bigint_identify_pad_chunk_and_trim(res);
-	return res;
+void bigint_expr_destroy(struct bigint_expr *expr) {
+	if (expr != NULL) {
+		free(expr->steps);
+		free(expr->stack);
+		free(expr->scratch);
+		free(expr);
+	}
 }
 
 
-struct bigint *bigint_shift_right(const struct bigint *a, const struct bigint *b) {
-	if (a == NULL || b == NULL) {
-		return NULL;
+void bigint_expr_reset(struct bigint_expr *expr) {
+	if (expr != NULL) {
+		expr->nstep = 0;
+		expr->ndepth = 0;
 	}
+}
 
-	if (bigint_msb(b, -1) == 1) {
-		struct bigint *minus_b = bigint_negate(b);
-		struct bigint *left_shfted_a = bigint_shift_left(a, minus_b);
 
-		bigint_destroy(minus_b);
-		return left_shfted_a;
+static int bigint_expr_add_step(struct bigint_expr *expr, int op, const struct bigint *operand, unsigned long shift) {
+	if (expr->nstep == expr->nalloc) {
+		int nalloc = expr->nalloc > 0 ? 2*expr->nalloc : 8;
+		struct bigint_expr_step *steps = realloc(expr->steps, nalloc*sizeof(*steps));
+		if (steps == NULL) {
+			return ENOMEM;
+		}
+		expr->steps = steps;
+		struct bigint_expr_value *stack = realloc(expr->stack, nalloc*sizeof(*stack));
+		if (stack == NULL) {
+			return ENOMEM;
+		}
+		expr->stack = stack;
+		expr->nalloc = nalloc;
 	}
 
-	int removed_chunks = b->chunks[0]/LONG_BIT;
-	int non_chunk_shift = b->chunks[0]%LONG_BIT;
+	expr->steps[expr->nstep++] = (struct bigint_expr_step){.op = op, .operand = operand, .shift = shift};
+	expr->ndepth += op == BIGINT_EXPR_PUSH ? 1 : op == BIGINT_EXPR_NEGATE || op == BIGINT_EXPR_SHL || op == BIGINT_EXPR_SHR ? 0 : -1;
+	return 0;
+}
 
-	int shift_more_than_a = removed_chunks >= a->nchunk;
 
-	struct bigint *res = bigint_init(shift_more_than_a ? 1 : a->nchunk-removed_chunks);
-	if (res == NULL) {
-		return NULL;
+int bigint_expr_push(struct bigint_expr *expr, const struct bigint *n) {
+	if (expr == NULL || n == NULL) {
+		return EINVAL;
 	}
+	return bigint_expr_add_step(expr, BIGINT_EXPR_PUSH, n, 0);
+}
 
-	if (shift_more_than_a) {
-		res->chunks[0] = a->pad_chunk;
-	} else {
-		unsigned long carry = a->pad_chunk << (LONG_BIT-non_chunk_shift);
-		for (int i = a->nchunk-1; i >= removed_chunks; i--) {
-			res->chunks[i-removed_chunks] = (a->chunks[i]>>non_chunk_shift) | carry;
-			carry = a->chunks[i]<<(LONG_BIT-non_chunk_shift);
-		}
+
+int bigint_expr_apply(struct bigint_expr *expr, enum bigint_expr_op op) {
+	if (expr == NULL) {
+		return EINVAL;
 	}
 
-	bigint_identify_pad_chunk_and_trim(res);
-	return res;
+	switch (op) {
+	case BIGINT_EXPR_ADD:
+	case BIGINT_EXPR_SUBTRACT:
+	case BIGINT_EXPR_MULTIPLY:
+		if (expr->ndepth < 2) {
+			return EINVAL;
+		}
+		break;
+	case BIGINT_EXPR_NEGATE:
+		if (expr->ndepth < 1) {
+			return EINVAL;
+		}
+		break;
+	default:
+		return EINVAL;
+	}
+	return bigint_expr_add_step(expr, op, NULL, 0);
 }
 
 
-void TestBigintBitshift(CuTest *tc) {
-	enum {
-		NHEXSTRING = 9,
-		RES_LEN = 64+1,
-	};
-
-	enum {
-		A,
-		B,
-		MINUS_B,
-		A_LEFT_SHIFT_B,
-		A_RIGHT_SHIFT_MINUS_B,
-		A_RIGHT_SHIFT_B,
-		A_LEFT_SHIFT_MINUS_B,
-		C,
-		C_RIGHT_SHIFT_B,
-	};
-	const char *hexstrings[] = {
-		"bfffffffffffefffffffffffffffefff",
-		"0000000000000043",
-		"ffffffffffffffbd",
-		"fffffffffffffffdffffffffffff7fffffffffffffff7ff80000000000000000",
-		"fffffffffffffffdffffffffffff7fffffffffffffff7ff80000000000000000",
-		"f7fffffffffffdff",
-		"f7fffffffffffdff",
-		"8fffffffffffffff",
-		"ffffffffffffffff",
-	};
+int bigint_expr_shl(struct bigint_expr *expr, unsigned long shift) {
+	if (expr == NULL || expr->ndepth < 1) {
+		return EINVAL;
+	}
+	return bigint_expr_add_step(expr, BIGINT_EXPR_SHL, NULL, shift);
+}
 
-	struct bigint *bns[NHEXSTRING];
-	bns[A] = bigint_from_msb_first_hexstring(hexstrings[A],0);
-	bns[B] = bigint_from_msb_first_hexstring(hexstrings[B],0);
-	bns[MINUS_B] = bigint_negate(bns[B]);
-	bns[A_LEFT_SHIFT_B] = bigint_shift_left(bns[A], bns[B]);
-	bns[A_RIGHT_SHIFT_MINUS_B] = bigint_shift_right(bns[A], bns[MINUS_B]);
-	bns[A_RIGHT_SHIFT_B] = bigint_shift_right(bns[A], bns[B]);
-	bns[A_LEFT_SHIFT_MINUS_B] = bigint_shift_left(bns[A], bns[MINUS_B]);
-	bns[C] = bigint_from_msb_first_hexstring(hexstrings[C], 0);
-	bns[C_RIGHT_SHIFT_B] = bigint_shift_right(bns[C], bns[B]);
 
-	for (int i = 0; i < NHEXSTRING; i++) {
-		char res[RES_LEN];
-		CuAssertIntEquals(tc, strlen(hexstrings[i]), bigint_to_msb_first_hexstring(bns[i], res));
-		CuAssertStrEquals(tc, hexstrings[i], res);
-		bigint_destroy(bns[i]);
+int bigint_expr_shr(struct bigint_expr *expr, unsigned long shift) {
+	if (expr == NULL || expr->ndepth < 1) {
+		return EINVAL;
 	}
+	return bigint_expr_add_step(expr, BIGINT_EXPR_SHR, NULL, shift);
 }
 
 
-struct bigint *bigint_negate(const struct bigint *n) {
-	if (n == NULL) {
-		return NULL;
+/* the chunks and the pad chunk of a value */
+static const unsigned long *bigint_expr_chunks(const struct bigint_expr *expr, const struct bigint_expr_value *v, unsigned long *pad_chunk) {
+	if (v->operand != NULL) {
+		*pad_chunk = v->operand->pad_chunk;
+		return v->operand->chunks;
 	}
 
-	struct bigint *not_n = NULL, *minus_n = NULL;
+	const unsigned long *c = expr->scratch + v->offset;
+	*pad_chunk = pad_chunks[c[v->nchunk-1] >> LONG_MSB];
+	return c;
+}
 
-	not_n = bigint_not(n);
-	if (not_n == NULL) {
-		goto cleanup;
+/* the magnitude of a value for a product, in place for a value in the scratch, otherwise in buf */
+static const unsigned long *bigint_expr_magnitude(struct bigint_expr *expr, const struct bigint_expr_value *v, unsigned long *buf, int *negative) {
+	unsigned long pad_chunk;
+	const unsigned long *c = bigint_expr_chunks(expr, v, &pad_chunk);
+	if (!(*negative = pad_chunk != 0)) {
+		return c;
 	}
 
-	minus_n = bigint_add(not_n, &bigint_one);
-
-cleanup:
-	bigint_destroy(not_n);
-	return minus_n;
+	unsigned long *m = v->operand != NULL ? buf : expr->scratch + v->offset;
+	chunks_negate(m, c, v->nchunk);
+	return m;
 }
 
+/*
+ * the steps, over a stack of values. a result replaces its first operand on
+ * the stack, and goes in the scratch at the lowest offset of its operands,
+ * or on top of the scratch in use when they are both read in place, so the
+ * scratch is a stack as well. all but products are computed in place there,
+ * from the least significant chunk for sums and differences, which only
+ * overwrites chunks of the operands that were already read. the results are
+ * never trimmed, their number of chunks is enough for any value of the
+ * operands, with the sign in the most significant bit.
+ *
+ * when compute == 0 nothing is computed, only the size of the scratch that
+ * the steps need is stored in *nscratch. the numbers of chunks of the
+ * products are smaller when they are computed, but never larger, so the
+ * computation stays within that size.
+ *
+ * returns:
+ *   a result does not fit in INT_MAX chunks --> ERANGE
+ *   error --> errno
+ *   --> 0
+ */
+static int bigint_expr_run(struct bigint_expr *expr, int compute, size_t *nscratch) {
+	struct bigint_expr_value *stack = expr->stack;
+	unsigned long *s = expr->scratch;
+	int depth = 0;
+	long top = 0, peak = 0;
+
+	for (int i = 0; i < expr->nstep; i++) {
+		const struct bigint_expr_step *step = &expr->steps[i];
+		if (step->op == BIGINT_EXPR_PUSH) {
+			stack[depth++] = (struct bigint_expr_value){.operand = step->operand, .offset = -1, .nchunk = step->operand->nchunk};
+			continue;
+		}
 
-struct bigint *bigint_abs(const struct bigint *n) {
-	if (n == NULL) {
-		return NULL;
+		int binary = step->op == BIGINT_EXPR_ADD || step->op == BIGINT_EXPR_SUBTRACT || step->op == BIGINT_EXPR_MULTIPLY;
+		struct bigint_expr_value *x = &stack[depth-1-binary], *y = &stack[depth-1]; // x == y for the unary steps
+		long base = x->operand == NULL ? x->offset : binary && y->operand == NULL ? y->offset : top, at = base;
+		long nx = x->nchunk, ny = binary ? y->nchunk : 0, nchunk, need;
+		unsigned long nwhole = step->shift/LONG_BIT;
+		int nbit = step->shift%LONG_BIT;
+
+		switch (step->op) {
+		case BIGINT_EXPR_ADD:
+		case BIGINT_EXPR_SUBTRACT:
+			nchunk = (nx > ny ? nx : ny) + 1;
+			break;
+		case BIGINT_EXPR_MULTIPLY:
+			at = top; // not in place, the magnitudes of negative operands that are read in place go above
+			nchunk = nx + ny + 1;
+			break;
+		case BIGINT_EXPR_NEGATE:
+			nchunk = nx + 1;
+			break;
+		case BIGINT_EXPR_SHL:
+			if (nwhole > INT_MAX) {
+				return ERANGE;
+			}
+			nchunk = nx + (long)nwhole + 1;
+			break;
+		case BIGINT_EXPR_SHR:
+			nchunk = nwhole >= (unsigned long)nx ? 1 : nx - (long)nwhole;
+			break;
+		default:
+			assert(0);
+			return EINVAL;
+		}
+		if (nchunk > INT_MAX) {
+			return ERANGE;
+		}
+		need = at + nchunk + (step->op == BIGINT_EXPR_MULTIPLY ? nx + ny : 0);
+		peak = need > peak ? need : peak;
+
+		if (compute) {
+			unsigned long pad_x, pad_y, *r = s + at;
+			const unsigned long *cx, *cy;
+			switch (step->op) {
+			case BIGINT_EXPR_ADD:
+			case BIGINT_EXPR_SUBTRACT:
+				cx = bigint_expr_chunks(expr, x, &pad_x);
+				cy = bigint_expr_chunks(expr, y, &pad_y);
+				if (step->op == BIGINT_EXPR_ADD) {
+					chunks_add_padded(r, cx, nx, pad_x, cy, ny, pad_y, nchunk);
+				} else {
+					chunks_sub_padded(r, cx, nx, pad_x, cy, ny, pad_y, nchunk);
+				}
+				break;
+			case BIGINT_EXPR_MULTIPLY: {
+				int negative_x, negative_y;
+				const unsigned long *mx = bigint_expr_magnitude(expr, x, r+nchunk, &negative_x);
+				const unsigned long *my = bigint_expr_magnitude(expr, y, r+nchunk+nx, &negative_y);
+				int kx = chunks_significant(mx, nx), ky = chunks_significant(my, ny);
+				if (kx < ky) {
+					const unsigned long *tmp = mx;
+					mx = my;
+					my = tmp;
+					int ktmp = kx;
+					kx = ky;
+					ky = ktmp;
+				}
+
+				if (ky == 0) {
+					r[0] = 0;
+					nchunk = 1;
+					break;
+				}
+				int status = chunks_mul(r, mx, kx, my, ky);
+				if (status != 0) {
+					return status;
+				}
+				nchunk = kx + ky + 1;
+				r[nchunk-1] = 0;
+				if (negative_x != negative_y) {
+					chunks_negate(r, r, nchunk);
+				}
+				break;
+			}
+			case BIGINT_EXPR_NEGATE:
+				cx = bigint_expr_chunks(expr, x, &pad_x);
+				memmove(r, cx, nx*sizeof(*r));
+				r[nx] = pad_x;
+				chunks_negate(r, r, nchunk);
+				break;
+			case BIGINT_EXPR_SHL:
+				// from the most significant chunk, so that r may be x
+				cx = bigint_expr_chunks(expr, x, &pad_x);
+				if (nbit == 0) {
+					memmove(r+nwhole, cx, nx*sizeof(*r));
+					r[nchunk-1] = pad_x;
+				} else {
+					unsigned long carry = chunks_shift_left(r+nwhole, cx, nx, nbit);
+					r[nchunk-1] = (pad_x << nbit) | carry;
+				}
+				memset(r, 0, nwhole*sizeof(*r));
+				break;
+			case BIGINT_EXPR_SHR:
+				// from the least significant chunk, so that r may be x
+				cx = bigint_expr_chunks(expr, x, &pad_x);
+				if (nwhole >= (unsigned long)nx) {
+					r[0] = pad_x;
+				} else if (nbit == 0) {
+					memmove(r, cx+nwhole, nchunk*sizeof(*r));
+				} else {
+					chunks_shift_right(r, cx+nwhole, nchunk, nbit);
+					r[nchunk-1] |= pad_x << (LONG_BIT-nbit);
+				}
+				break;
+			default:
+				assert(0);
+			}
+
+			if (at != base) {
+				memmove(s+base, r, nchunk*sizeof(*r));
+			}
+		}
+
+		depth -= binary;
+		*x = (struct bigint_expr_value){.operand = NULL, .offset = base, .nchunk = nchunk};
+		top = base + nchunk;
 	}
 
-	return bigint_msb(n, -1) == 1 ? bigint_negate(n) : bigint_copy(n);
+	*nscratch = peak;
+	return 0;
 }
 
 
-struct bigint *bigint_add(const struct bigint *a, const struct bigint *b) {
-	if (a == NULL || b == NULL) {
-		return NULL;
+int bigint_expr_evaluate_into(struct bigint_expr *expr, struct bigint *dst) {
+	if (expr == NULL || dst == NULL || expr->ndepth != 1) {
+		return EINVAL;
 	}
 
-	int maxchunk = a->nchunk > b->nchunk ? a->nchunk : b->nchunk;
-	struct bigint *res = bigint_init(maxchunk);
-	if (res == NULL) {
-		return NULL;
+	size_t nscratch;
+	int status = bigint_expr_run(expr, 0, &nscratch);
+	if (status != 0) {
+		return status;
 	}
 
-	for (int i = 0, carry = 0; i < maxchunk; i++) {
-		unsigned long sum_of_all_but_msbs = (bigint_index_with_padding(a, i) & ~LONG_MSB_MASK) + (bigint_index_with_padding(b, i) & ~LONG_MSB_MASK) + carry;
-		unsigned long sum_of_msbs = bigint_msb(a, i) + bigint_msb(b, i) + (sum_of_all_but_msbs>>LONG_MSB);
+	if (nscratch > expr->nscratch) {
+		unsigned long *scratch = realloc(expr->scratch, nscratch*sizeof(*scratch));
+		if (scratch == NULL) {
+			return ENOMEM;
+		}
+		expr->scratch = scratch;
+		expr->nscratch = nscratch;
+	}
 
-		res->chunks[i] = (sum_of_all_but_msbs & ~LONG_MSB_MASK) | sum_of_msbs<<LONG_MSB;
-		carry = sum_of_msbs>>1;
+	if ((status = bigint_expr_run(expr, 1, &nscratch)) != 0) {
+		return status;
 	}
 
-	bigint_identify_pad_chunk_and_trim(res);
-	return res;
+	// the only normalisation, dst is trimmed once
+	const struct bigint_expr_value *v = &expr->stack[0];
+	if (v->operand != NULL) {
+		return bigint_copy_into(dst, v->operand);
+	}
+	return bigint_assign_chunks(dst, expr->scratch + v->offset, v->nchunk);
 }
+void TestBigint_expr(CuTest *tc) {
+	enum {
+		NOPERAND = 5,
+		MAX_NSTEP = 24,
+	};
+	struct bigint_expr *expr = bigint_expr_create();
+	CuAssertPtrNotNull(tc, expr);
+	struct bigint res = BIGINT_STATIC_INIT(res);
+
+	// random expressions against the operations one by one, on a stack of bigints
+	srand(1337);
+	for (int i = 0; i < 500; i++) {
+		struct bigint *operands[NOPERAND], *stack[MAX_NSTEP];
+		for (int j = 0; j < NOPERAND; j++) {
+			operands[j] = bigint_random_for_test(1 + rand()%(j < 2 ? 3 : 20));
+			CuAssertPtrNotNull(tc, operands[j]);
+		}
 
-struct bigint *bigint_subtract(const struct bigint *a, const struct bigint *b) {
-	if (a == NULL || b == NULL) {
-		return NULL;
-	}
+		bigint_expr_reset(expr);
+		int depth = 0, nstep = 1 + rand()%MAX_NSTEP;
+		for (int j = 0; j < nstep || depth != 1; j++) {
+			int op = depth < 2 || (j < nstep && rand()%3 == 0) ? -1 : rand()%6;
+			if (depth == 0 || (op == -1 && depth < MAX_NSTEP && j < nstep)) {
+				struct bigint *n = operands[rand()%NOPERAND];
+				CuAssertIntEquals(tc, 0, bigint_expr_push(expr, n));
+				stack[depth++] = bigint_copy(n);
+				continue;
+			}
+
+			struct bigint *x = stack[depth-2], *y = stack[depth-1], *r;
+			unsigned long shift = rand()%200;
+			switch (op < 0 ? 3 + rand()%3 : op) {
+			case 0:
+				CuAssertIntEquals(tc, 0, bigint_expr_apply(expr, BIGINT_EXPR_ADD));
+				r = bigint_add(x, y);
+				break;
+			case 1:
+				CuAssertIntEquals(tc, 0, bigint_expr_apply(expr, BIGINT_EXPR_SUBTRACT));
+				r = bigint_subtract(x, y);
+				break;
+			case 2:
+				CuAssertIntEquals(tc, 0, bigint_expr_apply(expr, BIGINT_EXPR_MULTIPLY));
+				r = bigint_multiply(x, y);
+				break;
+			case 3:
+				CuAssertIntEquals(tc, 0, bigint_expr_apply(expr, BIGINT_EXPR_NEGATE));
+				r = bigint_negate(y);
+				break;
+			case 4:
+				CuAssertIntEquals(tc, 0, bigint_expr_shl(expr, shift));
+				r = bigint_shl_ul(y, shift);
+				break;
+			default:
+				CuAssertIntEquals(tc, 0, bigint_expr_shr(expr, shift));
+				r = bigint_shr_ul(y, shift);
+				break;
+			}
+			CuAssertPtrNotNull(tc, r);
+
+			int binary = op >= 0 && op <= 2;
+			bigint_destroy(stack[depth-1]);
+			if (binary) {
+				bigint_destroy(stack[depth-2]);
+			}
+			depth -= binary;
+			stack[depth-1] = r;
+		}
 
-	struct bigint *minus_b = bigint_negate(b);
-	if (minus_b == NULL) {
-		return NULL;
-	}
+		CuAssertIntEquals(tc, 0, bigint_expr_evaluate_into(expr, &res));
+		CuAssertIntEquals(tc, 0, bigint_compare(stack[0], &res));
+		CuAssertIntEquals(tc, stack[0]->nchunk, res.nchunk); // trimmed
 
-	struct bigint *a_minus_b = bigint_add(a, minus_b);
+		// the result may be an operand
+		struct bigint *expected = stack[0];
+		CuAssertIntEquals(tc, 0, bigint_expr_evaluate_into(expr, operands[0]));
+		CuAssertIntEquals(tc, 0, bigint_compare(expected, operands[0]));
 
-	bigint_destroy(minus_b);
-	return a_minus_b;
+		bigint_destroy(expected);
+		for (int j = 0; j < NOPERAND; j++) {
+			bigint_destroy(operands[j]);
+		}
+	}
+
+	// a*b + c - (d << k), evaluated again when the operands change
+	struct bigint *a = bigint_from_long(6), *b = bigint_from_long(-7), *c = bigint_from_long(100), *d = bigint_from_long(3);
+	bigint_expr_reset(expr);
+	CuAssertIntEquals(tc, 0, bigint_expr_push(expr, a));
+	CuAssertIntEquals(tc, 0, bigint_expr_push(expr, b));
+	CuAssertIntEquals(tc, 0, bigint_expr_apply(expr, BIGINT_EXPR_MULTIPLY));
+	CuAssertIntEquals(tc, 0, bigint_expr_push(expr, c));
+	CuAssertIntEquals(tc, 0, bigint_expr_apply(expr, BIGINT_EXPR_ADD));
+	CuAssertIntEquals(tc, 0, bigint_expr_push(expr, d));
+	CuAssertIntEquals(tc, 0, bigint_expr_shl(expr, 4));
+	CuAssertIntEquals(tc, 0, bigint_expr_apply(expr, BIGINT_EXPR_SUBTRACT));
+	unsigned long result;
+	CuAssertIntEquals(tc, 0, bigint_expr_evaluate_into(expr, &res));
+	CuAssertIntEquals(tc, 0, bigint_to_long(&res, &result));
+	CuAssertIntEquals(tc, 6*-7 + 100 - (3 << 4), (long)result);
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(d, -1));
+	CuAssertIntEquals(tc, 0, bigint_expr_evaluate_into(expr, &res));
+	CuAssertIntEquals(tc, 0, bigint_to_long(&res, &result));
+	CuAssertIntEquals(tc, 6*-7 + 100 + 16, (long)result);
+
+	// the stack must hold the operands of each operation, and exactly one value when evaluated
+	CuAssertIntEquals(tc, 0, bigint_expr_push(expr, a));
+	CuAssertIntEquals(tc, EINVAL, bigint_expr_evaluate_into(expr, &res));
+	bigint_expr_reset(expr);
+	CuAssertIntEquals(tc, EINVAL, bigint_expr_evaluate_into(expr, &res));
+	CuAssertIntEquals(tc, EINVAL, bigint_expr_apply(expr, BIGINT_EXPR_NEGATE));
+	CuAssertIntEquals(tc, EINVAL, bigint_expr_shl(expr, 1));
+	CuAssertIntEquals(tc, 0, bigint_expr_push(expr, a));
+	CuAssertIntEquals(tc, EINVAL, bigint_expr_apply(expr, BIGINT_EXPR_ADD));
+	CuAssertIntEquals(tc, EINVAL, bigint_expr_apply(expr, (enum bigint_expr_op)-1));
+	CuAssertIntEquals(tc, 0, bigint_expr_evaluate_into(expr, &res));
+	CuAssertIntEquals(tc, 0, bigint_compare(a, &res));
+	CuAssertIntEquals(tc, 0, bigint_expr_shl(expr, ULONG_MAX));
+	CuAssertIntEquals(tc, ERANGE, bigint_expr_evaluate_into(expr, &res));
+	CuAssertIntEquals(tc, 0, bigint_compare(a, &res));
+
+	bigint_destroy(a);
+	bigint_destroy(b);
+	bigint_destroy(c);
+	bigint_destroy(d);
+	bigint_clear(&res);
+	bigint_expr_destroy(expr);
 }
 
 
-void TestBigintArithmeticOperators(CuTest *tc) {
+void TestBigintExprBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
 	enum {
-		NHEXSTRING = 10,
-		RES_LEN = 32+1,
+		NITERATION = 10000,
 	};
 
-	enum {
-		A,
-		B,
-		MINUS_A,
-		MINUS_B,
-		ABS_A,
-		ABS_MINUS_A,
-		ABS_B,
-		ABS_MINUS_B,
-		A_ADD_B,
-		A_MINUS_B,
-	};
-	const char *hexstrings[] = {
-		"00000000000000010000000000000000",
-		"ffffffffffffffff",
-		"ffffffffffffffff0000000000000000",
-		"0000000000000001",
-		"00000000000000010000000000000000",
-		"00000000000000010000000000000000",
-		"0000000000000001",
-		"0000000000000001",
-		"0000000000000000ffffffffffffffff",
-		"00000000000000010000000000000001",
-	};
+	srand(1337);
+	const int nchunks[] = {2, 8, 32, 128};
+	for (size_t i = 0; i < sizeof(nchunks)/sizeof(*nchunks); i++) {
+		struct bigint *a = bigint_random_for_test(nchunks[i]), *b = bigint_random_for_test(nchunks[i]);
+		struct bigint *c = bigint_random_for_test(2*nchunks[i]), *d = bigint_random_for_test(nchunks[i]);
+		struct bigint res = BIGINT_STATIC_INIT(res), product = BIGINT_STATIC_INIT(product), shifted = BIGINT_STATIC_INIT(shifted);
+		struct bigint_expr *expr = bigint_expr_create();
+		CuAssertPtrNotNull(tc, expr);
+		CuAssertIntEquals(tc, 0, bigint_expr_push(expr, a));
+		CuAssertIntEquals(tc, 0, bigint_expr_push(expr, b));
+		CuAssertIntEquals(tc, 0, bigint_expr_apply(expr, BIGINT_EXPR_MULTIPLY));
+		CuAssertIntEquals(tc, 0, bigint_expr_push(expr, c));
+		CuAssertIntEquals(tc, 0, bigint_expr_apply(expr, BIGINT_EXPR_ADD));
+		CuAssertIntEquals(tc, 0, bigint_expr_push(expr, d));
+		CuAssertIntEquals(tc, 0, bigint_expr_shl(expr, 77));
+		CuAssertIntEquals(tc, 0, bigint_expr_apply(expr, BIGINT_EXPR_SUBTRACT));
+
+		char description[64];
+		snprintf(description, sizeof(description), "a*b + c - (d << k) allocating %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			struct bigint *ab = bigint_multiply(a, b), *sum = bigint_add(ab, c), *dk = bigint_shl_ul(d, 77);
+			bigint_destroy(bigint_subtract(sum, dk));
+			bigint_destroy(ab);
+			bigint_destroy(sum);
+			bigint_destroy(dk);
+		}
+		snprintf(description, sizeof(description), "a*b + c - (d << k) _into %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_multiply_into(&product, a, b);
+			bigint_add_into(&res, &product, c);
+			bigint_shl_ul_into(&shifted, d, 77);
+			bigint_subtract_into(&res, &res, &shifted);
+		}
+		snprintf(description, sizeof(description), "a*b + c - (d << k) expr %d", nchunks[i]);
+		TIMED_BLOCK(NITERATION, description) {
+			bigint_expr_evaluate_into(expr, &res);
+		}
 
-	struct bigint *bns[NHEXSTRING];
-	bns[A] = bigint_from_msb_first_hexstring(hexstrings[A], 0);
-	bns[B] = bigint_from_msb_first_hexstring(hexstrings[B], 0);
-	bns[MINUS_A] = bigint_negate(bns[A]);
-	bns[MINUS_B] = bigint_negate(bns[B]);
-	bns[ABS_A] = bigint_abs(bns[A]);
-	bns[ABS_MINUS_A] = bigint_abs(bns[MINUS_A]);
-	bns[ABS_B] = bigint_abs(bns[B]);
-	bns[ABS_MINUS_B] = bigint_abs(bns[MINUS_B]);
-	bns[A_ADD_B] = bigint_add(bns[A], bns[B]);
-	bns[A_MINUS_B] = bigint_subtract(bns[A], bns[B]);
+		bigint_expr_destroy(expr);
+		bigint_clear(&res);
+		bigint_clear(&product);
+		bigint_clear(&shifted);
+		bigint_destroy(a);
+		bigint_destroy(b);
+		bigint_destroy(c);
+		bigint_destroy(d);
+	}
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
 
-	for (int i = 0; i < NHEXSTRING; i++) {
-		char res[RES_LEN];
-		CuAssertIntEquals(tc, strlen(hexstrings[i]), bigint_to_msb_first_hexstring(bns[i], res));
-		CuAssertStrEquals(tc, hexstrings[i], res);
-		bigint_destroy(bns[i]);
+
+/* dst = n with nextra redundant chunks on top, and results into dst deferred */
+static int bigint_unnormalised_for_test(struct bigint *dst, const struct bigint *n, int nextra) {
+	bigint_defer_normalisation(dst, 1);
+	if (bigint_copy_into(dst, n) != 0 || bigint_reserve(dst, dst->nchunk + nextra) != 0) {
+		return ENOMEM;
+	}
+	for (int i = 0; i < nextra; i++) {
+		dst->chunks[dst->nchunk++] = dst->pad_chunk;
+	}
+	return 0;
+}
+void TestBigintDeferredNormalisation(CuTest *tc) {
+	struct bigint sum = BIGINT_STATIC_INIT(sum), x = BIGINT_STATIC_INIT(x), y = BIGINT_STATIC_INIT(y);
+	struct bigint expected = BIGINT_STATIC_INIT(expected), actual = BIGINT_STATIC_INIT(actual);
+	struct bigint q = BIGINT_STATIC_INIT(q), r = BIGINT_STATIC_INIT(r);
+
+	// a long chain of sums neither grows nor trims the result
+	bigint_defer_normalisation(&sum, 1);
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&x, 1000));
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&y, -999));
+	for (int i = 0; i < 1000; i++) {
+		CuAssertIntEquals(tc, 0, bigint_add_into(&sum, &sum, i%2 ? &x : &y));
+		CuAssertTrue(tc, sum.nchunk <= 2);
 	}
+	unsigned long result;
+	CuAssertIntEquals(tc, 0, bigint_to_long(&sum, &result));
+	CuAssertIntEquals(tc, 500, result);
+	bigint_normalise(&sum);
+	CuAssertIntEquals(tc, 1, sum.nchunk);
+	CuAssertIntEquals(tc, 1, sum.unnormalised);
+	bigint_clear(&sum);
+	CuAssertIntEquals(tc, 0, sum.unnormalised);
+
+	// unnormalised operands give the same results as normalised ones
+	srand(1337);
+	for (int i = 0; i < 200; i++) {
+		struct bigint *a = bigint_random_for_test(1 + rand()%6), *b = bigint_random_for_test(1 + rand()%4);
+		CuAssertPtrNotNull(tc, a);
+		CuAssertPtrNotNull(tc, b);
+		CuAssertIntEquals(tc, 0, bigint_unnormalised_for_test(&x, a, 1 + rand()%3));
+		CuAssertIntEquals(tc, 0, bigint_unnormalised_for_test(&y, b, 1 + rand()%3));
+		CuAssertTrue(tc, x.nchunk > a->nchunk);
+
+		CuAssertIntEquals(tc, 0, bigint_compare(a, &x));
+		CuAssertIntEquals(tc, bigint_compare(a, b), bigint_compare(&x, &y));
+		CuAssertIntEquals(tc, bigint_compare(b, a), bigint_compare(&y, a));
+		unsigned long la, lx;
+		CuAssertIntEquals(tc, bigint_to_long(a, &la), bigint_to_long(&x, &lx));
+		CuAssertIntEquals(tc, la, lx);
+
+		unsigned char bytes_a[128], bytes_x[128];
+		const enum bigint_format formats[] = {BIGINT_MAGNITUDE, BIGINT_TWOS_COMPLEMENT};
+		for (size_t j = 0; j < sizeof(formats)/sizeof(*formats); j++) {
+			size_t count = bigint_export_count(a, 1, formats[j]);
+			CuAssertIntEquals(tc, count, bigint_export_count(&x, 1, formats[j]));
+			memset(bytes_x, 0x5a, sizeof(bytes_x));
+			CuAssertIntEquals(tc, 0, bigint_export(a, bytes_a, count, -1, 1, 0, formats[j]));
+			CuAssertIntEquals(tc, 0, bigint_export(&x, bytes_x, count, -1, 1, 0, formats[j]));
+			CuAssertTrue(tc, memcmp(bytes_a, bytes_x, count) == 0);
+			if (count > 0) {
+				CuAssertIntEquals(tc, ERANGE, bigint_export(&x, bytes_x, count-1, -1, 1, 0, formats[j]));
+			}
+		}
+
+		char hex_a[256], hex_x[256];
+		CuAssertIntEquals(tc, bigint_nnibble(a), bigint_nnibble(&x));
+		CuAssertIntEquals(tc, bigint_to_msb_first_hexstring(a, hex_a), bigint_to_msb_first_hexstring(&x, hex_x));
+		CuAssertStrEquals(tc, hex_a, hex_x);
+		CuAssertIntEquals(tc, bigint_nbasechar(a, 10), bigint_nbasechar(&x, 10));
+		CuAssertIntEquals(tc, bigint_to_decimal(a, hex_a), bigint_to_decimal(&x, hex_x));
+		CuAssertStrEquals(tc, hex_a, hex_x);
+
+		// into normalised and deferred results, which only differ in their chunks on top
+		const int ops[] = {OPERATOR_NOT, OPERATOR_AND, OPERATOR_OR, OPERATOR_XOR, OPERATOR_NEGATE, OPERATOR_ABS, OPERATOR_ADD, OPERATOR_SUBTRACT, OPERATOR_MULTIPLY, OPERATOR_SQUARE};
+		for (size_t j = 0; j < sizeof(ops)/sizeof(*ops); j++) {
+			bigint_defer_normalisation(&actual, j%2);
+			CuAssertIntEquals(tc, 0, bigint_operator_into_for_test(ops[j], &expected, a, b));
+			CuAssertIntEquals(tc, 0, bigint_operator_into_for_test(ops[j], &actual, &x, &y));
+			CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+			if (j%2 == 0) {
+				CuAssertIntEquals(tc, expected.nchunk, actual.nchunk);
+			}
+		}
+		int status = bigint_divmod_into(&q, &r, a, b);
+		CuAssertIntEquals(tc, status, bigint_divmod_into(&expected, &actual, &x, &y));
+		if (status == 0) {
+			CuAssertIntEquals(tc, 0, bigint_compare(&q, &expected));
+			CuAssertIntEquals(tc, 0, bigint_compare(&r, &actual));
+		}
+		CuAssertIntEquals(tc, 0, bigint_gcd_into(&expected, a, b));
+		CuAssertIntEquals(tc, 0, bigint_gcd_into(&actual, &x, &y));
+		CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+
+		CuAssertIntEquals(tc, bigint_is_probable_prime(a, 0, 1), bigint_is_probable_prime(&x, 0, 1));
+		unsigned long batch_a[4] = {0}, batch_x[4] = {0};
+		CuAssertIntEquals(tc, bigint_batch_set(batch_a, 1, 4, 0, a, BIGINT_TWOS_COMPLEMENT), bigint_batch_set(batch_x, 1, 4, 0, &x, BIGINT_TWOS_COMPLEMENT));
+		CuAssertTrue(tc, memcmp(batch_a, batch_x, sizeof(batch_a)) == 0);
+
+		// the copy of an unnormalised bigint into a normalised one is normalised
+		CuAssertIntEquals(tc, 0, bigint_copy_into(&expected, &x));
+		CuAssertIntEquals(tc, a->nchunk, expected.nchunk);
+		bigint_defer_normalisation(&x, 0);
+		CuAssertIntEquals(tc, a->nchunk, x.nchunk);
+		CuAssertIntEquals(tc, 0, x.unnormalised);
+
+		bigint_destroy(a);
+		bigint_destroy(b);
+	}
+
+	// a shift count and a zero divisor with redundant chunks
+	struct bigint *one = bigint_from_long(1), *sixteen = bigint_from_long(16);
+	CuAssertIntEquals(tc, 0, bigint_unnormalised_for_test(&y, sixteen, 2));
+	CuAssertIntEquals(tc, 0, bigint_shift_left_into(&x, one, &y));
+	CuAssertIntEquals(tc, 0, bigint_to_long(&x, &result));
+	CuAssertIntEquals(tc, 1 << 16, result);
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&x, 0));
+	CuAssertIntEquals(tc, 0, bigint_unnormalised_for_test(&y, &x, 2));
+	CuAssertIntEquals(tc, 0, bigint_extended_gcd_into(&expected, &actual, &q, sixteen, &y));
+	CuAssertIntEquals(tc, 0, bigint_compare(sixteen, &expected));
+	CuAssertIntEquals(tc, 0, bigint_compare(&x, &q));
+
+	bigint_destroy(one);
+	bigint_destroy(sixteen);
+	bigint_clear(&x);
+	bigint_clear(&y);
+	bigint_clear(&expected);
+	bigint_clear(&actual);
+	bigint_clear(&q);
+	bigint_clear(&r);
 }
 
 
@@ -828,6 +8185,18 @@ void TestBigintErroneousInput(CuTest *tc) {
 	CuAssertIntEquals(tc, -EINVAL, bigint_to_msb_first_hexstring(multi_chunk_n, NULL));
 	CuAssertIntEquals(tc, -EINVAL, bigint_to_msb_first_hexstring(NULL, some_string));
 
+	CuAssertIntEquals(tc, -EINVAL, bigint_bit_length(NULL));
+	CuAssertIntEquals(tc, -EINVAL, bigint_popcount(NULL));
+	CuAssertIntEquals(tc, -EINVAL, bigint_ctz(NULL));
+	CuAssertIntEquals(tc, -EINVAL, bigint_test_bit(NULL, 0));
+	CuAssertIntEquals(tc, EINVAL, bigint_set_bit(NULL, 0, 1));
+	CuAssertIntEquals(tc, EINVAL, bigint_get_bits(NULL, 0, 1, &some_long));
+	CuAssertIntEquals(tc, EINVAL, bigint_get_bits(single_chunk_n, 0, 1, NULL));
+	CuAssertIntEquals(tc, EINVAL, bigint_get_bits(single_chunk_n, 0, -1, &some_long));
+	CuAssertIntEquals(tc, EINVAL, bigint_extract_bits_into(NULL, single_chunk_n, 0, 1));
+	CuAssertIntEquals(tc, EINVAL, bigint_extract_bits_into(multi_chunk_n, NULL, 0, 1));
+	CuAssertPtrEquals(tc, NULL, bigint_extract_bits(NULL, 0, 1));
+
 	CuAssertPtrEquals(tc, NULL, bigint_not(NULL));
 
 	CuAssertPtrEquals(tc, NULL, bigint_and(NULL, NULL));
@@ -863,6 +8232,59 @@ void TestBigintErroneousInput(CuTest *tc) {
 	CuAssertPtrEquals(tc, NULL, bigint_subtract(NULL, single_chunk_n));
 	CuAssertPtrEquals(tc, NULL, bigint_subtract(NULL, multi_chunk_n));
 
+	CuAssertPtrEquals(tc, NULL, bigint_multiply(NULL, NULL));
+	CuAssertPtrEquals(tc, NULL, bigint_multiply(single_chunk_n, NULL));
+	CuAssertPtrEquals(tc, NULL, bigint_multiply(NULL, multi_chunk_n));
+	CuAssertPtrEquals(tc, NULL, bigint_square(NULL));
+
+	CuAssertIntEquals(tc, EINVAL, bigint_divmod(NULL, NULL, NULL, NULL));
+	CuAssertIntEquals(tc, EINVAL, bigint_divmod(single_chunk_n, NULL, NULL, NULL));
+	CuAssertIntEquals(tc, EINVAL, bigint_divmod(NULL, multi_chunk_n, NULL, NULL));
+	CuAssertPtrEquals(tc, NULL, bigint_divide(NULL, multi_chunk_n));
+	CuAssertPtrEquals(tc, NULL, bigint_modulo(single_chunk_n, NULL));
+
+	CuAssertIntEquals(tc, EINVAL, bigint_copy_into(NULL, single_chunk_n));
+	CuAssertIntEquals(tc, EINVAL, bigint_copy_into(multi_chunk_n, NULL));
+	CuAssertIntEquals(tc, EINVAL, bigint_from_long_into(NULL, some_long));
+	CuAssertIntEquals(tc, EINVAL, bigint_not_into(NULL, single_chunk_n));
+	CuAssertIntEquals(tc, EINVAL, bigint_and_into(multi_chunk_n, single_chunk_n, NULL));
+	CuAssertIntEquals(tc, EINVAL, bigint_shift_left_into(NULL, single_chunk_n, single_chunk_n));
+	CuAssertIntEquals(tc, EINVAL, bigint_shl_ul_into(NULL, single_chunk_n, 1));
+	CuAssertIntEquals(tc, EINVAL, bigint_shr_ul_into(multi_chunk_n, NULL, 1));
+	CuAssertPtrEquals(tc, NULL, bigint_shl_ul(NULL, 1));
+	CuAssertPtrEquals(tc, NULL, bigint_import(NULL, 1, 1, 1, 0, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, EINVAL, bigint_import_into(NULL, &some_long, 1, 1, 1, 0, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, EINVAL, bigint_export(NULL, &some_long, 1, 1, 1, 0, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, 0, bigint_export_count(NULL, 1, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, EINVAL, bigint_negate_into(multi_chunk_n, NULL));
+	CuAssertIntEquals(tc, EINVAL, bigint_add_into(NULL, single_chunk_n, multi_chunk_n));
+	CuAssertIntEquals(tc, EINVAL, bigint_subtract_into(multi_chunk_n, NULL, single_chunk_n));
+	CuAssertIntEquals(tc, EINVAL, bigint_multiply_into(NULL, single_chunk_n, multi_chunk_n));
+	CuAssertIntEquals(tc, EINVAL, bigint_divmod_into(NULL, NULL, single_chunk_n, NULL));
+	CuAssertIntEquals(tc, EINVAL, bigint_divmod_into(multi_chunk_n, multi_chunk_n, single_chunk_n, single_chunk_n));
+
+	CuAssertPtrEquals(tc, NULL, bigint_barrett_init(NULL));
+	CuAssertPtrEquals(tc, NULL, bigint_barrett_init(single_chunk_n));
+	CuAssertPtrEquals(tc, NULL, bigint_barrett_reduce(NULL, multi_chunk_n));
+	CuAssertPtrEquals(tc, NULL, bigint_montgomery_init(NULL));
+	CuAssertPtrEquals(tc, NULL, bigint_montgomery_init(single_chunk_n));
+	CuAssertPtrEquals(tc, NULL, bigint_montgomery_reduce(NULL, multi_chunk_n));
+	CuAssertPtrEquals(tc, NULL, bigint_to_montgomery(NULL, multi_chunk_n));
+	CuAssertPtrEquals(tc, NULL, bigint_from_montgomery(NULL, multi_chunk_n));
+	CuAssertPtrEquals(tc, NULL, bigint_montgomery_multiply(NULL, multi_chunk_n, multi_chunk_n));
+
+	CuAssertPtrEquals(tc, NULL, bigint_gcd(NULL, multi_chunk_n));
+	CuAssertIntEquals(tc, EINVAL, bigint_gcd_into(NULL, single_chunk_n, multi_chunk_n));
+	CuAssertIntEquals(tc, EINVAL, bigint_extended_gcd_into(NULL, NULL, NULL, single_chunk_n, NULL));
+	CuAssertIntEquals(tc, EINVAL, bigint_random_into(NULL, 1, NULL));
+	CuAssertIntEquals(tc, -EINVAL, bigint_is_probable_prime(NULL, 0, 1));
+	CuAssertIntEquals(tc, EINVAL, bigint_batch_add(NULL, NULL, &some_long, &some_long, 1, 1));
+	CuAssertIntEquals(tc, EINVAL, bigint_batch_compare(NULL, &some_long, &some_long, 1, 1, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, EINVAL, bigint_batch_set(&some_long, 1, 1, 0, NULL, BIGINT_MAGNITUDE));
+	CuAssertIntEquals(tc, EINVAL, bigint_expr_push(NULL, single_chunk_n));
+	CuAssertIntEquals(tc, EINVAL, bigint_expr_apply(NULL, BIGINT_EXPR_ADD));
+	CuAssertIntEquals(tc, EINVAL, bigint_expr_evaluate_into(NULL, multi_chunk_n));
+
 
 	bigint_destroy(single_chunk_n);
 	bigint_destroy(multi_chunk_n);
@@ -1,16 +1,89 @@
 #ifndef BIGINT_H_
 #define BIGINT_H_
+#include <stdint.h>
 #include <stdlib.h>
 
-struct bigint;
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * the members are private, the struct is only public so that bigints can be
+ * allocated by the caller (e.g. on the stack). values of up to
+ * BIGINT_INLINE_NCHUNK chunks are stored inside the struct, so arithmetic on
+ * them with the *_into functions does not touch the heap.
+ *
+ * WARNING: chunks may point into the struct itself, so a bigint must not be
+ * copied by assignment, use bigint_copy_into instead.
+ */
+#define BIGINT_INLINE_NCHUNK 2
+struct bigint {
+	int nchunk;
+	int nalloc;
+	int unnormalised; // see bigint_defer_normalisation
+	unsigned long pad_chunk;
+	unsigned long *chunks;
+	unsigned long inline_chunks[BIGINT_INLINE_NCHUNK];
+};
+#define BIGINT_STATIC_INIT(n) {\
+	.nchunk = 1,\
+	.nalloc = BIGINT_INLINE_NCHUNK,\
+	.unnormalised = 0,\
+	.pad_chunk = 0,\
+	.chunks = (n).inline_chunks,\
+	.inline_chunks = {0},\
+}
+
+
+/*
+ * caller allocated bigint initializer. it sets n to 0, like
+ * BIGINT_STATIC_INIT.
+ */
+extern void bigint_init_inline(struct bigint *n);
+
+/*
+ * caller allocated bigint destroyer. it frees the chunks that did not fit
+ * inline, and sets n to 0 so that it may be reused. if n == NULL it does
+ * nothing.
+ */
+extern void bigint_clear(struct bigint *n);
+
+
+/*
+ * deferred normalisation. the results of operations are trimmed to the
+ * fewest chunks that hold them, which rescans the most significant chunks
+ * of every result. when defer is set, results stored into n skip that: at
+ * most one redundant chunk is dropped, so that chains of sums do not grow,
+ * and the value is trimmed for good by bigint_normalise, or when the mode
+ * is turned off again. the mode belongs to n as a destination and is reset
+ * by bigint_clear.
+ *
+ * unnormalised bigints are valid operands for all functions here, and
+ * compare, convert and export exactly like normalised ones. if n == NULL
+ * they do nothing.
+ */
+extern void bigint_defer_normalisation(struct bigint *n, int defer);
+extern void bigint_normalise(struct bigint *n);
 
 
 /*
- * bigint destructor. if n == NULL it does nothing.
+ * bigint destructor, for bigints returned by this library. if n == NULL it
+ * does nothing.
  */
 extern void bigint_destroy(struct bigint *n);
 
 
+/*
+ * create a bigint with the value 0 and room for nchunk chunks, to be used as
+ * destination for the *_into functions below.
+ *
+ * returns:
+ *   error --> NULL
+ *   --> *(new bigint)
+ */
+extern struct bigint *bigint_with_capacity(int nchunk);
+
+
 /*
  * make a copy of a bigint.
  *
@@ -43,6 +116,78 @@ extern struct bigint *bigint_from_long(unsigned long n);
 extern int bigint_to_long(const struct bigint *n, unsigned long *result);
 
 
+/*
+ * binary import and export, like mpz_import/mpz_export. the value is count
+ * words of size bytes at data:
+ *   order: 1 --> the most significant word first, -1 --> the least
+ *   endian: 1 --> the most significant byte of each word first, -1 --> the
+ *     least, 0 --> the byte order of the host
+ *
+ * so a little endian byte blob is order == -1, size == 1, and for those
+ * layouts that match the chunks of the host the bytes are copied as a whole.
+ */
+enum bigint_format {
+	BIGINT_MAGNITUDE, // an unsigned value, export stores |n|
+	BIGINT_TWOS_COMPLEMENT, // the most significant bit is the sign bit
+};
+
+/*
+ * returns:
+ *   data == NULL && count > 0 || invalid order, size or endian --> NULL
+ *   error --> NULL
+ *   --> *(new bigint)
+ */
+extern struct bigint *bigint_import(const void *data, size_t count, int order, size_t size, int endian, enum bigint_format format);
+
+/*
+ * bigint_import into an existing bigint, see the *_into functions below.
+ *
+ * returns:
+ *   dst == NULL || data == NULL && count > 0 || invalid order, size or endian --> EINVAL
+ *   count*size bytes do not fit in a bigint --> ERANGE
+ *   error --> errno
+ *   --> 0
+ */
+extern int bigint_import_into(struct bigint *dst, const void *data, size_t count, int order, size_t size, int endian, enum bigint_format format);
+
+/*
+ * the number of words of size bytes needed to export n, which is 0 for a
+ * magnitude of 0.
+ *
+ * returns:
+ *   n == NULL || size == 0 --> 0
+ *   --> count
+ */
+extern size_t bigint_export_count(const struct bigint *n, size_t size, enum bigint_format format);
+
+/*
+ * export n into exactly count words at data, the words above the value are
+ * filled with 0 or, for negative two's complement values, with 0xff bytes.
+ *
+ * returns:
+ *   n == NULL || data == NULL && count > 0 || invalid order, size or endian --> EINVAL
+ *   n does not fit into count words --> ERANGE, and data is not touched
+ *   error --> errno
+ *   --> 0
+ */
+extern int bigint_export(const struct bigint *n, void *data, size_t count, int order, size_t size, int endian, enum bigint_format format);
+
+
+/*
+ * a read-only bigint over nchunk chunks owned by the caller, which are two's
+ * complement, least significant first and aligned like unsigned long, i.e.
+ * the same as the chunks of a bigint. nothing is copied, so the view is only
+ * valid as long as chunks is, and it may only be used as an operand: never as
+ * the dst of a *_into function, nor with bigint_clear or bigint_destroy.
+ * unsigned values whose most significant bit is set need a 0 chunk on top.
+ *
+ * returns:
+ *   view == NULL || chunks == NULL || nchunk < 1 || chunks is misaligned --> NULL
+ *   --> view
+ */
+extern const struct bigint *bigint_view(struct bigint *view, const unsigned long *chunks, int nchunk);
+
+
 /*
  * this is the charset used for strings of hexadecimal characters (aka.
  * hexstrings). it is {0..9}{a..z}, and the charset is stored so that
@@ -56,10 +201,12 @@ extern const char *bigint_hex_charset;
  * most significant bit first. the result is stored in s.
  *
  * ns is the length of s (excluding null character), if ns == 0 strlen(s) is
- * used instead.
+ * used instead. the most significant bit of the first character is the sign
+ * bit.
  *
  * returns:
  *   s == NULL --> NULL
+ *   s[0..ns) has a character that is not in bigint_hex_charset --> NULL
  *   error --> NULL
  *   --> *(new bigint)
  */
@@ -89,6 +236,58 @@ extern int bigint_nnibble(const struct bigint *n);
 extern int bigint_to_msb_first_hexstring(const struct bigint *n, char *s);
 
 
+/*
+ * create a bigint from a string of digits in base 2..36, using the
+ * characters in basestring_alphabet from dmath.h, with an optional leading
+ * '-'. bigint_from_decimal is the same with base 10.
+ *
+ * ns is the length of s (excluding null character), if ns == 0 strlen(s) is
+ * used instead.
+ *
+ * returns:
+ *   s == NULL --> NULL
+ *   base < 2 || base > 36 --> NULL
+ *   s is not a number in base --> NULL
+ *   error --> NULL
+ *   --> *(new bigint)
+ */
+extern struct bigint *bigint_from_basestring(const char *s, size_t ns, int base);
+extern struct bigint *bigint_from_decimal(const char *s, size_t ns);
+
+
+/*
+ * number of characters needed for n as a string in base, excluding the
+ * null character. this is an upper bound, the string may be a few
+ * characters shorter.
+ *
+ * returns:
+ *   n == NULL --> -EINVAL
+ *   base < 2 || base > 36 --> -ERANGE
+ *   --> upper bound of strlen(s) from bigint_to_basestring
+ */
+extern int bigint_nbasechar(const struct bigint *n, int base);
+
+
+/*
+ * convert a bigint into a string of digits in base 2..36, with a leading '-'
+ * when negative and without leading zeros. the resulting string is put into
+ * s, which must have room for bigint_nbasechar(n, base)+1 characters.
+ * bigint_to_decimal is the same with base 10.
+ *
+ * this is divide-and-conquer over powers of the base, so that it is
+ * subquadratic for large numbers, see BIGINT_BASESTRING_THRESHOLD in
+ * bigint.c.
+ *
+ * returns:
+ *   n == NULL || s == NULL --> -EINVAL
+ *   base < 2 || base > 36 --> -ERANGE
+ *   error --> -error
+ *   --> strlen(s)
+ */
+extern int bigint_to_basestring(const struct bigint *n, char *s, int base);
+extern int bigint_to_decimal(const struct bigint *n, char *s);
+
+
 /*
  * function to compare two bigints. any NULL arguments is interpreted as
  * -infinity.
@@ -101,6 +300,73 @@ extern int bigint_to_msb_first_hexstring(const struct bigint *n, char *s);
 extern int bigint_compare(const struct bigint *a, const struct bigint *b);
 
 
+/*
+ * bit queries on the two's complement of n, where a negative n has
+ * infinitely many ones above its chunks. they read the chunks in place
+ * instead of shifting and masking copies of n.
+ *
+ * bit_length is the number of bits of |n|, popcount the number of bits that
+ * differ from the sign bit, i.e. the ones of a non-negative n and the zeros
+ * of a negative one, and ctz the number of zeros below the lowest one.
+ *
+ * returns:
+ *   n == NULL --> -EINVAL
+ *   ctz of 0 --> -EDOM
+ *   --> the count
+ */
+extern long bigint_bit_length(const struct bigint *n);
+extern long bigint_popcount(const struct bigint *n);
+extern long bigint_ctz(const struct bigint *n);
+
+/*
+ * returns:
+ *   n == NULL --> -EINVAL
+ *   --> bit number bit of n, 0 or 1
+ */
+extern int bigint_test_bit(const struct bigint *n, unsigned long bit);
+
+/*
+ * set bit number bit of n to 1 if value != 0 and to 0 otherwise. this grows
+ * n when the bit is above its chunks and changes the sign when the bit is
+ * the sign.
+ *
+ * returns:
+ *   n == NULL --> EINVAL
+ *   the bit needs more than INT_MAX chunks --> ERANGE
+ *   error --> errno
+ *   --> 0
+ */
+extern int bigint_set_bit(struct bigint *n, unsigned long bit, int value);
+
+/*
+ * *bits = the nbit bits of n from bit number first, (n >> first) mod 2^nbit.
+ *
+ * returns:
+ *   n == NULL || bits == NULL || nbit < 0 || nbit > LONG_BIT --> EINVAL
+ *   --> 0
+ */
+extern int bigint_get_bits(const struct bigint *n, unsigned long first, int nbit, unsigned long *bits);
+
+/*
+ * dst = (n >> first) mod 2^nbit, which is never negative. dst may be n.
+ *
+ * returns:
+ *   dst == NULL || n == NULL --> EINVAL
+ *   nbit needs more than INT_MAX chunks --> ERANGE
+ *   error --> errno
+ *   --> 0
+ */
+extern int bigint_extract_bits_into(struct bigint *dst, const struct bigint *n, unsigned long first, unsigned long nbit);
+
+/*
+ * returns:
+ *   n == NULL --> NULL
+ *   error --> NULL
+ *   --> *(new bigint)
+ */
+extern struct bigint *bigint_extract_bits(const struct bigint *n, unsigned long first, unsigned long nbit);
+
+
 /*
  * the rest of the functions are bitwise or arithmetical operators. the
  * operator used for the operation in C, or if C does not support this
@@ -120,6 +386,8 @@ extern struct bigint *bigint_xor(const struct bigint *a, const struct bigint *b)
 
 extern struct bigint *bigint_shift_left(const struct bigint *a, const struct bigint *b); // a<<b
 extern struct bigint *bigint_shift_right(const struct bigint *a, const struct bigint *b); // a>>b
+extern struct bigint *bigint_shl_ul(const struct bigint *a, unsigned long shift); // a<<shift
+extern struct bigint *bigint_shr_ul(const struct bigint *a, unsigned long shift); // a>>shift
 
 extern struct bigint *bigint_negate(const struct bigint *n); // -n
 extern struct bigint *bigint_abs(const struct bigint *n); // |n|
@@ -127,4 +395,413 @@ extern struct bigint *bigint_abs(const struct bigint *n); // |n|
 extern struct bigint *bigint_add(const struct bigint *a, const struct bigint *b); // a+b
 extern struct bigint *bigint_subtract(const struct bigint *a, const struct bigint *b); // a-b
 
+/* schoolbook, karatsuba or toom-3 depending on the number of chunks, see BIGINT_*_THRESHOLD in bigint.c */
+extern struct bigint *bigint_multiply(const struct bigint *a, const struct bigint *b); // a*b
+extern struct bigint *bigint_square(const struct bigint *n); // n*n
+
+/* truncating division like in C, i.e. the remainder has the same sign as a */
+extern struct bigint *bigint_divide(const struct bigint *a, const struct bigint *b); // a/b
+extern struct bigint *bigint_modulo(const struct bigint *a, const struct bigint *b); // a%b
+
+
+/*
+ * divide a by b using knuth's algorithm D, the quotient and remainder are
+ * the same as a/b and a%b respectively. any of quotient and remainder may be
+ * NULL if that result is not needed.
+ *
+ * returns:
+ *   a == NULL || b == NULL --> EINVAL
+ *   b == 0 --> EDOM
+ *   error --> errno
+ *   --> 0
+ *     quotient != NULL --> *quotient = *(new bigint)
+ *     remainder != NULL --> *remainder = *(new bigint)
+ */
+extern int bigint_divmod(const struct bigint *a, const struct bigint *b, struct bigint **quotient, struct bigint **remainder);
+
+
+/*
+ * the operators above with the result written into an existing bigint dst
+ * instead of a new one. dst is grown when needed, but the memory is never
+ * shrunk, so reusing dst in a loop does not allocate once it is large
+ * enough. dst may be the same bigint as any of the operands.
+ *
+ * they all return:
+ *   dst == NULL || any operand == NULL --> EINVAL
+ *   error --> errno, dst is left in an unspecified state
+ *   --> 0
+ */
+extern int bigint_copy_into(struct bigint *dst, const struct bigint *n);
+extern int bigint_from_long_into(struct bigint *dst, unsigned long n);
+
+extern int bigint_not_into(struct bigint *dst, const struct bigint *n);
+extern int bigint_and_into(struct bigint *dst, const struct bigint *a, const struct bigint *b);
+extern int bigint_or_into(struct bigint *dst, const struct bigint *a, const struct bigint *b);
+extern int bigint_xor_into(struct bigint *dst, const struct bigint *a, const struct bigint *b);
+
+extern int bigint_shift_left_into(struct bigint *dst, const struct bigint *a, const struct bigint *b);
+extern int bigint_shift_right_into(struct bigint *dst, const struct bigint *a, const struct bigint *b);
+/*
+ * shift by a plain count. whole chunks are moved with memmove and the
+ * remaining bits in a single pass, so bigint_shl_ul_into(n, n, shift) and
+ * bigint_shr_ul_into(n, n, shift) shift n in place. a left shift whose
+ * result would have more than INT_MAX chunks returns ERANGE.
+ */
+extern int bigint_shl_ul_into(struct bigint *dst, const struct bigint *a, unsigned long shift);
+extern int bigint_shr_ul_into(struct bigint *dst, const struct bigint *a, unsigned long shift);
+
+extern int bigint_negate_into(struct bigint *dst, const struct bigint *n);
+extern int bigint_abs_into(struct bigint *dst, const struct bigint *n);
+
+extern int bigint_add_into(struct bigint *dst, const struct bigint *a, const struct bigint *b);
+extern int bigint_subtract_into(struct bigint *dst, const struct bigint *a, const struct bigint *b);
+
+extern int bigint_multiply_into(struct bigint *dst, const struct bigint *a, const struct bigint *b);
+extern int bigint_square_into(struct bigint *dst, const struct bigint *n);
+
+/*
+ * bigint_divmod into existing bigints. quotient and remainder may be NULL,
+ * but not the same bigint.
+ *
+ * returns:
+ *   a == NULL || b == NULL || quotient == remainder != NULL --> EINVAL
+ *   b == 0 --> EDOM
+ *   error --> errno
+ *   --> 0
+ */
+extern int bigint_divmod_into(struct bigint *quotient, struct bigint *remainder, const struct bigint *a, const struct bigint *b);
+
+
+/*
+ * reduction contexts precomputes constants for a modulus m, so that reducing
+ * many values modulo the same m costs multiplications instead of divisions.
+ * the results are always in [0, m), also for negative values.
+ */
+struct bigint_barrett;
+struct bigint_montgomery;
+
+/*
+ * create a reduction context for the modulus. montgomery requires an odd
+ * modulus.
+ *
+ * returns:
+ *   modulus == NULL --> NULL
+ *   modulus < 1 --> NULL
+ *   montgomery && modulus is even --> NULL
+ *   error --> NULL
+ *   --> *(new context)
+ */
+extern struct bigint_barrett *bigint_barrett_init(const struct bigint *modulus);
+extern struct bigint_montgomery *bigint_montgomery_init(const struct bigint *modulus);
+
+/*
+ * reduction context destructors. if ctx == NULL they do nothing.
+ */
+extern void bigint_barrett_destroy(struct bigint_barrett *ctx);
+extern void bigint_montgomery_destroy(struct bigint_montgomery *ctx);
+
+/*
+ * n mod m. this is only multiplications when |n| < m^2 for barrett and
+ * |n| < m*R for montgomery, where R = 2^(LONG_BIT*nchunk(m)). larger values
+ * falls back to division.
+ *
+ * returns:
+ *   ctx == NULL || n == NULL --> NULL
+ *   error --> NULL
+ *   --> *(new bigint)
+ */
+extern struct bigint *bigint_barrett_reduce(const struct bigint_barrett *ctx, const struct bigint *n);
+extern struct bigint *bigint_montgomery_reduce(const struct bigint_montgomery *ctx, const struct bigint *n);
+
+/*
+ * convert n into montgomery form, n*R mod m, and back, n*R^-1 mod m. a
+ * product in montgomery form is a*b*R^-1 mod m, so it stays in montgomery
+ * form.
+ *
+ * returns:
+ *   any argument == NULL --> NULL
+ *   error --> NULL
+ *   --> *(new bigint)
+ */
+extern struct bigint *bigint_to_montgomery(const struct bigint_montgomery *ctx, const struct bigint *n);
+extern struct bigint *bigint_from_montgomery(const struct bigint_montgomery *ctx, const struct bigint *n);
+extern struct bigint *bigint_montgomery_multiply(const struct bigint_montgomery *ctx, const struct bigint *a, const struct bigint *b);
+
+/*
+ * modular exponentiation, base^exponent mod m in [0, m), using sliding
+ * windows with montgomery multiplication for odd moduli and barrett
+ * reduction for even ones.
+ *
+ * the context keeps what only depends on m, and the table of powers of the
+ * last base, so repeated exponentiations with the same modulus skip the
+ * setup and do not allocate. a context must not be used by more than one
+ * thread at a time.
+ */
+struct bigint_modpow_ctx;
+
+/*
+ * create a modular exponentiation context for the modulus.
+ *
+ * returns:
+ *   modulus == NULL --> NULL
+ *   modulus < 1 --> NULL
+ *   error --> NULL
+ *   --> *(new context)
+ */
+extern struct bigint_modpow_ctx *bigint_modpow_ctx_init(const struct bigint *modulus);
+
+/*
+ * modular exponentiation context destructor. if ctx == NULL it does nothing.
+ */
+extern void bigint_modpow_ctx_destroy(struct bigint_modpow_ctx *ctx);
+
+/*
+ * dst = base^exponent mod m. dst may be base or exponent.
+ *
+ * returns:
+ *   any argument == NULL --> EINVAL
+ *   exponent < 0 --> EDOM
+ *   error --> errno
+ *   --> 0
+ */
+extern int bigint_modpow_ctx_into(struct bigint_modpow_ctx *ctx, struct bigint *dst, const struct bigint *base, const struct bigint *exponent);
+
+/*
+ * base^exponent mod modulus, with a context that is only used once.
+ *
+ * returns:
+ *   any argument == NULL --> NULL
+ *   modulus < 1 --> NULL
+ *   exponent < 0 --> NULL
+ *   error --> NULL
+ *   --> *(new bigint)
+ */
+extern struct bigint *bigint_modpow(const struct bigint *base, const struct bigint *exponent, const struct bigint *modulus);
+
+/*
+ * greatest common divisor of a and b, which is never negative. unlike gcd in
+ * dmath.h zero is not an error, gcd(a, 0) = |a| and gcd(0, 0) = 0. dst may be
+ * a or b.
+ *
+ * returns:
+ *   any argument == NULL --> EINVAL
+ *   error --> errno
+ *   --> 0
+ */
+extern int bigint_gcd_into(struct bigint *dst, const struct bigint *a, const struct bigint *b);
+
+/*
+ * greatest common divisor of a and b.
+ *
+ * returns:
+ *   a == NULL || b == NULL --> NULL
+ *   error --> NULL
+ *   --> *(new bigint)
+ */
+extern struct bigint *bigint_gcd(const struct bigint *a, const struct bigint *b);
+
+/*
+ * extended gcd, g = gcd(a, b) = s*a + t*b like extended_gcd in dmath.h, where
+ * s and t are the coefficients found by the euclidean algorithm. g, s and t
+ * may be NULL when they are not needed, and they may be a or b.
+ *
+ * returns:
+ *   a == NULL || b == NULL --> EINVAL
+ *   two of g, s and t are the same bigint --> EINVAL
+ *   error --> errno
+ *   --> 0
+ */
+extern int bigint_extended_gcd_into(struct bigint *g, struct bigint *s, struct bigint *t, const struct bigint *a, const struct bigint *b);
+
+/*
+ * dst = base^exponent, by squaring and multiplying. 0^0 = 1. dst may be
+ * base.
+ *
+ * returns:
+ *   dst == NULL || base == NULL --> EINVAL
+ *   the power needs more than INT_MAX chunks --> ERANGE
+ *   error --> errno
+ *   --> 0
+ */
+extern int bigint_pow_into(struct bigint *dst, const struct bigint *base, unsigned long exponent);
+
+/*
+ * returns:
+ *   base == NULL --> NULL
+ *   error --> NULL
+ *   --> *(new bigint)
+ */
+extern struct bigint *bigint_pow(const struct bigint *base, unsigned long exponent);
+
+/*
+ * integer k-th root, floor(n^(1/k)) for n >= 0, and rounded towards zero for
+ * negative n and odd k, so that |dst|^k <= |n| < (|dst|+1)^k. isqrt is the
+ * root for k == 2. they use newton's method from an estimate of the top bits
+ * of the root, so they take a few multiplications and divisions the size of
+ * n. dst may be n.
+ *
+ * returns:
+ *   dst == NULL || n == NULL --> EINVAL
+ *   k == 0 || n < 0 and k is even --> EDOM
+ *   error --> errno
+ *   --> 0
+ */
+extern int bigint_iroot_into(struct bigint *dst, const struct bigint *n, unsigned long k);
+extern int bigint_isqrt_into(struct bigint *dst, const struct bigint *n);
+
+/*
+ * returns:
+ *   n == NULL || k == 0 || n < 0 and k is even --> NULL
+ *   error --> NULL
+ *   --> *(new bigint)
+ */
+extern struct bigint *bigint_iroot(const struct bigint *n, unsigned long k);
+extern struct bigint *bigint_isqrt(const struct bigint *n);
+
+/*
+ * random bigint in [0, 2^nbit) from splitmix64, seeded and advanced through
+ * *state. it is fast and statistically good, but not cryptographically
+ * secure. threads that each have a state of their own may generate at the
+ * same time, and the same seed gives the same bigints.
+ *
+ * returns:
+ *   dst == NULL || state == NULL --> EINVAL
+ *   nbit needs more than INT_MAX chunks --> ERANGE
+ *   error --> errno
+ *   --> 0
+ */
+extern int bigint_random_into(struct bigint *dst, unsigned long nbit, uint64_t *state);
+
+/*
+ * random bigint in [0, 2^nbit).
+ *
+ * returns:
+ *   state == NULL --> NULL
+ *   error --> NULL
+ *   --> *(new bigint)
+ */
+extern struct bigint *bigint_random(unsigned long nbit, uint64_t *state);
+
+/*
+ * probable prime test, the baillie-psw test of trial division, miller-rabin
+ * to base 2 and a strong lucas test, followed by nround miller-rabin rounds
+ * with random bases that are spread across nthread threads. unlike isprime
+ * in dmath.h n may be of any size. no composite is known to pass baillie-psw,
+ * and each extra round lets at most 1/4 of the composites through. the bases
+ * are derived from n, so the result does not depend on nthread.
+ *
+ * returns:
+ *   n == NULL || nround < 0 || nthread < 1 --> -EINVAL
+ *   error --> -errno
+ *   n is probably prime --> 1
+ *   --> 0
+ */
+extern int bigint_is_probable_prime(const struct bigint *n, int nround, int nthread);
+
+/*
+ * batched arithmetic on n independent numbers of nchunk chunks each, for
+ * when there are many fixed-size numbers and a struct bigint for each would
+ * cost more than the arithmetic. the numbers are a structure of arrays,
+ * chunk j of number i is at [j*n + i], so the operations vectorize across
+ * the numbers. results are written into caller-provided arrays, which may
+ * be the operands.
+ *
+ * add and subtract are modulo 2^(LONG_BIT*nchunk), the same for unsigned
+ * and two's complement numbers, and carry and borrow get the unsigned carry
+ * out, 0 or 1, of each number unless they are NULL. compare stores -1, 0 or
+ * 1 like bigint_compare, with the numbers read in the given format.
+ *
+ * they all return:
+ *   nchunk < 0 || n > 0 and an array is NULL --> EINVAL
+ *   --> 0
+ */
+extern int bigint_batch_add(unsigned long *r, unsigned long *carry, const unsigned long *a, const unsigned long *b, size_t n, int nchunk);
+extern int bigint_batch_subtract(unsigned long *r, unsigned long *borrow, const unsigned long *a, const unsigned long *b, size_t n, int nchunk);
+extern int bigint_batch_compare(int *r, const unsigned long *a, const unsigned long *b, size_t n, int nchunk, enum bigint_format format);
+
+/*
+ * number i of a batch into dst, and src into number i of a batch. like
+ * bigint_export, a magnitude stores |src|.
+ *
+ * returns:
+ *   any pointer == NULL || nchunk < 1 || i >= n --> EINVAL
+ *   src does not fit in nchunk chunks --> ERANGE, and a is not touched
+ *   error --> errno
+ *   --> 0
+ */
+extern int bigint_batch_get_into(struct bigint *dst, const unsigned long *a, size_t n, int nchunk, size_t i, enum bigint_format format);
+extern int bigint_batch_set(unsigned long *a, size_t n, int nchunk, size_t i, const struct bigint *src, enum bigint_format format);
+
+/*
+ * lazy expressions, built in reverse polish notation: the operands are
+ * pushed, and each operation replaces the topmost values of the stack with
+ * its result, so a*b + c - (d << k) is
+ *   push a, push b, MULTIPLY, push c, ADD, push d, shl k, SUBTRACT
+ *
+ * nothing is computed before bigint_expr_evaluate_into, which runs the
+ * whole expression in one pass over scratch space that is kept in the
+ * expression. the operands are read in place, and the intermediate results
+ * are neither allocated nor trimmed, only the final result is. the operands
+ * are read when the expression is evaluated, not when they are pushed, so an
+ * expression may be built once and evaluated for new values of them.
+ */
+enum bigint_expr_op {
+	BIGINT_EXPR_ADD,
+	BIGINT_EXPR_SUBTRACT, // the value below the top minus the top
+	BIGINT_EXPR_MULTIPLY,
+	BIGINT_EXPR_NEGATE,
+};
+struct bigint_expr;
+
+/*
+ * create an empty expression.
+ *
+ * returns:
+ *   error --> NULL
+ *   --> *(new expression)
+ */
+extern struct bigint_expr *bigint_expr_create(void);
+
+/*
+ * expression destructor. if expr == NULL it does nothing.
+ */
+extern void bigint_expr_destroy(struct bigint_expr *expr);
+
+/*
+ * empty the expression, keeping its memory for the next one.
+ */
+extern void bigint_expr_reset(struct bigint_expr *expr);
+
+/*
+ * push an operand, apply an operation to the topmost values, or shift the
+ * top value by shift bits like bigint_shl_ul and bigint_shr_ul. n must
+ * outlive the expression, or at least its evaluations.
+ *
+ * they all return:
+ *   expr == NULL || n == NULL || invalid op --> EINVAL
+ *   too few values on the stack --> EINVAL
+ *   error --> errno
+ *   --> 0
+ */
+extern int bigint_expr_push(struct bigint_expr *expr, const struct bigint *n);
+extern int bigint_expr_apply(struct bigint_expr *expr, enum bigint_expr_op op);
+extern int bigint_expr_shl(struct bigint_expr *expr, unsigned long shift);
+extern int bigint_expr_shr(struct bigint_expr *expr, unsigned long shift);
+
+/*
+ * dst = the value of the expression. dst may be one of its operands.
+ *
+ * returns:
+ *   expr == NULL || dst == NULL --> EINVAL
+ *   not exactly one value on the stack --> EINVAL
+ *   a value does not fit in INT_MAX chunks --> ERANGE
+ *   error --> errno
+ *   --> 0
+ */
+extern int bigint_expr_evaluate_into(struct bigint_expr *expr, struct bigint *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /*BIGINT_H_*/
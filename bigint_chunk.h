@@ -0,0 +1,173 @@
+#ifndef BIGINT_CHUNK_H_
+#define BIGINT_CHUNK_H_
+#include <assert.h>
+#include <limits.h>
+
+/*
+ * the single chunk primitives of bigint.c, the carry chains, the double
+ * chunk product and quotient, and the shifts, shared with the fixed size integers in
+ * fixed_int.hpp so that both use the same algorithms. everything is static
+ * inline and compiles as both C and C++.
+ */
+
+enum {
+	BIGINT_CHUNK_BIT = sizeof(unsigned long) * CHAR_BIT,
+};
+
+/* the double chunk of chunk_multiply and chunk_divide, __extension__ keeps -pedantic quiet about it */
+#ifdef __SIZEOF_INT128__
+__extension__ typedef unsigned __int128 bigint_double_chunk;
+#endif
+
+/* adc/sbb for chunk_add_carry and chunk_sub_borrow */
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_addcl) && __has_builtin(__builtin_subcl)
+#define BIGINT_HAVE_BUILTIN_ADDCL
+#endif
+#endif
+#if !defined(BIGINT_HAVE_BUILTIN_ADDCL) && defined(__x86_64__) && ULONG_MAX == 0xffffffffffffffffUL
+#include <x86intrin.h>
+#define BIGINT_HAVE_ADDCARRY_U64
+#endif
+
+/*
+ * add and subtract with carry/borrow in and out. these compile into adc/sbb
+ * chains when the compiler has builtins or intrinsics for it, carry must be
+ * 0 or 1.
+ */
+static inline unsigned long chunk_add_carry(unsigned long a, unsigned long b, unsigned long carry, unsigned long *carry_out) {
+#if defined(BIGINT_HAVE_BUILTIN_ADDCL)
+	return __builtin_addcl(a, b, carry, carry_out);
+#elif defined(BIGINT_HAVE_ADDCARRY_U64)
+	unsigned long long sum;
+	*carry_out = _addcarry_u64(carry, a, b, &sum);
+	return sum;
+#else
+	unsigned long sum = a + b;
+	unsigned long carry_sum = sum < a;
+	sum += carry;
+	*carry_out = carry_sum | (sum < carry);
+	return sum;
+#endif
+}
+
+static inline unsigned long chunk_sub_borrow(unsigned long a, unsigned long b, unsigned long borrow, unsigned long *borrow_out) {
+#if defined(BIGINT_HAVE_BUILTIN_ADDCL)
+	return __builtin_subcl(a, b, borrow, borrow_out);
+#elif defined(BIGINT_HAVE_ADDCARRY_U64)
+	unsigned long long difference;
+	*borrow_out = _subborrow_u64(borrow, a, b, &difference);
+	return difference;
+#else
+	unsigned long difference = a - b;
+	unsigned long borrow_difference = difference > a;
+	*borrow_out = borrow_difference | (difference < borrow);
+	return difference - borrow;
+#endif
+}
+
+/* a*b, the most significant chunk of the product is stored in *high */
+static inline unsigned long chunk_multiply(unsigned long a, unsigned long b, unsigned long *high) {
+#ifdef __SIZEOF_INT128__
+	bigint_double_chunk product = (bigint_double_chunk)a * b;
+	*high = product >> BIGINT_CHUNK_BIT;
+	return (unsigned long)product;
+#else
+	enum {
+		HALF_CHUNK_BIT = BIGINT_CHUNK_BIT/2,
+	};
+	const unsigned long half_mask = ULONG_MAX >> HALF_CHUNK_BIT;
+
+	unsigned long al = a & half_mask, ah = a >> HALF_CHUNK_BIT;
+	unsigned long bl = b & half_mask, bh = b >> HALF_CHUNK_BIT;
+	unsigned long ll = al*bl, lh = al*bh, hl = ah*bl, hh = ah*bh;
+
+	unsigned long middle = (ll >> HALF_CHUNK_BIT) + (lh & half_mask) + (hl & half_mask);
+	*high = hh + (lh >> HALF_CHUNK_BIT) + (hl >> HALF_CHUNK_BIT) + (middle >> HALF_CHUNK_BIT);
+	return (middle << HALF_CHUNK_BIT) | (ll & half_mask);
+#endif
+}
+
+/* (high*2^BIGINT_CHUNK_BIT + low)/d where high < d, the remainder is stored in *remainder */
+static inline unsigned long chunk_divide(unsigned long high, unsigned long low, unsigned long d, unsigned long *remainder) {
+	assert(high < d);
+#ifdef __SIZEOF_INT128__
+	bigint_double_chunk dividend = ((bigint_double_chunk)high << BIGINT_CHUNK_BIT) | low;
+	*remainder = (unsigned long)(dividend % d);
+	return (unsigned long)(dividend / d);
+#else
+	// divlu from Hacker's Delight, dividing normalized half chunks
+	enum {
+		HALF_CHUNK_BIT = BIGINT_CHUNK_BIT/2,
+	};
+	const unsigned long half_base = 1UL << HALF_CHUNK_BIT;
+	const unsigned long half_mask = half_base - 1;
+
+	int shift = __builtin_clzl(d);
+	if (shift > 0) {
+		d <<= shift;
+		high = (high << shift) | (low >> (BIGINT_CHUNK_BIT-shift));
+		low <<= shift;
+	}
+
+	unsigned long dh = d >> HALF_CHUNK_BIT, dl = d & half_mask;
+	unsigned long low1 = low >> HALF_CHUNK_BIT, low0 = low & half_mask;
+
+	unsigned long q1 = high/dh, rhat = high - q1*dh;
+	while (q1 >= half_base || q1*dl > ((rhat << HALF_CHUNK_BIT) | low1)) {
+		q1--;
+		rhat += dh;
+		if (rhat >= half_base) {
+			break;
+		}
+	}
+
+	unsigned long high_low1 = (high << HALF_CHUNK_BIT) + low1 - q1*d;
+	unsigned long q0 = high_low1/dh;
+	rhat = high_low1 - q0*dh;
+	while (q0 >= half_base || q0*dl > ((rhat << HALF_CHUNK_BIT) | low0)) {
+		q0--;
+		rhat += dh;
+		if (rhat >= half_base) {
+			break;
+		}
+	}
+
+	*remainder = ((high_low1 << HALF_CHUNK_BIT) + low0 - q0*d) >> shift;
+	return (q1 << HALF_CHUNK_BIT) | q0;
+#endif
+}
+
+/* r = a<<shift where 0 < shift < BIGINT_CHUNK_BIT, returns the bits shifted out. r may alias a when r >= a */
+static inline unsigned long chunks_shift_left(unsigned long *r, const unsigned long *a, int n, int shift) {
+	assert(shift > 0 && shift < BIGINT_CHUNK_BIT);
+	unsigned long carry = 0;
+	if (n > 0) {
+		carry = a[n-1] >> (BIGINT_CHUNK_BIT-shift);
+	}
+	for (int i = n-1; i > 0; i--) {
+		r[i] = (a[i] << shift) | (a[i-1] >> (BIGINT_CHUNK_BIT-shift));
+	}
+	if (n > 0) {
+		r[0] = a[0] << shift;
+	}
+	return carry;
+}
+
+/* r = a>>shift (logical) where 0 < shift < BIGINT_CHUNK_BIT, returns the bits shifted out. r may alias a when r <= a */
+static inline unsigned long chunks_shift_right(unsigned long *r, const unsigned long *a, int n, int shift) {
+	assert(shift > 0 && shift < BIGINT_CHUNK_BIT);
+	unsigned long carry = 0;
+	if (n > 0) {
+		carry = a[0] << (BIGINT_CHUNK_BIT-shift);
+	}
+	for (int i = 0; i < n-1; i++) {
+		r[i] = (a[i] >> shift) | (a[i+1] << (BIGINT_CHUNK_BIT-shift));
+	}
+	if (n > 0) {
+		r[n-1] = a[n-1] >> shift;
+	}
+	return carry;
+}
+
+#endif /*BIGINT_CHUNK_H_*/
@@ -1,9 +1,15 @@
 #include "CuTest/CuTest.h"
 #include "dict.h"
+#ifdef JCCL_BENCHMARK
+#include "timer.h"
+#endif /*JCCL_BENCHMARK*/
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* Self-balancing binary search dict
  *
@@ -13,11 +19,52 @@ struct subtree {
 	struct subtree *left, *right;
 	const void *key, *value;
 	int nnode, level;
+	int nref; // the nodes and snapshots pointing to it, more than one only in a persistent dict
+};
+
+/*
+ * the nodes are carved from slabs, and removed nodes are kept on a free
+ * list for the next put. the slabs grow from DICT_SLAB_MIN_NNODE nodes to
+ * DICT_SLAB_MAX_NNODE nodes, so that a small dict stays small.
+ */
+enum {
+	DICT_SLAB_MIN_NNODE = 32,
+	DICT_SLAB_MAX_NNODE = 4096,
+};
+
+struct dict_slab {
+	struct dict_slab *next;
+	int nnode, nused;
+	struct subtree nodes[];
+};
+
+struct dict_pool {
+	struct dict_slab *slabs; // the first one is where the nodes are carved from
+	struct subtree *free; // linked through right
+	int nfree;
+};
+
+/*
+ * a version of a persistent dict, which a snapshot is a reference to. only
+ * nref is touched by the readers, the rest belongs to the writer. versions
+ * are reused rather than freed while the dict lives, so that a reader may
+ * still try to reference one that has just been reclaimed.
+ */
+struct dict_snapshot {
+	struct subtree *head;
+	dict_comparator compar;
+	atomic_int nref; // the snapshots, and the dict while it is current
+	struct dict_snapshot *next; // retired or spare versions
 };
 
 struct dict {
 	struct subtree *head;
 	dict_comparator compar;
+	struct dict_pool *pool; // &own_pool unless it is shared
+	struct dict_pool own_pool;
+	struct btree *btree; // instead of head when from dict_init_btree
+	_Atomic(struct dict_snapshot *) current; // the version of head when persistent, otherwise NULL
+	struct dict_snapshot *retired, *spare;
 };
 
 static struct subtree end_of_tree_sentinel = {.left = &end_of_tree_sentinel, .right = &end_of_tree_sentinel};
@@ -29,8 +76,99 @@ static int compare_pointers(const void *a, const void *b) {
 }
 
 
-static struct subtree *node_init(const void *key, const void *value) {
-	struct subtree *node = malloc(sizeof(*node));
+static void dict_pool_init_inline(struct dict_pool *pool) {
+	pool->slabs = NULL;
+	pool->free = NULL;
+	pool->nfree = 0;
+}
+
+
+static void dict_pool_clear(struct dict_pool *pool) {
+	while (pool->slabs != NULL) {
+		struct dict_slab *next = pool->slabs->next;
+		free(pool->slabs);
+		pool->slabs = next;
+	}
+	pool->free = NULL;
+	pool->nfree = 0;
+}
+
+
+struct dict_pool *dict_pool_init(void) {
+	struct dict_pool *pool = malloc(sizeof(*pool));
+	if (pool != NULL) {
+		dict_pool_init_inline(pool);
+	}
+	return pool;
+}
+
+
+void dict_pool_destroy(struct dict_pool *pool) {
+	if (pool != NULL) {
+		dict_pool_clear(pool);
+		free(pool);
+	}
+}
+
+
+static struct dict_slab *dict_pool_add_slab(struct dict_pool *pool, int nnode) {
+	assert(nnode > 0);
+	struct dict_slab *slab = malloc(sizeof(*slab) + nnode*sizeof(*slab->nodes));
+	if (slab == NULL) {
+		return NULL;
+	}
+
+	slab->next = pool->slabs;
+	slab->nnode = nnode;
+	slab->nused = 0;
+	pool->slabs = slab;
+
+	return slab;
+}
+
+
+static struct subtree *dict_pool_carve(struct dict_pool *pool) {
+	struct dict_slab *slab = pool->slabs;
+	if (slab == NULL || slab->nused == slab->nnode) {
+		int nnode = slab == NULL ? DICT_SLAB_MIN_NNODE : slab->nnode < DICT_SLAB_MAX_NNODE/2 ? 2*slab->nnode : DICT_SLAB_MAX_NNODE;
+		if ((slab = dict_pool_add_slab(pool, nnode)) == NULL) {
+			return NULL;
+		}
+	}
+
+	return slab->nodes + slab->nused++;
+}
+
+
+static struct subtree *dict_pool_alloc(struct dict_pool *pool) {
+	struct subtree *node = pool->free;
+	if (node != NULL) {
+		pool->free = node->right;
+		pool->nfree--;
+		return node;
+	}
+
+	return dict_pool_carve(pool);
+}
+
+
+/* makes sure that the next nnode allocations are from the free list and cannot fail */
+static int dict_pool_reserve(struct dict_pool *pool, int nnode) {
+	while (pool->nfree < nnode) {
+		struct subtree *node = dict_pool_carve(pool);
+		if (node == NULL) {
+			return ENOMEM;
+		}
+		node->right = pool->free;
+		pool->free = node;
+		pool->nfree++;
+	}
+	return 0;
+}
+
+
+static struct subtree *node_init(struct dict_pool *pool, const void *key, const void *value) {
+	struct subtree *node = dict_pool_alloc(pool);
 	if (node == NULL) {
 		return NULL;
 	}
@@ -41,26 +179,74 @@ static struct subtree *node_init(const void *key, const void *value) {
 	node->right = &end_of_tree_sentinel;
 	node->nnode = 1;
 	node->level = 1;
+	node->nref = 1;
 
 	return node;
 }
 
 
-static void node_destroy(struct subtree *node) {
+static void node_destroy(struct dict_pool *pool, struct subtree *node) {
 	assert(node != NULL);
 	// NOTE: assuming children are destroyed
 
 	if (!EOT(node)) {
-		free(node);
+		node->right = pool->free;
+		pool->free = node;
+		pool->nfree++;
+	}
+}
+
+
+static void node_ref(struct subtree *node) {
+	if (!EOT(node)) {
+		node->nref++;
+	}
+}
+
+
+/* drops a reference to node, which is destroyed with its references to the children when it was the last one */
+static void node_release(struct dict_pool *pool, struct subtree *node) {
+	while (!EOT(node) && --node->nref == 0) {
+		node_release(pool, node->left);
+		struct subtree *right = node->right;
+		node_destroy(pool, node);
+		node = right;
+	}
+}
+
+
+/*
+ * node if the caller has the only reference to it, otherwise a copy that
+ * takes over the reference of the caller. the copy is from the nodes
+ * reserved by dict_pool_reserve. a node reached through a copy has another
+ * reference from the copy, so the nodes of a persistent dict that a
+ * snapshot may see are copied before they are changed, while the nodes of
+ * other dicts always have one reference and are changed in place.
+ */
+static struct subtree *node_own(struct dict_pool *pool, struct subtree *node) {
+	if (EOT(node) || node->nref == 1) {
+		return node;
 	}
+
+	assert(pool->nfree > 0);
+	struct subtree *copy = dict_pool_alloc(pool);
+	*copy = *node;
+	copy->nref = 1;
+	node_ref(copy->left);
+	node_ref(copy->right);
+	node->nref--;
+
+	return copy;
 }
 
 
 void TestNodeConstructionAndDestruction(CuTest *tc) {
 	int key = 0xdeadbeef;
 	int value = 0xc0ffee;
+	struct dict_pool pool;
+	dict_pool_init_inline(&pool);
 
-	struct subtree *node = node_init(&key, &value);
+	struct subtree *node = node_init(&pool, &key, &value);
 	CuAssertPtrNotNull(tc, node);
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wnull-dereference"
@@ -68,643 +254,2659 @@ void TestNodeConstructionAndDestruction(CuTest *tc) {
 	CuAssertPtrEquals(tc, &value, (int *)node->value);
 	CuAssertIntEquals(tc, 1, node->nnode);
 	CuAssertIntEquals(tc, 1, node->level);
+	CuAssertIntEquals(tc, 1, node->nref);
 	CuAssertTrue(tc, EOT(node->left));
 	CuAssertTrue(tc, EOT(node->right));
 #pragma GCC diagnostic pop
 
-	node_destroy(node);
+	node_destroy(&pool, node);
+	CuAssertPtrEquals(tc, node, node_init(&pool, &key, &value));
+	CuAssertPtrEquals(tc, NULL, pool.free);
+	dict_pool_clear(&pool);
 }
 
 
-struct dict *dict_init(dict_comparator compar) {
-	if (compar == NULL) {
-		return NULL;
-	}
+/*
+ * b+-tree backend of dict_init_btree. the pairs are in the leaves, and the
+ * inner nodes have the keys between their children and the number of pairs
+ * below each child, for the index of dict_get and for dict_select. the keys
+ * of a node are contiguous, so that a node is a few cache lines to search
+ * instead of one node per level of the aa tree.
+ *
+ * a key in an inner node is always the least key below the child to its
+ * right, so that it is a key the dict still has and that the caller has not
+ * freed. full nodes are split on the way down to a put and small nodes
+ * filled on the way down to a remove, so that there is nothing to undo when
+ * a malloc fails.
+ */
+enum {
+	BTREE_NKEY = 16, // keys in a leaf, two cache lines of key pointers
+	BTREE_NCHILD = 16, // children of an inner node
+	BTREE_MAX_HEIGHT = 32, // more than enough for INT_MAX pairs with half full nodes
+};
 
-	struct dict *dict = malloc(sizeof(*dict));
-	if (dict == NULL) {
-		return NULL;
-	}
+struct btree_leaf {
+	int nkey;
+	const void *keys[BTREE_NKEY];
+	const void *values[BTREE_NKEY];
+	struct btree_leaf *prev, *next;
+};
 
-	dict->head = &end_of_tree_sentinel;
-	dict->compar = compar;
+struct btree_inner {
+	int nchild;
+	const void *keys[BTREE_NCHILD-1]; // keys[i] is the least key below children[i+1]
+	void *children[BTREE_NCHILD];
+	int counts[BTREE_NCHILD];
+};
 
-	return dict;
-}
+struct btree {
+	void *root; // NULL when empty
+	int height; // the number of inner levels above the leaves
+	int nkey;
+};
 
 
-static void subtree_destroy(struct subtree *head) {
-	assert(head != NULL);
-	if (EOT(head)) {
-		return;
+/* the number of keys in keys[0..n) that are <= key, *found tells whether the last of them == key */
+static int btree_search(const void *const *keys, int n, dict_comparator compar, const void *key, int *found) {
+	int lo = 0, hi = n;
+	*found = 0;
+	while (lo < hi) {
+		int mid = lo + (hi-lo)/2;
+		int compared = compar(key, keys[mid]);
+		if (compared < 0) {
+			hi = mid;
+		} else if (compared > 0) {
+			lo = mid+1;
+		} else {
+			*found = 1;
+			return mid+1;
+		}
 	}
+	return lo;
+}
 
-	subtree_destroy(head->left);
-	subtree_destroy(head->right);
 
-	node_destroy(head);
+static void *btree_node_init(int height) {
+	return malloc(height == 0 ? sizeof(struct btree_leaf) : sizeof(struct btree_inner));
 }
 
-void dict_destroy(struct dict *dict) {
-	if (dict != NULL) {
-		subtree_destroy(dict->head);
-		free(dict);
+
+static void btree_node_destroy(void *node, int height) {
+	if (height > 0) {
+		struct btree_inner *inner = node;
+		int i;
+		for (i = 0; i < inner->nchild; i++) {
+			btree_node_destroy(inner->children[i], height-1);
+		}
 	}
+	free(node);
 }
 
 
-static int subtree_size(struct subtree *head) {
-	assert(head != NULL);
-	return head->nnode;
-}
+static int btree_node_count(const void *node, int height) {
+	if (height == 0) {
+		return ((const struct btree_leaf *)node)->nkey;
+	}
 
-int dict_size(struct dict *dict) {
-	return dict == NULL ? -EINVAL : subtree_size(dict->head);
+	const struct btree_inner *inner = node;
+	int i, count = 0;
+	for (i = 0; i < inner->nchild; i++) {
+		count += inner->counts[i];
+	}
+	return count;
 }
 
 
-void TestDictConstructionAndDestruction(CuTest *tc) {
-	struct dict *dict = dict_init(compare_pointers);
-	CuAssertPtrNotNull(tc, dict);
+static const void *btree_node_least_key(const void *node, int height) {
+	for (; height > 0; height--) {
+		node = ((const struct btree_inner *)node)->children[0];
+	}
+	return ((const struct btree_leaf *)node)->keys[0];
+}
 
-	CuAssertIntEquals(tc, 0, dict_size(dict));
 
-	dict_destroy(dict);
+/* the number of keys or children compared to the least a node may have, <0, 0 or >0 */
+static int btree_node_fill(const void *node, int height) {
+	if (height == 0) {
+		return ((const struct btree_leaf *)node)->nkey - BTREE_NKEY/2;
+	}
+	return ((const struct btree_inner *)node)->nchild - BTREE_NCHILD/2;
 }
 
 
-enum {
-	NNODE_1_LAYER_BALANCED_TREE = 1,
-	NNODE_2_LAYER_BALANCED_TREE = 3,
-	NNODE_3_LAYER_BALANCED_TREE = 7,
-};
-static struct subtree *dummy_1_layer_balanced_tree(struct subtree *a_node) {
-	assert(a_node != NULL && !EOT(a_node));
+static int btree_node_is_full(const void *node, int height) {
+	if (height == 0) {
+		return ((const struct btree_leaf *)node)->nkey == BTREE_NKEY;
+	}
+	return ((const struct btree_inner *)node)->nchild == BTREE_NCHILD;
+}
 
-	struct subtree *first   = a_node+0;      first->key   = (void *)1; first->nnode   = 1; first->left   = &end_of_tree_sentinel; first->right   = &end_of_tree_sentinel;
 
-	return first;
+/* inserts child, with key as the least key below it, at index i > 0 of node, which has room for it */
+static void btree_inner_insert(struct btree_inner *node, int i, const void *key, void *child, int count) {
+	assert(i > 0 && node->nchild < BTREE_NCHILD);
+	memmove(node->keys+i, node->keys+i-1, (node->nchild-i)*sizeof(*node->keys));
+	memmove(node->children+i+1, node->children+i, (node->nchild-i)*sizeof(*node->children));
+	memmove(node->counts+i+1, node->counts+i, (node->nchild-i)*sizeof(*node->counts));
+	node->keys[i-1] = key;
+	node->children[i] = child;
+	node->counts[i] = count;
+	node->nchild++;
 }
-static struct subtree *dummy_2_layer_balanced_tree(struct subtree *three_nodes) {
-	assert(three_nodes != NULL && !EOT(three_nodes));
 
-	struct subtree *first   = three_nodes+0; first->key   = (void *)1; first->nnode   = 1; first->left   = &end_of_tree_sentinel; first->right   = &end_of_tree_sentinel;
-	struct subtree *third   = three_nodes+1; third->key   = (void *)3; third->nnode   = 1; third->left   = &end_of_tree_sentinel; third->right   = &end_of_tree_sentinel;
-	struct subtree *second  = three_nodes+4; second->key  = (void *)2; second->nnode  = 3; second->left  = first;                 second->right  = third;
 
-	return second;
+/* removes child i > 0 of node and the key before it */
+static void btree_inner_remove(struct btree_inner *node, int i) {
+	assert(i > 0 && i < node->nchild);
+	memmove(node->keys+i-1, node->keys+i, (node->nchild-1-i)*sizeof(*node->keys));
+	memmove(node->children+i, node->children+i+1, (node->nchild-1-i)*sizeof(*node->children));
+	memmove(node->counts+i, node->counts+i+1, (node->nchild-1-i)*sizeof(*node->counts));
+	node->nchild--;
 }
-static struct subtree *dummy_3_layer_balanced_tree(struct subtree *seven_nodes) {
-	assert(seven_nodes != NULL && !EOT(seven_nodes));
 
-	struct subtree *first   = seven_nodes+0; first->key   = (void *)1; first->nnode   = 1; first->left   = &end_of_tree_sentinel; first->right   = &end_of_tree_sentinel;
-	struct subtree *third   = seven_nodes+1; third->key   = (void *)3; third->nnode   = 1; third->left   = &end_of_tree_sentinel; third->right   = &end_of_tree_sentinel;
-	struct subtree *fifth   = seven_nodes+2; fifth->key   = (void *)5; fifth->nnode   = 1; fifth->left   = &end_of_tree_sentinel; fifth->right   = &end_of_tree_sentinel;
-	struct subtree *seventh = seven_nodes+3; seventh->key = (void *)7; seventh->nnode = 1; seventh->left = &end_of_tree_sentinel; seventh->right = &end_of_tree_sentinel;
-	struct subtree *second  = seven_nodes+4; second->key  = (void *)2; second->nnode  = 3; second->left  = first;                 second->right  = third;
-	struct subtree *sixth   = seven_nodes+5; sixth->key   = (void *)6; sixth->nnode   = 3; sixth->left   = fifth;                 sixth->right   = seventh;
-	struct subtree *fourth  = seven_nodes+6; fourth->key  = (void *)4; fourth->nnode  = 7; fourth->left  = second;                 fourth->right  = sixth;
 
-	return fourth;
+/* splits the full child i of node in two halves, the upper half becomes child i+1 */
+static int btree_split_child(struct btree_inner *node, int i, int height) {
+	void *right = btree_node_init(height);
+	if (right == NULL) {
+		return ENOMEM;
+	}
+
+	const void *key;
+	if (height == 0) {
+		struct btree_leaf *l = node->children[i], *r = right;
+		r->nkey = l->nkey - BTREE_NKEY/2;
+		l->nkey = BTREE_NKEY/2;
+		memcpy(r->keys, l->keys+l->nkey, r->nkey*sizeof(*r->keys));
+		memcpy(r->values, l->values+l->nkey, r->nkey*sizeof(*r->values));
+		r->prev = l;
+		r->next = l->next;
+		if (r->next != NULL) {
+			r->next->prev = r;
+		}
+		l->next = r;
+		key = r->keys[0];
+	} else {
+		struct btree_inner *l = node->children[i], *r = right;
+		r->nchild = l->nchild - BTREE_NCHILD/2;
+		l->nchild = BTREE_NCHILD/2;
+		memcpy(r->keys, l->keys+l->nchild, (r->nchild-1)*sizeof(*r->keys));
+		memcpy(r->children, l->children+l->nchild, r->nchild*sizeof(*r->children));
+		memcpy(r->counts, l->counts+l->nchild, r->nchild*sizeof(*r->counts));
+		key = l->keys[l->nchild-1];
+	}
+
+	int count = btree_node_count(right, height);
+	node->counts[i] -= count;
+	btree_inner_insert(node, i+1, key, right, count);
+	return 0;
 }
-void TestDictDummyBalancedDicts(CuTest *tc) {
-	struct subtree nodes[7];
 
-	struct subtree *head = dummy_1_layer_balanced_tree(nodes);
-	CuAssertPtrNotNull(tc, head);
-	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, subtree_size(head));
-	CuAssertPtrEquals(tc, (void const *)1, head->key);
-	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, head->nnode);
 
-	head = dummy_2_layer_balanced_tree(nodes);
-	CuAssertPtrNotNull(tc, head);
-	CuAssertIntEquals(tc, NNODE_2_LAYER_BALANCED_TREE, subtree_size(head));
-	CuAssertPtrEquals(tc, (void const *)1, head->left->key);
-	CuAssertPtrEquals(tc, (void const *)2, head->key);
-	CuAssertPtrEquals(tc, (void const *)3, head->right->key);
-	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, head->left->nnode);
-	CuAssertIntEquals(tc, NNODE_2_LAYER_BALANCED_TREE, head->nnode);
-	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, head->right->nnode);
+/*
+ * moves the first key or child of child i+1 of node to the end of child i,
+ * or the other way around when to_right, through the key between them.
+ */
+static void btree_rotate(struct btree_inner *node, int i, int height, int to_right) {
+	int moved;
+	if (height == 0) {
+		struct btree_leaf *l = node->children[i], *r = node->children[i+1];
+		if (to_right) {
+			memmove(r->keys+1, r->keys, r->nkey*sizeof(*r->keys));
+			memmove(r->values+1, r->values, r->nkey*sizeof(*r->values));
+			r->keys[0] = l->keys[l->nkey-1];
+			r->values[0] = l->values[l->nkey-1];
+			r->nkey++;
+			l->nkey--;
+		} else {
+			l->keys[l->nkey] = r->keys[0];
+			l->values[l->nkey] = r->values[0];
+			l->nkey++;
+			r->nkey--;
+			memmove(r->keys, r->keys+1, r->nkey*sizeof(*r->keys));
+			memmove(r->values, r->values+1, r->nkey*sizeof(*r->values));
+		}
+		node->keys[i] = r->keys[0];
+		moved = 1;
+	} else {
+		struct btree_inner *l = node->children[i], *r = node->children[i+1];
+		if (to_right) {
+			memmove(r->keys+1, r->keys, (r->nchild-1)*sizeof(*r->keys));
+			memmove(r->children+1, r->children, r->nchild*sizeof(*r->children));
+			memmove(r->counts+1, r->counts, r->nchild*sizeof(*r->counts));
+			r->keys[0] = node->keys[i];
+			r->children[0] = l->children[l->nchild-1];
+			r->counts[0] = l->counts[l->nchild-1];
+			node->keys[i] = l->keys[l->nchild-2];
+			r->nchild++;
+			l->nchild--;
+			moved = r->counts[0];
+		} else {
+			l->keys[l->nchild-1] = node->keys[i];
+			l->children[l->nchild] = r->children[0];
+			l->counts[l->nchild] = r->counts[0];
+			l->nchild++;
+			node->keys[i] = r->keys[0];
+			memmove(r->keys, r->keys+1, (r->nchild-2)*sizeof(*r->keys));
+			memmove(r->children, r->children+1, (r->nchild-1)*sizeof(*r->children));
+			memmove(r->counts, r->counts+1, (r->nchild-1)*sizeof(*r->counts));
+			r->nchild--;
+			moved = l->counts[l->nchild-1];
+		}
+	}
 
-	head = dummy_3_layer_balanced_tree(nodes);
-	CuAssertPtrNotNull(tc, head);
-	CuAssertIntEquals(tc, NNODE_3_LAYER_BALANCED_TREE, subtree_size(head));
-	CuAssertPtrEquals(tc, (void const *)1, head->left->left->key);
-	CuAssertPtrEquals(tc, (void const *)2, head->left->key);
-	CuAssertPtrEquals(tc, (void const *)3, head->left->right->key);
-	CuAssertPtrEquals(tc, (void const *)4, head->key);
-	CuAssertPtrEquals(tc, (void const *)5, head->right->left->key);
-	CuAssertPtrEquals(tc, (void const *)6, head->right->key);
-	CuAssertPtrEquals(tc, (void const *)7, head->right->right->key);
-	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, head->left->left->nnode);
-	CuAssertIntEquals(tc, NNODE_2_LAYER_BALANCED_TREE, head->left->nnode);
-	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, head->left->right->nnode);
-	CuAssertIntEquals(tc, NNODE_3_LAYER_BALANCED_TREE, head->nnode);
-	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, head->right->left->nnode);
-	CuAssertIntEquals(tc, NNODE_2_LAYER_BALANCED_TREE, head->right->nnode);
-	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, head->right->right->nnode);
+	node->counts[i] += to_right ? -moved : moved;
+	node->counts[i+1] += to_right ? moved : -moved;
 }
 
 
-#if 0
-struct node_position {
-	struct subtree *node;
-	int depth;
-};
-static void subtree_fill_positions(struct subtree *head, struct node_position *lines, int depth, int nnode_parent) {
-	assert(head != NULL && lines != NULL);
-	if (EOT(head)) {
-		return;
+/* merges child i+1 of node into child i, the two fit in one node when neither has more than the least */
+static void btree_merge_children(struct btree_inner *node, int i, int height) {
+	if (height == 0) {
+		struct btree_leaf *l = node->children[i], *r = node->children[i+1];
+		memcpy(l->keys+l->nkey, r->keys, r->nkey*sizeof(*l->keys));
+		memcpy(l->values+l->nkey, r->values, r->nkey*sizeof(*l->values));
+		l->nkey += r->nkey;
+		l->next = r->next;
+		if (l->next != NULL) {
+			l->next->prev = l;
+		}
+	} else {
+		struct btree_inner *l = node->children[i], *r = node->children[i+1];
+		l->keys[l->nchild-1] = node->keys[i];
+		memcpy(l->keys+l->nchild, r->keys, (r->nchild-1)*sizeof(*l->keys));
+		memcpy(l->children+l->nchild, r->children, r->nchild*sizeof(*l->children));
+		memcpy(l->counts+l->nchild, r->counts, r->nchild*sizeof(*l->counts));
+		l->nchild += r->nchild;
 	}
 
-	subtree_fill_positions(head->left, lines, depth+1, nnode_parent);
-	struct node_position *line = lines + nnode_parent + head->left->nnode;
-	line->node = head;
-	line->depth = depth;
-	subtree_fill_positions(head->right, lines, depth+1, nnode_parent + head->left->nnode + 1);
+	free(node->children[i+1]);
+	node->counts[i] += node->counts[i+1];
+	btree_inner_remove(node, i+1);
 }
-static void subtree_print(FILE *stream, struct subtree *head, int minimal) {
-	assert(head != NULL);
-	struct node_position *lines = calloc(head->nnode, sizeof(*lines));
-	if (lines == NULL) {
-		return;
+
+
+/* gives child i of node more than the least, from a sibling that has more or by merging with one */
+static void btree_fill_child(struct btree_inner *node, int i, int height) {
+	assert(node->nchild > 1);
+	if (i > 0 && btree_node_fill(node->children[i-1], height) > 0) {
+		btree_rotate(node, i-1, height, 1);
+	} else if (i+1 < node->nchild && btree_node_fill(node->children[i+1], height) > 0) {
+		btree_rotate(node, i, height, 0);
+	} else {
+		btree_merge_children(node, i > 0 ? i-1 : i, height);
 	}
+}
 
-	subtree_fill_positions(head, lines, 0, 0);
 
-	int i;
-	for (i = 0; i < head->nnode; i++) {
-		struct node_position *line = lines+i;
-		int j;
-		for (j = 0; j < line->depth; j++) {
-			fprintf(stream, "\t");
+static int btree_put(struct btree *tree, dict_comparator compar, void const *key, void const *value, void **nkey, void **nvalue) {
+	if (tree->root == NULL) {
+		struct btree_leaf *leaf = btree_node_init(0);
+		if (leaf == NULL) {
+			return ENOMEM;
 		}
+		leaf->nkey = 0;
+		leaf->prev = NULL;
+		leaf->next = NULL;
+		tree->root = leaf;
+	}
 
-		if (line->node == NULL) {
-			fprintf(stream, "NULL\n");
-		} else {
-			if (minimal) {
-				fprintf(stream, "%p\n", line->node->key);
-			} else {
-				fprintf(stream, "%p (key), value:%p, node:%p, left:%p, right:%p, nnode:%d, level:%d\n", line->node->key, line->node->value, line->node, line->node->left, line->node->right, line->node->nnode, line->node->level);
-			}
+	if (btree_node_is_full(tree->root, tree->height)) {
+		struct btree_inner *root = btree_node_init(tree->height+1);
+		if (root == NULL) {
+			return ENOMEM;
+		}
+		root->nchild = 1;
+		root->children[0] = tree->root;
+		root->counts[0] = tree->nkey;
+		if (btree_split_child(root, 0, tree->height) != 0) {
+			free(root);
+			return ENOMEM;
+		}
+		tree->root = root;
+		tree->height++;
+	}
 
+	struct btree_inner *path[BTREE_MAX_HEIGHT];
+	int path_index[BTREE_MAX_HEIGHT];
+	void *node = tree->root;
+	int height, i, found;
+	for (height = tree->height; height > 0; height--) {
+		struct btree_inner *inner = node;
+		i = btree_search(inner->keys, inner->nchild-1, compar, key, &found);
+		if (btree_node_is_full(inner->children[i], height-1)) {
+			if (btree_split_child(inner, i, height-1) != 0) {
+				return ENOMEM;
+			}
+			i = btree_search(inner->keys, inner->nchild-1, compar, key, &found);
 		}
+		if (found) {
+			inner->keys[i-1] = key;
+		}
+
+		path[height-1] = inner;
+		path_index[height-1] = i;
+		node = inner->children[i];
 	}
-}
-#endif
 
+	struct btree_leaf *leaf = node;
+	i = btree_search(leaf->keys, leaf->nkey, compar, key, &found);
+	if (found) {
+		if (nkey != NULL) {
+			*nkey = (void *)leaf->keys[i-1];
+		}
+		if (nvalue != NULL) {
+			*nvalue = (void *)leaf->values[i-1];
+		}
+		leaf->keys[i-1] = key;
+		leaf->values[i-1] = value;
+		return 0;
+	}
 
-static void node_reconstruct_nnode(struct subtree *node) {
-	assert(node != NULL && !EOT(node));
-	// NOTE: assuming nnode in children is correct
+	memmove(leaf->keys+i+1, leaf->keys+i, (leaf->nkey-i)*sizeof(*leaf->keys));
+	memmove(leaf->values+i+1, leaf->values+i, (leaf->nkey-i)*sizeof(*leaf->values));
+	leaf->keys[i] = key;
+	leaf->values[i] = value;
+	leaf->nkey++;
+	tree->nkey++;
+	for (height = 0; height < tree->height; height++) {
+		path[height]->counts[path_index[height]]++;
+	}
 
-	node->nnode = node->left->nnode + 1 + node->right->nnode;
+	if (nkey != NULL) {
+		*nkey = NULL;
+	}
+	if (nvalue != NULL) {
+		*nvalue = NULL;
+	}
+	return 0;
 }
 
-static void subtree_reconstruct_nnode(struct subtree *head) {
+
+static void *btree_get(const struct btree *tree, dict_comparator compar, void const *key, int *index_of_key) {
+	const void *node = tree->root;
+	if (node == NULL) {
+		return NULL;
+	}
+
+	int height, i, found, index = 0;
+	for (height = tree->height; height > 0; height--) {
+		const struct btree_inner *inner = node;
+		i = btree_search(inner->keys, inner->nchild-1, compar, key, &found);
+		int j;
+		for (j = 0; j < i; j++) {
+			index += inner->counts[j];
+		}
+		node = inner->children[i];
+	}
+
+	const struct btree_leaf *leaf = node;
+	i = btree_search(leaf->keys, leaf->nkey, compar, key, &found);
+	if (!found) {
+		return NULL;
+	}
+
+	if (index_of_key != NULL) {
+		*index_of_key = index + i-1;
+	}
+	return (void *)leaf->values[i-1];
+}
+
+
+/*
+ * a removed key that is also in an inner node is the least key below the
+ * child to its right there, and is replaced by the new least key after the
+ * pair is removed from the leaf.
+ */
+static int btree_remove(struct btree *tree, dict_comparator compar, void const *key, void **nkey, void **nvalue) {
+	if (tree->root == NULL) {
+		return ESRCH;
+	}
+
+	struct btree_inner *path[BTREE_MAX_HEIGHT];
+	int path_index[BTREE_MAX_HEIGHT], path_found[BTREE_MAX_HEIGHT];
+	void *node = tree->root;
+	int height, i, found;
+	for (height = tree->height; height > 0; height--) {
+		struct btree_inner *inner = node;
+		i = btree_search(inner->keys, inner->nchild-1, compar, key, &found);
+		if (btree_node_fill(inner->children[i], height-1) <= 0) {
+			btree_fill_child(inner, i, height-1);
+			i = btree_search(inner->keys, inner->nchild-1, compar, key, &found);
+		}
+
+		path[height-1] = inner;
+		path_index[height-1] = i;
+		path_found[height-1] = found;
+		node = inner->children[i];
+	}
+
+	struct btree_leaf *leaf = node;
+	i = btree_search(leaf->keys, leaf->nkey, compar, key, &found);
+	int status = ESRCH;
+	if (found) {
+		if (nkey != NULL) {
+			*nkey = (void *)leaf->keys[i-1];
+		}
+		if (nvalue != NULL) {
+			*nvalue = (void *)leaf->values[i-1];
+		}
+		memmove(leaf->keys+i-1, leaf->keys+i, (leaf->nkey-i)*sizeof(*leaf->keys));
+		memmove(leaf->values+i-1, leaf->values+i, (leaf->nkey-i)*sizeof(*leaf->values));
+		leaf->nkey--;
+		tree->nkey--;
+
+		for (height = 0; height < tree->height; height++) {
+			struct btree_inner *inner = path[height];
+			i = path_index[height];
+			inner->counts[i]--;
+			if (path_found[height]) {
+				inner->keys[i-1] = btree_node_least_key(inner->children[i], height);
+			}
+		}
+		status = 0;
+	}
+
+	// the root has one child after the last two below it were merged
+	while (tree->height > 0 && ((struct btree_inner *)tree->root)->nchild == 1) {
+		void *child = ((struct btree_inner *)tree->root)->children[0];
+		free(tree->root);
+		tree->root = child;
+		tree->height--;
+	}
+	if (tree->height == 0 && ((struct btree_leaf *)tree->root)->nkey == 0) {
+		free(tree->root);
+		tree->root = NULL;
+	}
+
+	return status;
+}
+
+
+static int btree_select(const struct btree *tree, int i, void **key, void **value) {
+	if (i < 0) {
+		i += tree->nkey;
+	}
+	if (i < 0 || i >= tree->nkey) {
+		return ESRCH;
+	}
+
+	const void *node = tree->root;
+	int height;
+	for (height = tree->height; height > 0; height--) {
+		const struct btree_inner *inner = node;
+		int j = 0;
+		while (i >= inner->counts[j]) {
+			i -= inner->counts[j++];
+		}
+		node = inner->children[j];
+	}
+
+	const struct btree_leaf *leaf = node;
+	*key = (void *)leaf->keys[i];
+	*value = (void *)leaf->values[i];
+	return 0;
+}
+
+
+static int btree_for_each(const struct btree *tree, dict_action action, void *state) {
+	const void *node = tree->root;
+	if (node == NULL) {
+		return 0;
+	}
+
+	int height;
+	for (height = tree->height; height > 0; height--) {
+		node = ((const struct btree_inner *)node)->children[0];
+	}
+
+	const struct btree_leaf *leaf;
+	for (leaf = node; leaf != NULL; leaf = leaf->next) {
+		int i;
+		for (i = 0; i < leaf->nkey; i++) {
+			int status = action(leaf->keys[i], leaf->values[i], state);
+			if (status != 0) {
+				return status;
+			}
+		}
+	}
+	return 0;
+}
+
+
+struct dict *dict_init_with_pool(dict_comparator compar, struct dict_pool *pool) {
+	if (compar == NULL) {
+		return NULL;
+	}
+
+	struct dict *dict = malloc(sizeof(*dict));
+	if (dict == NULL) {
+		return NULL;
+	}
+
+	dict->head = &end_of_tree_sentinel;
+	dict->compar = compar;
+	dict_pool_init_inline(&dict->own_pool);
+	dict->pool = pool != NULL ? pool : &dict->own_pool;
+	dict->btree = NULL;
+	atomic_init(&dict->current, NULL);
+	dict->retired = NULL;
+	dict->spare = NULL;
+
+	return dict;
+}
+
+struct dict *dict_init(dict_comparator compar) {
+	return dict_init_with_pool(compar, NULL);
+}
+
+struct dict *dict_init_btree(dict_comparator compar) {
+	struct dict *dict = dict_init(compar);
+	if (dict == NULL) {
+		return NULL;
+	}
+
+	dict->btree = calloc(1, sizeof(*dict->btree));
+	if (dict->btree == NULL) {
+		dict_destroy(dict);
+		return NULL;
+	}
+
+	return dict;
+}
+
+struct dict *dict_init_persistent(dict_comparator compar) {
+	struct dict *dict = dict_init(compar);
+	if (dict == NULL) {
+		return NULL;
+	}
+
+	struct dict_snapshot *version = calloc(1, sizeof(*version));
+	if (version == NULL) {
+		dict_destroy(dict);
+		return NULL;
+	}
+	version->head = dict->head;
+	version->compar = compar;
+	atomic_init(&version->nref, 1);
+	atomic_init(&dict->current, version);
+
+	return dict;
+}
+
+
+/*
+ * a persistent write copies the path to the changed node and the nodes it
+ * rotates, which are at most 8 per level of the aa tree. they are reserved
+ * up front together with the new version, so that once the write has begun
+ * it cannot fail halfway with some of the nodes of the current version
+ * already released.
+ */
+static struct dict_snapshot *dict_persistent_begin(struct dict *dict) {
+	if (dict_pool_reserve(dict->pool, 8*(2*dict->head->level + 2)) != 0) {
+		return NULL;
+	}
+
+	struct dict_snapshot *version = dict->spare;
+	if (version != NULL) {
+		dict->spare = version->next;
+	} else if ((version = calloc(1, sizeof(*version))) == NULL) {
+		return NULL;
+	}
+	version->compar = dict->compar;
+	// a spare has no references, so no reader can take one from it meanwhile
+	atomic_store(&version->nref, 1);
+
+	// the head is shared with the current version, so the write copies it
+	node_ref(dict->head);
+
+	return version;
+}
+
+
+/*
+ * the retired versions that no snapshot refers to any more release the
+ * nodes that no other version has, and become spares. a version without
+ * references gets none back, since dict_snapshot_take only adds to a
+ * count that is not 0.
+ */
+static void dict_persistent_reclaim(struct dict *dict) {
+	struct dict_snapshot **version = &dict->retired;
+	while (*version != NULL) {
+		struct dict_snapshot *retired = *version;
+		if (atomic_load(&retired->nref) == 0) {
+			*version = retired->next;
+			node_release(dict->pool, retired->head);
+			retired->next = dict->spare;
+			dict->spare = retired;
+		} else {
+			version = &retired->next;
+		}
+	}
+}
+
+
+static void dict_persistent_publish(struct dict *dict, struct dict_snapshot *version, struct subtree *head) {
+	version->head = head;
+	dict->head = head;
+
+	struct dict_snapshot *retired = atomic_exchange(&dict->current, version);
+	atomic_fetch_sub(&retired->nref, 1);
+	retired->next = dict->retired;
+	dict->retired = retired;
+
+	dict_persistent_reclaim(dict);
+}
+
+
+static void dict_snapshot_list_free(struct dict_snapshot *version) {
+	while (version != NULL) {
+		struct dict_snapshot *next = version->next;
+		free(version);
+		version = next;
+	}
+}
+
+
+static void subtree_destroy(struct dict_pool *pool, struct subtree *head) {
+	assert(head != NULL);
+	if (EOT(head)) {
+		return;
+	}
+
+	subtree_destroy(pool, head->left);
+	subtree_destroy(pool, head->right);
+
+	node_destroy(pool, head);
+}
+
+/* the nodes of an own pool go with its slabs, only a shared pool gets them back one by one */
+void dict_destroy(struct dict *dict) {
+	if (dict != NULL) {
+		if (dict->pool != &dict->own_pool) {
+			subtree_destroy(dict->pool, dict->head);
+		}
+		dict_pool_clear(&dict->own_pool);
+		if (dict->btree != NULL && dict->btree->root != NULL) {
+			btree_node_destroy(dict->btree->root, dict->btree->height);
+		}
+		free(dict->btree);
+		free(atomic_load(&dict->current));
+		dict_snapshot_list_free(dict->retired);
+		dict_snapshot_list_free(dict->spare);
+		free(dict);
+	}
+}
+
+
+static int subtree_size(struct subtree *head) {
 	assert(head != NULL);
+	return head->nnode;
+}
+
+int dict_size(struct dict *dict) {
+	if (dict == NULL) {
+		return -EINVAL;
+	}
+	return dict->btree != NULL ? dict->btree->nkey : subtree_size(dict->head);
+}
+
+
+void TestDictConstructionAndDestruction(CuTest *tc) {
+	struct dict *dict = dict_init(compare_pointers);
+	CuAssertPtrNotNull(tc, dict);
+
+	CuAssertIntEquals(tc, 0, dict_size(dict));
+
+	dict_destroy(dict);
+}
+
+
+enum {
+	NNODE_1_LAYER_BALANCED_TREE = 1,
+	NNODE_2_LAYER_BALANCED_TREE = 3,
+	NNODE_3_LAYER_BALANCED_TREE = 7,
+};
+static struct subtree *dummy_1_layer_balanced_tree(struct subtree *a_node) {
+	assert(a_node != NULL && !EOT(a_node));
+
+	struct subtree *first   = a_node+0;      first->key   = (void *)1; first->nnode   = 1; first->left   = &end_of_tree_sentinel; first->right   = &end_of_tree_sentinel;
+
+	return first;
+}
+static struct subtree *dummy_2_layer_balanced_tree(struct subtree *three_nodes) {
+	assert(three_nodes != NULL && !EOT(three_nodes));
+
+	struct subtree *first   = three_nodes+0; first->key   = (void *)1; first->nnode   = 1; first->left   = &end_of_tree_sentinel; first->right   = &end_of_tree_sentinel;
+	struct subtree *third   = three_nodes+1; third->key   = (void *)3; third->nnode   = 1; third->left   = &end_of_tree_sentinel; third->right   = &end_of_tree_sentinel;
+	struct subtree *second  = three_nodes+4; second->key  = (void *)2; second->nnode  = 3; second->left  = first;                 second->right  = third;
+
+	return second;
+}
+static struct subtree *dummy_3_layer_balanced_tree(struct subtree *seven_nodes) {
+	assert(seven_nodes != NULL && !EOT(seven_nodes));
+
+	struct subtree *first   = seven_nodes+0; first->key   = (void *)1; first->nnode   = 1; first->left   = &end_of_tree_sentinel; first->right   = &end_of_tree_sentinel;
+	struct subtree *third   = seven_nodes+1; third->key   = (void *)3; third->nnode   = 1; third->left   = &end_of_tree_sentinel; third->right   = &end_of_tree_sentinel;
+	struct subtree *fifth   = seven_nodes+2; fifth->key   = (void *)5; fifth->nnode   = 1; fifth->left   = &end_of_tree_sentinel; fifth->right   = &end_of_tree_sentinel;
+	struct subtree *seventh = seven_nodes+3; seventh->key = (void *)7; seventh->nnode = 1; seventh->left = &end_of_tree_sentinel; seventh->right = &end_of_tree_sentinel;
+	struct subtree *second  = seven_nodes+4; second->key  = (void *)2; second->nnode  = 3; second->left  = first;                 second->right  = third;
+	struct subtree *sixth   = seven_nodes+5; sixth->key   = (void *)6; sixth->nnode   = 3; sixth->left   = fifth;                 sixth->right   = seventh;
+	struct subtree *fourth  = seven_nodes+6; fourth->key  = (void *)4; fourth->nnode  = 7; fourth->left  = second;                 fourth->right  = sixth;
+
+	return fourth;
+}
+void TestDictDummyBalancedDicts(CuTest *tc) {
+	struct subtree nodes[7];
+
+	struct subtree *head = dummy_1_layer_balanced_tree(nodes);
+	CuAssertPtrNotNull(tc, head);
+	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, subtree_size(head));
+	CuAssertPtrEquals(tc, (void const *)1, head->key);
+	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, head->nnode);
+
+	head = dummy_2_layer_balanced_tree(nodes);
+	CuAssertPtrNotNull(tc, head);
+	CuAssertIntEquals(tc, NNODE_2_LAYER_BALANCED_TREE, subtree_size(head));
+	CuAssertPtrEquals(tc, (void const *)1, head->left->key);
+	CuAssertPtrEquals(tc, (void const *)2, head->key);
+	CuAssertPtrEquals(tc, (void const *)3, head->right->key);
+	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, head->left->nnode);
+	CuAssertIntEquals(tc, NNODE_2_LAYER_BALANCED_TREE, head->nnode);
+	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, head->right->nnode);
+
+	head = dummy_3_layer_balanced_tree(nodes);
+	CuAssertPtrNotNull(tc, head);
+	CuAssertIntEquals(tc, NNODE_3_LAYER_BALANCED_TREE, subtree_size(head));
+	CuAssertPtrEquals(tc, (void const *)1, head->left->left->key);
+	CuAssertPtrEquals(tc, (void const *)2, head->left->key);
+	CuAssertPtrEquals(tc, (void const *)3, head->left->right->key);
+	CuAssertPtrEquals(tc, (void const *)4, head->key);
+	CuAssertPtrEquals(tc, (void const *)5, head->right->left->key);
+	CuAssertPtrEquals(tc, (void const *)6, head->right->key);
+	CuAssertPtrEquals(tc, (void const *)7, head->right->right->key);
+	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, head->left->left->nnode);
+	CuAssertIntEquals(tc, NNODE_2_LAYER_BALANCED_TREE, head->left->nnode);
+	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, head->left->right->nnode);
+	CuAssertIntEquals(tc, NNODE_3_LAYER_BALANCED_TREE, head->nnode);
+	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, head->right->left->nnode);
+	CuAssertIntEquals(tc, NNODE_2_LAYER_BALANCED_TREE, head->right->nnode);
+	CuAssertIntEquals(tc, NNODE_1_LAYER_BALANCED_TREE, head->right->right->nnode);
+}
+
+
+#if 0
+struct node_position {
+	struct subtree *node;
+	int depth;
+};
+static void subtree_fill_positions(struct subtree *head, struct node_position *lines, int depth, int nnode_parent) {
+	assert(head != NULL && lines != NULL);
 	if (EOT(head)) {
 		return;
 	}
 
-	subtree_reconstruct_nnode(head->left);
-	subtree_reconstruct_nnode(head->right);
-	node_reconstruct_nnode(head);
+	subtree_fill_positions(head->left, lines, depth+1, nnode_parent);
+	struct node_position *line = lines + nnode_parent + head->left->nnode;
+	line->node = head;
+	line->depth = depth;
+	subtree_fill_positions(head->right, lines, depth+1, nnode_parent + head->left->nnode + 1);
+}
+static void subtree_print(FILE *stream, struct subtree *head, int minimal) {
+	assert(head != NULL);
+	struct node_position *lines = calloc(head->nnode, sizeof(*lines));
+	if (lines == NULL) {
+		return;
+	}
+
+	subtree_fill_positions(head, lines, 0, 0);
+
+	int i;
+	for (i = 0; i < head->nnode; i++) {
+		struct node_position *line = lines+i;
+		int j;
+		for (j = 0; j < line->depth; j++) {
+			fprintf(stream, "\t");
+		}
+
+		if (line->node == NULL) {
+			fprintf(stream, "NULL\n");
+		} else {
+			if (minimal) {
+				fprintf(stream, "%p\n", line->node->key);
+			} else {
+				fprintf(stream, "%p (key), value:%p, node:%p, left:%p, right:%p, nnode:%d, level:%d\n", line->node->key, line->node->value, line->node, line->node->left, line->node->right, line->node->nnode, line->node->level);
+			}
+
+		}
+	}
+}
+#endif
+
+
+static void node_reconstruct_nnode(struct subtree *node) {
+	assert(node != NULL && !EOT(node));
+	// NOTE: assuming nnode in children is correct
+
+	node->nnode = node->left->nnode + 1 + node->right->nnode;
+}
+
+static void subtree_reconstruct_nnode(struct subtree *head) {
+	assert(head != NULL);
+	if (EOT(head)) {
+		return;
+	}
+
+	subtree_reconstruct_nnode(head->left);
+	subtree_reconstruct_nnode(head->right);
+	node_reconstruct_nnode(head);
+}
+void TestSubtree_reconstruct_nnode(CuTest *tc) {
+	struct subtree nodes[NNODE_3_LAYER_BALANCED_TREE];
+	struct subtree *head = dummy_3_layer_balanced_tree(nodes);
+
+	int i;
+	for (i = 0; i < NNODE_3_LAYER_BALANCED_TREE; i++) {
+		(nodes+i)->nnode = 0;
+	}
+
+	CuAssertIntEquals(tc, 0, subtree_size(head));
+	subtree_reconstruct_nnode(head);
+	CuAssertIntEquals(tc, NNODE_3_LAYER_BALANCED_TREE, subtree_size(head));
+}
+
+
+static struct subtree *subtree_rotate_right(struct subtree *head) {
+	assert(head != NULL);
+	assert(!EOT(head) && !EOT(head->left));
+
+	struct subtree *left = head->left;
+	head->left = left->right;
+	left->right = head;
+
+	node_reconstruct_nnode(head);
+	node_reconstruct_nnode(left);
+
+	return left;
+}
+void TestSubtree_rotate_right(CuTest *tc) {
+	struct subtree nodes[NNODE_3_LAYER_BALANCED_TREE];
+	struct subtree *head = dummy_3_layer_balanced_tree(nodes);
+
+	head = subtree_rotate_right(head);
+	CuAssertPtrEquals(tc, (void const *)1, head->left->key);
+	CuAssertPtrEquals(tc, (void const *)2, head->key);
+	CuAssertPtrEquals(tc, (void const *)3, head->right->left->key);
+	CuAssertPtrEquals(tc, (void const *)4, head->right->key);
+	CuAssertPtrEquals(tc, (void const *)5, head->right->right->left->key);
+	CuAssertPtrEquals(tc, (void const *)6, head->right->right->key);
+	CuAssertPtrEquals(tc, (void const *)7, head->right->right->right->key);
+
+	subtree_reconstruct_nnode(head);
+	CuAssertIntEquals(tc, NNODE_3_LAYER_BALANCED_TREE, subtree_size(head));
+}
+
+
+static struct subtree *subtree_rotate_left(struct subtree *head) {
+	assert(head != NULL);
+	assert(!EOT(head) && !EOT(head->right));
+
+	struct subtree *right = head->right;
+	head->right = right->left;
+	right->left = head;
+
+	node_reconstruct_nnode(head);
+	node_reconstruct_nnode(right);
+
+	return right;
+}
+void TestSubtree_rotate_left(CuTest *tc) {
+	struct subtree nodes[NNODE_3_LAYER_BALANCED_TREE];
+	struct subtree *head = dummy_3_layer_balanced_tree(nodes);
+
+	head = subtree_rotate_left(head);
+	CuAssertPtrEquals(tc, (void const *)1, head->left->left->left->key);
+	CuAssertPtrEquals(tc, (void const *)2, head->left->left->key);
+	CuAssertPtrEquals(tc, (void const *)3, head->left->left->right->key);
+	CuAssertPtrEquals(tc, (void const *)4, head->left->key);
+	CuAssertPtrEquals(tc, (void const *)5, head->left->right->key);
+	CuAssertPtrEquals(tc, (void const *)6, head->key);
+	CuAssertPtrEquals(tc, (void const *)7, head->right->key);
+
+	subtree_reconstruct_nnode(head);
+	CuAssertIntEquals(tc, NNODE_3_LAYER_BALANCED_TREE, subtree_size(head));
+}
+
+
+static int skew_needed(struct subtree *head) {
+	return head->level == head->left->level;
+}
+static struct subtree *skew(struct dict_pool *pool, struct subtree *head) {
+	assert(head != NULL && !EOT(head));
+
+	if (skew_needed(head)) {
+		head = node_own(pool, head);
+		head->left = node_own(pool, head->left);
+		head = subtree_rotate_right(head);
+	}
+
+	return head;
+}
+static struct subtree *split(struct dict_pool *pool, struct subtree *head) {
+	assert(head != NULL && !EOT(head));
+
+	if (head->level == head->right->right->level) {
+		head = node_own(pool, head);
+		head->right = node_own(pool, head->right);
+		head = subtree_rotate_left(head);
+		head->level++;
+	}
+
+	return head;
+}
+
+
+static struct subtree *subtree_put(struct subtree *head, struct dict_pool *pool, dict_comparator compar, void const *key, void const *value, void **nkey, void **nvalue, int *status) {
+	if (EOT(head)) {
+		struct subtree *new = node_init(pool, key, value);
+		if (new == NULL) {
+			*status = errno != 0 ? errno : -1;
+			return &end_of_tree_sentinel;
+		}
+		if (nkey != NULL) {
+			*nkey = NULL;
+		}
+		if (nvalue != NULL) {
+			*nvalue = NULL;
+		}
+		return new;
+	}
+
+	head = node_own(pool, head);
+	int compared = compar(key, head->key);
+	if (compared < 0) {
+		head->left = subtree_put(head->left, pool, compar, key, value, nkey, nvalue, status);
+	} else if (compared == 0) {
+		if (nkey != NULL) {
+			*nkey = (void *)head->key;
+		}
+		if (nvalue != NULL) {
+			*nvalue = (void *)head->value;
+		}
+		head->key = key;
+		head->value = value;
+		return head;
+	} else {
+		head->right = subtree_put(head->right, pool, compar, key, value, nkey, nvalue, status);
+	}
+
+	node_reconstruct_nnode(head);
+
+	head = skew(pool, head);
+	head = split(pool, head);
+
+	return head;
+}
+
+int dict_put(struct dict *dict, void const *key, void const *value, void **nkey, void **nvalue) {
+	if (dict == NULL || key == NULL) {
+		return EINVAL;
+	}
+
+	if (dict->btree != NULL) {
+		return btree_put(dict->btree, dict->compar, key, value, nkey, nvalue);
+	}
+
+	struct dict_snapshot *version = NULL;
+	if (atomic_load(&dict->current) != NULL && (version = dict_persistent_begin(dict)) == NULL) {
+		return ENOMEM;
+	}
+
+	int status = 0;
+	struct subtree *head = subtree_put(dict->head, dict->pool, dict->compar, key, value, nkey, nvalue, &status);
+	if (status != 0) {
+		assert(version == NULL);
+		return status;
+	}
+
+	if (version != NULL) {
+		dict_persistent_publish(dict, version, head);
+	} else {
+		dict->head = head;
+	}
+
+	return 0;
+}
+
+void TestDict_put(CuTest *tc) {
+	struct dict *dict = dict_init(compare_pointers);
+	CuAssertPtrNotNull(tc, dict);
+
+	int i;
+	for (i = 1; i <= 7; i++) {
+		unsigned long wannabe_pointer = i;
+		void *nkey = (void*)42, *nvalue = (void*)42;
+		CuAssertIntEquals(tc, 0, dict_put(dict, (void *)wannabe_pointer, (void *)0x1337, &nkey, &nvalue));
+		CuAssertIntEquals(tc, i, dict_size(dict));
+		CuAssertPtrEquals(tc, NULL, nkey);
+		CuAssertPtrEquals(tc, NULL, nvalue);
+
+		CuAssertIntEquals(tc, 0, dict_put(dict, (void *)wannabe_pointer, NULL, &nkey, &nvalue));
+		CuAssertIntEquals(tc, i, dict_size(dict));
+		CuAssertPtrEquals(tc, (void *)wannabe_pointer, nkey);
+		CuAssertPtrEquals(tc, (void *)0x1337, nvalue);
+	}
+
+	// ensure it is balanced
+	CuAssertPtrEquals(tc, (void const *)1, dict->head->left->left->key);
+	CuAssertPtrEquals(tc, (void const *)2, dict->head->left->key);
+	CuAssertPtrEquals(tc, (void const *)3, dict->head->left->right->key);
+	CuAssertPtrEquals(tc, (void const *)4, dict->head->key);
+	CuAssertPtrEquals(tc, (void const *)5, dict->head->right->left->key);
+	CuAssertPtrEquals(tc, (void const *)6, dict->head->right->key);
+	CuAssertPtrEquals(tc, (void const *)7, dict->head->right->right->key);
+
+	dict_destroy(dict);
+}
+
+
+/*
+ * the subtree of the n pairs from keys and values in nodes, with each node
+ * at the index of its pair. the right subtree gets the extra node when n-1
+ * is odd, so that the left child always is one level below and the level
+ * of each node is floor(log2(nnode+1)). the right child is at the same
+ * level only when it is a perfect subtree, whose right child is below.
+ */
+static struct subtree *subtree_from_sorted(struct subtree *nodes, void const *const *keys, void const *const *values, int n) {
+	if (n == 0) {
+		return &end_of_tree_sentinel;
+	}
+
+	int nleft = (n-1)/2;
+	struct subtree *head = nodes + nleft;
+	head->key = keys[nleft];
+	head->value = values != NULL ? values[nleft] : NULL;
+	head->left = subtree_from_sorted(nodes, keys, values, nleft);
+	head->right = subtree_from_sorted(head+1, keys+nleft+1, values != NULL ? values+nleft+1 : NULL, n-nleft-1);
+	head->nnode = n;
+	head->level = head->left->level + 1;
+	head->nref = 1;
+
+	return head;
+}
+
+struct dict *dict_from_sorted(dict_comparator compar, void const *const *keys, void const *const *values, int n) {
+	if (compar == NULL || n < 0 || (keys == NULL && n > 0)) {
+		return NULL;
+	}
+
+	int i;
+	for (i = 0; i < n; i++) {
+		if (keys[i] == NULL || (i > 0 && compar(keys[i-1], keys[i]) >= 0)) {
+			return NULL;
+		}
+	}
+
+	struct dict *dict = dict_init(compar);
+	if (dict == NULL || n == 0) {
+		return dict;
+	}
+
+	struct dict_slab *slab = dict_pool_add_slab(dict->pool, n);
+	if (slab == NULL) {
+		dict_destroy(dict);
+		return NULL;
+	}
+	slab->nused = n;
+	dict->head = subtree_from_sorted(slab->nodes, keys, values, n);
+
+	return dict;
+}
+
+
+/* the number of nodes in head if it is an aa tree with correct nnode, otherwise -1 */
+static int subtree_check(struct subtree *head, dict_comparator compar, const void *min, const void *max) {
+	if (EOT(head)) {
+		return 0;
+	}
+
+	int nleft = subtree_check(head->left, compar, min, head->key);
+	int nright = subtree_check(head->right, compar, head->key, max);
+	if (nleft < 0 || nright < 0 || head->nnode != nleft + 1 + nright) {
+		return -1;
+	}
+	if ((min != NULL && compar(min, head->key) >= 0) || (max != NULL && compar(head->key, max) >= 0)) {
+		return -1;
+	}
+	if (head->left->level != head->level-1 || head->right->level < head->level-1 || head->right->level > head->level) {
+		return -1;
+	}
+	if (head->right->right->level >= head->level) {
+		return -1;
+	}
+	if (head->level > 1 && (EOT(head->left) || EOT(head->right))) {
+		return -1;
+	}
+
+	return head->nnode;
+}
+void TestDict_from_sorted(CuTest *tc) {
+	enum {
+		MAX_NNODE = 100,
+	};
+	void const *keys[MAX_NNODE], *values[MAX_NNODE];
+
+	int n;
+	for (n = 0; n <= MAX_NNODE; n++) {
+		int i;
+		for (i = 0; i < n; i++) {
+			keys[i] = (void *)(unsigned long)(2*i+2);
+			values[i] = (void *)(unsigned long)(2*i+1000);
+		}
+
+		struct dict *dict = dict_from_sorted(compare_pointers, keys, values, n);
+		CuAssertPtrNotNull(tc, dict);
+		CuAssertIntEquals(tc, n, dict_size(dict));
+		CuAssertIntEquals(tc, n, subtree_check(dict->head, compare_pointers, NULL, NULL));
+
+		for (i = 0; i < n; i++) {
+			int index = -1;
+			void *rkey, *rvalue;
+			CuAssertPtrEquals(tc, (void *)values[i], dict_get(dict, keys[i], &index));
+			CuAssertIntEquals(tc, i, index);
+			CuAssertIntEquals(tc, 0, dict_select(dict, i, &rkey, &rvalue));
+			CuAssertPtrEquals(tc, (void *)keys[i], rkey);
+			CuAssertPtrEquals(tc, (void *)values[i], rvalue);
+		}
+
+		// it is an ordinary dict, where nodes may be added around the block
+		for (i = 0; i <= n; i++) {
+			unsigned long key = 2*i+1;
+			CuAssertIntEquals(tc, 0, dict_put(dict, (void *)key, (void *)key, NULL, NULL));
+		}
+		CuAssertIntEquals(tc, 2*n+1, dict_size(dict));
+		CuAssertIntEquals(tc, 2*n+1, subtree_check(dict->head, compare_pointers, NULL, NULL));
+		for (i = 0; i < 2*n+1; i++) {
+			void *rkey, *rvalue;
+			CuAssertIntEquals(tc, 0, dict_select(dict, i, &rkey, &rvalue));
+			CuAssertPtrEquals(tc, (void *)(unsigned long)(i+1), rkey);
+		}
+
+		dict_destroy(dict);
+	}
+
+	// a set without values
+	struct dict *dict = dict_from_sorted(compare_pointers, keys, NULL, MAX_NNODE);
+	CuAssertPtrNotNull(tc, dict);
+	CuAssertPtrEquals(tc, NULL, dict_get(dict, keys[MAX_NNODE/2], NULL));
+	dict_destroy(dict);
+
+	// the keys are not strictly increasing
+	keys[MAX_NNODE/2] = keys[MAX_NNODE/2 - 1];
+	CuAssertPtrEquals(tc, NULL, dict_from_sorted(compare_pointers, keys, values, MAX_NNODE));
+	keys[MAX_NNODE/2] = NULL;
+	CuAssertPtrEquals(tc, NULL, dict_from_sorted(compare_pointers, keys, values, MAX_NNODE));
+	CuAssertPtrEquals(tc, NULL, dict_from_sorted(NULL, keys, values, 1));
+	CuAssertPtrEquals(tc, NULL, dict_from_sorted(compare_pointers, NULL, values, 1));
+	CuAssertPtrEquals(tc, NULL, dict_from_sorted(compare_pointers, keys, values, -1));
+}
+
+
+void TestDictFromSortedBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		NNODE = 1 << 20,
+		NITERATION = 10,
+	};
+	void const **keys = malloc(NNODE*sizeof(*keys));
+	CuAssertPtrNotNull(tc, keys);
+	int i;
+	for (i = 0; i < NNODE; i++) {
+		keys[i] = (void *)(unsigned long)(i+1);
+	}
+
+	TIMED_BLOCK(NITERATION, "dict_put sorted 2^20") {
+		struct dict *dict = dict_init(compare_pointers);
+		for (i = 0; i < NNODE; i++) {
+			dict_put(dict, keys[i], keys[i], NULL, NULL);
+		}
+		dict_destroy(dict);
+	}
+	TIMED_BLOCK(NITERATION, "dict_from_sorted 2^20") {
+		struct dict *dict = dict_from_sorted(compare_pointers, keys, keys, NNODE);
+		dict_destroy(dict);
+	}
+
+	free(keys);
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
+
+
+static void *subtree_get(struct subtree *head, dict_comparator compar, void const *key, int *index_of_key) {
+	assert(key != NULL);
+	int le_valued_keys_skipped = 0;
+
+	while (!EOT(head)) {
+		int compared = compar(key, head->key);
+		if (compared < 0) {
+			head = head->left;
+		} else {
+			le_valued_keys_skipped += head->left->nnode;
+			if (compared == 0) {
+				if (index_of_key != NULL) {
+					*index_of_key = le_valued_keys_skipped;
+				}
+				return (void *)head->value;
+			} else {
+				le_valued_keys_skipped += 1;
+				head = head->right;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+void *dict_get(struct dict *dict, void const *key, int *index_of_key) {
+	if (dict == NULL || key == NULL) {
+		return NULL;
+	}
+
+	if (dict->btree != NULL) {
+		return btree_get(dict->btree, dict->compar, key, index_of_key);
+	}
+	return subtree_get(dict->head, dict->compar, key, index_of_key);
+}
+void TestDict_get(CuTest *tc) {
+	struct dict *dict = dict_init(compare_pointers);
+	CuAssertPtrNotNull(tc, dict);
+
+	int index = 42;
+	CuAssertPtrEquals(tc, NULL, dict_get(dict, (void *)0xdeadbeef, &index));
+	CuAssertPtrEquals(tc, NULL, dict_get(dict, (void *)0xdeadbeef, NULL));
+
+	int i;
+	for (i = 0; i < 7; i++) {
+		unsigned long set_key = i+1;
+		CuAssertPtrEquals(tc, NULL, dict_get(dict, (void *)set_key, &index));
+		CuAssertPtrEquals(tc, NULL, dict_get(dict, (void *)set_key, NULL));
+
+		CuAssertIntEquals(tc, 0, dict_put(dict, (void *)set_key, (void *)set_key, NULL, NULL));
+
+		int j;
+		for (j = 0; j < i; j++) {
+			unsigned long get_key = j+1;
+			CuAssertPtrEquals(tc, (void *)get_key, dict_get(dict, (void *)get_key, NULL));
+			CuAssertPtrEquals(tc, (void *)get_key, dict_get(dict, (void *)get_key, &index));
+			CuAssertIntEquals(tc, j, index);
+		}
+	}
+
+	dict_destroy(dict);
+}
+
+
+/*
+ * restores the levels below head after a node was removed from one of its
+ * subtrees, with up to three skews and two splits along the right spine.
+ */
+static struct subtree *subtree_rebalance_removed(struct subtree *head, struct dict_pool *pool) {
+	assert(head != NULL && !EOT(head));
+	node_reconstruct_nnode(head);
+
+	int level = (head->left->level < head->right->level ? head->left->level : head->right->level) + 1;
+	if (level < head->level) {
+		head->level = level;
+		if (level < head->right->level) {
+			head->right = node_own(pool, head->right);
+			head->right->level = level;
+		}
+	}
+
+	head = skew(pool, head);
+	if (!EOT(head->right)) {
+		head->right = skew(pool, head->right);
+		if (!EOT(head->right->right) && skew_needed(head->right->right)) {
+			head->right = node_own(pool, head->right);
+			head->right->right = skew(pool, head->right->right);
+		}
+	}
+	head = split(pool, head);
+	if (!EOT(head->right)) {
+		head->right = split(pool, head->right);
+	}
+
+	return head;
+}
+
+
+/*
+ * unlinks the node with the greatest key into *max, which keeps the
+ * reference of its parent and gives another one to its left child.
+ */
+static struct subtree *subtree_remove_max(struct subtree *head, struct dict_pool *pool, struct subtree **max) {
+	assert(head != NULL && !EOT(head));
+
+	if (EOT(head->right)) {
+		*max = head;
+		node_ref(head->left);
+		return head->left;
+	}
+
+	head = node_own(pool, head);
+	head->right = subtree_remove_max(head->right, pool, max);
+	return subtree_rebalance_removed(head, pool);
+}
+
+
+/*
+ * a node with a left child takes over the pair of its predecessor, whose
+ * node is removed instead. without a left child the node is at level 1, so
+ * the right child, if any, is a leaf that may take its place.
+ */
+static struct subtree *subtree_remove(struct subtree *head, struct dict_pool *pool, dict_comparator compar, void const *key, void **nkey, void **nvalue, int *status) {
+	if (EOT(head)) {
+		*status = ESRCH;
+		return head;
+	}
+
+	head = node_own(pool, head);
+	int compared = compar(key, head->key);
+	if (compared < 0) {
+		head->left = subtree_remove(head->left, pool, compar, key, nkey, nvalue, status);
+	} else if (compared > 0) {
+		head->right = subtree_remove(head->right, pool, compar, key, nkey, nvalue, status);
+	} else {
+		if (nkey != NULL) {
+			*nkey = (void *)head->key;
+		}
+		if (nvalue != NULL) {
+			*nvalue = (void *)head->value;
+		}
+
+		if (EOT(head->left)) {
+			struct subtree *right = head->right;
+			node_ref(right);
+			node_release(pool, head);
+			return right;
+		}
+
+		struct subtree *predecessor;
+		head->left = subtree_remove_max(head->left, pool, &predecessor);
+		head->key = predecessor->key;
+		head->value = predecessor->value;
+		node_release(pool, predecessor);
+	}
+
+	if (*status != 0) {
+		return head;
+	}
+	return subtree_rebalance_removed(head, pool);
+}
+
+int dict_remove(struct dict *dict, void const *key, void **nkey, void **nvalue) {
+	if (dict == NULL || key == NULL) {
+		return EINVAL;
+	}
+
+	if (dict->btree != NULL) {
+		return btree_remove(dict->btree, dict->compar, key, nkey, nvalue);
+	}
+
+	struct dict_snapshot *version = NULL;
+	if (atomic_load(&dict->current) != NULL) {
+		// the path is copied on the way down, so a missing key is found out before
+		int index = -1;
+		subtree_get(dict->head, dict->compar, key, &index);
+		if (index < 0) {
+			return ESRCH;
+		}
+		if ((version = dict_persistent_begin(dict)) == NULL) {
+			return ENOMEM;
+		}
+	}
+
+	int status = 0;
+	struct subtree *head = subtree_remove(dict->head, dict->pool, dict->compar, key, nkey, nvalue, &status);
+
+	if (version != NULL) {
+		assert(status == 0);
+		dict_persistent_publish(dict, version, head);
+	} else {
+		dict->head = head;
+	}
+
+	return status;
+}
+void TestDict_remove(CuTest *tc) {
+	enum {
+		NKEY = 200,
+	};
+	struct dict *dict = dict_init(compare_pointers);
+	CuAssertPtrNotNull(tc, dict);
+
+	void *rkey = (void *)42, *rvalue = (void *)42;
+	CuAssertIntEquals(tc, ESRCH, dict_remove(dict, (void *)1, &rkey, &rvalue));
+	CuAssertPtrEquals(tc, (void *)42, rkey);
+
+	// keys in a scrambled order, since 7 is coprime to NKEY
+	int i;
+	for (i = 0; i < NKEY; i++) {
+		unsigned long key = (7*i)%NKEY + 1;
+		CuAssertIntEquals(tc, 0, dict_put(dict, (void *)key, (void *)(key+1000), NULL, NULL));
+	}
+	CuAssertIntEquals(tc, NKEY, subtree_check(dict->head, compare_pointers, NULL, NULL));
+
+	for (i = 0; i < NKEY; i++) {
+		unsigned long key = (13*i)%NKEY + 1;
+		CuAssertIntEquals(tc, 0, dict_remove(dict, (void *)key, &rkey, &rvalue));
+		CuAssertPtrEquals(tc, (void *)key, rkey);
+		CuAssertPtrEquals(tc, (void *)(key+1000), rvalue);
+		CuAssertIntEquals(tc, ESRCH, dict_remove(dict, (void *)key, NULL, NULL));
+		CuAssertPtrEquals(tc, NULL, dict_get(dict, (void *)key, NULL));
+		CuAssertIntEquals(tc, NKEY-i-1, subtree_check(dict->head, compare_pointers, NULL, NULL));
+
+		// the order of the rest is kept
+		int j, index;
+		void *previous = NULL;
+		for (j = 0; j < NKEY-i-1; j++) {
+			CuAssertIntEquals(tc, 0, dict_select(dict, j, &rkey, &rvalue));
+			CuAssertTrue(tc, rkey > previous);
+			CuAssertPtrEquals(tc, (char *)rkey + 1000, rvalue);
+			CuAssertPtrEquals(tc, rvalue, dict_get(dict, rkey, &index));
+			CuAssertIntEquals(tc, j, index);
+			previous = rkey;
+		}
+	}
+	CuAssertIntEquals(tc, 0, dict_size(dict));
+
+	CuAssertIntEquals(tc, EINVAL, dict_remove(NULL, (void *)1, NULL, NULL));
+	CuAssertIntEquals(tc, EINVAL, dict_remove(dict, NULL, NULL, NULL));
+
+	dict_destroy(dict);
+}
+
+
+void TestDictPool(CuTest *tc) {
+	enum {
+		NKEY = 100,
+	};
+	struct dict_pool *pool = dict_pool_init();
+	CuAssertPtrNotNull(tc, pool);
+	struct dict *a = dict_init_with_pool(compare_pointers, pool), *b = dict_init_with_pool(compare_pointers, pool);
+	CuAssertPtrNotNull(tc, a);
+	CuAssertPtrNotNull(tc, b);
+
+	unsigned long key;
+	for (key = 1; key <= NKEY; key++) {
+		CuAssertIntEquals(tc, 0, dict_put(a, (void *)key, (void *)key, NULL, NULL));
+		CuAssertIntEquals(tc, 0, dict_put(b, (void *)key, (void *)key, NULL, NULL));
+	}
+	CuAssertIntEquals(tc, NKEY, subtree_check(a->head, compare_pointers, NULL, NULL));
+	CuAssertIntEquals(tc, NKEY, subtree_check(b->head, compare_pointers, NULL, NULL));
+	CuAssertPtrEquals(tc, NULL, a->own_pool.slabs);
+
+	// the slabs grow, so the nodes of both dicts fit in a handful of them
+	int nslab = 0, nnode = 0;
+	struct dict_slab *slab;
+	for (slab = pool->slabs; slab != NULL; slab = slab->next) {
+		nslab++;
+		nnode += slab->nused;
+	}
+	CuAssertIntEquals(tc, 2*NKEY, nnode);
+	CuAssertTrue(tc, nslab <= 3);
+
+	// a removed node is the next one to be put, in any dict of the pool
+	struct subtree *node = a->head;
+	while (!EOT(node->left)) {
+		node = node->left;
+	}
+	CuAssertIntEquals(tc, 0, dict_remove(a, (void *)1, NULL, NULL));
+	CuAssertPtrEquals(tc, node, pool->free);
+	CuAssertIntEquals(tc, 0, dict_put(b, (void *)(NKEY+1), NULL, NULL, NULL));
+	CuAssertPtrEquals(tc, NULL, pool->free);
+
+	// the nodes of a destroyed dict are put by the others without new slabs
+	slab = pool->slabs;
+	dict_destroy(a);
+	for (key = NKEY+2; key <= 2*NKEY; key++) {
+		CuAssertIntEquals(tc, 0, dict_put(b, (void *)key, (void *)key, NULL, NULL));
+	}
+	CuAssertPtrEquals(tc, slab, pool->slabs);
+	CuAssertIntEquals(tc, 2*NKEY, subtree_check(b->head, compare_pointers, NULL, NULL));
+
+	dict_destroy(b);
+	dict_pool_destroy(pool);
+	dict_pool_destroy(NULL);
+}
+
+
+void TestDictPoolBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		NKEY = 1 << 16,
+		NITERATION = 10,
+	};
+
+	struct dict_pool *pool = dict_pool_init();
+	CuAssertPtrNotNull(tc, pool);
+	int k;
+	for (k = 0; k < 2; k++) {
+		char description[64];
+		snprintf(description, sizeof(description), "%s pool put, churn and destroy 2^16", k == 0 ? "own" : "shared");
+		TIMED_BLOCK(NITERATION, description) {
+			struct dict *dict = dict_init_with_pool(compare_pointers, k == 0 ? NULL : pool);
+			unsigned long i;
+			for (i = 0; i < NKEY; i++) {
+				unsigned long key = (7919*i)%NKEY + 1;
+				dict_put(dict, (void *)key, (void *)key, NULL, NULL);
+			}
+			for (i = 0; i < NKEY; i++) { // remove one, put another
+				unsigned long key = (7919*i)%NKEY + 1;
+				dict_remove(dict, (void *)key, NULL, NULL);
+				dict_put(dict, (void *)(key+NKEY), (void *)key, NULL, NULL);
+			}
+			dict_destroy(dict);
+		}
+	}
+	dict_pool_destroy(pool);
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
+
+
+static int subtree_select(struct subtree *head, int i, void **key, void **value) {
+	assert(key != NULL && value != NULL);
+
+	if (i < 0) {
+		i += head->nnode;
+	}
+
+	while (!EOT(head)) {
+		int i_head = head->left->nnode;
+
+		if (i < i_head) {
+			head = head->left;
+		} else {
+			if (i > i_head) {
+				i -= i_head+1;
+				head = head->right;
+			} else {
+				*key = (void *)head->key;
+				*value = (void *)head->value;
+				return 0;
+			}
+		}
+
+	}
+
+	return ESRCH;
+}
+
+int dict_select(struct dict *dict, int i, void **key, void **value) {
+	if (dict == NULL || key == NULL || value == NULL) {
+		return EINVAL;
+	}
+
+	if (dict->btree != NULL) {
+		return btree_select(dict->btree, i, key, value);
+	}
+	return subtree_select(dict->head, i, key, value);
+}
+void TestDict_select(CuTest *tc) {
+	struct dict *dict = dict_init(compare_pointers);
+	CuAssertPtrNotNull(tc, dict);
+
+	void *rkey = (void*)42, *rvalue = (void*)42;
+	CuAssertIntEquals(tc, ESRCH, dict_select(dict, 0, &rkey, &rvalue));
+
+	int i;
+	for (i = 0; i < 7; i++) {
+		unsigned long set_key = i+1;
+		unsigned long set_value = set_key + 1000;
+		CuAssertIntEquals(tc, ESRCH, dict_select(dict, i, &rkey, &rvalue));
+		CuAssertIntEquals(tc, ESRCH, dict_select(dict, -i-1, &rkey, &rvalue));
+
+		CuAssertIntEquals(tc, 0, dict_put(dict, (void *)set_key, (void *)set_value, NULL, NULL));
+
+		CuAssertIntEquals(tc, 0, dict_select(dict, i, &rkey, &rvalue));
+		CuAssertPtrEquals(tc, (void *)set_key, rkey);
+		CuAssertPtrEquals(tc, (void *)set_value, rvalue);
+
+		int j;
+		for (j = 0; j < i; j++) {
+			unsigned long get_key = j+1;
+			unsigned long get_value = get_key + 1000;
+
+			CuAssertIntEquals(tc, 0, dict_select(dict, j, &rkey, &rvalue));
+			CuAssertPtrEquals(tc, (void *)get_key, rkey);
+			CuAssertPtrEquals(tc, (void *)get_value, rvalue);
+
+			CuAssertIntEquals(tc, 0, dict_select(dict, -i-1+j, &rkey, &rvalue));
+			CuAssertPtrEquals(tc, (void *)get_key, rkey);
+			CuAssertPtrEquals(tc, (void *)get_value, rvalue);
+		}
+	}
+
+	dict_destroy(dict);
+}
+
+
+static int subtree_for_each(struct subtree *head, dict_action action, void *state) {
+	if (EOT(head)) {
+		return 0;
+	}
+
+	int status = subtree_for_each(head->left, action, state);
+	if (status != 0) {
+		return status;
+	}
+	status = action(head->key, head->value, state);
+	if (status != 0) {
+		return status;
+	}
+	return subtree_for_each(head->right, action, state);
+}
+
+int dict_for_each(struct dict *dict, dict_action action, void *state) {
+	if (dict == NULL || action == NULL) {
+		return EINVAL;
+	}
+
+	if (dict->btree != NULL) {
+		return btree_for_each(dict->btree, action, state);
+	}
+	return subtree_for_each(dict->head, action, state);
 }
-void TestSubtree_reconstruct_nnode(CuTest *tc) {
-	struct subtree nodes[NNODE_3_LAYER_BALANCED_TREE];
-	struct subtree *head = dummy_3_layer_balanced_tree(nodes);
 
-	int i;
-	for (i = 0; i < NNODE_3_LAYER_BALANCED_TREE; i++) {
-		(nodes+i)->nnode = 0;
-	}
 
-	CuAssertIntEquals(tc, 0, subtree_size(head));
-	subtree_reconstruct_nnode(head);
-	CuAssertIntEquals(tc, NNODE_3_LAYER_BALANCED_TREE, subtree_size(head));
+struct dict_action_dump_state {
+	int n;
+	void const *keys[NNODE_3_LAYER_BALANCED_TREE];
+	void const *values[NNODE_3_LAYER_BALANCED_TREE];
+};
+static int dict_action_dump(void const *key, void const *value, void *state) {
+	struct dict_action_dump_state *known_state = (struct dict_action_dump_state *)state;
+	int n = known_state->n++;
+	known_state->keys[n] = key;
+	known_state->values[n] = value;
+
+	return 0;
 }
 
+void TestDict_for_each(CuTest *tc) {
+	struct dict *dict = dict_init(compare_pointers);
+	CuAssertPtrNotNull(tc, dict);
 
-static struct subtree *subtree_rotate_right(struct subtree *head) {
-	assert(head != NULL);
-	assert(!EOT(head) && !EOT(head->left));
+	int i;
+	for (i = 0; i < NNODE_3_LAYER_BALANCED_TREE; i++) {
+		unsigned long set_key = i+1;
+		unsigned long set_value = set_key+1000;
 
-	struct subtree *left = head->left;
-	head->left = left->right;
-	left->right = head;
+		CuAssertIntEquals(tc, 0, dict_put(dict, (void *)set_key, (void *)set_value, NULL, NULL));
 
-	node_reconstruct_nnode(head);
-	node_reconstruct_nnode(left);
+		struct dict_action_dump_state state = {};
+		state.n = 0;
+		dict_for_each(dict, dict_action_dump, &state);
+		CuAssertIntEquals(tc, i+1, state.n);
 
-	return left;
+		int j;
+		for (j = 0; j < i; j++) {
+			unsigned long get_key = j+1;
+			unsigned long get_value = get_key+1000;
+
+			CuAssertPtrEquals(tc, (void *)get_key, state.keys[j]);
+			CuAssertPtrEquals(tc, (void *)get_value, state.values[j]);
+		}
+	}
 }
-void TestSubtree_rotate_right(CuTest *tc) {
-	struct subtree nodes[NNODE_3_LAYER_BALANCED_TREE];
-	struct subtree *head = dummy_3_layer_balanced_tree(nodes);
 
-	head = subtree_rotate_right(head);
-	CuAssertPtrEquals(tc, (void const *)1, head->left->key);
-	CuAssertPtrEquals(tc, (void const *)2, head->key);
-	CuAssertPtrEquals(tc, (void const *)3, head->right->left->key);
-	CuAssertPtrEquals(tc, (void const *)4, head->right->key);
-	CuAssertPtrEquals(tc, (void const *)5, head->right->right->left->key);
-	CuAssertPtrEquals(tc, (void const *)6, head->right->right->key);
-	CuAssertPtrEquals(tc, (void const *)7, head->right->right->right->key);
 
-	subtree_reconstruct_nnode(head);
-	CuAssertIntEquals(tc, NNODE_3_LAYER_BALANCED_TREE, subtree_size(head));
+struct dict_action_abort_after_state {
+	int ncall;
+	int abort_after;
+};
+static int dict_action_abort_after(void const *key, void const *value, void *state) {
+	struct dict_action_abort_after_state *known_state = (struct dict_action_abort_after_state *)state;
+	known_state->ncall++;
+	return known_state->ncall >= known_state->abort_after ? known_state->abort_after : 0;
+	(void)(key), (void)(value);
 }
 
+void TestDict_for_eachWithAbortion(CuTest *tc) {
+	struct dict *dict = dict_init(compare_pointers);
+	CuAssertPtrNotNull(tc, dict);
 
-static struct subtree *subtree_rotate_left(struct subtree *head) {
-	assert(head != NULL);
-	assert(!EOT(head) && !EOT(head->right));
+	int i;
+	for (i = 0; i < NNODE_3_LAYER_BALANCED_TREE; i++) {
+		unsigned long key = i+1;
+		CuAssertIntEquals(tc, 0, dict_put(dict, (void *)key, (void *)key, NULL, NULL));
 
-	struct subtree *right = head->right;
-	head->right = right->left;
-	right->left = head;
+		int j;
+		for (j = 1; j < i; j++) { // cannot abort before the zeroth call
+			struct dict_action_abort_after_state state;
+			state.ncall = 0;
+			state.abort_after = j;
+			CuAssertIntEquals(tc, j, dict_for_each(dict, dict_action_abort_after, &state));
 
-	node_reconstruct_nnode(head);
-	node_reconstruct_nnode(right);
+			CuAssertIntEquals(tc, j, state.ncall);
+		}
 
-	return right;
+
+	}
 }
-void TestSubtree_rotate_left(CuTest *tc) {
-	struct subtree nodes[NNODE_3_LAYER_BALANCED_TREE];
-	struct subtree *head = dummy_3_layer_balanced_tree(nodes);
 
-	head = subtree_rotate_left(head);
-	CuAssertPtrEquals(tc, (void const *)1, head->left->left->left->key);
-	CuAssertPtrEquals(tc, (void const *)2, head->left->left->key);
-	CuAssertPtrEquals(tc, (void const *)3, head->left->left->right->key);
-	CuAssertPtrEquals(tc, (void const *)4, head->left->key);
-	CuAssertPtrEquals(tc, (void const *)5, head->left->right->key);
-	CuAssertPtrEquals(tc, (void const *)6, head->key);
-	CuAssertPtrEquals(tc, (void const *)7, head->right->key);
 
-	subtree_reconstruct_nnode(head);
-	CuAssertIntEquals(tc, NNODE_3_LAYER_BALANCED_TREE, subtree_size(head));
+/*
+ * a snapshot is taken between two writes, so the version it refers to has
+ * its nodes for as long as the snapshot is not released. taking and
+ * releasing one only touches counters, and reading it takes no locks.
+ *
+ * the version that was loaded may be retired, reclaimed and even reused
+ * before it is referenced, so the count is only increased while it is not
+ * 0, and the version is kept only if it still is the current one. a writer
+ * may make the reader try again, but never waits for it.
+ */
+struct dict_snapshot *dict_snapshot_take(struct dict *dict) {
+	if (dict == NULL) {
+		return NULL;
+	}
+
+	for (;;) {
+		struct dict_snapshot *version = atomic_load(&dict->current);
+		if (version == NULL) {
+			return NULL;
+		}
+		int nref = atomic_load(&version->nref);
+		if (nref > 0 && atomic_compare_exchange_weak(&version->nref, &nref, nref+1)) {
+			if (atomic_load(&dict->current) == version) {
+				return version;
+			}
+			atomic_fetch_sub(&version->nref, 1);
+		}
+	}
 }
 
+void dict_snapshot_release(struct dict_snapshot *snapshot) {
+	if (snapshot != NULL) {
+		atomic_fetch_sub(&snapshot->nref, 1);
+	}
+}
 
-static struct subtree *skew(struct subtree *head) {
-	assert(head != NULL && !EOT(head));
+int dict_snapshot_size(struct dict_snapshot *snapshot) {
+	if (snapshot == NULL) {
+		return -EINVAL;
+	}
+	return subtree_size(snapshot->head);
+}
 
-	if (head->level == head->left->level) {
-		subtree_rotate_right(head);
+void *dict_snapshot_get(struct dict_snapshot *snapshot, const void *key, int *index_of_key) {
+	if (snapshot == NULL || key == NULL) {
+		return NULL;
 	}
+	return subtree_get(snapshot->head, snapshot->compar, key, index_of_key);
+}
 
-	return head;
+int dict_snapshot_select(struct dict_snapshot *snapshot, int i, void **key, void **value) {
+	if (snapshot == NULL || key == NULL || value == NULL) {
+		return EINVAL;
+	}
+	return subtree_select(snapshot->head, i, key, value);
 }
-static struct subtree *split(struct subtree *head) {
-	assert(head != NULL && !EOT(head));
 
-	if (head->level == head->right->right->level) {
-		head = subtree_rotate_left(head);
-		head->level++;
+int dict_snapshot_for_each(struct dict_snapshot *snapshot, dict_action action, void *state) {
+	if (snapshot == NULL || action == NULL) {
+		return EINVAL;
 	}
+	return subtree_for_each(snapshot->head, action, state);
+}
 
-	return head;
+
+/* the nodes carved from the slabs of pool that are not on its free list */
+static int dict_pool_nlive(const struct dict_pool *pool) {
+	int nlive = -pool->nfree;
+	const struct dict_slab *slab;
+	for (slab = pool->slabs; slab != NULL; slab = slab->next) {
+		nlive += slab->nused;
+	}
+	return nlive;
 }
 
+void TestDictSnapshot(CuTest *tc) {
+	enum {
+		NKEY = 200,
+		NSNAPSHOT = 4,
+	};
+	struct dict *dict = dict_init_persistent(compare_pointers);
+	CuAssertPtrNotNull(tc, dict);
 
-static struct subtree *subtree_put(struct subtree *head, dict_comparator compar, void const *key, void const *value, void **nkey, void **nvalue, int *status) {
-	if (EOT(head)) {
-		struct subtree *new = node_init(key, value);
-		if (new == NULL) {
-			*status = errno != 0 ? errno : -1;
-			return &end_of_tree_sentinel;
-		}
-		if (nkey != NULL) {
-			*nkey = NULL;
-		}
-		if (nvalue != NULL) {
-			*nvalue = NULL;
+	// every NKEY/NSNAPSHOT puts a snapshot is taken, which keeps the keys it had
+	struct dict_snapshot *snapshots[NSNAPSHOT];
+	unsigned long key;
+	for (key = 1; key <= NKEY; key++) {
+		if ((key-1) % (NKEY/NSNAPSHOT) == 0) {
+			snapshots[(key-1) / (NKEY/NSNAPSHOT)] = dict_snapshot_take(dict);
 		}
-		return new;
+		int nlive = dict_pool_nlive(dict->pool);
+		CuAssertIntEquals(tc, 0, dict_put(dict, (void *)key, (void *)(key+1000), NULL, NULL));
+		// the versions share all but the copied path
+		CuAssertTrue(tc, dict_pool_nlive(dict->pool) - nlive <= 8*(2*dict->head->level + 2));
 	}
+	CuAssertIntEquals(tc, NKEY, subtree_check(dict->head, compare_pointers, NULL, NULL));
+	CuAssertTrue(tc, dict_pool_nlive(dict->pool) < 2*NKEY);
 
-	int compared = compar(key, head->key);
-	if (compared < 0) {
-		head->left = subtree_put(head->left, compar, key, value, nkey, nvalue, status);
-	} else if (compared == 0) {
-		if (nkey != NULL) {
-			*nkey = (void *)head->key;
-		}
-		if (nvalue != NULL) {
-			*nvalue = (void *)head->value;
+	int i;
+	for (i = 0; i < NSNAPSHOT; i++) {
+		int n = i*(NKEY/NSNAPSHOT);
+		CuAssertIntEquals(tc, n, dict_snapshot_size(snapshots[i]));
+		CuAssertIntEquals(tc, n, subtree_check(snapshots[i]->head, compare_pointers, NULL, NULL));
+		int index = -1;
+		CuAssertPtrEquals(tc, NULL, dict_snapshot_get(snapshots[i], (void *)(unsigned long)(n+1), &index));
+		CuAssertIntEquals(tc, -1, index);
+		if (n > 0) {
+			void *rkey, *rvalue;
+			CuAssertPtrEquals(tc, (void *)(unsigned long)(n+1000), dict_snapshot_get(snapshots[i], (void *)(unsigned long)n, &index));
+			CuAssertIntEquals(tc, n-1, index);
+			CuAssertIntEquals(tc, 0, dict_snapshot_select(snapshots[i], -1, &rkey, &rvalue));
+			CuAssertPtrEquals(tc, (void *)(unsigned long)n, rkey);
+			struct dict_action_abort_after_state state = {0, n};
+			CuAssertIntEquals(tc, n, dict_snapshot_for_each(snapshots[i], dict_action_abort_after, &state));
 		}
-		head->key = key;
-		head->value = value;
-		return head;
-	} else {
-		head->right = subtree_put(head->right, compar, key, value, nkey, nvalue, status);
 	}
 
-	node_reconstruct_nnode(head);
+	// removes keep the snapshots too, and a missing key copies nothing
+	struct dict_snapshot *full = dict_snapshot_take(dict);
+	for (key = 1; key <= NKEY; key += 2) {
+		CuAssertIntEquals(tc, 0, dict_remove(dict, (void *)key, NULL, NULL));
+		CuAssertIntEquals(tc, NKEY - (int)key/2 - 1, subtree_check(dict->head, compare_pointers, NULL, NULL));
+	}
+	int nlive = dict_pool_nlive(dict->pool);
+	CuAssertIntEquals(tc, ESRCH, dict_remove(dict, (void *)1, NULL, NULL));
+	CuAssertIntEquals(tc, nlive, dict_pool_nlive(dict->pool));
+	CuAssertIntEquals(tc, NKEY, subtree_check(full->head, compare_pointers, NULL, NULL));
+	CuAssertIntEquals(tc, NKEY/2, dict_size(dict));
+
+	// the released versions go with the next write, until only the dict's is left
+	for (i = 0; i < NSNAPSHOT; i++) {
+		dict_snapshot_release(snapshots[i]);
+	}
+	dict_snapshot_release(full);
+	CuAssertIntEquals(tc, 0, dict_put(dict, (void *)1, NULL, NULL, NULL));
+	CuAssertPtrEquals(tc, NULL, dict->retired);
+	CuAssertIntEquals(tc, NKEY/2 + 1, dict_pool_nlive(dict->pool));
+	CuAssertIntEquals(tc, NKEY/2 + 1, subtree_check(dict->head, compare_pointers, NULL, NULL));
+
+	// only persistent dicts have snapshots
+	struct dict *plain = dict_init(compare_pointers);
+	CuAssertPtrEquals(tc, NULL, dict_snapshot_take(plain));
+	CuAssertPtrEquals(tc, NULL, dict_snapshot_take(NULL));
+	CuAssertIntEquals(tc, -EINVAL, dict_snapshot_size(NULL));
+	CuAssertIntEquals(tc, EINVAL, dict_snapshot_for_each(NULL, dict_action_abort_after, NULL));
+	dict_snapshot_release(NULL);
+
+	dict_destroy(plain);
+	dict_destroy(dict);
+}
 
-	head = skew(head);
-	head = split(head);
 
-	return head;
+struct dict_snapshot_reader {
+	struct dict *dict;
+	atomic_int *done;
+	int nsnapshot;
+	int nbad;
+};
+struct dict_action_consecutive_state {
+	unsigned long last;
+	int ok;
+};
+static int dict_action_consecutive(void const *key, void const *value, void *state) {
+	struct dict_action_consecutive_state *known_state = state;
+	known_state->ok &= known_state->last == 0 || (unsigned long)key == known_state->last+1;
+	known_state->last = (unsigned long)key;
+	return 0;
+	(void)value;
+}
+static void *dict_snapshot_reader_run(void *arg) {
+	struct dict_snapshot_reader *reader = arg;
+	while (!atomic_load(reader->done)) {
+		struct dict_snapshot *snapshot = dict_snapshot_take(reader->dict);
+		struct dict_action_consecutive_state state = {0, 1};
+		dict_snapshot_for_each(snapshot, dict_action_consecutive, &state);
+		int n = dict_snapshot_size(snapshot);
+		void *first = NULL, *value;
+		if (n > 0) {
+			dict_snapshot_select(snapshot, 0, &first, &value);
+		}
+		reader->nbad += !state.ok || (n > 0 && state.last - (unsigned long)first + 1 != (unsigned long)n);
+		reader->nsnapshot++;
+		dict_snapshot_release(snapshot);
+	}
+	return NULL;
 }
 
-int dict_put(struct dict *dict, void const *key, void const *value, void **nkey, void **nvalue) {
-	if (dict == NULL || key == NULL) {
-		return EINVAL;
+/* while the writer puts and removes keys in order, the readers see runs of consecutive keys */
+void TestDictSnapshotThreads(CuTest *tc) {
+	enum {
+		NKEY = 20000,
+		NREADER = 4,
+	};
+	struct dict *dict = dict_init_persistent(compare_pointers);
+	CuAssertPtrNotNull(tc, dict);
+
+	atomic_int done;
+	atomic_init(&done, 0);
+	struct dict_snapshot_reader readers[NREADER];
+	pthread_t threads[NREADER];
+	int i;
+	for (i = 0; i < NREADER; i++) {
+		readers[i] = (struct dict_snapshot_reader){dict, &done, 0, 0};
+		CuAssertIntEquals(tc, 0, pthread_create(&threads[i], NULL, dict_snapshot_reader_run, &readers[i]));
 	}
 
-	int status = 0;
-	struct subtree *head = subtree_put(dict->head, dict->compar, key, value, nkey, nvalue, &status);
-	if (status != 0) {
-		return status;
+	// a reader holds one version at a time, so the others are reclaimed right away however busy the readers are
+	int nretired_max = 0;
+	unsigned long key;
+	for (key = 1; key <= 3*NKEY/2; key++) {
+		if (key <= NKEY) {
+			CuAssertIntEquals(tc, 0, dict_put(dict, (void *)key, NULL, NULL, NULL));
+		} else {
+			CuAssertIntEquals(tc, 0, dict_remove(dict, (void *)(key-NKEY), NULL, NULL));
+		}
+		int nretired = 0;
+		struct dict_snapshot *version;
+		for (version = dict->retired; version != NULL; version = version->next) {
+			nretired++;
+		}
+		nretired_max = nretired > nretired_max ? nretired : nretired_max;
 	}
+	atomic_store(&done, 1);
+	CuAssertTrue(tc, nretired_max <= NREADER);
+
+	int nsnapshot = 0;
+	for (i = 0; i < NREADER; i++) {
+		pthread_join(threads[i], NULL);
+		CuAssertIntEquals(tc, 0, readers[i].nbad);
+		nsnapshot += readers[i].nsnapshot;
+	}
+	CuAssertTrue(tc, nsnapshot > 0);
+	CuAssertIntEquals(tc, NKEY/2, subtree_check(dict->head, compare_pointers, NULL, NULL));
 
-	dict->head = head;
+	// with the readers gone the next write frees every old version
+	CuAssertIntEquals(tc, 0, dict_put(dict, (void *)1, NULL, NULL, NULL));
+	CuAssertPtrEquals(tc, NULL, dict->retired);
+	CuAssertIntEquals(tc, NKEY/2 + 1, dict_pool_nlive(dict->pool));
 
-	return 0;
+	dict_destroy(dict);
 }
 
-void TestDict_put(CuTest *tc) {
-	struct dict *dict = dict_init(compare_pointers);
-	CuAssertPtrNotNull(tc, dict);
 
+void TestDictSnapshotBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		NKEY = 1 << 16,
+		NITERATION = 10,
+	};
+
+	int k;
+	for (k = 0; k < 2; k++) {
+		char description[64];
+		snprintf(description, sizeof(description), "%s put and remove 2^16", k == 0 ? "in place" : "persistent");
+		TIMED_BLOCK(NITERATION, description) {
+			struct dict *dict = k == 0 ? dict_init(compare_pointers) : dict_init_persistent(compare_pointers);
+			unsigned long i;
+			for (i = 0; i < NKEY; i++) {
+				unsigned long key = (7919*i)%NKEY + 1;
+				dict_put(dict, (void *)key, (void *)key, NULL, NULL);
+			}
+			for (i = 0; i < NKEY; i++) {
+				unsigned long key = (7919*i)%NKEY + 1;
+				dict_remove(dict, (void *)key, NULL, NULL);
+			}
+			dict_destroy(dict);
+		}
+	}
+
+	struct dict *dict = dict_init_persistent(compare_pointers);
+	unsigned long i;
+	for (i = 1; i <= NKEY; i++) {
+		dict_put(dict, (void *)i, (void *)i, NULL, NULL);
+	}
+	TIMED_BLOCK(NITERATION, "dict_snapshot_take and release 2^16") {
+		for (i = 0; i < NKEY; i++) {
+			dict_snapshot_release(dict_snapshot_take(dict));
+		}
+	}
+	struct dict_snapshot *snapshot = dict_snapshot_take(dict);
+	CuAssertIntEquals(tc, NKEY, dict_snapshot_size(snapshot));
+	dict_snapshot_release(snapshot);
+	CuAssertIntEquals(tc, 0, dict_remove(dict, (void *)1, NULL, NULL));
+	CuAssertPtrEquals(tc, NULL, dict->retired);
+	dict_destroy(dict);
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
+
+
+/*
+ * a cursor is at a pair of the dict or off it. for the aa tree it has the
+ * path from the head down to the node of the pair, since the nodes have no
+ * parent pointers, and the next or previous node is below the node or up
+ * the path. each node is pushed and popped at most once in a walk, so a
+ * step is O(1) amortised. for the b+-tree it has the leaf and the index in
+ * it, and the leaves are linked both ways.
+ */
+enum {
+	DICT_CURSOR_MAX_DEPTH = 64, // the height of an aa tree is at most 2*log2(nnode+1)
+};
+
+struct dict_cursor {
+	struct dict *dict;
+	int depth; // 0 when off
+	struct subtree *path[DICT_CURSOR_MAX_DEPTH];
+	const struct btree_leaf *leaf; // NULL when off
 	int i;
-	for (i = 1; i <= 7; i++) {
-		unsigned long wannabe_pointer = i;
-		void *nkey = (void*)42, *nvalue = (void*)42;
-		CuAssertIntEquals(tc, 0, dict_put(dict, (void *)wannabe_pointer, (void *)0x1337, &nkey, &nvalue));
-		CuAssertIntEquals(tc, i, dict_size(dict));
-		CuAssertPtrEquals(tc, NULL, nkey);
-		CuAssertPtrEquals(tc, NULL, nvalue);
+};
 
-		CuAssertIntEquals(tc, 0, dict_put(dict, (void *)wannabe_pointer, NULL, &nkey, &nvalue));
-		CuAssertIntEquals(tc, i, dict_size(dict));
-		CuAssertPtrEquals(tc, (void *)wannabe_pointer, nkey);
-		CuAssertPtrEquals(tc, (void *)0x1337, nvalue);
+
+struct dict_cursor *dict_cursor_init(struct dict *dict) {
+	if (dict == NULL) {
+		return NULL;
 	}
 
-	// ensure it is balanced
-	CuAssertPtrEquals(tc, (void const *)1, dict->head->left->left->key);
-	CuAssertPtrEquals(tc, (void const *)2, dict->head->left->key);
-	CuAssertPtrEquals(tc, (void const *)3, dict->head->left->right->key);
-	CuAssertPtrEquals(tc, (void const *)4, dict->head->key);
-	CuAssertPtrEquals(tc, (void const *)5, dict->head->right->left->key);
-	CuAssertPtrEquals(tc, (void const *)6, dict->head->right->key);
-	CuAssertPtrEquals(tc, (void const *)7, dict->head->right->right->key);
+	struct dict_cursor *cursor = malloc(sizeof(*cursor));
+	if (cursor == NULL) {
+		return NULL;
+	}
+
+	cursor->dict = dict;
+	cursor->depth = 0;
+	cursor->leaf = NULL;
+	cursor->i = 0;
+
+	return cursor;
+}
 
-	dict_destroy(dict);
+
+void dict_cursor_destroy(struct dict_cursor *cursor) {
+	free(cursor);
 }
 
 
-static void *subtree_get(struct subtree *head, dict_comparator compar, void const *key, int *index_of_key) {
-	assert(key != NULL);
-	int le_valued_keys_skipped = 0;
+static int dict_cursor_status(const struct dict_cursor *cursor) {
+	return (cursor->dict->btree != NULL ? cursor->leaf != NULL : cursor->depth > 0) ? 0 : ESRCH;
+}
 
+
+/* pushes head and the nodes down its left side, or right side when !left */
+static void dict_cursor_push_side(struct dict_cursor *cursor, struct subtree *head, int left) {
 	while (!EOT(head)) {
-		int compared = compar(key, head->key);
-		if (compared < 0) {
-			head = head->left;
-		} else {
-			le_valued_keys_skipped += head->left->nnode;
-			if (compared == 0) {
-				if (index_of_key != NULL) {
-					*index_of_key = le_valued_keys_skipped;
-				}
-				return (void *)head->value;
-			} else {
-				le_valued_keys_skipped += 1;
-				head = head->right;
-			}
-		}
+		assert(cursor->depth < DICT_CURSOR_MAX_DEPTH);
+		cursor->path[cursor->depth++] = head;
+		head = left ? head->left : head->right;
 	}
-
-	return NULL;
 }
 
-void *dict_get(struct dict *dict, void const *key, int *index_of_key) {
-	if (dict == NULL || key == NULL) {
+
+/* the first leaf, or the last one when !first */
+static const struct btree_leaf *btree_end_leaf(const struct btree *tree, int first) {
+	const void *node = tree->root;
+	if (node == NULL) {
 		return NULL;
 	}
 
-	return subtree_get(dict->head, dict->compar, key, index_of_key);
+	int height;
+	for (height = tree->height; height > 0; height--) {
+		const struct btree_inner *inner = node;
+		node = inner->children[first ? 0 : inner->nchild-1];
+	}
+	return node;
 }
-void TestDict_get(CuTest *tc) {
-	struct dict *dict = dict_init(compare_pointers);
-	CuAssertPtrNotNull(tc, dict);
-
-	int index = 42;
-	CuAssertPtrEquals(tc, NULL, dict_get(dict, (void *)0xdeadbeef, &index));
-	CuAssertPtrEquals(tc, NULL, dict_get(dict, (void *)0xdeadbeef, NULL));
 
-	int i;
-	for (i = 0; i < 7; i++) {
-		unsigned long set_key = i+1;
-		CuAssertPtrEquals(tc, NULL, dict_get(dict, (void *)set_key, &index));
-		CuAssertPtrEquals(tc, NULL, dict_get(dict, (void *)set_key, NULL));
 
-		CuAssertIntEquals(tc, 0, dict_put(dict, (void *)set_key, (void *)set_key, NULL, NULL));
+static int dict_cursor_end(struct dict_cursor *cursor, int first) {
+	if (cursor == NULL) {
+		return EINVAL;
+	}
 
-		int j;
-		for (j = 0; j < i; j++) {
-			unsigned long get_key = j+1;
-			CuAssertPtrEquals(tc, (void *)get_key, dict_get(dict, (void *)get_key, NULL));
-			CuAssertPtrEquals(tc, (void *)get_key, dict_get(dict, (void *)get_key, &index));
-			CuAssertIntEquals(tc, j, index);
-		}
+	if (cursor->dict->btree != NULL) {
+		cursor->leaf = btree_end_leaf(cursor->dict->btree, first);
+		cursor->i = first || cursor->leaf == NULL ? 0 : cursor->leaf->nkey-1;
+	} else {
+		cursor->depth = 0;
+		dict_cursor_push_side(cursor, cursor->dict->head, first);
 	}
+	return dict_cursor_status(cursor);
+}
 
-	dict_destroy(dict);
+int dict_cursor_first(struct dict_cursor *cursor) {
+	return dict_cursor_end(cursor, 1);
+}
+
+int dict_cursor_last(struct dict_cursor *cursor) {
+	return dict_cursor_end(cursor, 0);
 }
 
 
 /*
- * removes the key-value pair such that compar(key, node->key) == 0
- *
- * NOTE: the contents of node->key,node->value is untouched and NOT freed
- *
- * returns:
- *   dict == NULL || key == NULL --> EINVAL
- *   key not in dict --> ESRCH
- *   --> 0
- *     nkey != NULL -> *nkey = node->key
- *     nvalue != NULL -> *nvalue = node->value
+ * the first pair with a key >= key, or > key when upper. the aa tree path
+ * is cut back to the last node on it that was such a key.
  */
-extern int dict_remove(struct dict *dict, void const *key, void **nkey, void **nvalue);
+static int dict_cursor_seek(struct dict_cursor *cursor, void const *key, int upper) {
+	if (cursor == NULL || key == NULL) {
+		return EINVAL;
+	}
 
+	struct dict *dict = cursor->dict;
+	int found;
+	if (dict->btree != NULL) {
+		const void *node = dict->btree->root;
+		if (node == NULL) {
+			cursor->leaf = NULL;
+			return ESRCH;
+		}
 
-static int subtree_select(struct subtree *head, int i, void **key, void **value) {
-	assert(key != NULL && value != NULL);
+		int height;
+		for (height = dict->btree->height; height > 0; height--) {
+			const struct btree_inner *inner = node;
+			node = inner->children[btree_search(inner->keys, inner->nchild-1, dict->compar, key, &found)];
+		}
 
-	if (i < 0) {
-		i += head->nnode;
+		const struct btree_leaf *leaf = node;
+		int i = btree_search(leaf->keys, leaf->nkey, dict->compar, key, &found);
+		if (found && !upper) {
+			i--;
+		}
+		if (i == leaf->nkey) {
+			leaf = leaf->next;
+			i = 0;
+		}
+		cursor->leaf = leaf;
+		cursor->i = i;
+	} else {
+		struct subtree *head = dict->head;
+		int depth = 0;
+		cursor->depth = 0;
+		while (!EOT(head)) {
+			assert(cursor->depth < DICT_CURSOR_MAX_DEPTH);
+			cursor->path[cursor->depth++] = head;
+			int compared = dict->compar(key, head->key);
+			if (compared < 0 || (compared == 0 && !upper)) {
+				depth = cursor->depth;
+				head = head->left;
+			} else {
+				head = head->right;
+			}
+		}
+		cursor->depth = depth;
 	}
 
-	while (!EOT(head)) {
-		int i_head = head->left->nnode;
+	return dict_cursor_status(cursor);
+}
 
-		if (i < i_head) {
-			head = head->left;
-		} else {
-			if (i > i_head) {
-				i -= i_head+1;
-				head = head->right;
-			} else {
-				*key = (void *)head->key;
-				*value = (void *)head->value;
-				return 0;
-			}
+int dict_cursor_lower_bound(struct dict_cursor *cursor, void const *key) {
+	return dict_cursor_seek(cursor, key, 0);
+}
+
+int dict_cursor_upper_bound(struct dict_cursor *cursor, void const *key) {
+	return dict_cursor_seek(cursor, key, 1);
+}
+
+
+/* one pair forward, or backward when !forward. off the dict it goes to the first or last pair */
+static int dict_cursor_step(struct dict_cursor *cursor, int forward) {
+	if (cursor == NULL) {
+		return EINVAL;
+	}
+	if (dict_cursor_status(cursor) != 0) {
+		return dict_cursor_end(cursor, forward);
+	}
+
+	if (cursor->dict->btree != NULL) {
+		if (forward && ++cursor->i == cursor->leaf->nkey) {
+			cursor->leaf = cursor->leaf->next;
+			cursor->i = 0;
+		} else if (!forward && cursor->i-- == 0) {
+			cursor->leaf = cursor->leaf->prev;
+			cursor->i = cursor->leaf != NULL ? cursor->leaf->nkey-1 : 0;
 		}
+		return dict_cursor_status(cursor);
+	}
 
+	struct subtree *node = cursor->path[cursor->depth-1];
+	struct subtree *below = forward ? node->right : node->left;
+	if (!EOT(below)) {
+		// the least node of the right subtree, or the greatest of the left one
+		dict_cursor_push_side(cursor, below, forward);
+	} else {
+		// up to the first node that node is to the left of, or to the right of
+		struct subtree *child;
+		do {
+			child = cursor->path[--cursor->depth];
+		} while (cursor->depth > 0 && (forward ? cursor->path[cursor->depth-1]->right : cursor->path[cursor->depth-1]->left) == child);
 	}
+	return dict_cursor_status(cursor);
+}
 
-	return ESRCH;
+int dict_cursor_next(struct dict_cursor *cursor) {
+	return dict_cursor_step(cursor, 1);
 }
 
-int dict_select(struct dict *dict, int i, void **key, void **value) {
-	if (dict == NULL || key == NULL || value == NULL) {
+int dict_cursor_prev(struct dict_cursor *cursor) {
+	return dict_cursor_step(cursor, 0);
+}
+
+
+int dict_cursor_get(struct dict_cursor *cursor, void **key, void **value) {
+	if (cursor == NULL || key == NULL || value == NULL) {
 		return EINVAL;
 	}
+	if (dict_cursor_status(cursor) != 0) {
+		return ESRCH;
+	}
 
-	return subtree_select(dict->head, i, key, value);
+	if (cursor->dict->btree != NULL) {
+		*key = (void *)cursor->leaf->keys[cursor->i];
+		*value = (void *)cursor->leaf->values[cursor->i];
+	} else {
+		*key = (void *)cursor->path[cursor->depth-1]->key;
+		*value = (void *)cursor->path[cursor->depth-1]->value;
+	}
+	return 0;
 }
-void TestDict_select(CuTest *tc) {
-	struct dict *dict = dict_init(compare_pointers);
-	CuAssertPtrNotNull(tc, dict);
 
-	void *rkey = (void*)42, *rvalue = (void*)42;
-	CuAssertIntEquals(tc, ESRCH, dict_select(dict, 0, &rkey, &rvalue));
 
-	int i;
-	for (i = 0; i < 7; i++) {
-		unsigned long set_key = i+1;
-		unsigned long set_value = set_key + 1000;
-		CuAssertIntEquals(tc, ESRCH, dict_select(dict, i, &rkey, &rvalue));
-		CuAssertIntEquals(tc, ESRCH, dict_select(dict, -i-1, &rkey, &rvalue));
+void TestDictCursor(CuTest *tc) {
+	enum {
+		NKEY = 500,
+	};
+
+	int k;
+	for (k = 0; k < 2; k++) {
+		struct dict *dict = k == 0 ? dict_init(compare_pointers) : dict_init_btree(compare_pointers);
+		CuAssertPtrNotNull(tc, dict);
+		struct dict_cursor *cursor = dict_cursor_init(dict);
+		CuAssertPtrNotNull(tc, cursor);
+		void *rkey = (void *)42, *rvalue = (void *)42;
+
+		// an empty dict has only the position off it
+		CuAssertIntEquals(tc, ESRCH, dict_cursor_first(cursor));
+		CuAssertIntEquals(tc, ESRCH, dict_cursor_last(cursor));
+		CuAssertIntEquals(tc, ESRCH, dict_cursor_lower_bound(cursor, (void *)1));
+		CuAssertIntEquals(tc, ESRCH, dict_cursor_next(cursor));
+		CuAssertIntEquals(tc, ESRCH, dict_cursor_prev(cursor));
+		CuAssertIntEquals(tc, ESRCH, dict_cursor_get(cursor, &rkey, &rvalue));
+		CuAssertPtrEquals(tc, (void *)42, rkey);
+
+		// the even keys 2..2*NKEY
+		unsigned long i;
+		for (i = 0; i < NKEY; i++) {
+			unsigned long key = 2*((7*i)%NKEY) + 2;
+			CuAssertIntEquals(tc, 0, dict_put(dict, (void *)key, (void *)(key+1), NULL, NULL));
+		}
 
-		CuAssertIntEquals(tc, 0, dict_put(dict, (void *)set_key, (void *)set_value, NULL, NULL));
+		// all of them forward and backward, and around through the position off the dict
+		CuAssertIntEquals(tc, 0, dict_cursor_first(cursor));
+		for (i = 1; i <= NKEY; i++) {
+			CuAssertIntEquals(tc, 0, dict_cursor_get(cursor, &rkey, &rvalue));
+			CuAssertPtrEquals(tc, (void *)(2*i), rkey);
+			CuAssertPtrEquals(tc, (void *)(2*i+1), rvalue);
+			CuAssertIntEquals(tc, i < NKEY ? 0 : ESRCH, dict_cursor_next(cursor));
+		}
+		CuAssertIntEquals(tc, ESRCH, dict_cursor_get(cursor, &rkey, &rvalue));
+		CuAssertIntEquals(tc, 0, dict_cursor_next(cursor));
+		CuAssertIntEquals(tc, 0, dict_cursor_get(cursor, &rkey, &rvalue));
+		CuAssertPtrEquals(tc, (void *)2, rkey);
+		CuAssertIntEquals(tc, ESRCH, dict_cursor_prev(cursor));
+		CuAssertIntEquals(tc, 0, dict_cursor_prev(cursor));
+		for (i = NKEY; i >= 1; i--) {
+			CuAssertIntEquals(tc, 0, dict_cursor_get(cursor, &rkey, &rvalue));
+			CuAssertPtrEquals(tc, (void *)(2*i), rkey);
+			CuAssertIntEquals(tc, i > 1 ? 0 : ESRCH, dict_cursor_prev(cursor));
+		}
 
-		CuAssertIntEquals(tc, 0, dict_select(dict, i, &rkey, &rvalue));
-		CuAssertPtrEquals(tc, (void *)set_key, rkey);
-		CuAssertPtrEquals(tc, (void *)set_value, rvalue);
+		// the bounds of every key and of the ones between and around them
+		for (i = 0; i <= 2*NKEY+1; i++) {
+			unsigned long lower = i < 2 ? 2 : i + i%2, upper = i < 2 ? 2 : i + 2 - i%2;
+			if (i == 0) {
+				CuAssertIntEquals(tc, EINVAL, dict_cursor_lower_bound(cursor, (void *)i));
+				continue;
+			}
 
-		int j;
-		for (j = 0; j < i; j++) {
-			unsigned long get_key = j+1;
-			unsigned long get_value = get_key + 1000;
+			CuAssertIntEquals(tc, lower <= 2*NKEY ? 0 : ESRCH, dict_cursor_lower_bound(cursor, (void *)i));
+			if (lower <= 2*NKEY) {
+				CuAssertIntEquals(tc, 0, dict_cursor_get(cursor, &rkey, &rvalue));
+				CuAssertPtrEquals(tc, (void *)lower, rkey);
+			}
+			// the previous one is the greatest key < i
+			CuAssertIntEquals(tc, lower > 2 ? 0 : ESRCH, dict_cursor_prev(cursor));
+			if (lower > 2) {
+				CuAssertIntEquals(tc, 0, dict_cursor_get(cursor, &rkey, &rvalue));
+				CuAssertPtrEquals(tc, (void *)(lower-2), rkey);
+			}
 
-			CuAssertIntEquals(tc, 0, dict_select(dict, j, &rkey, &rvalue));
-			CuAssertPtrEquals(tc, (void *)get_key, rkey);
-			CuAssertPtrEquals(tc, (void *)get_value, rvalue);
+			CuAssertIntEquals(tc, upper <= 2*NKEY ? 0 : ESRCH, dict_cursor_upper_bound(cursor, (void *)i));
+			if (upper <= 2*NKEY) {
+				CuAssertIntEquals(tc, 0, dict_cursor_get(cursor, &rkey, &rvalue));
+				CuAssertPtrEquals(tc, (void *)upper, rkey);
+				CuAssertIntEquals(tc, upper < 2*NKEY ? 0 : ESRCH, dict_cursor_next(cursor));
+				if (upper < 2*NKEY) {
+					CuAssertIntEquals(tc, 0, dict_cursor_get(cursor, &rkey, &rvalue));
+					CuAssertPtrEquals(tc, (void *)(upper+2), rkey);
+				}
+			}
+		}
 
-			CuAssertIntEquals(tc, 0, dict_select(dict, -i-1+j, &rkey, &rvalue));
-			CuAssertPtrEquals(tc, (void *)get_key, rkey);
-			CuAssertPtrEquals(tc, (void *)get_value, rvalue);
+		CuAssertIntEquals(tc, EINVAL, dict_cursor_get(cursor, NULL, &rvalue));
+		CuAssertIntEquals(tc, EINVAL, dict_cursor_upper_bound(NULL, (void *)1));
+		CuAssertIntEquals(tc, EINVAL, dict_cursor_next(NULL));
+		CuAssertIntEquals(tc, EINVAL, dict_cursor_first(NULL));
+		CuAssertPtrEquals(tc, NULL, dict_cursor_init(NULL));
+
+		dict_cursor_destroy(cursor);
+		dict_destroy(dict);
+	}
+}
+
+
+void TestDictCursorBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		NKEY = 1 << 20,
+		NSCAN = 1000,
+		NRANGE = 1000,
+	};
+
+	int k;
+	for (k = 0; k < 2; k++) {
+		struct dict *dict = k == 0 ? dict_init(compare_pointers) : dict_init_btree(compare_pointers);
+		CuAssertPtrNotNull(tc, dict);
+		struct dict_cursor *cursor = dict_cursor_init(dict);
+		CuAssertPtrNotNull(tc, cursor);
+		unsigned long i, sum = 0;
+		for (i = 1; i <= NKEY; i++) {
+			dict_put(dict, (void *)i, (void *)i, NULL, NULL);
+		}
+
+		const char *name = k == 0 ? "aa tree" : "b+-tree";
+		char description[64];
+		void *key, *value;
+		snprintf(description, sizeof(description), "%s 1000 ranges of 1000 by cursor", name);
+		TIMED_BLOCK(1, description) {
+			int j;
+			for (j = 0; j < NSCAN; j++) {
+				int n = 0, status = dict_cursor_lower_bound(cursor, (void *)(1 + (7919ul*j) % (NKEY-NRANGE)));
+				for (; status == 0 && n < NRANGE; status = dict_cursor_next(cursor), n++) {
+					dict_cursor_get(cursor, &key, &value);
+					sum += (unsigned long)value;
+				}
+			}
+		}
+		snprintf(description, sizeof(description), "%s 1000 ranges of 1000 by dict_select", name);
+		TIMED_BLOCK(1, description) {
+			int j;
+			for (j = 0; j < NSCAN; j++) {
+				int first, n;
+				dict_get(dict, (void *)(1 + (7919ul*j) % (NKEY-NRANGE)), &first);
+				for (n = 0; n < NRANGE && dict_select(dict, first+n, &key, &value) == 0; n++) {
+					sum -= (unsigned long)value;
+				}
+			}
 		}
+		CuAssertTrue(tc, sum == 0);
+
+		dict_cursor_destroy(cursor);
+		dict_destroy(dict);
 	}
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
 
-	dict_destroy(dict);
+
+static int compare_ints(const void *a, const void *b) {
+	int x = *(const int *)a, y = *(const int *)b;
+	return (x > y) - (x < y);
 }
 
 
-static int subtree_for_each(struct subtree *head, dict_action action, void *state) {
-	if (EOT(head)) {
-		return 0;
+/*
+ * the number of pairs below node if it is a b+-tree node with the least key
+ * min and keys less than max, otherwise -1. the leaves must come in the
+ * order of the chain from *leaf.
+ */
+static int btree_check_node(const void *node, int height, int is_root, dict_comparator compar, const void *min, const void *max, const struct btree_leaf **leaf) {
+	if (height == 0) {
+		const struct btree_leaf *l = node;
+		if (l != *leaf || (l->next != NULL && l->next->prev != l) || l->nkey > BTREE_NKEY || l->nkey < (is_root ? 1 : BTREE_NKEY/2)) {
+			return -1;
+		}
+		if ((min != NULL && l->keys[0] != min) || (max != NULL && compar(l->keys[l->nkey-1], max) >= 0)) {
+			return -1;
+		}
+		int i;
+		for (i = 1; i < l->nkey; i++) {
+			if (compar(l->keys[i-1], l->keys[i]) >= 0) {
+				return -1;
+			}
+		}
+		*leaf = l->next;
+		return l->nkey;
 	}
 
-	int status = subtree_for_each(head->left, action, state);
-	if (status != 0) {
-		return status;
+	const struct btree_inner *inner = node;
+	if (inner->nchild > BTREE_NCHILD || inner->nchild < (is_root ? 2 : BTREE_NCHILD/2)) {
+		return -1;
 	}
-	status = action(head->key, head->value, state);
-	if (status != 0) {
-		return status;
+	int i, count = 0;
+	for (i = 0; i < inner->nchild; i++) {
+		const void *child_min = i == 0 ? min : inner->keys[i-1], *child_max = i+1 < inner->nchild ? inner->keys[i] : max;
+		int child_count = btree_check_node(inner->children[i], height-1, 0, compar, child_min, child_max, leaf);
+		if (child_count < 0 || child_count != inner->counts[i]) {
+			return -1;
+		}
+		count += child_count;
 	}
-	return subtree_for_each(head->right, action, state);
+	return count;
 }
+static int btree_check(const struct btree *tree, dict_comparator compar) {
+	if (tree->root == NULL) {
+		return tree->nkey == 0 && tree->height == 0 ? 0 : -1;
+	}
 
-int dict_for_each(struct dict *dict, dict_action action, void *state) {
-	if (dict == NULL || action == NULL) {
-		return EINVAL;
+	const void *node = tree->root;
+	int height;
+	for (height = tree->height; height > 0; height--) {
+		node = ((const struct btree_inner *)node)->children[0];
 	}
-	return subtree_for_each(dict->head, action, state);
+	const struct btree_leaf *leaf = node;
+	if (leaf->prev != NULL) {
+		return -1;
+	}
+
+	int count = btree_check_node(tree->root, tree->height, 1, compar, NULL, NULL, &leaf);
+	return leaf == NULL && count == tree->nkey ? count : -1;
 }
 
 
-struct dict_action_dump_state {
+struct dict_action_order_state {
+	dict_comparator compar;
+	const void *previous;
 	int n;
-	void const *keys[NNODE_3_LAYER_BALANCED_TREE];
-	void const *values[NNODE_3_LAYER_BALANCED_TREE];
+	int unordered;
 };
-static int dict_action_dump(void const *key, void const *value, void *state) {
-	struct dict_action_dump_state *known_state = (struct dict_action_dump_state *)state;
-	int n = known_state->n++;
-	known_state->keys[n] = key;
-	known_state->values[n] = value;
+static int dict_action_order(void const *key, void const *value, void *state) {
+	struct dict_action_order_state *known_state = (struct dict_action_order_state *)state;
+	if (known_state->previous != NULL && known_state->compar(known_state->previous, key) >= 0) {
+		known_state->unordered++;
+	}
+	known_state->previous = key;
+	known_state->n++;
 
 	return 0;
+	(void)(value);
 }
 
-void TestDict_for_each(CuTest *tc) {
-	struct dict *dict = dict_init(compare_pointers);
-	CuAssertPtrNotNull(tc, dict);
 
+/* the b+-tree against the aa tree, through the dict interface */
+void TestDictBtree(CuTest *tc) {
+	enum {
+		NKEY = 3000,
+	};
+	int *keys = malloc(2*NKEY*sizeof(*keys)), *same_keys = keys + NKEY;
+	CuAssertPtrNotNull(tc, keys);
 	int i;
-	for (i = 0; i < NNODE_3_LAYER_BALANCED_TREE; i++) {
-		unsigned long set_key = i+1;
-		unsigned long set_value = set_key+1000;
-
-		CuAssertIntEquals(tc, 0, dict_put(dict, (void *)set_key, (void *)set_value, NULL, NULL));
+	for (i = 0; i < NKEY; i++) {
+		keys[i] = same_keys[i] = i;
+	}
 
-		struct dict_action_dump_state state = {};
-		state.n = 0;
-		dict_for_each(dict, dict_action_dump, &state);
-		CuAssertIntEquals(tc, i+1, state.n);
+	struct dict *btree = dict_init_btree(compare_ints), *aa = dict_init(compare_ints);
+	CuAssertPtrNotNull(tc, btree);
+	CuAssertPtrNotNull(tc, aa);
+	CuAssertIntEquals(tc, 0, dict_size(btree));
+	CuAssertPtrEquals(tc, NULL, dict_get(btree, &keys[0], NULL));
+	CuAssertIntEquals(tc, ESRCH, dict_remove(btree, &keys[0], NULL, NULL));
+
+	void *rkey, *rvalue;
+	for (i = 0; i < NKEY; i++) {
+		int *key = &keys[(7919*i)%NKEY];
+		rkey = rvalue = (void *)42;
+		CuAssertIntEquals(tc, 0, dict_put(btree, key, key, &rkey, &rvalue));
+		CuAssertPtrEquals(tc, NULL, rkey);
+		CuAssertPtrEquals(tc, NULL, rvalue);
+		CuAssertIntEquals(tc, 0, dict_put(aa, key, key, NULL, NULL));
+		if (i%97 == 0) {
+			CuAssertIntEquals(tc, i+1, btree_check(btree->btree, compare_ints));
+		}
+	}
+	CuAssertIntEquals(tc, NKEY, btree_check(btree->btree, compare_ints));
+	CuAssertTrue(tc, btree->btree->height >= 2);
+
+	// replacing the keys replaces them in the inner nodes too, so that the first ones may be freed
+	for (i = 0; i < NKEY; i++) {
+		CuAssertIntEquals(tc, 0, dict_put(btree, &same_keys[i], &keys[i], &rkey, &rvalue));
+		CuAssertPtrEquals(tc, &keys[i], rkey);
+		CuAssertPtrEquals(tc, &keys[i], rvalue);
+	}
+	CuAssertIntEquals(tc, NKEY, btree_check(btree->btree, compare_ints));
+	for (i = 0; i < NKEY; i++) {
+		CuAssertIntEquals(tc, 0, dict_select(btree, i, &rkey, &rvalue));
+		CuAssertPtrEquals(tc, &same_keys[i], rkey);
+	}
 
-		int j;
-		for (j = 0; j < i; j++) {
-			unsigned long get_key = j+1;
-			unsigned long get_value = get_key+1000;
+	for (i = 0; i < NKEY; i++) {
+		int btree_index = -1, aa_index = -1;
+		CuAssertPtrEquals(tc, dict_get(aa, &keys[i], &aa_index), dict_get(btree, &keys[i], &btree_index));
+		CuAssertIntEquals(tc, aa_index, btree_index);
 
-			CuAssertPtrEquals(tc, (void *)get_key, state.keys[j]);
-			CuAssertPtrEquals(tc, (void *)get_value, state.values[j]);
+		void *aa_key, *aa_value;
+		CuAssertIntEquals(tc, 0, dict_select(aa, -i-1, &aa_key, &aa_value));
+		CuAssertIntEquals(tc, 0, dict_select(btree, -i-1, &rkey, &rvalue));
+		CuAssertIntEquals(tc, *(int *)aa_key, *(int *)rkey);
+		CuAssertPtrEquals(tc, aa_value, rvalue);
+	}
+	CuAssertIntEquals(tc, ESRCH, dict_select(btree, NKEY, &rkey, &rvalue));
+	CuAssertIntEquals(tc, ESRCH, dict_select(btree, -NKEY-1, &rkey, &rvalue));
+
+	struct dict_action_order_state state = {compare_ints, NULL, 0, 0};
+	CuAssertIntEquals(tc, 0, dict_for_each(btree, dict_action_order, &state));
+	CuAssertIntEquals(tc, NKEY, state.n);
+	CuAssertIntEquals(tc, 0, state.unordered);
+	struct dict_action_abort_after_state abort_state = {0, 100};
+	CuAssertIntEquals(tc, 100, dict_for_each(btree, dict_action_abort_after, &abort_state));
+
+	for (i = 0; i < NKEY; i++) {
+		int *key = &keys[(4409*i)%NKEY];
+		CuAssertIntEquals(tc, 0, dict_remove(btree, key, &rkey, &rvalue));
+		CuAssertPtrEquals(tc, &same_keys[key-keys], rkey);
+		CuAssertPtrEquals(tc, key, rvalue);
+		CuAssertIntEquals(tc, ESRCH, dict_remove(btree, key, NULL, NULL));
+		CuAssertIntEquals(tc, 0, dict_remove(aa, key, NULL, NULL));
+		if (i%97 == 0) {
+			CuAssertIntEquals(tc, NKEY-i-1, btree_check(btree->btree, compare_ints));
+			int j;
+			for (j = 0; j < NKEY; j += 31) {
+				int btree_index = -1, aa_index = -1;
+				CuAssertPtrEquals(tc, dict_get(aa, &keys[j], &aa_index), dict_get(btree, &keys[j], &btree_index));
+				CuAssertIntEquals(tc, aa_index, btree_index);
+			}
 		}
 	}
-}
+	CuAssertIntEquals(tc, 0, dict_size(btree));
+	CuAssertIntEquals(tc, 0, btree_check(btree->btree, compare_ints));
 
+	// empty again, and the tree grows from scratch
+	CuAssertIntEquals(tc, 0, dict_put(btree, &keys[1], &keys[1], NULL, NULL));
+	CuAssertPtrEquals(tc, &keys[1], dict_get(btree, &keys[1], NULL));
 
-struct dict_action_abort_after_state {
-	int ncall;
-	int abort_after;
-};
-static int dict_action_abort_after(void const *key, void const *value, void *state) {
-	struct dict_action_abort_after_state *known_state = (struct dict_action_abort_after_state *)state;
-	known_state->ncall++;
-	return known_state->ncall >= known_state->abort_after ? known_state->abort_after : 0;
-	(void)(key), (void)(value);
+	dict_destroy(btree);
+	dict_destroy(aa);
+	free(keys);
 }
 
-void TestDict_for_eachWithAbortion(CuTest *tc) {
-	struct dict *dict = dict_init(compare_pointers);
-	CuAssertPtrNotNull(tc, dict);
 
+void TestDictBtreeBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		NKEY = 1 << 21,
+		NITERATION = 1,
+	};
+	int *keys = malloc(NKEY*sizeof(*keys));
+	CuAssertPtrNotNull(tc, keys);
 	int i;
-	for (i = 0; i < NNODE_3_LAYER_BALANCED_TREE; i++) {
-		unsigned long key = i+1;
-		CuAssertIntEquals(tc, 0, dict_put(dict, (void *)key, (void *)key, NULL, NULL));
-
-		int j;
-		for (j = 1; j < i; j++) { // cannot abort before the zeroth call
-			struct dict_action_abort_after_state state;
-			state.ncall = 0;
-			state.abort_after = j;
-			CuAssertIntEquals(tc, j, dict_for_each(dict, dict_action_abort_after, &state));
+	for (i = 0; i < NKEY; i++) {
+		keys[i] = (int)((2654435761u*(unsigned)i) % NKEY); // a permutation, since the factor is odd
+	}
 
-			CuAssertIntEquals(tc, j, state.ncall);
+	int k;
+	for (k = 0; k < 2; k++) {
+		struct dict *dict = k == 0 ? dict_init(compare_ints) : dict_init_btree(compare_ints);
+		CuAssertPtrNotNull(tc, dict);
+		const char *name = k == 0 ? "aa tree" : "b+-tree";
+		char description[64];
+		void *key, *value;
+		long sum = 0;
+
+		snprintf(description, sizeof(description), "%s dict_put 2^21", name);
+		TIMED_BLOCK(NITERATION, description) {
+			for (i = 0; i < NKEY; i++) {
+				dict_put(dict, &keys[i], &keys[i], NULL, NULL);
+			}
 		}
+		snprintf(description, sizeof(description), "%s dict_get 2^21", name);
+		TIMED_BLOCK(NITERATION, description) {
+			for (i = 0; i < NKEY; i++) {
+				sum += dict_get(dict, &keys[(7919u*(unsigned)i) % NKEY], NULL) != NULL;
+			}
+		}
+		snprintf(description, sizeof(description), "%s dict_select 2^21", name);
+		TIMED_BLOCK(NITERATION, description) {
+			for (i = 0; i < NKEY; i++) {
+				sum += dict_select(dict, (7919u*(unsigned)i) % NKEY, &key, &value) == 0;
+			}
+		}
+		struct dict_action_order_state state = {compare_ints, NULL, 0, 0};
+		snprintf(description, sizeof(description), "%s dict_for_each 2^21", name);
+		TIMED_BLOCK(NITERATION, description) {
+			dict_for_each(dict, dict_action_order, &state);
+		}
+		snprintf(description, sizeof(description), "%s dict_remove 2^21", name);
+		TIMED_BLOCK(NITERATION, description) {
+			for (i = 0; i < NKEY; i++) {
+				dict_remove(dict, &keys[(4409u*(unsigned)i) % NKEY], NULL, NULL);
+			}
+		}
+		CuAssertIntEquals(tc, 2*NKEY, sum);
+		CuAssertIntEquals(tc, 0, state.unordered);
 
-
+		dict_destroy(dict);
 	}
+
+	free(keys);
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
 }
@@ -22,6 +22,88 @@ typedef int (*dict_comparator)(void const *a, void const *b);
  */
 extern struct dict *dict_init(dict_comparator compar);
 
+/*
+ * pool of dict nodes that several dicts may share. a dict carves its nodes
+ * from slabs of its pool and puts removed nodes on the pool's free list, so
+ * that puts and removes seldom reach malloc. a dict without a shared pool
+ * has one of its own, which is freed slab by slab on dict_destroy instead of
+ * node by node.
+ *
+ * a shared pool is not locked, so the dicts of one pool must be used from
+ * one thread at a time, and they must be destroyed before the pool. if
+ * pool == NULL dict_pool_destroy does nothing.
+ *
+ * returns:
+ *   error --> NULL
+ *   --> *(new pool)
+ */
+extern struct dict_pool *dict_pool_init(void);
+extern void dict_pool_destroy(struct dict_pool *pool);
+
+/*
+ * dict initializer with the nodes from pool, or from a pool of its own if
+ * pool == NULL.
+ *
+ * returns:
+ *   compar == NULL --> NULL
+ *   error --> NULL
+ *   --> *(new dict)
+ */
+extern struct dict *dict_init_with_pool(dict_comparator compar, struct dict_pool *pool);
+
+/*
+ * dict initializer for a b+-tree instead of the aa tree. the nodes have
+ * room for 16 keys or children, whose keys are next to each other, so a
+ * dict_get reads a couple of cache lines per level of a tree that is about
+ * a quarter as high. the order statistics of dict_get and dict_select come
+ * from the number of pairs below each child. it does not use a pool.
+ *
+ * returns:
+ *   compar == NULL --> NULL
+ *   error --> NULL
+ *   --> *(new dict)
+ */
+extern struct dict *dict_init_btree(dict_comparator compar);
+
+/*
+ * dict initializer for an aa tree that is changed by copying, so that
+ * readers on other threads can take snapshots of it. a dict_put or
+ * dict_remove copies the nodes on the path to the changed pair, and the
+ * new version shares all the other nodes with the ones before it. the
+ * dict itself, with all of its other functions, belongs to one writer
+ * thread at a time, while dict_snapshot_take and the snapshot functions
+ * may be called from any thread without locking.
+ *
+ * an old version is freed, with the nodes that no newer version has, by the
+ * first write after its last snapshot was released. readers never hold that
+ * up, but a writer that stops writing keeps the old versions until
+ * dict_destroy. it uses a pool of its own.
+ *
+ * the key and value that a dict_put or dict_remove hands back through nkey
+ * and nvalue are still in the snapshots taken before it. unlike with other
+ * dicts they must stay valid until all of those snapshots are released.
+ *
+ * returns:
+ *   compar == NULL --> NULL
+ *   error --> NULL
+ *   --> *(new dict)
+ */
+extern struct dict *dict_init_persistent(dict_comparator compar);
+
+/*
+ * dict of the n key-value pairs keys[i], values[i], where the keys are
+ * strictly increasing by compar. the tree is built perfectly balanced in
+ * O(n), and the nodes are allocated together in one block. values may be
+ * NULL, then all the values are NULL.
+ *
+ * returns:
+ *   compar == NULL || n < 0 || keys == NULL && n > 0 --> NULL
+ *   a key is NULL or not greater than the one before --> NULL
+ *   error --> NULL
+ *   --> *(new dict)
+ */
+extern struct dict *dict_from_sorted(dict_comparator compar, void const *const *keys, void const *const *values, int n);
+
 /*
  * dict destructor. if dict == NULL it does nothing.
  */
@@ -107,5 +189,73 @@ typedef int (*dict_action)(const void *key, const void *value, void *state);
  */
 extern int dict_for_each(struct dict *dict, dict_action action, void *state);
 
+/*
+ * cursor for walking the pairs of a dict in order from any position, for
+ * range scans in O(log n + k) instead of a dict_select for each pair. a
+ * cursor is at a pair or off the dict, and stepping past either end goes
+ * off it, from where the next step goes to the first or last pair again.
+ * a dict_put or dict_remove on the dict invalidates its cursors until they
+ * are positioned again with first, last or a bound.
+ *
+ * returns:
+ *   dict == NULL --> NULL
+ *   error --> NULL
+ *   --> *(new cursor), off the dict
+ */
+extern struct dict_cursor *dict_cursor_init(struct dict *dict);
+extern void dict_cursor_destroy(struct dict_cursor *cursor);
+
+/*
+ * position the cursor at the first or the last pair, at the first pair with
+ * a key >= key (lower_bound) or at the first pair with a key > key
+ * (upper_bound). next and prev are O(1) amortised over a walk.
+ *
+ * returns:
+ *   cursor == NULL || key == NULL --> EINVAL
+ *   no such pair, the cursor is off the dict --> ESRCH
+ *   --> 0
+ */
+extern int dict_cursor_first(struct dict_cursor *cursor);
+extern int dict_cursor_last(struct dict_cursor *cursor);
+extern int dict_cursor_lower_bound(struct dict_cursor *cursor, void const *key);
+extern int dict_cursor_upper_bound(struct dict_cursor *cursor, void const *key);
+extern int dict_cursor_next(struct dict_cursor *cursor);
+extern int dict_cursor_prev(struct dict_cursor *cursor);
+
+/*
+ * the pair at the cursor.
+ *
+ * returns:
+ *   cursor == NULL || key == NULL || value == NULL --> EINVAL
+ *   the cursor is off the dict --> ESRCH
+ *   --> 0
+ *     *key = node->key
+ *     *value = node->value
+ */
+extern int dict_cursor_get(struct dict_cursor *cursor, void **key, void **value);
+
+
+/*
+ * snapshot of the current version of a dict from dict_init_persistent, in
+ * O(1). it does not change with later writes to the dict, and it must be
+ * released before the dict is destroyed.
+ *
+ * returns:
+ *   dict == NULL --> NULL
+ *   dict is not persistent --> NULL
+ *   --> *(snapshot)
+ */
+extern struct dict_snapshot *dict_snapshot_take(struct dict *dict);
+extern void dict_snapshot_release(struct dict_snapshot *snapshot);
+
+/*
+ * dict_size, dict_get, dict_select and dict_for_each for a snapshot, with
+ * snapshot == NULL where those have dict == NULL.
+ */
+extern int dict_snapshot_size(struct dict_snapshot *snapshot);
+extern void *dict_snapshot_get(struct dict_snapshot *snapshot, const void *key, int *index_of_key);
+extern int dict_snapshot_select(struct dict_snapshot *snapshot, int i, void **key, void **value);
+extern int dict_snapshot_for_each(struct dict_snapshot *snapshot, dict_action action, void *state);
+
 
 #endif /*DICT_H*/
@@ -0,0 +1,238 @@
+#include <cstdint>
+#include <cstring>
+#include "fixed_int.hpp"
+extern "C" {
+#include "CuTest/CuTest.h"
+#ifdef JCCL_BENCHMARK
+#include "timer.h"
+#endif /*JCCL_BENCHMARK*/
+}
+
+using jccl::fixed_int;
+
+/* the operators of fixed_int<Bits> against struct bigint modulo 2^Bits */
+template <int Bits>
+static void fixed_int_test(CuTest *tc, uint64_t *state) {
+	// BIGINT_STATIC_INIT uses designated initializers, which C++17 does not have
+	struct bigint x, y, expected, actual, modulus, mask, one;
+	bigint_init_inline(&x);
+	bigint_init_inline(&y);
+	bigint_init_inline(&expected);
+	bigint_init_inline(&actual);
+	bigint_init_inline(&modulus);
+	bigint_init_inline(&mask);
+	bigint_init_inline(&one);
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&one, 1));
+	CuAssertIntEquals(tc, 0, bigint_shl_ul_into(&modulus, &one, Bits));
+	CuAssertIntEquals(tc, 0, bigint_subtract_into(&mask, &modulus, &one));
+
+	for (int i = 0; i < 100; i++) {
+		// random bits, with runs of ones and zeros now and then for the carries
+		CuAssertIntEquals(tc, 0, bigint_random_into(&x, Bits, state));
+		CuAssertIntEquals(tc, 0, bigint_random_into(&y, Bits, state));
+		if (i%4 == 1) {
+			CuAssertIntEquals(tc, 0, bigint_copy_into(&x, &mask));
+		} else if (i%4 == 2) {
+			CuAssertIntEquals(tc, 0, bigint_from_long_into(&y, i));
+		}
+
+		fixed_int<Bits> a, b;
+		CuAssertIntEquals(tc, 0, a.from_bigint(&x));
+		CuAssertIntEquals(tc, 0, b.from_bigint(&y));
+
+		fixed_int<Bits> sum;
+		unsigned long carry = add_carry(sum, a, b);
+		CuAssertIntEquals(tc, 0, bigint_add_into(&expected, &x, &y));
+		CuAssertIntEquals(tc, bigint_compare(&expected, &modulus) >= 0, carry);
+		CuAssertIntEquals(tc, 0, bigint_and_into(&expected, &expected, &mask));
+		CuAssertIntEquals(tc, 0, (a + b).to_bigint(&actual));
+		CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+		CuAssertTrue(tc, sum == a + b);
+
+		fixed_int<Bits> difference;
+		unsigned long borrow = sub_borrow(difference, a, b);
+		CuAssertIntEquals(tc, bigint_compare(&x, &y) < 0, borrow);
+		CuAssertIntEquals(tc, 0, bigint_subtract_into(&expected, &x, &y));
+		CuAssertIntEquals(tc, 0, bigint_and_into(&expected, &expected, &mask));
+		CuAssertIntEquals(tc, 0, (a - b).to_bigint(&actual));
+		CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+		CuAssertTrue(tc, difference + b == a);
+		CuAssertTrue(tc, -b + a == difference);
+
+		CuAssertIntEquals(tc, 0, bigint_multiply_into(&expected, &x, &y));
+		CuAssertIntEquals(tc, 0, multiply_wide(a, b).to_bigint(&actual));
+		CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+		CuAssertIntEquals(tc, 0, bigint_and_into(&expected, &expected, &mask));
+		CuAssertIntEquals(tc, 0, (a * b).to_bigint(&actual));
+		CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+
+		CuAssertIntEquals(tc, 0, bigint_xor_into(&expected, &x, &y));
+		CuAssertIntEquals(tc, 0, (a ^ b).to_bigint(&actual));
+		CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+		CuAssertIntEquals(tc, 0, bigint_and_into(&expected, &x, &y));
+		CuAssertIntEquals(tc, 0, (a & b).to_bigint(&actual));
+		CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+		CuAssertIntEquals(tc, 0, bigint_or_into(&expected, &x, &y));
+		CuAssertIntEquals(tc, 0, (a | b).to_bigint(&actual));
+		CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+		CuAssertIntEquals(tc, 0, bigint_xor_into(&expected, &x, &mask));
+		CuAssertIntEquals(tc, 0, (~a).to_bigint(&actual));
+		CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+
+		int order = bigint_compare(&x, &y);
+		CuAssertIntEquals(tc, order, compare(a, b));
+		CuAssertIntEquals(tc, order < 0, a < b);
+		CuAssertIntEquals(tc, order <= 0, a <= b);
+		CuAssertIntEquals(tc, order > 0, a > b);
+		CuAssertIntEquals(tc, order >= 0, a >= b);
+		CuAssertIntEquals(tc, order == 0, a == b);
+		CuAssertIntEquals(tc, order != 0, a != b);
+
+		const unsigned long shifts[] = {0, 1, 63, 64, 65, Bits/2 + 3, Bits-1, Bits, Bits+1};
+		for (unsigned long shift : shifts) {
+			CuAssertIntEquals(tc, 0, bigint_shl_ul_into(&expected, &x, shift));
+			CuAssertIntEquals(tc, 0, bigint_and_into(&expected, &expected, &mask));
+			CuAssertIntEquals(tc, 0, (a << shift).to_bigint(&actual));
+			CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+			CuAssertIntEquals(tc, 0, bigint_shr_ul_into(&expected, &x, shift));
+			CuAssertIntEquals(tc, 0, (a >> shift).to_bigint(&actual));
+			CuAssertIntEquals(tc, 0, bigint_compare(&expected, &actual));
+		}
+
+		fixed_int<Bits> quotient;
+		unsigned long divisor = 1000000007 + i, remainder = divrem_1(quotient, a, divisor);
+		CuAssertTrue(tc, quotient * fixed_int<Bits>(divisor) + fixed_int<Bits>(remainder) == a);
+		CuAssertTrue(tc, remainder < divisor);
+	}
+
+	// values that do not fit are not converted
+	fixed_int<Bits> a(42);
+	CuAssertIntEquals(tc, ERANGE, a.from_bigint(&modulus));
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&x, -1));
+	CuAssertIntEquals(tc, ERANGE, a.from_bigint(&x));
+	CuAssertTrue(tc, a == fixed_int<Bits>(42));
+	CuAssertIntEquals(tc, EINVAL, a.from_bigint(NULL));
+	CuAssertTrue(tc, fixed_int<Bits>::max() + fixed_int<Bits>(1) == fixed_int<Bits>());
+	CuAssertTrue(tc, !fixed_int<Bits>() && bool(fixed_int<Bits>::max()));
+
+	bigint_clear(&x);
+	bigint_clear(&y);
+	bigint_clear(&expected);
+	bigint_clear(&actual);
+	bigint_clear(&modulus);
+	bigint_clear(&mask);
+	bigint_clear(&one);
+}
+
+extern "C" {
+
+void TestFixedInt(CuTest *tc) {
+	uint64_t state = 1337;
+	fixed_int_test<64>(tc, &state);
+	fixed_int_test<128>(tc, &state);
+	fixed_int_test<256>(tc, &state);
+	fixed_int_test<512>(tc, &state);
+	fixed_int_test<1024>(tc, &state);
+
+	// a fixed_int takes no more room than its chunks
+	CuAssertIntEquals(tc, 32, sizeof(fixed_int<256>));
+}
+
+
+void TestFixedIntBenchmark(CuTest *tc) {
+#ifdef JCCL_BENCHMARK
+	enum {
+		N = 1 << 12,
+		NITERATION = 100,
+	};
+
+	uint64_t state = 1337;
+	fixed_int<256> *as = new fixed_int<256>[2*N], *bs = as + N;
+	struct bigint *xs = new struct bigint[3*N], *ys = xs + N, *zs = ys + N;
+	for (int i = 0; i < N; i++) {
+		bigint_init_inline(&xs[i]);
+		bigint_init_inline(&ys[i]);
+		bigint_init_inline(&zs[i]);
+		CuAssertIntEquals(tc, 0, bigint_random_into(&xs[i], 256, &state));
+		CuAssertIntEquals(tc, 0, bigint_random_into(&ys[i], 256, &state));
+		CuAssertIntEquals(tc, 0, as[i].from_bigint(&xs[i]));
+		CuAssertIntEquals(tc, 0, bs[i].from_bigint(&ys[i]));
+	}
+
+	fixed_int<256> sum, product, high;
+	int status = 0;
+	TIMED_BLOCK(NITERATION, "fixed_int<256> + 4096") {
+		for (int i = 0; i < N; i++) {
+			sum += as[i] + bs[i];
+		}
+	}
+	TIMED_BLOCK(NITERATION, "bigint_add_into 256 bit 4096") {
+		for (int i = 0; i < N; i++) {
+			status |= bigint_add_into(&zs[i], &xs[i], &ys[i]);
+		}
+	}
+	TIMED_BLOCK(NITERATION, "fixed_int<256> * 4096") {
+		for (int i = 0; i < N; i++) {
+			product += as[i] * bs[i];
+		}
+	}
+	TIMED_BLOCK(NITERATION, "fixed_int<256> multiply_wide 4096") {
+		for (int i = 0; i < N; i++) {
+			high += fixed_int<256>(multiply_wide(as[i], bs[i]).chunks[7]);
+		}
+	}
+	TIMED_BLOCK(NITERATION, "bigint_multiply_into 256 bit 4096") {
+		for (int i = 0; i < N; i++) {
+			status |= bigint_multiply_into(&zs[i], &xs[i], &ys[i]);
+		}
+	}
+	CuAssertIntEquals(tc, 0, status);
+
+	// each block ran NITERATION times, so the sums are NITERATION times the sums over the pairs modulo 2^256
+	struct bigint expected[3], term, mask, top_chunk_mask, niteration, actual;
+	for (int k = 0; k < 3; k++) {
+		bigint_init_inline(&expected[k]);
+	}
+	bigint_init_inline(&term);
+	bigint_init_inline(&mask);
+	bigint_init_inline(&top_chunk_mask);
+	bigint_init_inline(&niteration);
+	bigint_init_inline(&actual);
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&term, 1));
+	CuAssertIntEquals(tc, 0, bigint_shl_ul_into(&mask, &term, 256));
+	CuAssertIntEquals(tc, 0, bigint_subtract_into(&mask, &mask, &term));
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&top_chunk_mask, ULONG_MAX));
+	CuAssertIntEquals(tc, 0, bigint_from_long_into(&niteration, NITERATION));
+	for (int i = 0; i < N; i++) { // zs[i] = xs[i]*ys[i] from the last block
+		CuAssertIntEquals(tc, 0, bigint_add_into(&term, &xs[i], &ys[i]));
+		CuAssertIntEquals(tc, 0, bigint_add_into(&expected[0], &expected[0], &term));
+		CuAssertIntEquals(tc, 0, bigint_add_into(&expected[1], &expected[1], &zs[i]));
+		CuAssertIntEquals(tc, 0, bigint_shr_ul_into(&term, &zs[i], 7*BIGINT_CHUNK_BIT));
+		CuAssertIntEquals(tc, 0, bigint_and_into(&term, &term, &top_chunk_mask));
+		CuAssertIntEquals(tc, 0, bigint_add_into(&expected[2], &expected[2], &term));
+	}
+	const fixed_int<256> *sums[] = {&sum, &product, &high};
+	for (int k = 0; k < 3; k++) {
+		CuAssertIntEquals(tc, 0, bigint_multiply_into(&term, &expected[k], &niteration));
+		CuAssertIntEquals(tc, 0, bigint_and_into(&expected[k], &term, &mask));
+		CuAssertIntEquals(tc, 0, sums[k]->to_bigint(&actual));
+		CuAssertIntEquals(tc, 0, bigint_compare(&expected[k], &actual));
+		bigint_clear(&expected[k]);
+	}
+
+	bigint_clear(&term);
+	bigint_clear(&mask);
+	bigint_clear(&top_chunk_mask);
+	bigint_clear(&niteration);
+	bigint_clear(&actual);
+	for (int i = 0; i < 3*N; i++) {
+		bigint_clear(&xs[i]);
+	}
+	delete[] xs;
+	delete[] as;
+#else
+	(void)tc;
+#endif /*JCCL_BENCHMARK*/
+}
+
+}
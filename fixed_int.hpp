@@ -0,0 +1,347 @@
+#ifndef FIXED_INT_HPP_
+#define FIXED_INT_HPP_
+#include <cerrno>
+#include "bigint.h"
+#include "bigint_chunk.h"
+
+// the loops over the chunks have constant bounds and are unrolled completely up to 1024 bits
+#define FIXED_INT_UNROLL _Pragma("GCC unroll 16")
+
+namespace jccl {
+
+/*
+ * unsigned integer of Bits bits, a multiple of BIGINT_CHUNK_BIT, with
+ * arithmetic modulo 2^Bits. the chunks are least significant first like in
+ * struct bigint, and live in the object, so a fixed_int on the stack never
+ * touches the heap. the number of chunks is a constant, so the compiler
+ * unrolls the loops over them, and the carry chains, products and shifts
+ * are the chunk primitives of bigint.c from bigint_chunk.h.
+ *
+ * add_carry, sub_borrow and multiply_wide give the bits that wrap around,
+ * and values that outgrow Bits continue as a struct bigint with to_bigint.
+ */
+template <int Bits>
+class fixed_int {
+	static_assert(Bits > 0 && Bits % BIGINT_CHUNK_BIT == 0, "Bits must be a positive multiple of BIGINT_CHUNK_BIT");
+
+public:
+	static constexpr int nchunk = Bits / BIGINT_CHUNK_BIT;
+	unsigned long chunks[nchunk];
+
+	constexpr fixed_int() : chunks{} {}
+	constexpr fixed_int(unsigned long n) : chunks{n} {}
+
+	static constexpr fixed_int max() {
+		fixed_int res;
+		FIXED_INT_UNROLL
+		for (int i = 0; i < nchunk; i++) {
+			res.chunks[i] = ULONG_MAX;
+		}
+		return res;
+	}
+
+	/*
+	 * *this = n.
+	 *
+	 * returns:
+	 *   n == NULL --> EINVAL
+	 *   n < 0 || n >= 2^Bits --> ERANGE, and *this is not touched
+	 *   --> 0
+	 */
+	int from_bigint(const struct bigint *n) {
+		if (n == nullptr) {
+			return EINVAL;
+		}
+
+		struct bigint zero;
+		bigint_init_inline(&zero);
+		if (bigint_compare(n, &zero) < 0) {
+			return ERANGE;
+		}
+		return bigint_export(n, chunks, nchunk, -1, sizeof(*chunks), 0, BIGINT_MAGNITUDE);
+	}
+
+	/*
+	 * dst = *this.
+	 *
+	 * returns:
+	 *   dst == NULL --> EINVAL
+	 *   error --> errno
+	 *   --> 0
+	 */
+	int to_bigint(struct bigint *dst) const {
+		return bigint_import_into(dst, chunks, nchunk, -1, sizeof(*chunks), 0, BIGINT_MAGNITUDE);
+	}
+
+	explicit operator bool() const {
+		unsigned long any = 0;
+		FIXED_INT_UNROLL
+		for (int i = 0; i < nchunk; i++) {
+			any |= chunks[i];
+		}
+		return any != 0;
+	}
+
+	fixed_int operator~() const {
+		fixed_int res;
+		FIXED_INT_UNROLL
+		for (int i = 0; i < nchunk; i++) {
+			res.chunks[i] = ~chunks[i];
+		}
+		return res;
+	}
+
+	fixed_int operator-() const {
+		return fixed_int() - *this;
+	}
+
+	fixed_int &operator+=(const fixed_int &b);
+	fixed_int &operator-=(const fixed_int &b);
+	fixed_int &operator*=(const fixed_int &b) {
+		return *this = *this * b;
+	}
+
+	fixed_int &operator&=(const fixed_int &b) {
+		FIXED_INT_UNROLL
+		for (int i = 0; i < nchunk; i++) {
+			chunks[i] &= b.chunks[i];
+		}
+		return *this;
+	}
+
+	fixed_int &operator|=(const fixed_int &b) {
+		FIXED_INT_UNROLL
+		for (int i = 0; i < nchunk; i++) {
+			chunks[i] |= b.chunks[i];
+		}
+		return *this;
+	}
+
+	fixed_int &operator^=(const fixed_int &b) {
+		FIXED_INT_UNROLL
+		for (int i = 0; i < nchunk; i++) {
+			chunks[i] ^= b.chunks[i];
+		}
+		return *this;
+	}
+
+	fixed_int &operator<<=(unsigned long shift);
+	fixed_int &operator>>=(unsigned long shift);
+};
+
+/* r = a+b, returns carry. r may alias a and/or b */
+template <int Bits>
+unsigned long add_carry(fixed_int<Bits> &r, const fixed_int<Bits> &a, const fixed_int<Bits> &b) {
+	unsigned long carry = 0;
+	FIXED_INT_UNROLL
+	for (int i = 0; i < fixed_int<Bits>::nchunk; i++) {
+		r.chunks[i] = chunk_add_carry(a.chunks[i], b.chunks[i], carry, &carry);
+	}
+	return carry;
+}
+
+/* r = a-b, returns borrow. r may alias a and/or b */
+template <int Bits>
+unsigned long sub_borrow(fixed_int<Bits> &r, const fixed_int<Bits> &a, const fixed_int<Bits> &b) {
+	unsigned long borrow = 0;
+	FIXED_INT_UNROLL
+	for (int i = 0; i < fixed_int<Bits>::nchunk; i++) {
+		r.chunks[i] = chunk_sub_borrow(a.chunks[i], b.chunks[i], borrow, &borrow);
+	}
+	return borrow;
+}
+
+/* the whole product a*b, schoolbook like chunks_mul_schoolbook */
+template <int Bits>
+fixed_int<2*Bits> multiply_wide(const fixed_int<Bits> &a, const fixed_int<Bits> &b) {
+	constexpr int n = fixed_int<Bits>::nchunk;
+	fixed_int<2*Bits> res;
+	FIXED_INT_UNROLL
+	for (int i = 0; i < n; i++) {
+		unsigned long carry = 0;
+		FIXED_INT_UNROLL
+		for (int j = 0; j < n; j++) {
+			unsigned long high, low = chunk_multiply(a.chunks[i], b.chunks[j], &high);
+			low = chunk_add_carry(low, carry, 0, &carry);
+			high += carry;
+			res.chunks[i+j] = chunk_add_carry(res.chunks[i+j], low, 0, &carry);
+			carry += high;
+		}
+		res.chunks[i+n] = carry;
+	}
+	return res;
+}
+
+/* q = a/d for d != 0, returns the remainder. q may alias a */
+template <int Bits>
+unsigned long divrem_1(fixed_int<Bits> &q, const fixed_int<Bits> &a, unsigned long d) {
+	constexpr int n = fixed_int<Bits>::nchunk;
+	unsigned long remainder = 0;
+	FIXED_INT_UNROLL
+	for (int i = n-1; i >= 0; i--) {
+		q.chunks[i] = chunk_divide(remainder, a.chunks[i], d, &remainder);
+	}
+	return remainder;
+}
+
+template <int Bits>
+fixed_int<Bits> &fixed_int<Bits>::operator+=(const fixed_int &b) {
+	add_carry(*this, *this, b);
+	return *this;
+}
+
+template <int Bits>
+fixed_int<Bits> &fixed_int<Bits>::operator-=(const fixed_int &b) {
+	sub_borrow(*this, *this, b);
+	return *this;
+}
+
+/* whole chunks are moved first, then the bits with chunks_shift_left/right */
+template <int Bits>
+fixed_int<Bits> &fixed_int<Bits>::operator<<=(unsigned long shift) {
+	if (shift >= (unsigned long)Bits) {
+		return *this = fixed_int();
+	}
+
+	int nwhole = shift/BIGINT_CHUNK_BIT, nbit = shift%BIGINT_CHUNK_BIT;
+	FIXED_INT_UNROLL
+	for (int j = nchunk-1; j >= 0; j--) {
+		chunks[j] = j >= nwhole ? chunks[j-nwhole] : 0;
+	}
+	if (nbit != 0) {
+		chunks_shift_left(chunks, chunks, nchunk, nbit);
+	}
+	return *this;
+}
+
+template <int Bits>
+fixed_int<Bits> &fixed_int<Bits>::operator>>=(unsigned long shift) {
+	if (shift >= (unsigned long)Bits) {
+		return *this = fixed_int();
+	}
+
+	int nwhole = shift/BIGINT_CHUNK_BIT, nbit = shift%BIGINT_CHUNK_BIT;
+	FIXED_INT_UNROLL
+	for (int i = 0; i < nchunk; i++) {
+		chunks[i] = i+nwhole < nchunk ? chunks[i+nwhole] : 0;
+	}
+	if (nbit != 0) {
+		chunks_shift_right(chunks, chunks, nchunk, nbit);
+	}
+	return *this;
+}
+
+template <int Bits>
+fixed_int<Bits> operator+(fixed_int<Bits> a, const fixed_int<Bits> &b) {
+	return a += b;
+}
+
+template <int Bits>
+fixed_int<Bits> operator-(fixed_int<Bits> a, const fixed_int<Bits> &b) {
+	return a -= b;
+}
+
+/* the low Bits of the product, skipping the chunks of multiply_wide above them */
+template <int Bits>
+fixed_int<Bits> operator*(const fixed_int<Bits> &a, const fixed_int<Bits> &b) {
+	constexpr int n = fixed_int<Bits>::nchunk;
+	fixed_int<Bits> res;
+	FIXED_INT_UNROLL
+	for (int i = 0; i < n; i++) {
+		unsigned long carry = 0;
+		FIXED_INT_UNROLL
+		for (int j = 0; i+j < n; j++) {
+			unsigned long high, low = chunk_multiply(a.chunks[i], b.chunks[j], &high);
+			low = chunk_add_carry(low, carry, 0, &carry);
+			high += carry;
+			res.chunks[i+j] = chunk_add_carry(res.chunks[i+j], low, 0, &carry);
+			carry += high;
+		}
+	}
+	return res;
+}
+
+template <int Bits>
+fixed_int<Bits> operator&(fixed_int<Bits> a, const fixed_int<Bits> &b) {
+	return a &= b;
+}
+
+template <int Bits>
+fixed_int<Bits> operator|(fixed_int<Bits> a, const fixed_int<Bits> &b) {
+	return a |= b;
+}
+
+template <int Bits>
+fixed_int<Bits> operator^(fixed_int<Bits> a, const fixed_int<Bits> &b) {
+	return a ^= b;
+}
+
+template <int Bits>
+fixed_int<Bits> operator<<(fixed_int<Bits> a, unsigned long shift) {
+	return a <<= shift;
+}
+
+template <int Bits>
+fixed_int<Bits> operator>>(fixed_int<Bits> a, unsigned long shift) {
+	return a >>= shift;
+}
+
+/* -1, 0 or 1 like bigint_compare */
+template <int Bits>
+int compare(const fixed_int<Bits> &a, const fixed_int<Bits> &b) {
+	constexpr int n = fixed_int<Bits>::nchunk;
+	FIXED_INT_UNROLL
+	for (int i = n-1; i >= 0; i--) {
+		if (a.chunks[i] != b.chunks[i]) {
+			return a.chunks[i] > b.chunks[i] ? 1 : -1;
+		}
+	}
+	return 0;
+}
+
+template <int Bits>
+bool operator==(const fixed_int<Bits> &a, const fixed_int<Bits> &b) {
+	unsigned long difference = 0;
+	FIXED_INT_UNROLL
+	for (int i = 0; i < fixed_int<Bits>::nchunk; i++) {
+		difference |= a.chunks[i] ^ b.chunks[i];
+	}
+	return difference == 0;
+}
+
+template <int Bits>
+bool operator!=(const fixed_int<Bits> &a, const fixed_int<Bits> &b) {
+	return !(a == b);
+}
+
+/* a < b is the borrow out of a-b */
+template <int Bits>
+bool operator<(const fixed_int<Bits> &a, const fixed_int<Bits> &b) {
+	unsigned long borrow = 0;
+	FIXED_INT_UNROLL
+	for (int i = 0; i < fixed_int<Bits>::nchunk; i++) {
+		chunk_sub_borrow(a.chunks[i], b.chunks[i], borrow, &borrow);
+	}
+	return borrow != 0;
+}
+
+template <int Bits>
+bool operator>(const fixed_int<Bits> &a, const fixed_int<Bits> &b) {
+	return b < a;
+}
+
+template <int Bits>
+bool operator<=(const fixed_int<Bits> &a, const fixed_int<Bits> &b) {
+	return !(b < a);
+}
+
+template <int Bits>
+bool operator>=(const fixed_int<Bits> &a, const fixed_int<Bits> &b) {
+	return !(a < b);
+}
+
+}
+
+#undef FIXED_INT_UNROLL
+
+#endif /*FIXED_INT_HPP_*/
@@ -15,8 +15,8 @@
 #define TIMED_BLOCK(niteration, description) for (\
 			struct timespec /* INIT: (i.e. before first iteration) */\
 				_tb_start, _tb_stop\
-				, _tb_sum={0}\
-				, _tb_i={0}/* comma expression is limited to a single type, so exploit struct timespec.tv_sec (time_t) as integer */\
+				, _tb_sum={0, 0}\
+				, _tb_i={0, 0}/* comma expression is limited to a single type, so exploit struct timespec.tv_sec (time_t) as integer */\
 				,_tb_niteration = {(niteration), 0} /* expand niteration once */\
 			; /* CONDITION: (i.e. before first and after every iteration)*/\
 				(\